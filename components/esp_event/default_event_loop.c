@@ -77,6 +77,18 @@ esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
 }
 
 
+esp_err_t esp_event_post_with_priority(esp_event_base_t event_base, int32_t event_id,
+        const void* event_data, size_t event_data_size, esp_event_priority_t priority, TickType_t ticks_to_wait)
+{
+    if (s_default_loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return esp_event_post_to_with_priority(s_default_loop, event_base, event_id,
+            event_data, event_data_size, priority, ticks_to_wait);
+}
+
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 esp_err_t esp_event_isr_post(esp_event_base_t event_base, int32_t event_id,
         const void* event_data, size_t event_data_size, BaseType_t* task_unblocked)
@@ -102,12 +114,16 @@ esp_err_t esp_event_loop_create_default(void)
         .task_name = "sys_evt",
         .task_stack_size = ESP_TASKD_EVENT_STACK,
         .task_priority = ESP_TASKD_EVENT_PRIO,
-        .task_core_id = 0
+        .task_core_id = 0,
     };
 
     esp_err_t err;
 
+#if CONFIG_ESP_EVENT_DEFAULT_LOOP_PRIORITY_LANES
+    err = esp_event_loop_create_with_priority_lanes(&loop_args, &s_default_loop);
+#else
     err = esp_event_loop_create(&loop_args, &s_default_loop);
+#endif
     if (err != ESP_OK) {
         return err;
     }
@@ -24,8 +24,8 @@
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
 // LOOP @<address, name> rx:<recieved events no.> dr:<dropped events no.>
 #define LOOP_DUMP_FORMAT              "LOOP @%p,%s rx:%u dr:%u\n"
- // handler @<address> ev:<base, id> inv:<times invoked> time:<runtime>
-#define HANDLER_DUMP_FORMAT           "  HANDLER @%p ev:%s,%s inv:%u time:%lld us\n"
+ // handler @<address> ev:<base, id> inv:<times invoked> time:<runtime> lat:<latency> max:<max. latency>
+#define HANDLER_DUMP_FORMAT           "  HANDLER @%p ev:%s,%s inv:%u time:%lld us lat:%lld us max:%lld us\n"
 
 #define PRINT_DUMP_INFO(dst, sz, ...)  do { \
                                             int cb = snprintf(dst, sz, __VA_ARGS__); \
@@ -34,6 +34,9 @@
                                         } while(0);
 #endif
 
+// Maximum number of queued events dispatched without releasing the loop mutex in between
+#define EVENT_LOOP_BATCH_SIZE         8
+
 /* ------------------------- Static Variables ------------------------------- */
 
 static const char* TAG = "event";
@@ -90,7 +93,7 @@ static int esp_event_dump_prepare(void)
     // Reserve slightly more memory than computed
     int allowance = 3;
     int size = (((loops + allowance) * (sizeof(LOOP_DUMP_FORMAT) + 10 + 20 + 2 * 11)) +
-                        ((handlers + allowance) * (sizeof(HANDLER_DUMP_FORMAT) + 10 + 2 * 20 + 11 + 20)));
+                        ((handlers + allowance) * (sizeof(HANDLER_DUMP_FORMAT) + 10 + 2 * 20 + 11 + 3 * 20)));
 
     return size;
 }
@@ -114,43 +117,58 @@ static void esp_event_loop_run_task(void* args)
     vTaskSuspend(NULL);
 }
 
-static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_node_t *handler, esp_event_post_instance_t post)
+static inline void* post_instance_data(esp_event_post_instance_t* post)
+{
+    if (!post->data_set) {
+        return NULL;
+    }
+    // Data which is not allocated is stored at the start of the union
+    return post->data_allocated ? post->data.ptr : (void*) &post->data;
+}
+
+static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_node_t *handler, esp_event_post_instance_t* post)
 {
-    ESP_LOGD(TAG, "running post %s:%d with handler %p and context %p on loop %p", post.base, post.id, handler->handler_ctx->handler, &handler->handler_ctx, loop);
+    ESP_LOGD(TAG, "running post %s:%d with handler %p and context %p on loop %p", post->base, post->id, handler->handler_ctx->handler, &handler->handler_ctx, loop);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     int64_t start, diff;
     start = esp_timer_get_time();
 #endif
     // Execute the handler
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
-    void* data_ptr = NULL;
-
-    if (post.data_set) {
-        if (post.data_allocated) {
-            data_ptr = post.data.ptr;
-        } else {
-            data_ptr = &post.data.val;
-        }
-    }
-
-    (*(handler->handler_ctx->handler))(handler->handler_ctx->arg, post.base, post.id, data_ptr);
-#else
-    (*(handler->handler_ctx->handler))(handler->handler_ctx->arg, post.base, post.id, post.data);
-#endif
+    (*(handler->handler_ctx->handler))(handler->handler_ctx->arg, post->base, post->id, post_instance_data(post));
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     diff = esp_timer_get_time() - start;
+    int64_t latency = start - post->time_posted;
 
     xSemaphoreTake(loop->profiling_mutex, portMAX_DELAY);
 
     handler->invoked++;
     handler->time += diff;
+    handler->latency += latency;
+    if (latency > handler->latency_max) {
+        handler->latency_max = latency;
+    }
 
     xSemaphoreGive(loop->profiling_mutex);
 #endif
 }
 
+// Returns false if the handler is to be executed but has been unregistered
+static inline bool handler_visit(esp_event_loop_instance_t* loop, esp_event_handler_node_t *handler,
+                                  esp_event_handler_node_t** handlers, size_t index, esp_event_post_instance_t* post)
+{
+    if (handlers) {
+        handlers[index] = handler;
+    } else if (post) {
+        if (!handler->handler_ctx->handler) {
+            return false;
+        }
+        handler_execute(loop, handler, post);
+    }
+    return true;
+}
+
 static esp_err_t handler_instances_add(esp_event_handler_nodes_t* handlers, esp_event_handler_t event_handler, void* event_handler_arg, esp_event_handler_instance_context_t **handler_ctx, bool legacy)
 {
     esp_event_handler_node_t *handler_instance = calloc(1, sizeof(*handler_instance));
@@ -311,23 +329,38 @@ static esp_err_t loop_node_add_handler(esp_event_loop_node_t* loop_node,
     }
 }
 
-static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static void handler_instance_delete(esp_event_handler_nodes_t* handlers, esp_event_handler_node_t* handler, bool dispatching)
+{
+    if (dispatching) {
+        // The event being dispatched may still reference the handler, and the lists may be
+        // being walked. Keep it in place until the dispatch is done, but make sure it is not
+        // executed anymore.
+        handler->handler_ctx->handler = NULL;
+        return;
+    }
+    SLIST_REMOVE(handlers, handler, esp_event_handler_node, next);
+    free(handler->handler_ctx);
+    free(handler);
+}
+
+static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, esp_event_handler_instance_context_t* handler_ctx, bool legacy,
+                                          bool dispatching)
 {
     esp_event_handler_node_t *it, *temp;
 
     SLIST_FOREACH_SAFE(it, handlers, next, temp) {
+        if (!it->handler_ctx->handler) {
+            // Already unregistered during the dispatch
+            continue;
+        }
         if (legacy) {
             if (it->handler_ctx->handler == handler_ctx->handler) {
-                SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-                free(it->handler_ctx);
-                free(it);
+                handler_instance_delete(handlers, it, dispatching);
                 return ESP_OK;
             }
         } else {
             if (it->handler_ctx == handler_ctx) {
-                SLIST_REMOVE(handlers, it, esp_event_handler_node, next);
-                free(it->handler_ctx);
-                free(it);
+                handler_instance_delete(handlers, it, dispatching);
                 return ESP_OK;
             }
         }
@@ -337,16 +370,17 @@ static esp_err_t handler_instances_remove(esp_event_handler_nodes_t* handlers, e
 }
 
 
-static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy,
+                                          bool dispatching)
 {
     if (id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(base_node->handlers), handler_ctx, legacy);
+        return handler_instances_remove(&(base_node->handlers), handler_ctx, legacy, dispatching);
     }
     else {
         esp_event_id_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(base_node->id_nodes), next, temp) {
             if (it->id == id) {
-                esp_err_t res = handler_instances_remove(&(it->handlers), handler_ctx, legacy);
+                esp_err_t res = handler_instances_remove(&(it->handlers), handler_ctx, legacy, dispatching);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers))) {
@@ -362,16 +396,17 @@ static esp_err_t base_node_remove_handler(esp_event_base_node_t* base_node, int3
     return ESP_ERR_NOT_FOUND;
 }
 
-static esp_err_t loop_node_remove_handler(esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy)
+static esp_err_t loop_node_remove_handler(esp_event_loop_node_t* loop_node, esp_event_base_t base, int32_t id, esp_event_handler_instance_context_t* handler_ctx, bool legacy,
+                                          bool dispatching)
 {
     if (base == esp_event_any_base && id == ESP_EVENT_ANY_ID) {
-        return handler_instances_remove(&(loop_node->handlers), handler_ctx, legacy);
+        return handler_instances_remove(&(loop_node->handlers), handler_ctx, legacy, dispatching);
     }
     else {
         esp_event_base_node_t *it, *temp;
         SLIST_FOREACH_SAFE(it, &(loop_node->base_nodes), next, temp) {
             if (it->base == base) {
-                esp_err_t res = base_node_remove_handler(it, id, handler_ctx, legacy);
+                esp_err_t res = base_node_remove_handler(it, id, handler_ctx, legacy, dispatching);
 
                 if (res == ESP_OK) {
                     if (SLIST_EMPTY(&(it->handlers)) && SLIST_EMPTY(&(it->id_nodes))) {
@@ -421,23 +456,231 @@ static void loop_node_remove_all_handler(esp_event_loop_node_t* loop_node)
     }
 }
 
+static void handler_instances_remove_unregistered(esp_event_handler_nodes_t* handlers)
+{
+    esp_event_handler_node_t *it, *temp;
+    SLIST_FOREACH_SAFE(it, handlers, next, temp) {
+        if (!it->handler_ctx->handler) {
+            handler_instance_delete(handlers, it, false);
+        }
+    }
+}
+
+// Frees the handlers unregistered during a dispatch, and the nodes they leave empty
+static void loop_remove_unregistered(esp_event_loop_instance_t* loop)
+{
+    esp_event_loop_node_t *loop_node, *temp_node;
+    esp_event_base_node_t *base_node, *temp_base;
+    esp_event_id_node_t *id_node, *temp_id_node;
+
+    SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
+        handler_instances_remove_unregistered(&(loop_node->handlers));
+
+        SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
+            handler_instances_remove_unregistered(&(base_node->handlers));
+
+            SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
+                handler_instances_remove_unregistered(&(id_node->handlers));
+                if (SLIST_EMPTY(&(id_node->handlers))) {
+                    SLIST_REMOVE(&(base_node->id_nodes), id_node, esp_event_id_node, next);
+                    free(id_node);
+                }
+            }
+
+            if (SLIST_EMPTY(&(base_node->handlers)) && SLIST_EMPTY(&(base_node->id_nodes))) {
+                SLIST_REMOVE(&(loop_node->base_nodes), base_node, esp_event_base_node, next);
+                free(base_node);
+            }
+        }
+
+        if (SLIST_EMPTY(&(loop_node->handlers)) && SLIST_EMPTY(&(loop_node->base_nodes))) {
+            SLIST_REMOVE(&(loop->loop_nodes), loop_node, esp_event_loop_node, next);
+            free(loop_node);
+        }
+    }
+}
+
+// Walks the handlers to be executed for an event, in the order of execution. The handlers are stored
+// in the array, if provided, or executed for the post right away otherwise. Returns the number of handlers
+// stored, or executed.
+static size_t handlers_walk(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id,
+                            esp_event_handler_node_t** handlers, esp_event_post_instance_t* post)
+{
+    size_t count = 0;
+
+    esp_event_handler_node_t *handler, *temp_handler;
+    esp_event_loop_node_t *loop_node, *temp_node;
+    esp_event_base_node_t *base_node, *temp_base;
+    esp_event_id_node_t *id_node, *temp_id_node;
+
+    SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
+        // Loop level handlers
+        SLIST_FOREACH_SAFE(handler, &(loop_node->handlers), next, temp_handler) {
+            count += handler_visit(loop, handler, handlers, count, post);
+        }
+
+        SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
+            if (base_node->base == base) {
+                // Base level handlers
+                SLIST_FOREACH_SAFE(handler, &(base_node->handlers), next, temp_handler) {
+                    count += handler_visit(loop, handler, handlers, count, post);
+                }
+
+                SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
+                    if (id_node->id == id) {
+                        // Id level handlers
+                        SLIST_FOREACH_SAFE(handler, &(id_node->handlers), next, temp_handler) {
+                            count += handler_visit(loop, handler, handlers, count, post);
+                        }
+                        // Skip to next base node
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+static inline size_t dispatch_bucket(esp_event_base_t base, int32_t id)
+{
+    // Event bases are compared by address, so hash the address rather than the string
+    uint32_t hash = ((uint32_t) (uintptr_t) base >> 2) ^ ((uint32_t) id * 2654435761u);
+    return (hash ^ (hash >> 16)) % ESP_EVENT_DISPATCH_BUCKETS;
+}
+
+static void dispatch_table_flush(esp_event_loop_instance_t* loop)
+{
+    for (int i = 0; i < ESP_EVENT_DISPATCH_BUCKETS; i++) {
+        esp_event_dispatch_entry_t *it = loop->dispatch_table[i], *temp;
+        while (it) {
+            temp = it->next;
+            if (it == loop->dispatch_current) {
+                // Still being dispatched, freed once done
+                loop->dispatch_current_flushed = true;
+            } else {
+                free(it);
+            }
+            it = temp;
+        }
+        loop->dispatch_table[i] = NULL;
+    }
+    loop->dispatch_entries = 0;
+}
+
+// Returns the handlers to be executed for an event, indexing them if this is the first time
+// the event is dispatched since the handlers changed. Returns NULL if out of memory.
+static esp_event_dispatch_entry_t* dispatch_entry_get(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    size_t bucket = dispatch_bucket(base, id);
+    esp_event_dispatch_entry_t* entry;
+
+    for (entry = loop->dispatch_table[bucket]; entry != NULL; entry = entry->next) {
+        if (entry->base == base && entry->id == id) {
+            return entry;
+        }
+    }
+
+    // Bound the memory used by loops which get many different events posted
+    if (loop->dispatch_entries >= ESP_EVENT_DISPATCH_MAX_ENTRIES) {
+        dispatch_table_flush(loop);
+    }
+
+    size_t count = handlers_walk(loop, base, id, NULL, NULL);
+    entry = malloc(sizeof(*entry) + count * sizeof(entry->handlers[0]));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->base = base;
+    entry->id = id;
+    entry->count = handlers_walk(loop, base, id, entry->handlers, NULL);
+    entry->next = loop->dispatch_table[bucket];
+    loop->dispatch_table[bucket] = entry;
+    loop->dispatch_entries++;
+
+    return entry;
+}
+
 static void inline __attribute__((always_inline)) post_instance_delete(esp_event_post_instance_t* post)
 {
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
     if (post->data_allocated && post->data.ptr) {
         free(post->data.ptr);
     }
-#else
-    if (post->data) {
-        free(post->data);
-    }
-#endif
     memset(post, 0, sizeof(*post));
 }
 
+static QueueHandle_t loop_queue(esp_event_loop_instance_t* loop, esp_event_priority_t priority)
+{
+    return loop->pending ? loop->lanes[priority] : loop->queue;
+}
+
+static BaseType_t loop_receive(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post, TickType_t ticks_to_wait)
+{
+    if (loop->pending == NULL) {
+        return xQueueReceive(loop->queue, post, ticks_to_wait);
+    }
+
+    // Events are counted once queued and received once counted, so a counted event is always found
+    if (xSemaphoreTake(loop->pending, ticks_to_wait) != pdTRUE) {
+        return pdFALSE;
+    }
+    for (int i = ESP_EVENT_PRIORITY_MAX - 1; i >= 0; i--) {
+        if (xQueueReceive(loop->lanes[i], post, 0) == pdTRUE) {
+            return pdTRUE;
+        }
+    }
+    return pdFALSE;
+}
+
+static void loop_dispatch(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
+{
+    bool exec = false;
+
+    // Handlers may register or unregister handlers while the event is dispatched. The handlers
+    // to be executed are taken when the dispatch starts, and unregistered ones are skipped.
+    loop->dispatching = true;
+
+    esp_event_dispatch_entry_t* entry = dispatch_entry_get(loop, post->base, post->id);
+
+    if (entry) {
+        loop->dispatch_current = entry;
+
+        for (size_t i = 0; i < entry->count; i++) {
+            if (entry->handlers[i]->handler_ctx->handler) {
+                handler_execute(loop, entry->handlers[i], post);
+                exec = true;
+            }
+        }
+
+        if (loop->dispatch_current_flushed) {
+            free(entry);
+            loop->dispatch_current_flushed = false;
+        }
+        loop->dispatch_current = NULL;
+    } else {
+        // Not enough memory to index the handlers, execute them while walking the lists
+        exec = handlers_walk(loop, post->base, post->id, NULL, post) > 0;
+    }
+
+    loop->dispatching = false;
+    if (loop->handlers_unregistered) {
+        loop_remove_unregistered(loop);
+        loop->handlers_unregistered = false;
+    }
+
+    if (!exec) {
+        // No handlers were executed, not even loop/base level handlers
+        ESP_LOGD(TAG, "no handlers have been registered for event %s:%d posted to loop %p", post->base, post->id, loop);
+    }
+
+    post_instance_delete(post);
+}
+
 /* ---------------------------- Public API --------------------------------- */
 
-esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, esp_event_loop_handle_t* event_loop)
+static esp_err_t loop_create(const esp_event_loop_args_t* event_loop_args, bool priority_lanes, esp_event_loop_handle_t* event_loop)
 {
     if (event_loop_args == NULL) {
         ESP_LOGE(TAG, "event_loop_args was NULL");
@@ -464,6 +707,26 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
         goto on_err;
     }
 
+    if (priority_lanes) {
+        for (int i = 0; i < ESP_EVENT_PRIORITY_MAX; i++) {
+            if (i == ESP_EVENT_PRIORITY_NORMAL) {
+                loop->lanes[i] = loop->queue;
+                continue;
+            }
+            loop->lanes[i] = xQueueCreate(event_loop_args->queue_size, sizeof(esp_event_post_instance_t));
+            if (loop->lanes[i] == NULL) {
+                ESP_LOGE(TAG, "create event loop queue failed");
+                goto on_err;
+            }
+        }
+
+        loop->pending = xSemaphoreCreateCounting(ESP_EVENT_PRIORITY_MAX * event_loop_args->queue_size, 0);
+        if (loop->pending == NULL) {
+            ESP_LOGE(TAG, "create event loop semaphore failed");
+            goto on_err;
+        }
+    }
+
     loop->mutex = xSemaphoreCreateRecursiveMutex();
     if (loop->mutex == NULL) {
         ESP_LOGE(TAG, "create event loop mutex failed");
@@ -515,6 +778,16 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
     return ESP_OK;
 
 on_err:
+    for (int i = 0; i < ESP_EVENT_PRIORITY_MAX; i++) {
+        if (loop->lanes[i] != NULL && loop->lanes[i] != loop->queue) {
+            vQueueDelete(loop->lanes[i]);
+        }
+    }
+
+    if (loop->pending != NULL) {
+        vSemaphoreDelete(loop->pending);
+    }
+
     if (loop->queue != NULL) {
         vQueueDelete(loop->queue);
     }
@@ -534,12 +807,20 @@ on_err:
     return err;
 }
 
-// On event lookup performance: The library implements the event list as a linked list, which results to O(n)
-// lookup time. The test comparing this implementation to the O(lg n) performance of rbtrees
-// (https://github.com/freebsd/freebsd/blob/master/sys/sys/tree.h)
-// indicate that the difference is not that substantial, especially considering the additional
-// pointers per node of rbtrees. Code for the rbtree implementation of the event loop library is archived
-// in feature/esp_event_loop_library_rbtrees if needed.
+esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, esp_event_loop_handle_t* event_loop)
+{
+    return loop_create(event_loop_args, false, event_loop);
+}
+
+esp_err_t esp_event_loop_create_with_priority_lanes(const esp_event_loop_args_t* event_loop_args, esp_event_loop_handle_t* event_loop)
+{
+    return loop_create(event_loop_args, true, event_loop);
+}
+
+// On event lookup performance: The handlers are registered in linked lists, one per event base, event id and
+// registration order. Walking them for every post costs time proportional to the number of registered events. The
+// handlers to be executed for an event are therefore looked up once and kept in a hash table indexed by event base
+// and id, which is flushed whenever a handler is registered or unregistered.
 esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
 {
     assert(event_loop);
@@ -555,74 +836,37 @@ esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t tick
     int64_t remaining_ticks = ticks_to_run;
 #endif
 
-    while(xQueueReceive(loop->queue, &post, ticks_to_run) == pdTRUE) {
+    bool expired = false;
+
+    while(!expired && loop_receive(loop, &post, ticks_to_run) == pdTRUE) {
         // The event has already been unqueued, so ensure it gets executed.
         xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
         loop->running_task = xTaskGetCurrentTaskHandle();
 
-        bool exec = false;
+        // Dispatch the events queued meanwhile as well, without waiting on the queue
+        // or releasing the mutex in between, but for a bounded number of events
+        int dispatched = 0;
 
-        esp_event_handler_node_t *handler, *temp_handler;
-        esp_event_loop_node_t *loop_node, *temp_node;
-        esp_event_base_node_t *base_node, *temp_base;
-        esp_event_id_node_t *id_node, *temp_id_node;
+        do {
+            loop_dispatch(loop, &post);
+            dispatched++;
 
-        SLIST_FOREACH_SAFE(loop_node, &(loop->loop_nodes), next, temp_node) {
-            // Execute loop level handlers
-            SLIST_FOREACH_SAFE(handler, &(loop_node->handlers), next, temp_handler) {
-                handler_execute(loop, handler, post);
-                exec |= true;
-            }
-
-            SLIST_FOREACH_SAFE(base_node, &(loop_node->base_nodes), next, temp_base) {
-                if (base_node->base == post.base) {
-                    // Execute base level handlers
-                    SLIST_FOREACH_SAFE(handler, &(base_node->handlers), next, temp_handler) {
-                        handler_execute(loop, handler, post);
-                        exec |= true;
-                    }
-
-                    SLIST_FOREACH_SAFE(id_node, &(base_node->id_nodes), next, temp_id_node) {
-                        if (id_node->id == post.id) {
-                            // Execute id level handlers
-                            SLIST_FOREACH_SAFE(handler, &(id_node->handlers), next, temp_handler) {
-                                handler_execute(loop, handler, post);
-                                exec |= true;
-                            }
-                            // Skip to next base node
-                            break;
-                        }
-                    }
-                }
-            }
-        }
-
-        esp_event_base_t base = post.base;
-        int32_t id = post.id;
-
-        post_instance_delete(&post);
-
-        if (ticks_to_run != portMAX_DELAY) {
-            end = xTaskGetTickCount();
-            remaining_ticks -= end - marker;
-            // If the ticks to run expired, return to the caller
-            if (remaining_ticks <= 0) {
-                xSemaphoreGiveRecursive(loop->mutex);
-                break;
-            } else {
+            if (ticks_to_run != portMAX_DELAY) {
+                end = xTaskGetTickCount();
+                remaining_ticks -= end - marker;
                 marker = end;
+                // If the ticks to run expired, return to the caller
+                if (remaining_ticks <= 0) {
+                    expired = true;
+                    break;
+                }
             }
-        }
+        } while (dispatched < EVENT_LOOP_BATCH_SIZE && loop_receive(loop, &post, 0) == pdTRUE);
 
         loop->running_task = NULL;
 
         xSemaphoreGiveRecursive(loop->mutex);
-
-        if (!exec) {
-            // No handlers were registered, not even loop/base level handlers
-            ESP_LOGD(TAG, "no handlers have been registered for event %s:%d posted to loop %p", base, id, event_loop);
-        }
     }
 
     return ESP_OK;
@@ -659,14 +903,23 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
         SLIST_REMOVE(&(loop->loop_nodes), it, esp_event_loop_node, next);
         free(it);
     }
+    dispatch_table_flush(loop);
 
     // Drop existing posts on the queue
     esp_event_post_instance_t post;
-    while(xQueueReceive(loop->queue, &post, 0) == pdTRUE) {
+    while(loop_receive(loop, &post, 0) == pdTRUE) {
         post_instance_delete(&post);
     }
 
     // Cleanup loop
+    for (int i = 0; i < ESP_EVENT_PRIORITY_MAX; i++) {
+        if (loop->lanes[i] != NULL && loop->lanes[i] != loop->queue) {
+            vQueueDelete(loop->lanes[i]);
+        }
+    }
+    if (loop->pending != NULL) {
+        vSemaphoreDelete(loop->pending);
+    }
     vQueueDelete(loop->queue);
     free(loop);
     // Free loop mutex before deleting
@@ -742,6 +995,10 @@ esp_err_t esp_event_handler_register_with_internal(esp_event_loop_handle_t event
         err = loop_node_add_handler(last_loop_node, event_base, event_id, event_handler, event_handler_arg, handler_ctx_arg, legacy);
     }
 
+    if (err == ESP_OK) {
+        dispatch_table_flush(loop);
+    }
+
 on_err:
     xSemaphoreGiveRecursive(loop->mutex);
     return err;
@@ -781,8 +1038,12 @@ esp_err_t esp_event_handler_unregister_with_internal(esp_event_loop_handle_t eve
 
     esp_event_loop_node_t *it, *temp;
 
+    // Handlers unregistered by a handler are only marked, and freed after the dispatch
+    bool dispatching = loop->dispatching;
+    loop->handlers_unregistered |= dispatching;
+
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
-        esp_err_t res = loop_node_remove_handler(it, event_base, event_id, handler_ctx, legacy);
+        esp_err_t res = loop_node_remove_handler(it, event_base, event_id, handler_ctx, legacy, dispatching);
 
         if (res == ESP_OK && SLIST_EMPTY(&(it->base_nodes)) && SLIST_EMPTY(&(it->handlers))) {
             SLIST_REMOVE(&(loop->loop_nodes), it, esp_event_loop_node, next);
@@ -791,6 +1052,8 @@ esp_err_t esp_event_handler_unregister_with_internal(esp_event_loop_handle_t eve
         }
     }
 
+    dispatch_table_flush(loop);
+
     xSemaphoreGiveRecursive(loop->mutex);
 
     return ESP_OK;
@@ -816,6 +1079,14 @@ esp_err_t esp_event_handler_instance_unregister_with(esp_event_loop_handle_t eve
 
 esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
                             const void* event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    return esp_event_post_to_with_priority(event_loop, event_base, event_id, event_data, event_data_size,
+                                           ESP_EVENT_PRIORITY_NORMAL, ticks_to_wait);
+}
+
+esp_err_t esp_event_post_to_with_priority(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                                          const void* event_data, size_t event_data_size, esp_event_priority_t priority,
+                                          TickType_t ticks_to_wait)
 {
     assert(event_loop);
 
@@ -823,30 +1094,39 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (priority < ESP_EVENT_PRIORITY_LOW || priority >= ESP_EVENT_PRIORITY_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
     esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+    QueueHandle_t queue = loop_queue(loop, priority);
 
     esp_event_post_instance_t post;
     memset((void*)(&post), 0, sizeof(post));
 
     if (event_data != NULL && event_data_size != 0) {
-        // Make persistent copy of event data on heap.
-        void* event_data_copy = calloc(1, event_data_size);
+        if (event_data_size <= sizeof(post.data)) {
+            // Small enough to be carried by the queue item itself
+            memcpy((void*)(&post.data), event_data, event_data_size);
+        } else {
+            // Make persistent copy of event data on heap.
+            void* event_data_copy = calloc(1, event_data_size);
 
-        if (event_data_copy == NULL) {
-            return ESP_ERR_NO_MEM;
-        }
+            if (event_data_copy == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
 
-        memcpy(event_data_copy, event_data, event_data_size);
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
-        post.data.ptr = event_data_copy;
-        post.data_allocated = true;
+            memcpy(event_data_copy, event_data, event_data_size);
+            post.data.ptr = event_data_copy;
+            post.data_allocated = true;
+        }
         post.data_set = true;
-#else
-        post.data = event_data_copy;
-#endif
     }
     post.base = event_base;
     post.id = event_id;
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    post.time_posted = esp_timer_get_time();
+#endif
 
     BaseType_t result = pdFALSE;
 
@@ -859,18 +1139,18 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
         if (result == pdTRUE) {
             if (loop->running_task != xTaskGetCurrentTaskHandle()) {
                 xSemaphoreGiveRecursive(loop->mutex);
-                result = xQueueSendToBack(loop->queue, &post, ticks_to_wait);
+                result = xQueueSendToBack(queue, &post, ticks_to_wait);
             } else {
                 xSemaphoreGiveRecursive(loop->mutex);
-                result = xQueueSendToBack(loop->queue, &post, 0);
+                result = xQueueSendToBack(queue, &post, 0);
             }
         }
     } else {
         // The loop has a dedicated task.
         if (loop->task != xTaskGetCurrentTaskHandle()) {
-            result = xQueueSendToBack(loop->queue, &post, ticks_to_wait);
+            result = xQueueSendToBack(queue, &post, ticks_to_wait);
         } else {
-            result = xQueueSendToBack(loop->queue, &post, 0);
+            result = xQueueSendToBack(queue, &post, 0);
         }
     }
 
@@ -883,6 +1163,10 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
         return ESP_ERR_TIMEOUT;
     }
 
+    if (loop->pending) {
+        xSemaphoreGive(loop->pending);
+    }
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_fetch_add(&loop->events_recieved, 1);
 #endif
@@ -905,23 +1189,30 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_ba
     esp_event_post_instance_t post;
     memset((void*)(&post), 0, sizeof(post));
 
-    if (event_data_size > sizeof(post.data.val)) {
+    if (event_data_size > sizeof(post.data)) {
         return ESP_ERR_INVALID_ARG;
     }
 
     if (event_data != NULL && event_data_size != 0) {
-        memcpy((void*)(&(post.data.val)), event_data, event_data_size);
+        memcpy((void*)(&post.data), event_data, event_data_size);
         post.data_allocated = false;
         post.data_set = true;
     }
     post.base = event_base;
     post.id = event_id;
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    post.time_posted = esp_timer_get_time();
+#endif
 
     BaseType_t result = pdFALSE;
 
     // Post the event from an ISR,
     result = xQueueSendToBackFromISR(loop->queue, &post, task_unblocked);
 
+    if (result == pdTRUE && loop->pending) {
+        xSemaphoreGiveFromISR(loop->pending, task_unblocked);
+    }
+
     if (result != pdTRUE) {
         post_instance_delete(&post);
 
@@ -974,13 +1265,15 @@ esp_err_t esp_event_dump(FILE* file)
         SLIST_FOREACH(loop_node_it, &(loop_it->loop_nodes), next) {
             SLIST_FOREACH(handler_it, &(loop_node_it->handlers), next) {
                 PRINT_DUMP_INFO(dst, sz, HANDLER_DUMP_FORMAT, handler_it->handler_ctx->handler, "ESP_EVENT_ANY_BASE",
-                                "ESP_EVENT_ANY_ID", handler_it->invoked, handler_it->time);
+                                "ESP_EVENT_ANY_ID", handler_it->invoked, handler_it->time,
+                                handler_it->latency, handler_it->latency_max);
             }
 
             SLIST_FOREACH(base_node_it, &(loop_node_it->base_nodes), next) {
                 SLIST_FOREACH(handler_it, &(base_node_it->handlers), next) {
                     PRINT_DUMP_INFO(dst, sz, HANDLER_DUMP_FORMAT, handler_it->handler_ctx->handler, base_node_it->base ,
-                                    "ESP_EVENT_ANY_ID", handler_it->invoked, handler_it->time);
+                                    "ESP_EVENT_ANY_ID", handler_it->invoked, handler_it->time,
+                                    handler_it->latency, handler_it->latency_max);
                 }
 
                 SLIST_FOREACH(id_node_it, &(base_node_it->id_nodes), next) {
@@ -989,7 +1282,8 @@ esp_err_t esp_event_dump(FILE* file)
                         snprintf(id_str_buf, sizeof(id_str_buf), "%d", id_node_it->id);
 
                         PRINT_DUMP_INFO(dst, sz, HANDLER_DUMP_FORMAT, handler_it->handler_ctx->handler, base_node_it->base ,
-                                        id_str_buf, handler_it->invoked, handler_it->time);
+                                        id_str_buf, handler_it->invoked, handler_it->time,
+                                        handler_it->latency, handler_it->latency_max);
                     }
                 }
             }
@@ -10,6 +10,9 @@
 #define CATCH_CONFIG_MAIN
 
 #include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
 #include "esp_event.h"
 
 #include "catch.hpp"
@@ -43,6 +46,66 @@ static esp_event_loop_args_t test_event_get_default_loop_args(void)
 
 void dummy_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data) { }
 
+ESP_EVENT_DEFINE_BASE(s_bench_base);
+
+/**
+ * FIFO standing in for the FreeRTOS queue of an event loop without a dedicated task,
+ * so that events can actually be posted and dispatched by the mocked FreeRTOS.
+ */
+struct FakeQueue {
+    std::vector<uint8_t> items;
+    size_t item_size = 0;
+    size_t length = 0;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+static FakeQueue s_fake_queue;
+
+QueueHandle_t fake_queue_create(const UBaseType_t length, const UBaseType_t item_size, const uint8_t type, int num_calls)
+{
+    s_fake_queue.items.assign(length * item_size, 0);
+    s_fake_queue.item_size = item_size;
+    s_fake_queue.length = length;
+    s_fake_queue.head = 0;
+    s_fake_queue.count = 0;
+    return reinterpret_cast<QueueHandle_t>(&s_fake_queue);
+}
+
+BaseType_t fake_queue_send(QueueHandle_t queue, const void * const item, TickType_t ticks, const BaseType_t position, int num_calls)
+{
+    if (s_fake_queue.count == s_fake_queue.length) {
+        return pdFALSE;
+    }
+    size_t tail = (s_fake_queue.head + s_fake_queue.count) % s_fake_queue.length;
+    memcpy(&s_fake_queue.items[tail * s_fake_queue.item_size], item, s_fake_queue.item_size);
+    s_fake_queue.count++;
+    return pdTRUE;
+}
+
+BaseType_t fake_queue_receive(QueueHandle_t queue, void * const item, TickType_t ticks, int num_calls)
+{
+    if (s_fake_queue.count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, &s_fake_queue.items[s_fake_queue.head * s_fake_queue.item_size], s_fake_queue.item_size);
+    s_fake_queue.head = (s_fake_queue.head + 1) % s_fake_queue.length;
+    s_fake_queue.count--;
+    return pdTRUE;
+}
+
+struct BenchData {
+    size_t received;
+    uint8_t last;
+};
+
+void bench_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    BenchData *bench = static_cast<BenchData*>(event_handler_arg);
+    bench->received++;
+    bench->last = static_cast<uint8_t*>(event_data)[0];
+}
+
 }
 
 // TODO: IDF-2693, function definition just to satisfy linker, implement esp_common instead
@@ -150,3 +213,58 @@ TEST_CASE("registering with ANY_BASE but specific ID fails") {
             dummy_handler,
             nullptr) == ESP_ERR_INVALID_ARG);
 }
+
+TEST_CASE("posting and dispatching events benchmark", "[benchmark]")
+{
+    MockMutex sem(CreateAnd::IGNORE);
+    xQueueGenericCreate_Stub(fake_queue_create);
+    xQueueGenericSend_Stub(fake_queue_send);
+    xQueueReceive_Stub(fake_queue_receive);
+    xQueueTakeMutexRecursive_IgnoreAndReturn(pdTRUE);
+    xQueueGiveMutexRecursive_IgnoreAndReturn(pdTRUE);
+    xTaskGetCurrentTaskHandle_IgnoreAndReturn(reinterpret_cast<TaskHandle_t>(1));
+    xTaskGetTickCount_IgnoreAndReturn(0);
+
+    esp_event_loop_handle_t loop = nullptr;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+    loop_args.task_name = nullptr;
+    REQUIRE(ESP_OK == esp_event_loop_create(&loop_args, &loop));
+
+    BenchData bench = {};
+    REQUIRE(ESP_OK == esp_event_handler_register_with(loop, s_bench_base, 1, bench_handler, &bench));
+
+    const size_t EVENTS = 100000; // multiple of the queue size
+    // Payloads stored in the queue item and payloads copied to the heap
+    const size_t payload_sizes[] = {4, CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE, CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE + 64};
+    for (size_t size : payload_sizes) {
+        if (size == 0) {
+            continue;
+        }
+        std::vector<uint8_t> payload(size, 0);
+        bench.received = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < EVENTS; i += QUEUE_SIZE) {
+            for (size_t j = 0; j < QUEUE_SIZE; j++) {
+                payload[0] = static_cast<uint8_t>(i + j);
+                REQUIRE(ESP_OK == esp_event_post_to(loop, s_bench_base, 1, payload.data(), size, 0));
+            }
+            REQUIRE(ESP_OK == esp_event_loop_run(loop, portMAX_DELAY));
+            CHECK(bench.last == payload[0]);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        CHECK(bench.received == EVENTS);
+        printf("payload of %zu bytes: %.0f events/s\n", size, bench.received / elapsed.count());
+    }
+
+    CHECK(ESP_OK == esp_event_loop_delete(loop));
+
+    xQueueGenericCreate_Stub(nullptr);
+    xQueueGenericSend_Stub(nullptr);
+    xQueueReceive_Stub(nullptr);
+    xQueueTakeMutexRecursive_StopIgnore();
+    xQueueGiveMutexRecursive_StopIgnore();
+    xTaskGetCurrentTaskHandle_StopIgnore();
+    xTaskGetTickCount_StopIgnore();
+}
@@ -31,6 +31,14 @@ typedef struct {
                                                         ignored if task name is NULL */
 } esp_event_loop_args_t;
 
+/// Priority of a posted event, see esp_event_post_to_with_priority
+typedef enum {
+    ESP_EVENT_PRIORITY_LOW = 0,                 /**< dispatched after the events of the other priorities */
+    ESP_EVENT_PRIORITY_NORMAL,                  /**< priority of the events posted with esp_event_post_to */
+    ESP_EVENT_PRIORITY_HIGH,                    /**< dispatched before the events of the other priorities */
+    ESP_EVENT_PRIORITY_MAX,                     /**< number of priorities */
+} esp_event_priority_t;
+
 /**
  * @brief Create a new event loop.
  *
@@ -46,6 +54,25 @@ typedef struct {
  */
 esp_err_t esp_event_loop_create(const esp_event_loop_args_t *event_loop_args, esp_event_loop_handle_t *event_loop);
 
+/**
+ * @brief Create a new event loop with priority lanes.
+ *
+ * The loop has a queue of queue_size events for each event priority, and dispatches the pending events of
+ * higher priority first, see esp_event_post_to_with_priority. Loops created with esp_event_loop_create
+ * dispatch events in the order they are posted, whatever their priority.
+ *
+ * @param[in] event_loop_args configuration structure for the event loop to create
+ * @param[out] event_loop handle to the created event loop
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_INVALID_ARG: event_loop_args or event_loop was NULL
+ *  - ESP_ERR_NO_MEM: Cannot allocate memory for event loops list
+ *  - ESP_FAIL: Failed to create task loop
+ *  - Others: Fail
+ */
+esp_err_t esp_event_loop_create_with_priority_lanes(const esp_event_loop_args_t *event_loop_args, esp_event_loop_handle_t *event_loop);
+
 /**
  * @brief Delete an existing event loop.
  *
@@ -94,6 +121,10 @@ esp_err_t esp_event_loop_delete_default(void);
  * In cases where waiting on the queue times out, ESP_OK is returned and not ESP_ERR_TIMEOUT, since it is
  * normal behavior.
  *
+ * The events which are already queued when an event is dequeued are dispatched along with it, without blocking
+ * on the queue again or releasing the internal mutex in between. On loops with priority lanes, the pending event
+ * of highest priority is always dispatched next.
+ *
  * @param[in] event_loop event loop to dispatch posted events from, must not be NULL
  * @param[in] ticks_to_run number of ticks to run the loop
  *
@@ -352,7 +383,8 @@ esp_err_t esp_event_handler_instance_unregister(esp_event_base_t event_base,
 /**
  * @brief Posts an event to the system default event loop. The event loop library keeps a copy of event_data and manages
  * the copy's lifetime automatically (allocation + deletion); this ensures that the data the
- * handler receives is always valid.
+ * handler receives is always valid. Event data of up to CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE bytes
+ * is stored in the event queue and doesn't need a heap allocation.
  *
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event ID that identifies the event
@@ -376,7 +408,8 @@ esp_err_t esp_event_post(esp_event_base_t event_base,
 /**
  * @brief Posts an event to the specified event loop. The event loop library keeps a copy of event_data and manages
  * the copy's lifetime automatically (allocation + deletion); this ensures that the data the
- * handler receives is always valid.
+ * handler receives is always valid. Event data of up to CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE bytes
+ * is stored in the event queue and doesn't need a heap allocation.
  *
  * This function behaves in the same manner as esp_event_post_to, except the additional specification of the event loop
  * to post the event to.
@@ -402,6 +435,66 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
                             size_t event_data_size,
                             TickType_t ticks_to_wait);
 
+/**
+ * @brief Posts an event of the given priority to the system default event loop.
+ *
+ * This function behaves in the same manner as esp_event_post_to_with_priority, except the event is posted to the
+ * system default event loop. The system default event loop has priority lanes if
+ * CONFIG_ESP_EVENT_DEFAULT_LOOP_PRIORITY_LANES is enabled.
+ *
+ * @param[in] event_base the event base that identifies the event
+ * @param[in] event_id the event ID that identifies the event
+ * @param[in] event_data the data, specific to the event occurrence, that gets passed to the handler
+ * @param[in] event_data_size the size of the event data
+ * @param[in] priority the priority of the event
+ * @param[in] ticks_to_wait number of ticks to block on a full event queue
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_TIMEOUT: Time to wait for event queue to unblock expired,
+ *                      queue full when posting from ISR
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID, invalid priority
+ *  - Others: Fail
+ */
+esp_err_t esp_event_post_with_priority(esp_event_base_t event_base,
+                                       int32_t event_id,
+                                       const void *event_data,
+                                       size_t event_data_size,
+                                       esp_event_priority_t priority,
+                                       TickType_t ticks_to_wait);
+
+/**
+ * @brief Posts an event of the given priority to the specified event loop.
+ *
+ * This function behaves in the same manner as esp_event_post_to, except the additional specification of the event
+ * priority. If the event loop has been created with esp_event_loop_create_with_priority_lanes, the pending events of higher priority are
+ * dispatched first, and the events of the same priority in the order they are posted. Each priority has its own
+ * queue, so a full queue of low priority events doesn't prevent posting events of higher priority. Otherwise the
+ * priority is ignored.
+ *
+ * @param[in] event_loop the event loop to post to, must not be NULL
+ * @param[in] event_base the event base that identifies the event
+ * @param[in] event_id the event ID that identifies the event
+ * @param[in] event_data the data, specific to the event occurrence, that gets passed to the handler
+ * @param[in] event_data_size the size of the event data
+ * @param[in] priority the priority of the event
+ * @param[in] ticks_to_wait number of ticks to block on a full event queue
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_TIMEOUT: Time to wait for event queue to unblock expired,
+ *                      queue full when posting from ISR
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID, invalid priority
+ *  - Others: Fail
+ */
+esp_err_t esp_event_post_to_with_priority(esp_event_loop_handle_t event_loop,
+                                          esp_event_base_t event_base,
+                                          int32_t event_id,
+                                          const void *event_data,
+                                          size_t event_data_size,
+                                          esp_event_priority_t priority,
+                                          TickType_t ticks_to_wait);
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 /**
  * @brief Special variant of esp_event_post for posting events from interrupt handlers.
@@ -409,7 +502,8 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event ID that identifies the event
  * @param[in] event_data the data, specific to the event occurrence, that gets passed to the handler
- * @param[in] event_data_size the size of the event data; max is 4 bytes
+ * @param[in] event_data_size the size of the event data; max is 4 bytes, or
+ *                            CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE if larger
  * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with
  *                            higher priority than currently running task has been unblocked by the posted event;
  *                            a context switch should be requested before the interrupt is existed.
@@ -422,7 +516,7 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
  *  - ESP_OK: Success
  *  - ESP_FAIL: Event queue for the default event loop full
  *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID,
- *                          data size of more than 4 bytes
+ *                          data size of more than the maximum
  *  - Others: Fail
  */
 esp_err_t esp_event_isr_post(esp_event_base_t event_base,
@@ -438,7 +532,8 @@ esp_err_t esp_event_isr_post(esp_event_base_t event_base,
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event ID that identifies the event
  * @param[in] event_data the data, specific to the event occurrence, that gets passed to the handler
- * @param[in] event_data_size the size of the event data
+ * @param[in] event_data_size the size of the event data; max is 4 bytes, or
+ *                            CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE if larger
  * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with
  *                            higher priority than currently running task has been unblocked by the posted event;
  *                            a context switch should be requested before the interrupt is existed.
@@ -451,7 +546,7 @@ esp_err_t esp_event_isr_post(esp_event_base_t event_base,
  *  - ESP_OK: Success
  *  - ESP_FAIL: Event queue for the loop full
  *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event ID,
- *                          data size of more than 4 bytes
+ *                          data size of more than the maximum
  *  - Others: Fail
  */
 esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
@@ -488,12 +583,14 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
            total_dropped - number of events unsuccessfully posted due to queue being full
 
    handler
-       format: address ev:base,id inv:total_invoked run:total_runtime
+       format: address ev:base,id inv:total_invoked run:total_runtime lat:total_latency max:max_latency
        where:
            address - address of the handler function
            base,id - the event specified by event base and ID this handler executes
            total_invoked - number of times this handler has been invoked
            total_runtime - total amount of time used for invoking this handler
+           total_latency - total amount of time from posting the events to invoking this handler
+           max_latency - longest time from posting an event to invoking this handler
 
  @endverbatim
  *
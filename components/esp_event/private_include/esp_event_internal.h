@@ -37,6 +37,8 @@ typedef struct esp_event_handler_node {
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     uint32_t invoked;                                               /**< number of times this handler has been invoked */
     int64_t time;                                                   /**< total runtime of this handler across all calls */
+    int64_t latency;                                                /**< total time from posting events to invoking this handler */
+    int64_t latency_max;                                            /**< longest time from posting an event to invoking this handler */
 #endif
     SLIST_ENTRY(esp_event_handler_node) next;                   /**< next event handler in the list */
 } esp_event_handler_node_t;
@@ -73,16 +75,44 @@ typedef struct esp_event_loop_node {
 
 typedef SLIST_HEAD(esp_event_loop_nodes, esp_event_loop_node) esp_event_loop_nodes_t;
 
+#define ESP_EVENT_DISPATCH_BUCKETS      16                              /**< number of buckets of the dispatch table */
+#define ESP_EVENT_DISPATCH_MAX_ENTRIES  64                              /**< number of events in the dispatch table
+                                                                            before it is flushed */
+
+/// Handlers to be executed for an event, in the order of execution
+typedef struct esp_event_dispatch_entry {
+    esp_event_base_t base;                                          /**< base identifier of the event */
+    int32_t id;                                                     /**< id number of the event */
+    struct esp_event_dispatch_entry* next;                          /**< next entry in the same bucket */
+    size_t count;                                                   /**< number of handlers */
+    esp_event_handler_node_t* handlers[];                           /**< handlers to be executed */
+} esp_event_dispatch_entry_t;
+
 /// Event loop
 typedef struct esp_event_loop_instance {
     const char* name;                                               /**< name of this event loop */
-    QueueHandle_t queue;                                            /**< event queue */
+    QueueHandle_t queue;                                            /**< event queue, of the normal priority events
+                                                                            if the loop has priority lanes */
+    QueueHandle_t lanes[ESP_EVENT_PRIORITY_MAX];                    /**< event queue of each priority, including queue;
+                                                                            NULL if the loop has no priority lanes */
+    SemaphoreHandle_t pending;                                      /**< number of events queued in the lanes */
     TaskHandle_t task;                                              /**< task that consumes the event queue */
     TaskHandle_t running_task;                                      /**< for loops with no dedicated task, the
                                                                             task that consumes the queue */
     SemaphoreHandle_t mutex;                                        /**< mutex for updating the events linked list */
     esp_event_loop_nodes_t loop_nodes;                              /**< set of linked lists containing the
                                                                             registered handlers for the loop */
+    esp_event_dispatch_entry_t* dispatch_table[ESP_EVENT_DISPATCH_BUCKETS]; /**< handlers of the posted events, indexed
+                                                                            by event base and id; built on demand
+                                                                            and flushed when handlers change */
+    size_t dispatch_entries;                                        /**< number of events in the dispatch table */
+    esp_event_dispatch_entry_t* dispatch_current;                   /**< entry of the event being dispatched */
+    bool dispatch_current_flushed;                                  /**< entry of the event being dispatched has been
+                                                                            flushed from the table, free it when done */
+    bool dispatching;                                               /**< handlers of an event are being executed */
+    bool handlers_unregistered;                                     /**< handlers have been unregistered while dispatching;
+                                                                            they are left in place, with a NULL handler, and
+                                                                            freed once the dispatch is done */
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_uint_least32_t events_recieved;                          /**< number of events successfully posted to the loop */
     atomic_uint_least32_t events_dropped;                           /**< number of events dropped due to queue being full */
@@ -91,24 +121,26 @@ typedef struct esp_event_loop_instance {
 #endif
 } esp_event_loop_instance_t;
 
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
+/// Data of a posted event, either stored in place or copied to the heap
 typedef union esp_event_post_data {
-    uint32_t val;
-    void *ptr;
-} esp_event_post_data_t;
-#else
-typedef void* esp_event_post_data_t;
+    uint32_t val;                                                    /**< small data posted from ISR */
+    void *ptr;                                                       /**< data copied to the heap */
+#if CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE > 0
+    uint64_t align;                                                  /**< aligns inline data for any type */
+    uint8_t inline_data[CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE];     /**< data stored in the queue item */
 #endif
+} esp_event_post_data_t;
 
 /// Event posted to the event queue
 typedef struct esp_event_post_instance {
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
     bool data_allocated;                                             /**< indicates whether data is allocated from heap */
     bool data_set;                                                   /**< indicates if data is null */
-#endif
     esp_event_base_t base;                                           /**< the event base */
     int32_t id;                                                      /**< the event id */
     esp_event_post_data_t data;                                      /**< data associated with the event */
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    int64_t time_posted;                                             /**< time the event was posted */
+#endif
 } esp_event_post_instance_t;
 
 #ifdef __cplusplus
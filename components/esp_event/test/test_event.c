@@ -1839,6 +1839,136 @@ TEST_CASE("can register from handler", "[event]")
     TEST_TEARDOWN();
 }
 
+typedef struct {
+    esp_event_loop_handle_t loop;
+    esp_event_handler_instance_t others[2];
+    int count;
+} test_unregister_others_t;
+
+static void test_unregister_others_hdlr(void* handler_arg, esp_event_base_t base, int32_t id, void* event_arg)
+{
+    test_unregister_others_t* arg = (test_unregister_others_t*) handler_arg;
+    TEST_ESP_OK(esp_event_handler_instance_unregister_with(arg->loop, s_test_base1, TEST_EVENT_BASE1_EV1, arg->others[0]));
+    TEST_ESP_OK(esp_event_handler_instance_unregister_with(arg->loop, s_test_base1, ESP_EVENT_ANY_ID, arg->others[1]));
+    TEST_ESP_OK(esp_event_handler_register_with(arg->loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_1, &arg->count));
+}
+
+TEST_CASE("can unregister other handlers of the event being dispatched", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+
+    test_unregister_others_t arg = { 0 };
+    esp_event_handler_instance_t instance;
+
+    TEST_ESP_OK(esp_event_loop_create(&loop_args, &arg.loop));
+
+    TEST_ESP_OK(esp_event_handler_instance_register_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_unregister_others_hdlr, &arg, &instance));
+    TEST_ESP_OK(esp_event_handler_instance_register_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_2, &arg.count, &arg.others[0]));
+    TEST_ESP_OK(esp_event_handler_instance_register_with(arg.loop, s_test_base1, ESP_EVENT_ANY_ID, test_event_simple_handler_3, &arg.count, &arg.others[1]));
+
+    // Unregistered handlers are not executed anymore, the registered one starting from the next event
+    TEST_ESP_OK(esp_event_post_to(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, NULL, 0, portMAX_DELAY));
+    TEST_ESP_OK(esp_event_loop_run(arg.loop, pdMS_TO_TICKS(10)));
+    TEST_ASSERT_EQUAL(0, arg.count);
+
+    TEST_ESP_OK(esp_event_handler_instance_unregister_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, instance));
+
+    TEST_ESP_OK(esp_event_post_to(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, NULL, 0, portMAX_DELAY));
+    TEST_ESP_OK(esp_event_loop_run(arg.loop, pdMS_TO_TICKS(10)));
+    TEST_ASSERT_EQUAL(1, arg.count);
+
+    TEST_ESP_OK(esp_event_loop_delete(arg.loop));
+
+    TEST_TEARDOWN();
+}
+
+typedef struct {
+    esp_event_loop_handle_t loop;
+    esp_event_handler_instance_t next;
+    bool walked;
+    int count;
+} test_unregister_next_t;
+
+static void test_unregister_next_hdlr(void* handler_arg, esp_event_base_t base, int32_t id, void* event_arg)
+{
+    test_unregister_next_t* arg = (test_unregister_next_t*) handler_arg;
+    // Handlers are executed while walking the lists when there is no dispatch table entry
+    arg->walked = ((esp_event_loop_instance_t*) arg->loop)->dispatch_current == NULL;
+    if (arg->next) {
+        esp_event_handler_instance_unregister_with(arg->loop, s_test_base1, TEST_EVENT_BASE1_EV1, arg->next);
+        arg->next = NULL;
+    }
+}
+
+// Allocates all the free memory, returning the blocks chained through their first word
+static void** test_exhaust_heap(void)
+{
+    void** blocks = NULL;
+    size_t size;
+    while ((size = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT)) >= sizeof(void*)) {
+        void** block = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+        if (block == NULL) {
+            break;
+        }
+        *block = blocks;
+        blocks = block;
+    }
+    return blocks;
+}
+
+static void test_restore_heap(void** blocks)
+{
+    while (blocks) {
+        void** next = *blocks;
+        free(blocks);
+        blocks = next;
+    }
+}
+
+TEST_CASE("can unregister the next handler when the dispatch table can't be allocated", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+
+    test_unregister_next_t arg = { 0 };
+    esp_event_handler_instance_t instance, last;
+
+    TEST_ESP_OK(esp_event_loop_create(&loop_args, &arg.loop));
+
+    TEST_ESP_OK(esp_event_handler_instance_register_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_unregister_next_hdlr, &arg, &instance));
+    TEST_ESP_OK(esp_event_handler_instance_register_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_2, &arg.count, &arg.next));
+    TEST_ESP_OK(esp_event_handler_instance_register_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_simple_handler_3, &arg.count, &last));
+
+    TEST_ESP_OK(esp_event_post_to(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, NULL, 0, portMAX_DELAY));
+
+    // The unregistered handler is skipped, and the walk goes on with the handler after it
+    void** blocks = test_exhaust_heap();
+    esp_err_t err = esp_event_loop_run(arg.loop, pdMS_TO_TICKS(10));
+    test_restore_heap(blocks);
+    TEST_ESP_OK(err);
+    TEST_ASSERT_TRUE(arg.walked);
+    TEST_ASSERT_NULL(arg.next);
+    TEST_ASSERT_EQUAL(1, arg.count);
+
+    TEST_ESP_OK(esp_event_post_to(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, NULL, 0, portMAX_DELAY));
+    TEST_ESP_OK(esp_event_loop_run(arg.loop, pdMS_TO_TICKS(10)));
+    TEST_ASSERT_FALSE(arg.walked);
+    TEST_ASSERT_EQUAL(2, arg.count);
+
+    TEST_ESP_OK(esp_event_handler_instance_unregister_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, instance));
+    TEST_ESP_OK(esp_event_handler_instance_unregister_with(arg.loop, s_test_base1, TEST_EVENT_BASE1_EV1, last));
+    TEST_ESP_OK(esp_event_loop_delete(arg.loop));
+
+    TEST_TEARDOWN();
+}
+
 static void test_create_loop_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data)
 {
     esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
@@ -1930,6 +2060,97 @@ TEST_CASE("events are dispatched in the order they are registered", "[event]")
     TEST_TEARDOWN();
 }
 
+TEST_CASE("small event data is stored in the event queue", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+    TEST_ESP_OK(esp_event_loop_create(&loop_args, &loop));
+
+    esp_event_post_instance_t post;
+    esp_event_loop_instance_t* loop_def = (esp_event_loop_instance_t*) loop;
+
+    uint8_t data[CONFIG_ESP_EVENT_POST_INLINE_DATA_SIZE + 1];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    TEST_ESP_OK(esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, data, sizeof(data) - 1, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(loop_def->queue, &post, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(true, post.data_set);
+    TEST_ASSERT_EQUAL(sizeof(data) - 1 > sizeof(post.data), post.data_allocated);
+    if (!post.data_allocated) {
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(data, &post.data, sizeof(data) - 1);
+    } else {
+        free(post.data.ptr);
+    }
+
+    TEST_ESP_OK(esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, data, sizeof(data), portMAX_DELAY));
+    TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(loop_def->queue, &post, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(true, post.data_set);
+    TEST_ASSERT_EQUAL(sizeof(data) > sizeof(post.data), post.data_allocated);
+    if (post.data_allocated) {
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(data, post.data.ptr, sizeof(data));
+        free(post.data.ptr);
+    }
+
+    TEST_ESP_OK(esp_event_loop_delete(loop));
+
+    TEST_TEARDOWN();
+}
+
+typedef struct {
+    int order[8];
+    int count;
+} test_priority_order_t;
+
+static void test_priority_order_handler(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    test_priority_order_t* arg = (test_priority_order_t*) event_handler_arg;
+    arg->order[arg->count++] = *((int*) event_data);
+}
+
+TEST_CASE("events of higher priority are dispatched first", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+    loop_args.queue_size = 2;
+    TEST_ESP_OK(esp_event_loop_create_with_priority_lanes(&loop_args, &loop));
+
+    test_priority_order_t arg = { 0 };
+    TEST_ESP_OK(esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_priority_order_handler, &arg));
+
+    const esp_event_priority_t priorities[] = {
+        ESP_EVENT_PRIORITY_NORMAL, ESP_EVENT_PRIORITY_LOW, ESP_EVENT_PRIORITY_HIGH,
+        ESP_EVENT_PRIORITY_NORMAL, ESP_EVENT_PRIORITY_HIGH, ESP_EVENT_PRIORITY_LOW
+    };
+    for (int i = 0; i < sizeof(priorities) / sizeof(priorities[0]); i++) {
+        TEST_ESP_OK(esp_event_post_to_with_priority(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &i, sizeof(i), priorities[i], 0));
+    }
+
+    // Each priority has its own queue, a full one doesn't prevent posting to the others
+    int i = 6;
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &i, sizeof(i), 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_event_post_to_with_priority(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &i, sizeof(i), ESP_EVENT_PRIORITY_MAX, 0));
+
+    TEST_ESP_OK(esp_event_loop_run(loop, pdMS_TO_TICKS(10)));
+
+    const int expected[] = { 2, 4, 0, 3, 1, 5 };
+    TEST_ASSERT_EQUAL(6, arg.count);
+    TEST_ASSERT_EQUAL_INT_ARRAY(expected, arg.order, 6);
+
+    TEST_ESP_OK(esp_event_loop_delete(loop));
+
+    TEST_TEARDOWN();
+}
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 TEST_CASE("can properly prepare event data posted to loop", "[event]")
 {
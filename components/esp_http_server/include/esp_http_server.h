@@ -42,7 +42,8 @@ initializer that should be kept in sync
         .global_transport_ctx_free_fn = NULL,           \
         .open_fn = NULL,                                \
         .close_fn = NULL,                               \
-        .uri_match_fn = NULL                            \
+        .uri_match_fn = NULL,                           \
+        .worker_count = 0                               \
 }
 
 #define ESP_ERR_HTTPD_BASE              (0xb000)                    /*!< Starting number of HTTPD error codes */
@@ -232,8 +233,36 @@ typedef struct httpd_config {
      *
      * Users can implement their own matching functions (See description
      * of the `httpd_uri_match_func_t` function prototype)
+     *
+     * With either of the built-in options, registered URIs are compiled into
+     * a radix tree, so the time to find a handler doesn't grow with the number
+     * of handlers. A custom function is called for each registered handler.
      */
     httpd_uri_match_func_t uri_match_fn;
+
+    /**
+     * Number of worker tasks processing requests.
+     *
+     * With 0, all requests are parsed and handled by the server task itself,
+     * so one slow URI handler delays the requests of all the other clients.
+     *
+     * Otherwise, the server task only waits for sockets and accepts connections,
+     * and hands over sessions with incoming data to a pool of worker tasks.
+     * Requests of the same session are still processed one at a time and in
+     * order, but handlers of different sessions run concurrently, and on any
+     * core. Workers use the same stack size and priority as the server task.
+     *
+     * Note that work queued with `httpd_queue_work()` is still executed by the
+     * server task, so it may run concurrently with URI handlers.
+     *
+     * URI handlers may register and unregister handlers meanwhile: the handler
+     * table is locked while a request is matched against it. A handler which
+     * has been unregistered may however still be running in another worker,
+     * or be called once more by a request matched just before, so its
+     * `user_ctx` must not be freed right after `httpd_unregister_uri_handler()`
+     * returns. Data shared by handlers needs to be protected by the application.
+     */
+    uint8_t worker_count;
 } httpd_config_t;
 
 /**
@@ -1011,6 +1040,9 @@ bool httpd_uri_match_wildcard(const char *uri_template, const char *uri_to_match
  *  - Once this API is called, all request headers are purged, so
  *    request headers need be copied into separate buffers if
  *    they are required later.
+ *  - Status line and headers are serialized into an internal buffer
+ *    and sent together with the content if it fits, so a small
+ *    response is passed to the send function in a single call.
  *
  * @param[in] r         The request being responded to
  * @param[in] buf       Buffer from where the content is to be fetched
@@ -1560,6 +1592,100 @@ esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *ar
  * @}
  */
 
+/* ************** Group: Static Files ************** */
+/** @name Static Files
+ * Built-in handler serving files from a VFS directory or from memory
+ * @{
+ */
+
+/**
+ * @brief   File served from memory by the static file handler
+ */
+typedef struct httpd_static_file {
+    const char *path;   /*!< Path of the file under the URI prefix, starting with '/', e.g. "/index.html" */
+    const void *data;   /*!< Contents of the file, e.g. in a partition mapped with esp_partition_mmap() */
+    size_t      len;    /*!< Length of the contents */
+    const char *etag;   /*!< Quoted entity tag of the contents, or NULL to compute one from the
+                             contents when the handler is registered */
+} httpd_static_file_t;
+
+/**
+ * @brief   Configuration of the static file handler
+ */
+typedef struct httpd_static_config {
+    /**
+     * URI prefix under which the files are served, e.g. "/" or "/static"
+     */
+    const char *uri;
+
+    /**
+     * Directory the files are read from, e.g. "/spiffs/www".
+     * If NULL, the files are served from the `files` table instead.
+     */
+    const char *base_path;
+
+    /**
+     * Files served from memory, if `base_path` is NULL. Their contents are
+     * sent directly from where they are stored, without being copied.
+     */
+    const httpd_static_file_t *files;
+
+    size_t      file_count;     /*!< Number of entries in `files` */
+    const char *index_file;     /*!< File served for URIs ending with '/' */
+    const char *cache_control;  /*!< Value of the Cache-Control header, or NULL to omit it */
+    size_t      buf_size;       /*!< Size of the buffer for reading files from `base_path`,
+                                     which is also the size of each send */
+} httpd_static_config_t;
+
+#define HTTPD_STATIC_DEFAULT_CONFIG() {                 \
+        .uri                = "/",                      \
+        .base_path          = NULL,                     \
+        .files              = NULL,                     \
+        .file_count         = 0,                        \
+        .index_file         = "index.html",             \
+        .cache_control      = NULL,                     \
+        .buf_size           = 4096,                     \
+}
+
+/**
+ * @brief   Registers a handler serving static files for GET and HEAD requests
+ *
+ * The handler is registered with the URI template "<uri>/?*", so the server
+ * must use httpd_uri_match_wildcard() as its uri_match_fn. It can be
+ * unregistered with httpd_unregister_uri() for that template, which frees
+ * its copy of the configuration once requests being served complete.
+ *
+ * The handler:
+ *  - serves "<path>.gz", with Content-Encoding: gzip, instead of "<path>"
+ *    if it exists and the client accepts gzip encoding
+ *  - sends an ETag header, and responds with "304 Not Modified" if it
+ *    matches the If-None-Match header of the request
+ *  - supports requests for a single byte range with the Range header
+ *  - sends the content along with the headers when it is small, otherwise
+ *    in as few sends as possible: files in memory are sent with a single
+ *    call, and files from a VFS directory in pieces of buf_size bytes
+ *
+ * The Content-Type is guessed from the extension of the file.
+ *
+ * @param[in] handle    Handle to server returned by httpd_start
+ * @param[in] config    Configuration of the handler. It is copied along with
+ *                      its strings, so it can be allocated on the stack. The
+ *                      `files` table and the contents of the files are not
+ *                      copied, and need to stay valid while the handler is
+ *                      registered.
+ *
+ * @return
+ *  - ESP_OK : On successfully registering the handler
+ *  - ESP_ERR_INVALID_ARG : Null or invalid arguments
+ *  - ESP_ERR_INVALID_STATE : The server doesn't use the wildcard URI matcher
+ *  - Errors of httpd_register_uri_handler()
+ */
+esp_err_t httpd_register_static(httpd_handle_t handle, const httpd_static_config_t *config);
+
+/** End of Group Static Files
+ * @}
+ */
+
 /* ************** Group: WebSocket ************** */
 /** @name WebSocket
  * Functions and structs for WebSocket server
@@ -9,6 +9,7 @@
 #define _HTTPD_PRIV_H_
 
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <sys/socket.h>
 #include <sys/param.h>
 #include <netinet/in.h>
@@ -17,6 +18,8 @@
 
 #include <esp_http_server.h>
 #include "osal.h"
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -71,6 +74,8 @@ struct sock_db {
     bool ws_control_frames;                         /*!< WebSocket flag indicating that control frames should be passed to user handlers */
     void *ws_user_ctx;                         /*!< Pointer to user context data which will be available to handler for websocket*/
 #endif
+    bool in_worker;                         /*!< Session is being processed by a worker task */
+    bool close_pending;                     /*!< Session is to be deleted once the worker is done with it */
 };
 
 /**
@@ -99,6 +104,16 @@ struct httpd_req_aux {
 #endif
 };
 
+/**
+ * @brief   Worker task processing the requests of sessions handed over by the server task
+ */
+struct httpd_worker {
+    struct httpd_data *hd;                  /*!< Server instance the worker belongs to */
+    othread_t handle;                       /*!< Handle to the worker task */
+    struct httpd_req req;                   /*!< The request being processed by the worker */
+    struct httpd_req_aux req_aux;           /*!< Additional data about the request kept unexposed */
+};
+
 /**
  * @brief   Server data for each instance. This is exposed publicly as
  *          httpd_handle_t but internal structure/members are kept private.
@@ -112,12 +127,19 @@ struct httpd_data {
 #endif
     int msg_fd;                             /*!< Ctrl message sender FD */
     struct thread_data hd_td;               /*!< Information for the HTTPD thread */
+    struct httpd_evloop *hd_evloop;         /*!< Event loop waiting for the server sockets */
+    bool listen_enabled;                    /*!< New connections are being accepted */
     struct sock_db *hd_sd;                  /*!< The socket database */
     int hd_sd_active_count;                 /*!< The number of the active sockets */
     httpd_uri_t **hd_calls;                 /*!< Registered URI handlers */
+    struct httpd_uri_node *hd_uri_router;   /*!< Radix tree over the URIs of registered handlers */
+    SemaphoreHandle_t hd_uri_lock;          /*!< Guards the handlers and the router against concurrent changes */
     struct httpd_req hd_req;                /*!< The current HTTPD request */
     struct httpd_req_aux hd_req_aux;        /*!< Additional data about the HTTPD request kept unexposed */
-    uint64_t lru_counter;                   /*!< LRU counter */
+    struct httpd_worker *hd_workers;        /*!< Worker tasks processing requests, NULL if disabled */
+    QueueHandle_t hd_work_queue;            /*!< Sessions handed over to the workers */
+    QueueHandle_t hd_done_queue;            /*!< Sessions processed by the workers */
+    _Atomic uint64_t lru_counter;           /*!< LRU counter, also updated by worker and user tasks */
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
@@ -182,6 +204,7 @@ void httpd_sess_init(struct httpd_data *hd);
  *
  * @param[in] hd    Server instance data
  * @param[in] newfd Descriptor of the new client to be added to the session.
+ *                  It is closed if the session can't be started.
  *
  * @return
  *  - ESP_OK   : on successfully queuing the work
@@ -287,6 +310,162 @@ void httpd_sess_close_all(struct httpd_data *hd);
  * @}
  */
 
+/****************** Group : Event Loop ********************/
+/** @name Event Loop
+ * Methods for waiting on the server sockets. Every descriptor is registered
+ * with a data pointer, which is reported back when the descriptor is readable
+ * @{
+ */
+
+/**
+ * @brief   Event reported by httpd_evloop_wait()
+ */
+struct httpd_event {
+    void *data;     /*!< Data pointer the descriptor was registered with */
+    bool deferred;  /*!< Reported because of httpd_evloop_defer() rather than
+                         because the descriptor is readable */
+};
+
+/**
+ * @brief   Creates the event loop of the server instance
+ *
+ * @param[in] hd        Server instance data
+ * @param[in] capacity  Maximum number of descriptors to be registered
+ *
+ * @return
+ *  - ESP_OK         : on success
+ *  - ESP_ERR_NO_MEM : if memory couldn't be allocated
+ *  - ESP_FAIL       : in case of other errors
+ */
+esp_err_t httpd_evloop_create(struct httpd_data *hd, int capacity);
+
+/**
+ * @brief   Deletes the event loop of the server instance
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_evloop_delete(struct httpd_data *hd);
+
+/**
+ * @brief   Starts waiting for a descriptor to become readable
+ *
+ * @param[in] hd    Server instance data
+ * @param[in] fd    Descriptor
+ * @param[in] data  Data pointer to report, unique for each descriptor
+ *
+ * @return
+ *  - ESP_OK : on success
+ *  - ESP_ERR_NO_MEM / ESP_FAIL : if the descriptor couldn't be registered
+ */
+esp_err_t httpd_evloop_add(struct httpd_data *hd, int fd, void *data);
+
+/**
+ * @brief   Stops waiting for a descriptor. Must be called before it is closed.
+ *
+ * @param[in] hd    Server instance data
+ * @param[in] fd    Descriptor
+ * @param[in] data  Data pointer the descriptor was registered with
+ */
+void httpd_evloop_remove(struct httpd_data *hd, int fd, void *data);
+
+/**
+ * @brief   Temporarily stops (or resumes) reporting a registered descriptor
+ *
+ * @param[in] hd     Server instance data
+ * @param[in] fd     Descriptor
+ * @param[in] data   Data pointer the descriptor was registered with
+ * @param[in] enable Whether the descriptor should be reported
+ *
+ * @return
+ *  - ESP_OK : on success
+ *  - ESP_ERR_NOT_FOUND / ESP_FAIL : if the descriptor isn't registered
+ */
+esp_err_t httpd_evloop_enable(struct httpd_data *hd, int fd, void *data, bool enable);
+
+/**
+ * @brief   Makes the next httpd_evloop_wait() report data without blocking, e.g.
+ *          for a session which has buffered data left after processing a request
+ *
+ * @param[in] hd    Server instance data
+ * @param[in] data  Data pointer to report
+ */
+void httpd_evloop_defer(struct httpd_data *hd, void *data);
+
+/**
+ * @brief   Waits until some of the registered descriptors are readable
+ *
+ * @param[in]  hd      Server instance data
+ * @param[out] events  Reported events, valid until the next call
+ *
+ * @return
+ *  - Number of events, including the deferred ones
+ *  - -1 : in case of error
+ */
+int httpd_evloop_wait(struct httpd_data *hd, struct httpd_event **events);
+
+/** End of Group : Event Loop
+ * @}
+ */
+
+/****************** Group : Worker Pool ********************/
+/** @name Worker Pool
+ * Methods for processing requests in worker tasks (see httpd_config_t::worker_count).
+ * The server task hands a readable session over to the pool, and stops waiting
+ * on it until a worker is done, so requests of a session are processed in order
+ * @{
+ */
+
+/**
+ * @brief   Creates the worker tasks, if enabled in the configuration
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - ESP_OK : on success, or if no workers are configured
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : if memory couldn't be allocated
+ *  - ESP_ERR_HTTPD_TASK : if a task couldn't be created
+ */
+esp_err_t httpd_workers_start(struct httpd_data *hd);
+
+/**
+ * @brief   Waits for the workers to finish the sessions handed over to them,
+ *          and deletes the worker tasks
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_workers_stop(struct httpd_data *hd);
+
+/**
+ * @brief   Hands a readable session over to the workers
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_workers_dispatch(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Takes back the sessions the workers are done with, to wait for
+ *          their next requests or to delete them. Runs in the server task.
+ *
+ * @param[in] arg  Server instance data
+ */
+void httpd_workers_collect(void *arg);
+
+/**
+ * @brief   Returns the request structures owned by the calling task: those
+ *          of a worker task, or else those of the server task
+ *
+ * @param[in]  hd   Server instance data
+ * @param[out] aux  Auxiliary data of the request (may be NULL)
+ *
+ * @return Request to be processed by the calling task
+ */
+httpd_req_t *httpd_task_req(struct httpd_data *hd, struct httpd_req_aux **aux);
+
+/** End of Group : Worker Pool
+ * @}
+ */
+
 /****************** Group : URI Handling ********************/
 /** @name URI Handling
  * Methods for accessing URI handlers
@@ -297,13 +476,14 @@ void httpd_sess_close_all(struct httpd_data *hd);
  * @brief   For an HTTP request, searches through all the registered URI handlers
  *          and invokes the appropriate one if found
  *
- * @param[in] hd  Server instance data for which handler needs to be invoked
+ * @param[in] hd   Server instance data for which handler needs to be invoked
+ * @param[in] req  Request received and parsed by the calling task
  *
  * @return
  *  - ESP_OK    : if handler found and executed successfully
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_uri(struct httpd_data *hd);
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req);
 
 /**
  * @brief   Unregister all URI handlers
@@ -312,6 +492,26 @@ esp_err_t httpd_uri(struct httpd_data *hd);
  */
 void httpd_unregister_all_uri_handlers(struct httpd_data *hd);
 
+/**
+ * @brief   Takes a reference to the context of a static file handler,
+ *          if uri is one. Called with hd_uri_lock taken.
+ *
+ * @param[in] uri  Registered URI handler
+ *
+ * @return
+ *  - true : uri is a static file handler, and the reference was taken
+ *  - false : uri is another handler
+ */
+bool httpd_static_ref(const httpd_uri_t *uri);
+
+/**
+ * @brief   Releases a reference taken by httpd_static_ref(), freeing the
+ *          context with the last one. Called with hd_uri_lock taken.
+ *
+ * @param[in] uri  URI handler passed to httpd_static_ref()
+ */
+void httpd_static_unref(const httpd_uri_t *uri);
+
 /**
  * @brief   Validates the request to prevent users from calling APIs, that are to
  *          be called only inside a URI handler, outside the handler context
@@ -408,6 +608,53 @@ esp_err_t httpd_req_handle_err(httpd_req_t *req, httpd_err_code_t error);
  */
 int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len);
 
+/**
+ * @brief   For sending out all of the data, retrying partial sends
+ *
+ * @param[in] req     Pointer to the HTTP request for which the response needs to be sent
+ * @param[in] buf     Pointer to the buffer from where the body of the response is taken
+ * @param[in] buf_len Length of the buffer
+ *
+ * @return
+ *  - ESP_OK   : if all of the data was sent
+ *  - ESP_FAIL : if failed
+ */
+esp_err_t httpd_send_all(httpd_req_t *req, const char *buf, size_t buf_len);
+
+/**
+ * @brief   For sending out the status line and headers of a response, along
+ *          with the first part of its content
+ *
+ * The rest of the content, if any, is to be sent with httpd_send_all(). This
+ * lets content of known length be sent from several buffers without chunked
+ * encoding. httpd_resp_send() is this function with the whole content.
+ *
+ * @param[in] req         Pointer to the HTTP request for which the response needs to be sent
+ * @param[in] content_len Length of the whole content, sent as Content-Length
+ * @param[in] buf         Pointer to the first part of the content (may be NULL)
+ * @param[in] buf_len     Length of the first part of the content
+ *
+ * @return
+ *  - ESP_OK : if successful
+ *  - ESP_ERR_HTTPD_RESP_HDR  : Essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND : Error in raw send
+ */
+esp_err_t httpd_resp_send_head(httpd_req_t *req, size_t content_len, const char *buf, size_t buf_len);
+
+/**
+ * @brief   For sending out the status line and headers of a response which
+ *          has no content, like 304 Not Modified, without Content-Type and
+ *          Content-Length
+ *
+ * @param[in] req         Pointer to the HTTP request for which the response needs to be sent
+ *
+ * @return
+ *  - ESP_OK : if successful
+ *  - ESP_ERR_HTTPD_RESP_HDR  : Status line is too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND : Error in raw send
+ */
+esp_err_t httpd_resp_send_no_content(httpd_req_t *req);
+
 /**
  * @brief   For receiving HTTP request data
  *
@@ -0,0 +1,244 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+#include <sys/epoll.h>
+#else
+#include <sys/poll.h>
+#endif
+
+static const char *TAG = "httpd_evloop";
+
+/* Event loop waiting for the listening, control and session sockets of the server.
+ * Descriptors are registered once, when they are opened, so the cost of a wakeup
+ * depends on the number of ready descriptors rather than the number of sessions.
+ * Every descriptor is registered with a data pointer, which is reported back
+ * when the descriptor becomes readable.
+ *
+ * Two backends are available: epoll() on the linux target (CONFIG_HTTPD_EVLOOP_EPOLL),
+ * and poll() otherwise. The latter keeps a compact array of registered descriptors only */
+struct httpd_evloop {
+    int capacity;                   /*!< Maximum number of registered descriptors */
+    struct httpd_event *events;     /*!< Events reported by the last wait */
+    void **deferred;                /*!< Data to report by the next wait without blocking */
+    int deferred_count;
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    int epoll_fd;
+    struct epoll_event *ep_events;
+#else
+    struct pollfd *fds;             /*!< Registered descriptors */
+    void **data;                    /*!< Data pointers, in the same order as fds */
+    int count;                      /*!< Number of registered descriptors */
+#endif
+};
+
+static void httpd_evloop_free(struct httpd_evloop *el)
+{
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    if (el->epoll_fd >= 0) {
+        close(el->epoll_fd);
+    }
+    free(el->ep_events);
+#else
+    free(el->fds);
+    free(el->data);
+#endif
+    free(el->deferred);
+    free(el->events);
+    free(el);
+}
+
+esp_err_t httpd_evloop_create(struct httpd_data *hd, int capacity)
+{
+    struct httpd_evloop *el = calloc(1, sizeof(struct httpd_evloop));
+    if (el == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    el->capacity = capacity;
+    el->events = calloc(capacity, sizeof(struct httpd_event));
+    el->deferred = calloc(capacity, sizeof(void *));
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    el->ep_events = calloc(capacity, sizeof(struct epoll_event));
+    el->epoll_fd = epoll_create1(0);
+    if (el->epoll_fd < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in epoll_create1 (%d)"), errno);
+        httpd_evloop_free(el);
+        return ESP_FAIL;
+    }
+    if (el->events == NULL || el->deferred == NULL || el->ep_events == NULL) {
+#else
+    el->fds = calloc(capacity, sizeof(struct pollfd));
+    el->data = calloc(capacity, sizeof(void *));
+    if (el->events == NULL || el->deferred == NULL || el->fds == NULL || el->data == NULL) {
+#endif
+        httpd_evloop_free(el);
+        return ESP_ERR_NO_MEM;
+    }
+    hd->hd_evloop = el;
+    return ESP_OK;
+}
+
+void httpd_evloop_delete(struct httpd_data *hd)
+{
+    if (hd->hd_evloop) {
+        httpd_evloop_free(hd->hd_evloop);
+        hd->hd_evloop = NULL;
+    }
+}
+
+esp_err_t httpd_evloop_add(struct httpd_data *hd, int fd, void *data)
+{
+    struct httpd_evloop *el = hd->hd_evloop;
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.ptr = data,
+    };
+    if (epoll_ctl(el->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        ESP_LOGW(TAG, LOG_FMT("error in epoll_ctl (%d)"), errno);
+        return ESP_FAIL;
+    }
+#else
+    if (el->count == el->capacity) {
+        return ESP_ERR_NO_MEM;
+    }
+    el->fds[el->count].fd = fd;
+    el->fds[el->count].events = POLLIN;
+    el->fds[el->count].revents = 0;
+    el->data[el->count] = data;
+    el->count++;
+#endif
+    return ESP_OK;
+}
+
+void httpd_evloop_remove(struct httpd_data *hd, int fd, void *data)
+{
+    struct httpd_evloop *el = hd->hd_evloop;
+    if (el == NULL) {
+        return;
+    }
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    /* Fails harmlessly if the descriptor has been closed already */
+    epoll_ctl(el->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    for (int i = 0; i < el->count; i++) {
+        if (el->data[i] == data) {
+            /* Order doesn't matter, move the last descriptor into the gap */
+            el->count--;
+            el->fds[i] = el->fds[el->count];
+            el->data[i] = el->data[el->count];
+            break;
+        }
+    }
+#endif
+    for (int i = 0; i < el->deferred_count; i++) {
+        if (el->deferred[i] == data) {
+            el->deferred[i] = el->deferred[--el->deferred_count];
+            break;
+        }
+    }
+}
+
+esp_err_t httpd_evloop_enable(struct httpd_data *hd, int fd, void *data, bool enable)
+{
+    struct httpd_evloop *el = hd->hd_evloop;
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    struct epoll_event ev = {
+        .events = enable ? EPOLLIN : 0,
+        .data.ptr = data,
+    };
+    if (epoll_ctl(el->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        ESP_LOGW(TAG, LOG_FMT("error in epoll_ctl (%d)"), errno);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+#else
+    for (int i = 0; i < el->count; i++) {
+        if (el->data[i] == data) {
+            el->fds[i].events = enable ? POLLIN : 0;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+#endif
+}
+
+void httpd_evloop_defer(struct httpd_data *hd, void *data)
+{
+    struct httpd_evloop *el = hd->hd_evloop;
+    for (int i = 0; i < el->deferred_count; i++) {
+        if (el->deferred[i] == data) {
+            return;
+        }
+    }
+    if (el->deferred_count < el->capacity) {
+        el->deferred[el->deferred_count++] = data;
+    }
+}
+
+int httpd_evloop_wait(struct httpd_data *hd, struct httpd_event **events)
+{
+    struct httpd_evloop *el = hd->hd_evloop;
+    /* Don't block if some data is already waiting to be processed */
+    int timeout_ms = el->deferred_count ? 0 : -1;
+    int count = 0;
+
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+    int ready = epoll_wait(el->epoll_fd, el->ep_events, el->capacity, timeout_ms);
+    if (ready < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in epoll_wait (%d)"), errno);
+        return -1;
+    }
+    for (int i = 0; i < ready; i++) {
+        el->events[count].data = el->ep_events[i].data.ptr;
+        el->events[count].deferred = false;
+        count++;
+    }
+#else
+    int ready = poll(el->fds, el->count, timeout_ms);
+    if (ready < 0) {
+        ESP_LOGE(TAG, LOG_FMT("error in poll (%d)"), errno);
+        return -1;
+    }
+    for (int i = 0; i < el->count && count < ready; i++) {
+        if (el->fds[i].revents) {
+            el->events[count].data = el->data[i];
+            el->events[count].deferred = false;
+            count++;
+        }
+    }
+#endif
+
+    /* Append deferred data, unless its descriptor is reported as readable anyway */
+    const int readable = count;
+    for (int i = 0; i < el->deferred_count; i++) {
+        bool found = false;
+        for (int j = 0; j < readable; j++) {
+            if (el->events[j].data == el->deferred[i]) {
+                found = true;
+                break;
+            }
+        }
+        if (!found && count < el->capacity) {
+            el->events[count].data = el->deferred[i];
+            el->events[count].deferred = true;
+            count++;
+        }
+    }
+    el->deferred_count = 0;
+
+    *events = el->events;
+    return count;
+}
@@ -19,11 +19,6 @@
 #include "freertos/semphr.h"
 #endif
 
-typedef struct {
-    fd_set *fdset;
-    struct httpd_data *hd;
-} process_session_context_t;
-
 static const char *TAG = "httpd";
 
 static esp_err_t httpd_accept_conn(struct httpd_data *hd, int listen_fd)
@@ -63,8 +58,8 @@ static esp_err_t httpd_accept_conn(struct httpd_data *hd, int listen_fd)
     setsockopt(new_fd, SOL_SOCKET, SO_SNDTIMEO, (const char *)&tv, sizeof(tv));
 
     if (ESP_OK != httpd_sess_new(hd, new_fd)) {
+        /* The descriptor has been closed already */
         ESP_LOGW(TAG, LOG_FMT("session creation failed"));
-        close(new_fd);
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("complete"));
@@ -181,77 +176,90 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
 #endif
 }
 
-// Called for each session from httpd_server
-static int httpd_process_session(struct sock_db *session, void *context)
+// Called for each ready session from httpd_server
+static void httpd_process_session(struct httpd_data *hd, struct sock_db *session, bool deferred)
 {
-    if ((!session) || (!context)) {
-        return 0;
+    /* Session may have been closed while processing the preceding events */
+    if (session->fd < 0) {
+        return;
     }
 
-    if (session->fd < 0) {
-        return 1;
+    /* Deferred sessions are only processed if they still have data */
+    if (deferred && !httpd_sess_pending(hd, session)) {
+        return;
     }
 
-    process_session_context_t *ctx = (process_session_context_t *)context;
-    int fd = session->fd;
+    /* Let a worker process the session, if there are any */
+    if (hd->hd_workers) {
+        httpd_workers_dispatch(hd, session);
+        return;
+    }
 
-    if (FD_ISSET(fd, ctx->fdset) || httpd_sess_pending(ctx->hd, session)) {
-        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), fd);
-        if (httpd_sess_process(ctx->hd, session) != ESP_OK) {
-            httpd_sess_delete(ctx->hd, session); // Delete session
-        }
+    ESP_LOGD(TAG, LOG_FMT("processing socket %d"), session->fd);
+    if (httpd_sess_process(hd, session) != ESP_OK) {
+        httpd_sess_delete(hd, session); // Delete session
+        return;
+    }
+    session->lru_counter = atomic_fetch_add(&hd->lru_counter, 1) + 1;
+
+    /* Data left buffered after the request (e.g. a pipelined request, or
+     * decrypted TLS data) won't make the socket readable again */
+    if (httpd_sess_pending(hd, session)) {
+        httpd_evloop_defer(hd, session);
     }
-    return 1;
 }
 
 /* Manage in-coming connection or data requests */
 static esp_err_t httpd_server(struct httpd_data *hd)
 {
-    fd_set read_set;
-    FD_ZERO(&read_set);
-    if (hd->config.lru_purge_enable || httpd_is_sess_available(hd)) {
-        /* Only listen for new connections if server has capacity to
-         * handle more (or when LRU purge is enabled, in which case
-         * older connections will be closed) */
-        FD_SET(hd->listen_fd, &read_set);
-    }
-    FD_SET(hd->ctrl_fd, &read_set);
-
-    int tmp_max_fd;
-    httpd_sess_set_descriptors(hd, &read_set, &tmp_max_fd);
-    int maxfd = MAX(hd->listen_fd, tmp_max_fd);
-    tmp_max_fd = maxfd;
-    maxfd = MAX(hd->ctrl_fd, tmp_max_fd);
-
-    ESP_LOGD(TAG, LOG_FMT("doing select maxfd+1 = %d"), maxfd + 1);
-    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, NULL);
+    /* Take back the sessions the workers are done with. This is normally
+     * requested by the workers through control messages, but these may fail */
+    httpd_workers_collect(hd);
+
+    /* Only listen for new connections if server has capacity to
+     * handle more (or when LRU purge is enabled, in which case
+     * older connections will be closed) */
+    bool listen_enable = hd->config.lru_purge_enable || httpd_is_sess_available(hd);
+    if (listen_enable != hd->listen_enabled) {
+        if (httpd_evloop_enable(hd, hd->listen_fd, &hd->listen_fd, listen_enable) == ESP_OK) {
+            hd->listen_enabled = listen_enable;
+        }
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("waiting for events"));
+    struct httpd_event *events;
+    int active_cnt = httpd_evloop_wait(hd, &events);
     if (active_cnt < 0) {
-        ESP_LOGE(TAG, LOG_FMT("error in select (%d)"), errno);
         httpd_sess_delete_invalid(hd);
         return ESP_OK;
     }
 
     /* Case0: Do we have a control message? */
-    if (FD_ISSET(hd->ctrl_fd, &read_set)) {
-        ESP_LOGD(TAG, LOG_FMT("processing ctrl message"));
-        httpd_process_ctrl_msg(hd);
-        if (hd->hd_td.status == THREAD_STOPPING) {
-            ESP_LOGD(TAG, LOG_FMT("stopping thread"));
-            return ESP_FAIL;
+    bool listen_ready = false;
+    for (int i = 0; i < active_cnt; i++) {
+        if (events[i].data == &hd->ctrl_fd) {
+            ESP_LOGD(TAG, LOG_FMT("processing ctrl message"));
+            httpd_process_ctrl_msg(hd);
+            if (hd->hd_td.status == THREAD_STOPPING) {
+                ESP_LOGD(TAG, LOG_FMT("stopping thread"));
+                return ESP_FAIL;
+            }
+        } else if (events[i].data == &hd->listen_fd) {
+            listen_ready = true;
         }
     }
 
     /* Case1: Do we have any activity on the current data
      * sessions? */
-    process_session_context_t context = {
-        .fdset = &read_set,
-        .hd = hd
-    };
-    httpd_sess_enum(hd, httpd_process_session, &context);
+    for (int i = 0; i < active_cnt; i++) {
+        if (events[i].data != &hd->ctrl_fd && events[i].data != &hd->listen_fd) {
+            httpd_process_session(hd, events[i].data, events[i].deferred);
+        }
+    }
 
     /* Case2: Do we have any incoming connection requests to
      * process? */
-    if (FD_ISSET(hd->listen_fd, &read_set)) {
+    if (listen_ready) {
         ESP_LOGD(TAG, LOG_FMT("processing listen socket %d"), hd->listen_fd);
         if (httpd_accept_conn(hd, hd->listen_fd) != ESP_OK) {
             ESP_LOGW(TAG, LOG_FMT("error accepting new connection"));
@@ -276,10 +284,12 @@ static void httpd_thread(void *arg)
     }
 
     ESP_LOGD(TAG, LOG_FMT("web server exiting"));
+    httpd_workers_stop(hd);
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_sess_close_all(hd);
     close(hd->listen_fd);
+    httpd_evloop_delete(hd);
     hd->hd_td.status = THREAD_STOPPED;
     httpd_os_thread_delete();
 }
@@ -352,6 +362,19 @@ static esp_err_t httpd_server_init(struct httpd_data *hd)
     hd->listen_fd = fd;
     hd->ctrl_fd = ctrl_fd;
     hd->msg_fd  = msg_fd;
+
+    /* Besides the sessions, the event loop waits for the listening and control sockets */
+    if (httpd_evloop_create(hd, hd->config.max_open_sockets + 2) != ESP_OK ||
+        httpd_evloop_add(hd, hd->listen_fd, &hd->listen_fd) != ESP_OK ||
+        httpd_evloop_add(hd, hd->ctrl_fd, &hd->ctrl_fd) != ESP_OK) {
+        ESP_LOGE(TAG, LOG_FMT("error in creating event loop"));
+        httpd_evloop_delete(hd);
+        close(fd);
+        close(ctrl_fd);
+        close(msg_fd);
+        return ESP_FAIL;
+    }
+    hd->listen_enabled = true;
     return ESP_OK;
 }
 
@@ -394,6 +417,16 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
         free(hd);
         return NULL;
     }
+    hd->hd_uri_lock = xSemaphoreCreateMutex();
+    if (!hd->hd_uri_lock) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to create mutex for HTTP URI handlers"));
+        free(hd->err_handler_fns);
+        free(ra->resp_hdrs);
+        free(hd->hd_sd);
+        free(hd->hd_calls);
+        free(hd);
+        return NULL;
+    }
     /* Save the configuration for this instance */
     hd->config = *config;
     return hd;
@@ -410,6 +443,7 @@ static void httpd_delete(struct httpd_data *hd)
     /* Free registered URI handlers */
     httpd_unregister_all_uri_handlers(hd);
     free(hd->hd_calls);
+    vSemaphoreDelete(hd->hd_uri_lock);
     free(hd);
 }
 
@@ -460,12 +494,18 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 
     httpd_sess_init(hd);
+    esp_err_t ret = httpd_workers_start(hd);
+    if (ret != ESP_OK) {
+        httpd_delete(hd);
+        return ret;
+    }
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
                                httpd_thread, hd,
                                hd->config.core_id) != ESP_OK) {
         /* Failed to launch task */
+        httpd_workers_stop(hd);
         httpd_delete(hd);
         return ESP_ERR_HTTPD_TASK;
     }
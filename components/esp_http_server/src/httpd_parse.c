@@ -614,9 +614,8 @@ static void parse_init(httpd_req_t *r, http_parser *parser, parser_data_t *data)
 
 /* Function that receives TCP data and runs parser on it
  */
-static esp_err_t httpd_parse_req(struct httpd_data *hd)
+static esp_err_t httpd_parse_req(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     int blk_len,  offset;
     http_parser   parser;
     parser_data_t parser_data;
@@ -656,7 +655,7 @@ static esp_err_t httpd_parse_req(struct httpd_data *hd)
     } while (parser_data.status != PARSING_COMPLETE);
 
     ESP_LOGD(TAG, LOG_FMT("parsing complete"));
-    return httpd_uri(hd);
+    return httpd_uri(hd, r);
 }
 
 static void init_req(httpd_req_t *r, httpd_config_t *config)
@@ -722,14 +721,14 @@ static void httpd_req_cleanup(httpd_req_t *r)
  */
 esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 {
-    httpd_req_t *r = &hd->hd_req;
+    struct httpd_req_aux *ra;
+    httpd_req_t *r = httpd_task_req(hd, &ra);
     init_req(r, &hd->config);
-    init_req_aux(&hd->hd_req_aux, &hd->config);
+    init_req_aux(ra, &hd->config);
     r->handle = hd;
-    r->aux = &hd->hd_req_aux;
+    r->aux = ra;
 
     /* Associate the request to the socket */
-    struct httpd_req_aux *ra = r->aux;
     ra->sd = sd;
 
     /* Set defaults */
@@ -784,7 +783,7 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 #endif
 
     /* Parse request */
-    ret = httpd_parse_req(hd);
+    ret = httpd_parse_req(hd, r);
     if (ret != ESP_OK) {
         httpd_req_cleanup(r);
     }
@@ -795,7 +794,7 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
  */
 esp_err_t httpd_req_delete(struct httpd_data *hd)
 {
-    httpd_req_t *r = &hd->hd_req;
+    httpd_req_t *r = httpd_task_req(hd, NULL);
     struct httpd_req_aux *ra = r->aux;
 
     /* Finish off reading any pending/leftover data */
@@ -835,8 +834,11 @@ bool httpd_validate_req_ptr(httpd_req_t *r)
         struct httpd_data *hd = (struct httpd_data *) r->handle;
         if (hd) {
             /* Check if this function is running in the context of
-             * the correct httpd server thread */
-            if (httpd_os_thread_handle() == hd->hd_td.handle) {
+             * the correct httpd server thread, or worker processing it.
+             * Tasks other than the workers are given the request of the
+             * server thread, which only the server thread may use */
+            if (httpd_task_req(hd, NULL) == r && (r != &hd->hd_req ||
+                httpd_os_thread_handle() == hd->hd_td.handle)) {
                 return true;
             }
         }
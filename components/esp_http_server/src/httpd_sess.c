@@ -159,7 +159,7 @@ struct sock_db *httpd_sess_get_free(struct httpd_data *hd)
 
 bool httpd_is_sess_available(struct httpd_data *hd)
 {
-    return httpd_sess_get_free(hd) ? true : false;
+    return hd->hd_sd_active_count < hd->config.max_open_sockets;
 }
 
 struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
@@ -170,8 +170,10 @@ struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
 
     // Check if called inside a request handler, and the session sockfd in use is same as the parameter
     // => Just return the pointer to the sock_db corresponding to the request
-    if ((hd->hd_req_aux.sd) && (hd->hd_req_aux.sd->fd == sockfd)) {
-        return hd->hd_req_aux.sd;
+    struct httpd_req_aux *ra;
+    httpd_task_req(hd, &ra);
+    if ((ra->sd) && (ra->sd->fd == sockfd)) {
+        return ra->sd;
     }
 
     enum_context_t context = {
@@ -194,6 +196,7 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd)
     struct sock_db *session = httpd_sess_get_free(hd);
     if (!session) {
         ESP_LOGD(TAG, LOG_FMT("unable to launch session for fd = %d"), newfd);
+        close(newfd);
         return ESP_FAIL;
     }
 
@@ -218,6 +221,12 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd)
     hd->hd_sd_active_count++;
     ESP_LOGD(TAG, LOG_FMT("active sockets: %d"), hd->hd_sd_active_count);
 
+    // Wait for requests on this session
+    if (httpd_evloop_add(hd, session->fd, session) != ESP_OK) {
+        ESP_LOGD(TAG, LOG_FMT("unable to wait for fd = %d"), newfd);
+        httpd_sess_delete(hd, session);
+        return ESP_FAIL;
+    }
     return ESP_OK;
 }
 
@@ -263,9 +272,10 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
     // Check if the function has been called from inside a
     // request handler, in which case fetch the context from
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        return hd->hd_req.sess_ctx;
+    struct httpd_req_aux *ra;
+    httpd_req_t *r = httpd_task_req(handle, &ra);
+    if (ra->sd == session) {
+        return r->sess_ctx;
     }
     return session->ctx;
 }
@@ -280,17 +290,18 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
     // Check if the function has been called from inside a
     // request handler, in which case set the context inside
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    struct httpd_req_aux *ra;
+    httpd_req_t *r = httpd_task_req(handle, &ra);
+    if (ra->sd == session) {
+        if (r->sess_ctx != ctx) {
             // Don't free previous context if it is in sockdb
             // as it will be freed inside httpd_req_cleanup()
-            if (session->ctx != hd->hd_req.sess_ctx) {
-                httpd_sess_free_ctx(&hd->hd_req.sess_ctx, hd->hd_req.free_ctx); // Free previous context
+            if (session->ctx != r->sess_ctx) {
+                httpd_sess_free_ctx(&r->sess_ctx, r->free_ctx); // Free previous context
             }
-            hd->hd_req.sess_ctx = ctx;
+            r->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        r->free_ctx = free_fn;
         return;
     }
 
@@ -352,8 +363,18 @@ void httpd_sess_delete(struct httpd_data *hd, struct sock_db *session)
         return;
     }
 
+    // A worker is processing the session, let it finish first
+    if (session->in_worker) {
+        ESP_LOGD(TAG, LOG_FMT("fd = %d deferred"), session->fd);
+        session->close_pending = true;
+        return;
+    }
+
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), session->fd);
 
+    // Stop waiting for requests on this session
+    httpd_evloop_remove(hd, session->fd, session);
+
     // Call close function if defined
     if (hd->config.close_fn) {
         hd->config.close_fn(hd, session->fd);
@@ -371,7 +392,7 @@ void httpd_sess_delete(struct httpd_data *hd, struct sock_db *session)
     hd->hd_sd_active_count--;
     ESP_LOGD(TAG, LOG_FMT("active sockets: %d"), hd->hd_sd_active_count);
     if (!hd->hd_sd_active_count) {
-        hd->lru_counter = 0;
+        atomic_store(&hd->lru_counter, 0);
     }
 }
 
@@ -417,7 +438,6 @@ esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session)
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("success"));
-    session->lru_counter = ++hd->lru_counter;
     return ESP_OK;
 }
 
@@ -435,7 +455,7 @@ esp_err_t httpd_sess_update_lru_counter(httpd_handle_t handle, int sockfd)
     };
     httpd_sess_enum(hd, enum_function, &context);
     if (context.session) {
-        context.session->lru_counter = ++hd->lru_counter;
+        context.session->lru_counter = atomic_fetch_add(&hd->lru_counter, 1) + 1;
         return ESP_OK;
     }
     return ESP_ERR_NOT_FOUND;
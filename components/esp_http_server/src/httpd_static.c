@@ -0,0 +1,462 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_static";
+
+/* Room for the base path and ".gz" besides the URI */
+#define HTTPD_STATIC_PATH_LEN   (CONFIG_HTTPD_MAX_URI_LEN + 64)
+
+static const struct {
+    const char *ext;
+    const char *type;
+} httpd_static_types[] = {
+    { ".html",  "text/html" },
+    { ".htm",   "text/html" },
+    { ".css",   "text/css" },
+    { ".js",    "application/javascript" },
+    { ".json",  "application/json" },
+    { ".txt",   "text/plain" },
+    { ".xml",   "text/xml" },
+    { ".png",   "image/png" },
+    { ".jpg",   "image/jpeg" },
+    { ".jpeg",  "image/jpeg" },
+    { ".gif",   "image/gif" },
+    { ".svg",   "image/svg+xml" },
+    { ".ico",   "image/x-icon" },
+    { ".pdf",   "application/pdf" },
+    { ".wasm",  "application/wasm" },
+    { ".woff",  "font/woff" },
+    { ".woff2", "font/woff2" },
+};
+
+/* Context of a registered handler, freed once its handlers are unregistered
+ * and no request uses it anymore. References are counted under hd_uri_lock */
+struct httpd_static_ctx {
+    httpd_static_config_t config;   /*!< Copy of the configuration, with its own copies of the strings */
+    unsigned refs;              /*!< Registered handlers and requests using the context */
+    char etags[][24];           /*!< Entity tags of the files in memory */
+};
+
+/* A file opened for a request, either in memory or in a VFS directory */
+typedef struct {
+    const char *data;   /*!< Contents of a file in memory, or NULL */
+    FILE       *f;      /*!< File in a VFS directory, or NULL */
+    size_t      size;
+    char        etag[24];
+} static_file_t;
+
+static const char *httpd_static_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    if (ext) {
+        for (int i = 0; i < sizeof(httpd_static_types) / sizeof(httpd_static_types[0]); i++) {
+            if (strcasecmp(ext, httpd_static_types[i].ext) == 0) {
+                return httpd_static_types[i].type;
+            }
+        }
+    }
+    return HTTPD_TYPE_OCTET;
+}
+
+/* Decodes the percent-encoded octets of a request path into dst, which has
+ * room for dst_size - 1 characters. Returns the decoded length, or -1 if the
+ * path is malformed, too long or would contain a NUL */
+static int httpd_static_unescape(const char *src, size_t src_len, char *dst, size_t dst_size)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < src_len; i++) {
+        char c = src[i];
+        if (c == '%') {
+            if (i + 2 >= src_len || !isxdigit((unsigned char) src[i + 1]) || !isxdigit((unsigned char) src[i + 2])) {
+                return -1;
+            }
+            char hex[3] = { src[i + 1], src[i + 2], '\0' };
+            c = (char) strtol(hex, NULL, 16);
+            if (c == '\0') {
+                return -1;
+            }
+            i += 2;
+        }
+        if (len + 1 >= dst_size) {
+            return -1;
+        }
+        dst[len++] = c;
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+/* Checks that no segment of the path refers to the parent directory */
+static bool httpd_static_path_valid(const char *path)
+{
+    if (strchr(path, '\\') != NULL) {
+        return false;
+    }
+    while (*path) {
+        size_t seg_len = strcspn(path, "/");
+        if (seg_len == 2 && path[0] == '.' && path[1] == '.') {
+            return false;
+        }
+        path += seg_len;
+        if (*path == '/') {
+            path++;
+        }
+    }
+    return true;
+}
+
+static bool httpd_static_open(const struct httpd_static_ctx *ctx, const char *path, static_file_t *file)
+{
+    const httpd_static_config_t *config = &ctx->config;
+    memset(file, 0, sizeof(*file));
+
+    if (config->base_path == NULL) {
+        for (size_t i = 0; i < config->file_count; i++) {
+            const httpd_static_file_t *entry = &config->files[i];
+            if (strcmp(entry->path, path) == 0) {
+                file->data = entry->data;
+                file->size = entry->len;
+                strlcpy(file->etag, entry->etag ? entry->etag : ctx->etags[i], sizeof(file->etag));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    char full_path[HTTPD_STATIC_PATH_LEN];
+    if (snprintf(full_path, sizeof(full_path), "%s%s", config->base_path, path) >= sizeof(full_path)) {
+        return false;
+    }
+    struct stat st;
+    if (stat(full_path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    file->f = fopen(full_path, "r");
+    if (file->f == NULL) {
+        return false;
+    }
+    file->size = st.st_size;
+    snprintf(file->etag, sizeof(file->etag), "\"%x-%lx\"",
+             (unsigned) st.st_size, (unsigned long) st.st_mtime);
+    return true;
+}
+
+static void httpd_static_close(static_file_t *file)
+{
+    if (file->f) {
+        fclose(file->f);
+        file->f = NULL;
+    }
+}
+
+/* Parses a Range header with a single range of bytes. Returns false if the
+ * header is to be ignored, i.e. the whole file is to be sent. Otherwise,
+ * *satisfiable tells if the range overlaps the file, and *first / *last
+ * are set to the overlap */
+static bool httpd_static_parse_range(const char *hdr, size_t size, size_t *first, size_t *last, bool *satisfiable)
+{
+    if (strncmp(hdr, "bytes=", 6) != 0 || strchr(hdr, ',') != NULL) {
+        return false;
+    }
+    hdr += 6;
+
+    char *end;
+    if (*hdr == '-') {
+        /* Suffix range, i.e. the last bytes of the file */
+        unsigned long long suffix = strtoull(hdr + 1, &end, 10);
+        if (end == hdr + 1 || *end != '\0') {
+            return false;
+        }
+        *satisfiable = suffix > 0 && size > 0;
+        *first = suffix < size ? size - suffix : 0;
+        *last = size - 1;
+        return true;
+    }
+
+    unsigned long long from = strtoull(hdr, &end, 10);
+    if (end == hdr || *end != '-') {
+        return false;
+    }
+    hdr = end + 1;
+    unsigned long long to = size ? size - 1 : 0;
+    if (*hdr != '\0') {
+        to = strtoull(hdr, &end, 10);
+        if (end == hdr || *end != '\0' || to < from) {
+            return false;
+        }
+    }
+    *satisfiable = from < size;
+    *first = from;
+    *last = MIN(to, size - 1);
+    return true;
+}
+
+static esp_err_t httpd_static_send(httpd_req_t *req, const httpd_static_config_t *config,
+                                   static_file_t *file, size_t offset, size_t len)
+{
+    /* Send the headers only for HEAD requests */
+    if (req->method == HTTP_HEAD || len == 0) {
+        return httpd_resp_send_head(req, len, NULL, 0);
+    }
+
+    /* Files in memory are sent without copies, with the fewest sends */
+    if (file->data) {
+        return httpd_resp_send_head(req, len, file->data + offset, len);
+    }
+
+    if (fseek(file->f, offset, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    size_t buf_size = MIN(config->buf_size ? config->buf_size : 4096, len);
+    char *buf = malloc(buf_size);
+    if (buf == NULL) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for file buffer"));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+
+    /* As Content-Length is known, the file is sent as it is read, without chunked encoding */
+    esp_err_t ret = ESP_OK;
+    bool first = true;
+    while (len > 0) {
+        size_t read_len = fread(buf, 1, MIN(buf_size, len), file->f);
+        if (read_len == 0) {
+            ESP_LOGE(TAG, LOG_FMT("error reading file"));
+            ret = first ? httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL) : ESP_FAIL;
+            break;
+        }
+        if (first) {
+            ret = httpd_resp_send_head(req, len, buf, read_len);
+            first = false;
+        } else {
+            ret = httpd_send_all(req, buf, read_len);
+        }
+        if (ret != ESP_OK) {
+            break;
+        }
+        len -= read_len;
+    }
+    free(buf);
+    return ret;
+}
+
+static esp_err_t httpd_static_handler(httpd_req_t *req)
+{
+    const struct httpd_static_ctx *ctx = req->user_ctx;
+    const httpd_static_config_t *config = &ctx->config;
+
+    /* Path under the URI prefix, without the query */
+    size_t prefix_len = strlen(config->uri);
+    while (prefix_len > 0 && config->uri[prefix_len - 1] == '/') {
+        prefix_len--;
+    }
+    const char *rel = req->uri + prefix_len;
+    size_t rel_len = strcspn(rel, "?#");
+
+    /* The path is decoded before being checked, so that escaped dots or
+     * separators can't leave the directory. Room is left for ".gz" */
+    char path[HTTPD_STATIC_PATH_LEN];
+    int path_len = 0;
+    if (rel_len == 0 || rel[0] != '/') {
+        path[path_len++] = '/';
+    }
+    int decoded_len = httpd_static_unescape(rel, rel_len, path + path_len, sizeof(path) - 3 - path_len);
+    if (decoded_len < 0) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    path_len += decoded_len;
+    if (path[path_len - 1] == '/' && config->index_file) {
+        path_len += snprintf(path + path_len, sizeof(path) - 3 - path_len, "%s", config->index_file);
+    }
+    if (path_len >= sizeof(path) - 3 || !httpd_static_path_valid(path)) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+
+    /* Request headers need to be fetched before anything is sent */
+    char accept_enc[64] = "";
+    char if_none_match[128] = "";
+    char range[64] = "";
+    httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept_enc, sizeof(accept_enc));
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) != ESP_OK) {
+        if_none_match[0] = '\0';
+    }
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) != ESP_OK) {
+        range[0] = '\0';
+    }
+
+    /* Prefer the pre-compressed variant of the file */
+    static_file_t file;
+    httpd_resp_set_type(req, httpd_static_type(path));
+    bool gzip = false;
+    if (strstr(accept_enc, "gzip") != NULL) {
+        strcpy(path + path_len, ".gz");
+        gzip = httpd_static_open(ctx, path, &file);
+        path[path_len] = '\0';
+    }
+    if (!gzip && !httpd_static_open(ctx, path, &file)) {
+        ESP_LOGD(TAG, LOG_FMT("%s not found"), path);
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+
+    /* Headers which a 304 response has to repeat */
+    httpd_resp_set_hdr(req, "ETag", file.etag);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (config->cache_control) {
+        httpd_resp_set_hdr(req, "Cache-Control", config->cache_control);
+    }
+
+    esp_err_t ret;
+    if (if_none_match[0] && (strstr(if_none_match, file.etag) || strcmp(if_none_match, "*") == 0)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        ret = httpd_resp_send_no_content(req);
+        httpd_static_close(&file);
+        return ret;
+    }
+
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    if (gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+
+    size_t first, last;
+    bool satisfiable;
+    char content_range[48];
+    if (range[0] && httpd_static_parse_range(range, file.size, &first, &last, &satisfiable)) {
+        if (satisfiable) {
+            snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u",
+                     (unsigned) first, (unsigned) last, (unsigned) file.size);
+            httpd_resp_set_status(req, "206 Partial Content");
+            httpd_resp_set_hdr(req, "Content-Range", content_range);
+            ret = httpd_static_send(req, config, &file, first, last - first + 1);
+        } else {
+            snprintf(content_range, sizeof(content_range), "bytes */%u", (unsigned) file.size);
+            httpd_resp_set_status(req, "416 Range Not Satisfiable");
+            httpd_resp_set_hdr(req, "Content-Range", content_range);
+            ret = httpd_resp_send_head(req, 0, NULL, 0);
+        }
+    } else {
+        ret = httpd_static_send(req, config, &file, 0, file.size);
+    }
+    httpd_static_close(&file);
+    return ret;
+}
+
+static void httpd_static_ctx_free(struct httpd_static_ctx *ctx)
+{
+    free((char *) ctx->config.uri);
+    free((char *) ctx->config.base_path);
+    free((char *) ctx->config.index_file);
+    free((char *) ctx->config.cache_control);
+    free(ctx);
+}
+
+esp_err_t httpd_register_static(httpd_handle_t handle, const httpd_static_config_t *config)
+{
+    if (handle == NULL || config == NULL || config->uri == NULL ||
+        (config->base_path == NULL && config->files == NULL && config->file_count)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    if (hd->config.uri_match_fn != httpd_uri_match_wildcard) {
+        ESP_LOGE(TAG, LOG_FMT("static files need the wildcard URI matcher"));
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* Match the prefix itself, and anything under it */
+    char uri[CONFIG_HTTPD_MAX_URI_LEN + 1];
+    size_t prefix_len = strlen(config->uri);
+    while (prefix_len > 0 && config->uri[prefix_len - 1] == '/') {
+        prefix_len--;
+    }
+    if (snprintf(uri, sizeof(uri), "%.*s%s", (int) prefix_len, config->uri,
+                 prefix_len ? "/?*" : "/*") >= sizeof(uri)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Entity tags of the files in memory are computed once, from their contents */
+    size_t etag_count = config->base_path ? 0 : config->file_count;
+    struct httpd_static_ctx *ctx = calloc(1, sizeof(struct httpd_static_ctx) + etag_count * sizeof(ctx->etags[0]));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->refs = 1;
+    ctx->config = *config;
+    ctx->config.uri = strdup(config->uri);
+    ctx->config.base_path = config->base_path ? strdup(config->base_path) : NULL;
+    ctx->config.index_file = config->index_file ? strdup(config->index_file) : NULL;
+    ctx->config.cache_control = config->cache_control ? strdup(config->cache_control) : NULL;
+    if (ctx->config.uri == NULL ||
+        (config->base_path && ctx->config.base_path == NULL) ||
+        (config->index_file && ctx->config.index_file == NULL) ||
+        (config->cache_control && ctx->config.cache_control == NULL)) {
+        httpd_static_ctx_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < etag_count; i++) {
+        const httpd_static_file_t *entry = &config->files[i];
+        if (entry->etag == NULL) {
+            /* FNV-1a hash */
+            const uint8_t *data = entry->data;
+            uint32_t hash = 2166136261u;
+            for (size_t j = 0; j < entry->len; j++) {
+                hash = (hash ^ data[j]) * 16777619u;
+            }
+            snprintf(ctx->etags[i], sizeof(ctx->etags[i]), "\"%x-%x\"", (unsigned) entry->len, (unsigned) hash);
+        }
+    }
+
+    httpd_uri_t handler = {
+        .uri      = uri,
+        .method   = HTTP_GET,
+        .handler  = httpd_static_handler,
+        .user_ctx = ctx,
+    };
+    esp_err_t ret = httpd_register_uri_handler(handle, &handler);
+    if (ret == ESP_OK) {
+        handler.method = HTTP_HEAD;
+        ret = httpd_register_uri_handler(handle, &handler);
+        if (ret != ESP_OK) {
+            httpd_unregister_uri_handler(handle, uri, HTTP_GET);
+        }
+    }
+    /* Drop the reference taken above, the handlers hold their own
+     * ones, if they were registered */
+    xSemaphoreTake(hd->hd_uri_lock, portMAX_DELAY);
+    httpd_static_unref(&handler);
+    xSemaphoreGive(hd->hd_uri_lock);
+    return ret;
+}
+
+bool httpd_static_ref(const httpd_uri_t *uri)
+{
+    if (uri->handler != httpd_static_handler) {
+        return false;
+    }
+    ((struct httpd_static_ctx *) uri->user_ctx)->refs++;
+    return true;
+}
+
+void httpd_static_unref(const httpd_uri_t *uri)
+{
+    if (uri->handler != httpd_static_handler) {
+        return;
+    }
+    struct httpd_static_ctx *ctx = uri->user_ctx;
+    if (--ctx->refs == 0) {
+        httpd_static_ctx_free(ctx);
+    }
+}
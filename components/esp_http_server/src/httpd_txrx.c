@@ -63,7 +63,7 @@ int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
     return ret;
 }
 
-static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
+esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
 {
     struct httpd_req_aux *ra = r->aux;
     int ret;
@@ -224,6 +224,76 @@ esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
     return ESP_OK;
 }
 
+/* The response is serialized into the scratch buffer and handed over to the
+ * send function in as few calls as possible: the status line, all headers and,
+ * if it fits, the content go out together. `len` is the number of bytes already
+ * queued in the scratch buffer */
+static esp_err_t httpd_resp_buf_flush(httpd_req_t *r, size_t *len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    if (*len > 0) {
+        if (httpd_send_all(r, ra->scratch, *len) != ESP_OK) {
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+        *len = 0;
+    }
+    return ESP_OK;
+}
+
+/* Copies data into the scratch buffer, flushing it whenever it gets full */
+static esp_err_t httpd_resp_buf_append(httpd_req_t *r, size_t *len, const char *data, size_t data_len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    while (data_len > 0) {
+        if (*len == sizeof(ra->scratch)) {
+            if (httpd_resp_buf_flush(r, len) != ESP_OK) {
+                return ESP_ERR_HTTPD_RESP_SEND;
+            }
+        }
+        size_t copy_len = MIN(data_len, sizeof(ra->scratch) - *len);
+        memcpy(ra->scratch + *len, data, copy_len);
+        *len     += copy_len;
+        data     += copy_len;
+        data_len -= copy_len;
+    }
+    return ESP_OK;
+}
+
+/* Queues content which fits into the remaining space of the scratch buffer,
+ * otherwise sends whatever is queued and the content directly from the caller's buffer */
+static esp_err_t httpd_resp_buf_send(httpd_req_t *r, size_t *len, const char *data, size_t data_len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    if (data_len <= sizeof(ra->scratch) - *len) {
+        return httpd_resp_buf_append(r, len, data, data_len);
+    }
+    if (httpd_resp_buf_flush(r, len) != ESP_OK) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    if (httpd_send_all(r, data, data_len) != ESP_OK) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+/* Appends the additional headers based on set_header and the end of header section */
+static esp_err_t httpd_resp_buf_append_hdrs(httpd_req_t *r, size_t *len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    const char *colon_separator = ": ";
+    const char *cr_lf_seperator = "\r\n";
+
+    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
+        if (httpd_resp_buf_append(r, len, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK ||
+            httpd_resp_buf_append(r, len, colon_separator, strlen(colon_separator)) != ESP_OK ||
+            httpd_resp_buf_append(r, len, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK ||
+            httpd_resp_buf_append(r, len, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+    }
+    return httpd_resp_buf_append(r, len, cr_lf_seperator, strlen(cr_lf_seperator));
+}
+
 esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
 {
     if (r == NULL) {
@@ -234,61 +304,59 @@ esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
         return ESP_ERR_HTTPD_INVALID_REQ;
     }
 
-    struct httpd_req_aux *ra = r->aux;
-    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
-
     if (buf_len == HTTPD_RESP_USE_STRLEN) {
         buf_len = strlen(buf);
     }
+    return httpd_resp_send_head(r, buf_len, buf, buf_len);
+}
+
+esp_err_t httpd_resp_send_head(httpd_req_t *r, size_t content_len, const char *buf, size_t buf_len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n";
 
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
     /* Size of essential headers is limited by scratch buffer size */
-    if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
-                 ra->status, ra->content_type, buf_len) >= sizeof(ra->scratch)) {
+    int len = snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
+                       ra->status, ra->content_type, (unsigned) content_len);
+    if (len >= sizeof(ra->scratch)) {
         return ESP_ERR_HTTPD_RESP_HDR;
     }
+    size_t queued = len;
 
-    /* Sending essential headers */
-    if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != ESP_OK) {
+    /* Queue additional headers behind the essential ones */
+    if (httpd_resp_buf_append_hdrs(r, &queued) != ESP_OK) {
         return ESP_ERR_HTTPD_RESP_SEND;
     }
 
-    /* Sending additional headers based on set_header */
-    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-        /* Send header field */
-        if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send ': ' */
-        if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send header value */
-        if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send CR + LF */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
+    /* Sending headers together with the content, if it fits */
+    if (buf && buf_len) {
+        if (httpd_resp_buf_send(r, &queued, buf, buf_len) != ESP_OK) {
             return ESP_ERR_HTTPD_RESP_SEND;
         }
     }
+    return httpd_resp_buf_flush(r, &queued);
+}
 
-    /* End header section */
-    if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
+esp_err_t httpd_resp_send_no_content(httpd_req_t *r)
+{
+    struct httpd_req_aux *ra = r->aux;
+
+    /* Request headers are no longer available */
+    ra->req_hdrs_count = 0;
+
+    int len = snprintf(ra->scratch, sizeof(ra->scratch), "HTTP/1.1 %s\r\n", ra->status);
+    if (len >= sizeof(ra->scratch)) {
+        return ESP_ERR_HTTPD_RESP_HDR;
     }
+    size_t queued = len;
 
-    /* Sending content */
-    if (buf && buf_len) {
-        if (httpd_send_all(r, buf, buf_len) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
+    if (httpd_resp_buf_append_hdrs(r, &queued) != ESP_OK) {
+        return ESP_ERR_HTTPD_RESP_SEND;
     }
-    return ESP_OK;
+    return httpd_resp_buf_flush(r, &queued);
 }
 
 esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
@@ -307,69 +375,44 @@ esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len
 
     struct httpd_req_aux *ra = r->aux;
     const char *httpd_chunked_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
+    size_t queued = 0;
 
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
     if (!ra->first_chunk_sent) {
         /* Size of essential headers is limited by scratch buffer size */
-        if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
-                     ra->status, ra->content_type) >= sizeof(ra->scratch)) {
+        int len = snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
+                           ra->status, ra->content_type);
+        if (len >= sizeof(ra->scratch)) {
             return ESP_ERR_HTTPD_RESP_HDR;
         }
+        queued = len;
 
-        /* Sending essential headers */
-        if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-
-        /* Sending additional headers based on set_header */
-        for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-            /* Send header field */
-            if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send ': ' */
-            if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send header value */
-            if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send CR + LF */
-            if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-        }
-
-        /* End header section */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
+        /* Queue additional headers behind the essential ones */
+        if (httpd_resp_buf_append_hdrs(r, &queued) != ESP_OK) {
             return ESP_ERR_HTTPD_RESP_SEND;
         }
         ra->first_chunk_sent = true;
     }
 
-    /* Sending chunked content */
+    /* Queue chunk size, chunked content and end of chunk */
     char len_str[10];
     snprintf(len_str, sizeof(len_str), "%x\r\n", buf_len);
-    if (httpd_send_all(r, len_str, strlen(len_str)) != ESP_OK) {
+    if (httpd_resp_buf_append(r, &queued, len_str, strlen(len_str)) != ESP_OK) {
         return ESP_ERR_HTTPD_RESP_SEND;
     }
 
     if (buf) {
-        if (httpd_send_all(r, buf, (size_t) buf_len) != ESP_OK) {
+        if (httpd_resp_buf_send(r, &queued, buf, (size_t) buf_len) != ESP_OK) {
             return ESP_ERR_HTTPD_RESP_SEND;
         }
     }
 
-    /* Indicate end of chunk */
-    if (httpd_send_all(r, "\r\n", strlen("\r\n")) != ESP_OK) {
+    if (httpd_resp_buf_append(r, &queued, "\r\n", strlen("\r\n")) != ESP_OK) {
         return ESP_ERR_HTTPD_RESP_SEND;
     }
-    return ESP_OK;
+    return httpd_resp_buf_flush(r, &queued);
 }
 
 esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *usr_msg)
@@ -80,6 +80,215 @@ bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
     }
 }
 
+/* Node of the radix tree which routes requests to URI handlers. The edge from
+ * the parent is labelled with a substring of a registered URI, so a node stands
+ * for the concatenation of the labels on the path from the root. Each node keeps
+ * the indices (into hd_calls) of the handlers which match when the request URI
+ * equals the node string (exact) or starts with it (prefix). Indices are kept in
+ * registration order, so the first matching handler still takes precedence */
+struct httpd_uri_node {
+    const char *label;              /*!< Edge label, points into the URI of a registered handler */
+    size_t label_len;               /*!< Length of the edge label */
+    uint16_t *exact;                /*!< Handlers matching URIs equal to the node string */
+    uint16_t exact_count;
+    uint16_t *prefix;               /*!< Handlers matching URIs starting with the node string */
+    uint16_t prefix_count;
+    struct httpd_uri_node *child;   /*!< First child */
+    struct httpd_uri_node *next;    /*!< Next sibling */
+};
+
+static void httpd_uri_router_free(struct httpd_uri_node *node)
+{
+    while (node) {
+        struct httpd_uri_node *next = node->next;
+        httpd_uri_router_free(node->child);
+        free(node->exact);
+        free(node->prefix);
+        free(node);
+        node = next;
+    }
+}
+
+static esp_err_t httpd_uri_node_add(uint16_t **slots, uint16_t *count, uint16_t index)
+{
+    uint16_t *new_slots = realloc(*slots, (*count + 1) * sizeof(uint16_t));
+    if (new_slots == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    new_slots[(*count)++] = index;
+    *slots = new_slots;
+    return ESP_OK;
+}
+
+/* Adds handler at index, matching URIs equal to (or starting with, if prefix is set)
+ * the first len characters of str */
+static esp_err_t httpd_uri_router_insert(struct httpd_uri_node *root, const char *str, size_t len,
+                                         bool prefix, uint16_t index)
+{
+    struct httpd_uri_node *node = root;
+    size_t pos = 0;
+
+    while (pos < len) {
+        struct httpd_uri_node **link = &node->child;
+        while (*link && (*link)->label[0] != str[pos]) {
+            link = &(*link)->next;
+        }
+        struct httpd_uri_node *child = *link;
+        if (child == NULL) {
+            /* No edge starts with this character, the rest of string becomes a new leaf */
+            child = calloc(1, sizeof(struct httpd_uri_node));
+            if (child == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+            child->label = str + pos;
+            child->label_len = len - pos;
+            *link = child;
+            node = child;
+            break;
+        }
+
+        size_t common = 1;
+        while (common < child->label_len && pos + common < len &&
+               child->label[common] == str[pos + common]) {
+            common++;
+        }
+        if (common < child->label_len) {
+            /* String diverges or ends in the middle of the edge, split it */
+            struct httpd_uri_node *split = calloc(1, sizeof(struct httpd_uri_node));
+            if (split == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+            split->label = child->label;
+            split->label_len = common;
+            split->next = child->next;
+            split->child = child;
+            child->label += common;
+            child->label_len -= common;
+            child->next = NULL;
+            *link = split;
+            child = split;
+        }
+        node = child;
+        pos += common;
+    }
+
+    return prefix ? httpd_uri_node_add(&node->prefix, &node->prefix_count, index) :
+                    httpd_uri_node_add(&node->exact, &node->exact_count, index);
+}
+
+/* Adds a handler URI to the router, following the matching rules of
+ * httpd_uri_match_wildcard() (if wildcard is set) or of plain string compare */
+static esp_err_t httpd_uri_router_add(struct httpd_uri_node *root, const char *template,
+                                      bool wildcard, uint16_t index)
+{
+    const size_t tpl_len = strlen(template);
+    if (!wildcard) {
+        return httpd_uri_router_insert(root, template, tpl_len, false, index);
+    }
+
+    const char last = (const char) (tpl_len > 0 ? template[tpl_len - 1] : 0);
+    const char prevlast = (const char) (tpl_len > 1 ? template[tpl_len - 2] : 0);
+    const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+    const bool quest = last == '?' || (prevlast == '?' && last == '*');
+
+    /* Invalid template, it never matches */
+    if (tpl_len < asterisk + quest*2) {
+        return ESP_OK;
+    }
+    const size_t exact_match_chars = tpl_len - (asterisk + quest*2);
+
+    if (!quest) {
+        return httpd_uri_router_insert(root, template, exact_match_chars, asterisk, index);
+    }
+    /* With the optional character, the URI is either the mandatory part alone,
+     * or the mandatory part followed by the optional character (and anything
+     * else, if asterisk is present) */
+    esp_err_t ret = httpd_uri_router_insert(root, template, exact_match_chars, false, index);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return httpd_uri_router_insert(root, template, exact_match_chars + 1, asterisk, index);
+}
+
+/* Rebuilds the router after the set of handlers has changed. The router is only used with
+ * the built-in URI matching functions, otherwise (or if it can't be allocated) handlers
+ * are looked up by calling uri_match_fn for each of them */
+static void httpd_uri_router_rebuild(struct httpd_data *hd)
+{
+    httpd_uri_router_free(hd->hd_uri_router);
+    hd->hd_uri_router = NULL;
+
+    const bool wildcard = hd->config.uri_match_fn == httpd_uri_match_wildcard;
+    if (hd->config.uri_match_fn && !wildcard) {
+        return;
+    }
+
+    struct httpd_uri_node *root = calloc(1, sizeof(struct httpd_uri_node));
+    if (root == NULL) {
+        ESP_LOGW(TAG, LOG_FMT("no memory for URI router, using linear lookup"));
+        return;
+    }
+    for (uint16_t i = 0; i < hd->config.max_uri_handlers && hd->hd_calls[i]; i++) {
+        if (httpd_uri_router_add(root, hd->hd_calls[i]->uri, wildcard, i) != ESP_OK) {
+            ESP_LOGW(TAG, LOG_FMT("no memory for URI router, using linear lookup"));
+            httpd_uri_router_free(root);
+            return;
+        }
+    }
+    hd->hd_uri_router = root;
+}
+
+/* Picks the first handler in slots which supports the method, keeping
+ * the one registered earliest among all the candidates seen so far */
+static void httpd_uri_router_check(struct httpd_data *hd, const uint16_t *slots, uint16_t count,
+                                   httpd_method_t method, int *found, bool *uri_found)
+{
+    for (uint16_t i = 0; i < count; i++) {
+        *uri_found = true;
+        if (*found >= 0 && slots[i] >= *found) {
+            /* Only later registered handlers follow */
+            return;
+        }
+        if (hd->hd_calls[slots[i]]->method == method) {
+            *found = slots[i];
+            return;
+        }
+    }
+}
+
+static httpd_uri_t* httpd_uri_router_find(struct httpd_data *hd,
+                                          const char *uri, size_t uri_len,
+                                          httpd_method_t method,
+                                          httpd_err_code_t *err)
+{
+    struct httpd_uri_node *node = hd->hd_uri_router;
+    size_t pos = 0;
+    int found = -1;
+    bool uri_found = false;
+
+    httpd_uri_router_check(hd, node->prefix, node->prefix_count, method, &found, &uri_found);
+    while (pos < uri_len) {
+        node = node->child;
+        while (node && node->label[0] != uri[pos]) {
+            node = node->next;
+        }
+        if (node == NULL || node->label_len > uri_len - pos ||
+            memcmp(node->label, uri + pos, node->label_len) != 0) {
+            break;
+        }
+        pos += node->label_len;
+        httpd_uri_router_check(hd, node->prefix, node->prefix_count, method, &found, &uri_found);
+    }
+    if (pos == uri_len) {
+        httpd_uri_router_check(hd, node->exact, node->exact_count, method, &found, &uri_found);
+    }
+
+    if (err) {
+        *err = found >= 0 ? 0 : uri_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND;
+    }
+    return found >= 0 ? hd->hd_calls[found] : NULL;
+}
+
 /* Find handler with matching URI and method, and set
  * appropriate error code if URI or method not found */
 static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
@@ -87,6 +296,10 @@ static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
                                            httpd_method_t method,
                                            httpd_err_code_t *err)
 {
+    if (hd->hd_uri_router) {
+        return httpd_uri_router_find(hd, uri, uri_len, method, err);
+    }
+
     if (err) {
         *err = HTTPD_404_NOT_FOUND;
     }
@@ -123,20 +336,13 @@ static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
     return NULL;
 }
 
-esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
-                                     const httpd_uri_t *uri_handler)
+static esp_err_t httpd_uri_register(struct httpd_data *hd, const httpd_uri_t *uri_handler)
 {
-    if (handle == NULL || uri_handler == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    struct httpd_data *hd = (struct httpd_data *) handle;
-
     /* Make sure another handler with matching URI and method
      * is not already registered. This will also catch cases
      * when a registered URI wildcard pattern already accounts
      * for the new URI being registered */
-    if (httpd_find_uri_handler(handle, uri_handler->uri,
+    if (httpd_find_uri_handler(hd, uri_handler->uri,
                                strlen(uri_handler->uri),
                                uri_handler->method, NULL) != NULL) {
         ESP_LOGW(TAG, LOG_FMT("handler %s with method %d already registered"),
@@ -174,6 +380,8 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
             }
 #endif
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
+            httpd_static_ref(hd->hd_calls[i]);
+            httpd_uri_router_rebuild(hd);
             return ESP_OK;
         }
         ESP_LOGD(TAG, LOG_FMT("[%d] exists %s"), i, hd->hd_calls[i]->uri);
@@ -182,14 +390,23 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
     return ESP_ERR_HTTPD_HANDLERS_FULL;
 }
 
-esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
-                                       const char *uri, httpd_method_t method)
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler)
 {
-    if (handle == NULL || uri == NULL) {
+    if (handle == NULL || uri_handler == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
+    xSemaphoreTake(hd->hd_uri_lock, portMAX_DELAY);
+    esp_err_t ret = httpd_uri_register(hd, uri_handler);
+    xSemaphoreGive(hd->hd_uri_lock);
+    return ret;
+}
+
+static esp_err_t httpd_uri_unregister_handler(struct httpd_data *hd,
+                                              const char *uri, httpd_method_t method)
+{
     for (int i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -198,6 +415,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             (strcmp(hd->hd_calls[i]->uri, uri) == 0)) {  // Then match URI string
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
 
+            httpd_static_unref(hd->hd_calls[i]);
             free((char*)hd->hd_calls[i]->uri);
             free(hd->hd_calls[i]);
             hd->hd_calls[i] = NULL;
@@ -212,6 +430,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             }
             /* Nullify the following non null entry */
             hd->hd_calls[i-1] = NULL;
+            httpd_uri_router_rebuild(hd);
             return ESP_OK;
         }
     }
@@ -219,13 +438,22 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
     return ESP_ERR_NOT_FOUND;
 }
 
-esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
+                                       const char *uri, httpd_method_t method)
 {
     if (handle == NULL || uri == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
+    xSemaphoreTake(hd->hd_uri_lock, portMAX_DELAY);
+    esp_err_t ret = httpd_uri_unregister_handler(hd, uri, method);
+    xSemaphoreGive(hd->hd_uri_lock);
+    return ret;
+}
+
+static esp_err_t httpd_uri_unregister(struct httpd_data *hd, const char *uri)
+{
     bool found = false;
 
     int i = 0, j = 0; // For keeping count of removed entries
@@ -236,6 +464,7 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
         if (strcmp(hd->hd_calls[i]->uri, uri) == 0) {   // Match URI strings
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, uri);
 
+            httpd_static_unref(hd->hd_calls[i]);
             free((char*)hd->hd_calls[i]->uri);
             free(hd->hd_calls[i]);
             hd->hd_calls[i] = NULL;
@@ -255,35 +484,58 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
 
     if (!found) {
         ESP_LOGW(TAG, LOG_FMT("no handler found for URI %s"), uri);
+    } else {
+        httpd_uri_router_rebuild(hd);
     }
     return (found ? ESP_OK : ESP_ERR_NOT_FOUND);
 }
 
+esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
+{
+    if (handle == NULL || uri == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    xSemaphoreTake(hd->hd_uri_lock, portMAX_DELAY);
+    esp_err_t ret = httpd_uri_unregister(hd, uri);
+    xSemaphoreGive(hd->hd_uri_lock);
+    return ret;
+}
+
 void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
 {
+    httpd_uri_router_free(hd->hd_uri_router);
+    hd->hd_uri_router = NULL;
+
     for (unsigned i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
         }
         ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
 
+        httpd_static_unref(hd->hd_calls[i]);
         free((char*)hd->hd_calls[i]->uri);
         free(hd->hd_calls[i]);
         hd->hd_calls[i] = NULL;
     }
 }
 
-esp_err_t httpd_uri(struct httpd_data *hd)
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    struct http_parser_url *res = &((struct httpd_req_aux *)req->aux)->url_parse_res;
 
     /* For conveying URI not found/method not allowed */
     httpd_err_code_t err = 0;
 
     ESP_LOGD(TAG, LOG_FMT("request for %s with type %d"), req->uri, req->method);
 
+    /* Handlers may be registered and unregistered by other tasks (or by
+     * other workers) meanwhile, so the matched one is only accessed
+     * under the lock, and its handler function is called on a copy */
+    xSemaphoreTake(hd->hd_uri_lock, portMAX_DELAY);
+
     /* URL parser result contains offset and length of path string */
     if (res->field_set & (1 << UF_PATH)) {
         uri = httpd_find_uri_handler(hd, req->uri + res->field_data[UF_PATH].off,
@@ -292,6 +544,7 @@ esp_err_t httpd_uri(struct httpd_data *hd)
 
     /* If URI with method not found, respond with error code */
     if (uri == NULL) {
+        xSemaphoreGive(hd->hd_uri_lock);
         switch (err) {
             case HTTPD_404_NOT_FOUND:
                 ESP_LOGW(TAG, LOG_FMT("URI '%s' not found"), req->uri);
@@ -305,6 +558,10 @@ esp_err_t httpd_uri(struct httpd_data *hd)
         }
     }
 
+    /* Copy of the matched handler, which stays usable if it is unregistered
+     * while being executed. A static file handler context is kept until then */
+    httpd_uri_t matched = *uri;
+
     /* Attach user context data (passed during URI registration) into request */
     req->user_ctx = uri->user_ctx;
 
@@ -313,8 +570,9 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     struct httpd_req_aux   *aux = req->aux;
     if (uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET) {
         ESP_LOGD(TAG, LOG_FMT("Responding WS handshake to sock %d"), aux->sd->fd);
-        esp_err_t ret = httpd_ws_respond_server_handshake(&hd->hd_req, uri->supported_subprotocol);
+        esp_err_t ret = httpd_ws_respond_server_handshake(req, uri->supported_subprotocol);
         if (ret != ESP_OK) {
+            xSemaphoreGive(hd->hd_uri_lock);
             return ret;
         }
 
@@ -324,9 +582,20 @@ esp_err_t httpd_uri(struct httpd_data *hd)
         aux->sd->ws_user_ctx = uri->user_ctx;
     }
 #endif
+    bool ref = httpd_static_ref(uri);
+    xSemaphoreGive(hd->hd_uri_lock);
+
+    /* Invoke handler, without holding the lock, so that
+     * it can register and unregister handlers itself */
+    esp_err_t handler_ret = matched.handler(req);
+
+    if (ref) {
+        xSemaphoreTake(hd->hd_uri_lock, portMAX_DELAY);
+        httpd_static_unref(&matched);
+        xSemaphoreGive(hd->hd_uri_lock);
+    }
 
-    /* Invoke handler */
-    if (uri->handler(req) != ESP_OK) {
+    if (handler_ret != ESP_OK) {
         /* Handler returns error, this socket should be closed */
         ESP_LOGW(TAG, LOG_FMT("uri handler execution failed"));
         return ESP_FAIL;
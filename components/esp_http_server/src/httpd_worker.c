@@ -0,0 +1,199 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_worker";
+
+/* Outcome of processing a session, reported back to the server task.
+ * A NULL session is reported by a worker which is exiting */
+struct httpd_work_done {
+    struct sock_db *session;
+    esp_err_t ret;
+};
+
+static void httpd_worker_task(void *arg)
+{
+    struct httpd_worker *w = (struct httpd_worker *) arg;
+    struct httpd_data *hd = w->hd;
+    w->handle = httpd_os_thread_handle();
+
+    struct sock_db *session;
+    while (xQueueReceive(hd->hd_work_queue, &session, portMAX_DELAY) == pdTRUE && session) {
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), session->fd);
+        struct httpd_work_done done = {
+            .session = session,
+            .ret = httpd_sess_process(hd, session),
+        };
+        xQueueSend(hd->hd_done_queue, &done, portMAX_DELAY);
+
+        /* Wake up the server task to take the session back. If the control
+         * message can't be sent, the session is taken back on the next wakeup */
+        if (hd->hd_td.status == THREAD_RUNNING) {
+            httpd_queue_work(hd, httpd_workers_collect, hd);
+        }
+    }
+
+    struct httpd_work_done done = {
+        .session = NULL,
+    };
+    xQueueSend(hd->hd_done_queue, &done, portMAX_DELAY);
+    httpd_os_thread_delete();
+}
+
+static void httpd_workers_free(struct httpd_data *hd)
+{
+    if (hd->hd_workers) {
+        for (int i = 0; i < hd->config.worker_count; i++) {
+            free(hd->hd_workers[i].req_aux.resp_hdrs);
+        }
+        free(hd->hd_workers);
+        hd->hd_workers = NULL;
+    }
+    if (hd->hd_work_queue) {
+        vQueueDelete(hd->hd_work_queue);
+        hd->hd_work_queue = NULL;
+    }
+    if (hd->hd_done_queue) {
+        vQueueDelete(hd->hd_done_queue);
+        hd->hd_done_queue = NULL;
+    }
+}
+
+esp_err_t httpd_workers_start(struct httpd_data *hd)
+{
+    const int count = hd->config.worker_count;
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    /* Every session is handed over at most once at a time, and
+     * each worker reports its exit, so the queues never get full */
+    hd->hd_workers = calloc(count, sizeof(struct httpd_worker));
+    hd->hd_work_queue = xQueueCreate(hd->config.max_open_sockets + count, sizeof(struct sock_db *));
+    hd->hd_done_queue = xQueueCreate(hd->config.max_open_sockets + count, sizeof(struct httpd_work_done));
+    if (!hd->hd_workers || !hd->hd_work_queue || !hd->hd_done_queue) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP workers"));
+        httpd_workers_free(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    for (int i = 0; i < count; i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        w->hd = hd;
+        w->req_aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (!w->req_aux.resp_hdrs) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP response headers"));
+            httpd_workers_free(hd);
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        if (httpd_os_thread_create(&w->handle, "httpd_worker",
+                                   hd->config.stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_task, w,
+                                   tskNO_AFFINITY) != ESP_OK) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to launch HTTP worker"));
+            /* Only let the workers which have been launched exit */
+            for (int j = i; j < count; j++) {
+                free(hd->hd_workers[j].req_aux.resp_hdrs);
+            }
+            hd->config.worker_count = i;
+            httpd_workers_stop(hd);
+            return ESP_ERR_HTTPD_TASK;
+        }
+    }
+    return ESP_OK;
+}
+
+void httpd_workers_stop(struct httpd_data *hd)
+{
+    if (!hd->hd_workers) {
+        return;
+    }
+
+    /* Workers exit after processing the sessions queued before */
+    struct sock_db *stop = NULL;
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        xQueueSend(hd->hd_work_queue, &stop, portMAX_DELAY);
+    }
+
+    int running = hd->config.worker_count;
+    struct httpd_work_done done;
+    while (running && xQueueReceive(hd->hd_done_queue, &done, portMAX_DELAY) == pdTRUE) {
+        if (done.session) {
+            /* Leave the session to httpd_sess_close_all() */
+            done.session->in_worker = false;
+        } else {
+            running--;
+        }
+    }
+    httpd_workers_free(hd);
+}
+
+void httpd_workers_dispatch(struct httpd_data *hd, struct sock_db *session)
+{
+    /* Stop waiting on the session, rather than disabling it, as errors
+     * would still be reported for it while the worker processes it */
+    httpd_evloop_remove(hd, session->fd, session);
+    session->in_worker = true;
+    xQueueSend(hd->hd_work_queue, &session, portMAX_DELAY);
+}
+
+void httpd_workers_collect(void *arg)
+{
+    struct httpd_data *hd = (struct httpd_data *) arg;
+    if (!hd->hd_workers) {
+        return;
+    }
+
+    struct httpd_work_done done;
+    while (xQueueReceive(hd->hd_done_queue, &done, 0) == pdTRUE) {
+        struct sock_db *session = done.session;
+        session->in_worker = false;
+        if (done.ret != ESP_OK || session->close_pending) {
+            httpd_sess_delete(hd, session);
+            continue;
+        }
+        session->lru_counter = atomic_fetch_add(&hd->lru_counter, 1) + 1;
+        if (httpd_evloop_add(hd, session->fd, session) != ESP_OK) {
+            ESP_LOGW(TAG, LOG_FMT("unable to wait for fd = %d"), session->fd);
+            httpd_sess_delete(hd, session);
+            continue;
+        }
+        /* Data left buffered after the request won't make the socket readable */
+        if (httpd_sess_pending(hd, session)) {
+            httpd_evloop_defer(hd, session);
+        }
+    }
+}
+
+httpd_req_t *httpd_task_req(struct httpd_data *hd, struct httpd_req_aux **aux)
+{
+    if (hd->hd_workers) {
+        othread_t self = httpd_os_thread_handle();
+        for (int i = 0; i < hd->config.worker_count; i++) {
+            struct httpd_worker *w = &hd->hd_workers[i];
+            if (w->handle == self) {
+                if (aux) {
+                    *aux = &w->req_aux;
+                }
+                return &w->req;
+            }
+        }
+    }
+    if (aux) {
+        *aux = &hd->hd_req_aux;
+    }
+    return &hd->hd_req;
+}
@@ -8,6 +8,8 @@
 #include <stdbool.h>
 #include <esp_system.h>
 #include <esp_http_server.h>
+#include <esp_timer.h>
+#include "lwip/sockets.h"
 
 #include "unity.h"
 #include "test_utils.h"
@@ -225,6 +227,55 @@ TEST_CASE("URI Wildcard Matcher Tests", "[HTTP SERVER]")
     }
 }
 
+TEST_CASE("URI Router Tests", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = 64;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+
+    /* Registering a handler which is already covered by another
+     * URI and method is rejected, as the lookup finds the latter */
+    char paths[60][24];
+    for (int i = 0; i < 60; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/api/res%d/?*", i);
+        httpd_uri_t uri = {
+            .uri     = paths[i],
+            .method  = (i % 2) ? HTTP_POST : HTTP_GET,
+            .handler = null_func,
+        };
+        TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    }
+    httpd_uri_t uri = {
+        .uri     = "/api/res10/item",
+        .method  = HTTP_GET,
+        .handler = null_func,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    uri.uri = "/api/res10";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    uri.uri = "/api/res1";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    uri.uri = "/api/res10x";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    uri.uri = "/api/res11/item";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    /* After unregistering, the URI is free again */
+    TEST_ASSERT(httpd_unregister_uri_handler(hd, paths[10], HTTP_GET) == ESP_OK);
+    uri.uri = "/api/res10/item";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    uri.uri = "/api/res12/item";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    TEST_ASSERT(httpd_unregister_uri(hd, paths[12]) == ESP_OK);
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
 TEST_CASE("Max Allowed Sockets Test", "[HTTP SERVER]")
 {
     test_case_uses_tcpip();
@@ -243,3 +294,554 @@ TEST_CASE("Max Allowed Sockets Test", "[HTTP SERVER]")
     config.max_open_sockets += 1;
     TEST_ASSERT(httpd_start(&hd, &config) != ESP_OK);
 }
+
+static int test_connect(uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    TEST_ASSERT(sock >= 0);
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    TEST_ASSERT(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    return sock;
+}
+
+static unsigned resp_send_calls;
+
+static int counting_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    resp_send_calls++;
+    return send(sockfd, buf, buf_len, flags);
+}
+
+static char resp_body[100];
+
+static esp_err_t gather_handler(httpd_req_t *req)
+{
+    resp_send_calls = 0;
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), counting_send);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Connection", "keep-alive");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, resp_body, sizeof(resp_body));
+}
+
+TEST_CASE("Small response is sent with one call", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_uri_t uri = {
+        .uri      = "/gather",
+        .method   = HTTP_GET,
+        .handler  = gather_handler,
+        .user_ctx = NULL,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    memset(resp_body, 'x', sizeof(resp_body));
+
+    int sock = test_connect(config.server_port);
+
+    const char *request = "GET /gather HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    const int requests = 20;
+    char resp[512];
+    int64_t total_us = 0;
+    for (int i = 0; i < requests; i++) {
+        int64_t start = esp_timer_get_time();
+        TEST_ASSERT(send(sock, request, strlen(request), 0) == strlen(request));
+        /* Receive until the header section and the whole body are in */
+        int len = 0;
+        char *body = NULL;
+        while (body == NULL || len - (body - resp) < sizeof(resp_body)) {
+            int ret = recv(sock, &resp[len], sizeof(resp) - 1 - len, 0);
+            TEST_ASSERT(ret > 0);
+            len += ret;
+            resp[len] = '\0';
+            body = strstr(resp, "\r\n\r\n");
+            if (body) {
+                body += strlen("\r\n\r\n");
+            }
+        }
+        total_us += esp_timer_get_time() - start;
+        TEST_ASSERT(strncmp(resp, "HTTP/1.1 200 OK\r\n", strlen("HTTP/1.1 200 OK\r\n")) == 0);
+        TEST_ASSERT_NOT_NULL(strstr(resp, "\r\nContent-Length: 100\r\n"));
+        TEST_ASSERT_NOT_NULL(strstr(resp, "\r\nAccess-Control-Allow-Origin: *\r\n\r\n"));
+        TEST_ASSERT(memcmp(body, resp_body, sizeof(resp_body)) == 0);
+        TEST_ASSERT_EQUAL(1, resp_send_calls);
+    }
+    printf("Average latency per request: %lld us\n", total_us / requests);
+
+    close(sock);
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
+static esp_err_t hello_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, "hello");
+}
+
+TEST_CASE("Pipelined requests are processed", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_uri_t uri = {
+        .uri      = "/hello",
+        .method   = HTTP_GET,
+        .handler  = hello_handler,
+        .user_ctx = NULL,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    /* The second request is left buffered in the session after the first
+     * one is parsed, so the socket doesn't become readable for it again */
+    int sock = test_connect(config.server_port);
+    struct timeval tv = { .tv_sec = 2 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    const char *requests = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                           "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    TEST_ASSERT(send(sock, requests, strlen(requests), 0) == strlen(requests));
+
+    char resp[512];
+    int len = 0;
+    int responses = 0;
+    while (responses < 2) {
+        int ret = recv(sock, &resp[len], sizeof(resp) - 1 - len, 0);
+        TEST_ASSERT(ret > 0);
+        len += ret;
+        resp[len] = '\0';
+        responses = 0;
+        for (char *p = strstr(resp, "\r\n\r\nhello"); p; p = strstr(p + 1, "\r\n\r\nhello")) {
+            responses++;
+        }
+    }
+
+    close(sock);
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
+static esp_err_t slow_handler(httpd_req_t *req)
+{
+    vTaskDelay(500 / portTICK_PERIOD_MS);
+    return httpd_resp_sendstr(req, "slow");
+}
+
+static void test_recv_body(int sock, const char *body)
+{
+    char resp[512];
+    int len = 0;
+    do {
+        int ret = recv(sock, &resp[len], sizeof(resp) - 1 - len, 0);
+        TEST_ASSERT(ret > 0);
+        len += ret;
+        resp[len] = '\0';
+    } while (!strstr(resp, body));
+}
+
+TEST_CASE("Slow handler doesn't delay other sessions with workers", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.worker_count = 2;
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_uri_t slow_uri = {
+        .uri      = "/slow",
+        .method   = HTTP_GET,
+        .handler  = slow_handler,
+        .user_ctx = NULL,
+    };
+    httpd_uri_t hello_uri = {
+        .uri      = "/hello",
+        .method   = HTTP_GET,
+        .handler  = hello_handler,
+        .user_ctx = NULL,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &slow_uri) == ESP_OK);
+    TEST_ASSERT(httpd_register_uri_handler(hd, &hello_uri) == ESP_OK);
+
+    int slow_sock = test_connect(config.server_port);
+    int fast_sock = test_connect(config.server_port);
+    struct timeval tv = { .tv_sec = 2 };
+    setsockopt(slow_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fast_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    const char *slow_req = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    const char *fast_req = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    TEST_ASSERT(send(slow_sock, slow_req, strlen(slow_req), 0) == strlen(slow_req));
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+
+    /* Requests of the second session are handled by the other worker meanwhile */
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT(send(fast_sock, fast_req, strlen(fast_req), 0) == strlen(fast_req));
+        test_recv_body(fast_sock, "hello");
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    printf("Fast requests handled in %d ms\n", (int)(elapsed / 1000));
+    TEST_ASSERT(elapsed < 300 * 1000);
+
+    test_recv_body(slow_sock, "slow");
+    close(slow_sock);
+    close(fast_sock);
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
+#if CONFIG_HTTPD_EVLOOP_EPOLL
+#define TEST_EVLOOP_BACKEND     "epoll"
+#else
+#define TEST_EVLOOP_BACKEND     "poll"
+#endif
+#define KEEP_ALIVE_REQUESTS     200
+
+/* Returns the number of requests per second handled on a keep-alive connection */
+static unsigned test_keep_alive_rate(uint16_t port)
+{
+    int sock = test_connect(port);
+    struct timeval tv = { .tv_sec = 2 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    const char *req = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < KEEP_ALIVE_REQUESTS; i++) {
+        TEST_ASSERT(send(sock, req, strlen(req), 0) == strlen(req));
+        test_recv_body(sock, "hello");
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    close(sock);
+    return KEEP_ALIVE_REQUESTS * 1000000LL / elapsed;
+}
+
+/* Compares the time to wait for the sockets of the server, when most of the sessions
+ * are idle keep-alive connections. Both the server and the test open a socket per
+ * connection, so raise LWIP_MAX_SOCKETS (or use the linux target) for hundreds of them.
+ * The poll() and epoll() backends are compared by building with and without
+ * CONFIG_HTTPD_EVLOOP_EPOLL on the linux target */
+TEST_CASE("Keep-alive requests with idle sessions performance", "[HTTP SERVER][timeout=60]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    /* Listening, control and message sockets, and two sockets per session */
+    config.max_open_sockets = (CONFIG_LWIP_MAX_SOCKETS - 3) / 2;
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_uri_t hello_uri = {
+        .uri      = "/hello",
+        .method   = HTTP_GET,
+        .handler  = hello_handler,
+        .user_ctx = NULL,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &hello_uri) == ESP_OK);
+
+    unsigned rate_alone = test_keep_alive_rate(config.server_port);
+
+    const int idle_count = config.max_open_sockets - 1;
+    int *idle = malloc(idle_count * sizeof(int));
+    int *client_fds = malloc(config.max_open_sockets * sizeof(int));
+    TEST_ASSERT_NOT_NULL(idle);
+    TEST_ASSERT_NOT_NULL(client_fds);
+    for (int i = 0; i < idle_count; i++) {
+        idle[i] = test_connect(config.server_port);
+    }
+    /* Wait for the server to accept all of them */
+    size_t sessions = 0;
+    for (int i = 0; i < 100 && sessions < idle_count; i++) {
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+        sessions = config.max_open_sockets;
+        TEST_ASSERT(httpd_get_client_list(hd, &sessions, client_fds) == ESP_OK);
+    }
+    TEST_ASSERT_EQUAL(idle_count, sessions);
+
+    unsigned rate_idle = test_keep_alive_rate(config.server_port);
+    IDF_LOG_PERFORMANCE("httpd_keep_alive_req_per_sec", "%u, with %d idle sessions: %u (%s)",
+                        rate_alone, idle_count, rate_idle, TEST_EVLOOP_BACKEND);
+
+    for (int i = 0; i < idle_count; i++) {
+        close(idle[i]);
+    }
+    free(idle);
+    free(client_fds);
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
+static const char static_index[] = "<html>index</html>";
+static const char static_js[] = "console.log('0123456789');";
+static const char static_js_gz[] = "gzipped js";
+static const httpd_static_file_t static_files[] = {
+    { .path = "/index.html", .data = static_index, .len = sizeof(static_index) - 1 },
+    { .path = "/app.js", .data = static_js, .len = sizeof(static_js) - 1 },
+    { .path = "/app.js.gz", .data = static_js_gz, .len = sizeof(static_js_gz) - 1, .etag = "\"js-gz\"" },
+    { .path = "/app..min.js", .data = static_js, .len = sizeof(static_js) - 1 },
+};
+
+/* Sends a request on sock, and receives the whole response into resp */
+static void test_request(int sock, const char *method, const char *uri, const char *hdrs, char *resp, size_t resp_size)
+{
+    char req[256];
+    snprintf(req, sizeof(req), "%s %s HTTP/1.1\r\nHost: localhost\r\n%s\r\n", method, uri, hdrs);
+    TEST_ASSERT(send(sock, req, strlen(req), 0) == strlen(req));
+
+    /* The server keeps the connection open, so read until the content is complete,
+     * or the end of the headers of a response without content */
+    int len = 0;
+    while (1) {
+        int ret = recv(sock, &resp[len], resp_size - 1 - len, 0);
+        TEST_ASSERT(ret > 0);
+        len += ret;
+        resp[len] = '\0';
+        const char *body = strstr(resp, "\r\n\r\n");
+        const char *clen = strstr(resp, "Content-Length: ");
+        if (body && (!clen || strlen(body + 4) >= atoi(clen + 16))) {
+            break;
+        }
+    }
+}
+
+static void test_static_get(uint16_t port, const char *uri, const char *hdrs, char *resp, size_t resp_size)
+{
+    int sock = test_connect(port);
+    struct timeval tv = { .tv_sec = 2 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    test_request(sock, "GET", uri, hdrs, resp, resp_size);
+    close(sock);
+}
+
+TEST_CASE("Static files are served from memory", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_static_config_t static_config = HTTPD_STATIC_DEFAULT_CONFIG();
+    static_config.uri = "/static";
+    static_config.files = static_files;
+    static_config.file_count = sizeof(static_files) / sizeof(static_files[0]);
+
+    /* Unregistering the handler frees its copy of the configuration. This is
+     * checked before any connection is made, whose buffers are freed lazily */
+    TEST_ASSERT(httpd_register_static(hd, &static_config) == ESP_OK);
+    TEST_ASSERT(httpd_unregister_uri(hd, "/static/?*") == ESP_OK);
+    size_t free_mem = esp_get_free_heap_size();
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT(httpd_register_static(hd, &static_config) == ESP_OK);
+        TEST_ASSERT(httpd_unregister_uri(hd, "/static/?*") == ESP_OK);
+    }
+    TEST_ASSERT_EQUAL(free_mem, esp_get_free_heap_size());
+
+    TEST_ASSERT(httpd_register_static(hd, &static_config) == ESP_OK);
+    /* The configuration is copied, so it doesn't need to outlive the call */
+    memset(&static_config, 0, sizeof(static_config));
+
+    char resp[512];
+    test_static_get(config.server_port, "/static/", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "200 OK") && strstr(resp, "Content-Type: text/html"));
+    TEST_ASSERT(strstr(resp, "\r\n\r\n<html>index</html>"));
+
+    test_static_get(config.server_port, "/static/app.js?v=1", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "Content-Type: application/javascript"));
+    TEST_ASSERT(strstr(resp, static_js) && !strstr(resp, "Content-Encoding"));
+
+    /* Pre-compressed variant */
+    test_static_get(config.server_port, "/static/app.js", "Accept-Encoding: gzip, deflate\r\n", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "Content-Encoding: gzip") && strstr(resp, "ETag: \"js-gz\""));
+    TEST_ASSERT(strstr(resp, static_js_gz));
+
+    /* Conditional request */
+    test_static_get(config.server_port, "/static/app.js", "Accept-Encoding: gzip\r\nIf-None-Match: \"js-gz\"\r\n", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "304 Not Modified") && strstr(resp, "ETag: \"js-gz\""));
+    TEST_ASSERT(!strstr(resp, "Content-Length") && !strstr(resp, "Content-Type") && !strstr(resp, "Content-Encoding"));
+
+    /* Ranges */
+    test_static_get(config.server_port, "/static/app.js", "Range: bytes=13-22\r\n", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "206 Partial Content") && strstr(resp, "Content-Range: bytes 13-22/26"));
+    TEST_ASSERT(strstr(resp, "\r\n\r\n0123456789"));
+    test_static_get(config.server_port, "/static/app.js", "Range: bytes=-3\r\n", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "Content-Range: bytes 23-25/26") && strstr(resp, "\r\n\r\n');"));
+    test_static_get(config.server_port, "/static/app.js", "Range: bytes=26-\r\n", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "416 Range Not Satisfiable") && strstr(resp, "Content-Range: bytes */26"));
+
+    test_static_get(config.server_port, "/static/missing.js", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "404 Not Found"));
+    test_static_get(config.server_port, "/static/../static/app.js", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "404 Not Found"));
+    test_static_get(config.server_port, "/static/app..min.js", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "200 OK") && strstr(resp, static_js));
+
+    /* The path is decoded before it is looked up and checked */
+    test_static_get(config.server_port, "/static/app%2Ejs", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "200 OK") && strstr(resp, static_js));
+    test_static_get(config.server_port, "/static/%2e%2e/static/app.js", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "404 Not Found"));
+    test_static_get(config.server_port, "/static/app.js%00.html", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "404 Not Found"));
+
+    TEST_ASSERT(httpd_unregister_uri(hd, "/static/?*") == ESP_OK);
+    test_static_get(config.server_port, "/static/app.js", "", resp, sizeof(resp));
+    TEST_ASSERT(strstr(resp, "404 Not Found"));
+
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
+static esp_err_t name_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, req->user_ctx);
+}
+
+static void test_router_expect(uint16_t port, const char *method, const char *uri, const char *expected)
+{
+    char resp[512];
+    int sock = test_connect(port);
+    struct timeval tv = { .tv_sec = 2 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    test_request(sock, method, uri, "", resp, sizeof(resp));
+    close(sock);
+    if (strncmp(expected, "HTTP/1.1 ", strlen("HTTP/1.1 ")) == 0) {
+        TEST_ASSERT(strncmp(resp, expected, strlen(expected)) == 0);
+    } else {
+        TEST_ASSERT(strncmp(resp, "HTTP/1.1 200 OK\r\n", strlen("HTTP/1.1 200 OK\r\n")) == 0);
+        char *body = strstr(resp, "\r\n\r\n");
+        TEST_ASSERT_NOT_NULL(body);
+        TEST_ASSERT_EQUAL_STRING(expected, body + 4);
+    }
+}
+
+TEST_CASE("URI Router dispatches requests", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    const httpd_uri_t uris[] = {
+        { .uri = "/api/items",  .method = HTTP_GET,  .handler = name_handler, .user_ctx = "items" },
+        { .uri = "/api/*",      .method = HTTP_GET,  .handler = name_handler, .user_ctx = "api" },
+        { .uri = "/api/items",  .method = HTTP_POST, .handler = name_handler, .user_ctx = "post items" },
+        { .uri = "/files/?*",   .method = HTTP_GET,  .handler = name_handler, .user_ctx = "files" },
+        { .uri = "/files/list", .method = HTTP_PUT,  .handler = name_handler, .user_ctx = "put list" },
+    };
+    for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        TEST_ASSERT(httpd_register_uri_handler(hd, &uris[i]) == ESP_OK);
+    }
+    uint16_t port = config.server_port;
+
+    test_router_expect(port, "GET", "/api/items", "items");
+    test_router_expect(port, "POST", "/api/items", "post items");
+    test_router_expect(port, "GET", "/api/items?id=1", "items");
+    test_router_expect(port, "GET", "/api/other", "api");
+    test_router_expect(port, "GET", "/files", "files");
+    test_router_expect(port, "GET", "/files/list", "files");
+    test_router_expect(port, "PUT", "/files/list", "put list");
+    test_router_expect(port, "GET", "/apix", "HTTP/1.1 404 ");
+    test_router_expect(port, "GET", "/", "HTTP/1.1 404 ");
+    test_router_expect(port, "DELETE", "/api/items", "HTTP/1.1 405 ");
+    test_router_expect(port, "POST", "/api/other", "HTTP/1.1 405 ");
+
+    /* A handler covered by an earlier registered one is rejected, and of
+     * two matching handlers the earlier registered one is picked */
+    const httpd_uri_t files_txt = { .uri = "/files/a*", .method = HTTP_GET, .handler = name_handler, .user_ctx = "files a" };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &files_txt) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    const httpd_uri_t put_any = { .uri = "/files/*", .method = HTTP_PUT, .handler = name_handler, .user_ctx = "put any" };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &put_any) == ESP_OK);
+    test_router_expect(port, "PUT", "/files/list", "put list");
+    test_router_expect(port, "PUT", "/files/other", "put any");
+
+    /* The router is rebuilt after handlers are unregistered */
+    TEST_ASSERT(httpd_unregister_uri_handler(hd, "/api/items", HTTP_GET) == ESP_OK);
+    test_router_expect(port, "GET", "/api/items", "api");
+    test_router_expect(port, "POST", "/api/items", "post items");
+    TEST_ASSERT(httpd_unregister_uri_handler(hd, "/files/list", HTTP_PUT) == ESP_OK);
+    test_router_expect(port, "PUT", "/files/list", "put any");
+    TEST_ASSERT(httpd_unregister_uri(hd, "/api/*") == ESP_OK);
+    test_router_expect(port, "GET", "/api/items", "HTTP/1.1 405 ");
+    test_router_expect(port, "GET", "/api/other", "HTTP/1.1 404 ");
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uris[1]) == ESP_OK);
+    test_router_expect(port, "GET", "/api/items", "api");
+
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
+/* Same matching as the wildcard matcher, but not recognized as a built-in
+ * one by the server, so handlers are looked up by trying each of them */
+static bool linear_match_wildcard(const char *uri_template, const char *uri_to_match, size_t match_upto)
+{
+    return httpd_uri_match_wildcard(uri_template, uri_to_match, match_upto);
+}
+
+/* Responds to unknown URIs without closing the connection */
+static esp_err_t keep_open_404(httpd_req_t *req, httpd_err_code_t error)
+{
+    return httpd_resp_send_err(req, error, NULL);
+}
+
+#define ROUTER_PERF_HANDLERS    200
+#define ROUTER_PERF_REQUESTS    100
+
+static int64_t test_router_dispatch_time(httpd_uri_match_func_t match_fn, const char *uri, const char *expected)
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = ROUTER_PERF_HANDLERS;
+    config.uri_match_fn = match_fn;
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    TEST_ASSERT(httpd_register_err_handler(hd, HTTPD_404_NOT_FOUND, keep_open_404) == ESP_OK);
+
+    char (*paths)[24] = malloc(ROUTER_PERF_HANDLERS * sizeof(*paths));
+    TEST_ASSERT_NOT_NULL(paths);
+    for (int i = 0; i < ROUTER_PERF_HANDLERS; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/api/v1/res%d/?*", i);
+        httpd_uri_t uri_handler = {
+            .uri      = paths[i],
+            .method   = HTTP_GET,
+            .handler  = name_handler,
+            .user_ctx = "res",
+        };
+        TEST_ASSERT(httpd_register_uri_handler(hd, &uri_handler) == ESP_OK);
+    }
+
+    /* Requests are sent on a single connection, so that the time is
+     * spent on parsing and dispatching rather than on connecting */
+    int sock = test_connect(config.server_port);
+    struct timeval tv = { .tv_sec = 2 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char resp[512];
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < ROUTER_PERF_REQUESTS; i++) {
+        test_request(sock, "GET", uri, "", resp, sizeof(resp));
+        TEST_ASSERT_NOT_NULL(strstr(resp, expected));
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    close(sock);
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+    free(paths);
+    return elapsed / ROUTER_PERF_REQUESTS;
+}
+
+TEST_CASE("URI Router dispatch performance", "[HTTP SERVER][timeout=60]")
+{
+    test_case_uses_tcpip();
+
+    /* The last registered handler is the worst case of the linear lookup */
+    char uri[32];
+    snprintf(uri, sizeof(uri), "/api/v1/res%d/item", ROUTER_PERF_HANDLERS - 1);
+    int64_t router_us = test_router_dispatch_time(httpd_uri_match_wildcard, uri, "\r\n\r\nres");
+    int64_t linear_us = test_router_dispatch_time(linear_match_wildcard, uri, "\r\n\r\nres");
+    IDF_LOG_PERFORMANCE("httpd_router_request_us", "%lld, linear lookup: %lld (%d handlers)",
+                        router_us, linear_us, ROUTER_PERF_HANDLERS);
+
+    /* Unknown URIs are compared against all the handlers by the linear lookup */
+    router_us = test_router_dispatch_time(httpd_uri_match_wildcard, "/api/v2/res1", "404 Not Found");
+    linear_us = test_router_dispatch_time(linear_match_wildcard, "/api/v2/res1", "404 Not Found");
+    IDF_LOG_PERFORMANCE("httpd_router_404_us", "%lld, linear lookup: %lld (%d handlers)",
+                        router_us, linear_us, ROUTER_PERF_HANDLERS);
+}
@@ -63,7 +63,9 @@ typedef struct xSTATIC_RINGBUFFER {
     size_t xDummy1[2];
     UBaseType_t uxDummy2;
     BaseType_t xDummy3;
-    void *pvDummy4[11];
+    void *pvDummy4[13];
+    size_t xDummy6[4];
+    UBaseType_t uxDummy7[2];
     StaticSemaphore_t xDummy5[2];
     portMUX_TYPE muxDummy;
     /** @endcond */
@@ -185,7 +187,8 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
  * @param[in]   xItemSize       Size of item to acquire.
  * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
  *
- * @note Only applicable for no-split ring buffers now, the actual size of
+ * @note Only applicable for no-split ring buffers, use ``xRingbufferSendAcquireSplit``
+ *       for allow-split and byte buffers. The actual size of
  *       memory that the item will occupy will be rounded up to the nearest 32-bit
  *       aligned size. This is done to ensure all items are always stored in 32-bit
  *       aligned fashion.
@@ -196,15 +199,55 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer,
  */
 BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
 
+/**
+ * @brief Acquire memory from the ring buffer to be written to by an external
+ *        source and to be sent later, allowing the memory to wrap around.
+ *
+ * Same as ``xRingbufferSendAcquire`` but applicable to all types of ring buffers.
+ * In allow-split and byte buffers, the acquired memory may wrap around the end
+ * of the buffer, in which case it is returned as two parts: the head part at the
+ * end of the buffer and the tail part at its start. The item is written in place
+ * in both parts, then sent by calling ``xRingbufferSendComplete`` with the head part.
+ *
+ * Several items can be acquired at the same time, e.g. by different tasks, and be
+ * sent in any order. Items are still received in the order they were acquired: an
+ * item, as well as the items sent with ``xRingbufferSend`` after it, can only be
+ * read once the items acquired before it were sent.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to allocate the memory
+ * @param[out]  ppvHeadItem     Double pointer to the first part of the memory acquired (set to NULL if no memory were retrieved)
+ * @param[out]  ppvTailItem     Double pointer to the second part of the memory acquired (set to NULL if the memory does not wrap around)
+ * @param[out]  pxHeadItemSize  Pointer to size of the first part
+ * @param[out]  pxTailItemSize  Pointer to size of the second part (set to 0 if the memory does not wrap around)
+ * @param[in]   xItemSize       Size of item to acquire.
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note At most 4 items can be acquired and not yet sent at the same time in a
+ *       byte buffer. Acquiring 0 bytes in a byte buffer has no effect, and the
+ *       NULL item returned must not be sent.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE on time-out or when the data is larger than the maximum permissible size of the buffer
+ */
+BaseType_t xRingbufferSendAcquireSplit(RingbufHandle_t xRingbuffer,
+                                       void **ppvHeadItem,
+                                       void **ppvTailItem,
+                                       size_t *pxHeadItemSize,
+                                       size_t *pxTailItemSize,
+                                       size_t xItemSize,
+                                       TickType_t xTicksToWait);
+
 /**
  * @brief       Actually send an item into the ring buffer allocated before by
- *              ``xRingbufferSendAcquire``.
+ *              ``xRingbufferSendAcquire`` or ``xRingbufferSendAcquireSplit``.
  *
  * @param[in]   xRingbuffer     Ring buffer to insert the item into
- * @param[in]   pvItem          Pointer to item in allocated memory to insert.
+ * @param[in]   pvItem          Pointer to item in allocated memory to insert
+ *                              (the head part if acquired by ``xRingbufferSendAcquireSplit``).
  *
- * @note Only applicable for no-split ring buffers. Only call for items
- *       allocated by ``xRingbufferSendAcquire``.
+ * @note Only call for items allocated by ``xRingbufferSendAcquire`` or
+ *       ``xRingbufferSendAcquireSplit``, once each.
  *
  * @return
  *      - pdTRUE if succeeded
@@ -44,9 +44,15 @@ typedef struct {
 } ItemHeader_t;
 
 #define rbHEADER_SIZE     sizeof(ItemHeader_t)
+
+//Maximum number of acquired items that have not been sent yet in a byte buffer
+#define rbBYTE_BUF_MAX_ACQUIRED     4
+
 typedef struct RingbufferDefinition Ringbuffer_t;
 typedef BaseType_t (*CheckItemFitsFunction_t)(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 typedef void (*CopyItemFunction_t)(Ringbuffer_t *pxRingbuffer, const uint8_t *pcItem, size_t xItemSize);
+typedef uint8_t *(*AcquireItemFunction_t)(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize);
+typedef void (*SendItemDoneFunction_t)(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
 typedef BaseType_t (*CheckItemAvailFunction_t) (Ringbuffer_t *pxRingbuffer);
 typedef void *(*GetItemFunction_t)(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xMaxSize, size_t *pxItemSize);
 typedef void (*ReturnItemFunction_t)(Ringbuffer_t *pxRingbuffer, uint8_t *pvItem);
@@ -59,6 +65,8 @@ typedef struct RingbufferDefinition {
 
     CheckItemFitsFunction_t xCheckItemFits;     //Function to check if item can currently fit in ring buffer
     CopyItemFunction_t vCopyItem;               //Function to copy item to ring buffer
+    AcquireItemFunction_t pvAcquireItem;        //Function to acquire memory for an item in the ring buffer
+    SendItemDoneFunction_t vSendItemDone;       //Function to send an acquired item
     GetItemFunction_t pvGetItem;                //Function to get item from ring buffer
     ReturnItemFunction_t vReturnItem;           //Function to return item to ring buffer
     GetCurMaxSizeFunction_t xGetCurMaxSize;     //Function to get current free size
@@ -71,6 +79,14 @@ typedef struct RingbufferDefinition {
     uint8_t *pucTail;                           //Pointer to the end of the ring buffer storage area
 
     BaseType_t xItemsWaiting;                   //Number of items/bytes(for byte buffers) currently in ring buffer that have not yet been read
+    /*
+     * Byte buffers have no item headers to mark acquired items as sent, so the
+     * sizes of the pieces of data between pucWrite and pucAcquire are kept here,
+     * oldest first. Bit n of uxAcquiredSentMask is set if piece n was sent.
+     */
+    size_t xAcquiredSize[rbBYTE_BUF_MAX_ACQUIRED];
+    UBaseType_t uxAcquiredNum;
+    UBaseType_t uxAcquiredSentMask;
     /*
      * TransSem: Binary semaphore used to indicate to a blocked transmitting tasks
      *           that more free space has become available or that the block has
@@ -135,13 +151,40 @@ static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xI
 //Checks if an item will currently fit in a byte buffer
 static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 
+/*
+Acquires memory for an item in a no-split/allow-split/byte buffer
+Entry:
+    - Must have already guaranteed there is sufficient space for item by calling xCheckItemFits(),
+      and for byte buffers, that fewer than rbBYTE_BUF_MAX_ACQUIRED items are acquired
+Exit:
+    - Pointer to the item (or to its first part if split) is returned. *pxHeadSize is set to the size of this part.
+    - *ppucTail is set to the second part of the item if split, NULL otherwise
+    - pucAcquire updated
+    - Item can't be read until it is sent with vSendItemDone()
+*/
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize);
+static uint8_t *prvAcquireItemAllowSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize);
+static uint8_t *prvAcquireItemByteBuf(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize);
+
+/*
+Sends an acquired item in a no-split/allow-split buffer
+Exit:
+    - Item (both parts if split) is marked with rbITEM_WRITTEN_FLAG
+    - pucWrite is progressed as far as possible, skipping over written items or dummy items
+    - xItemsWaiting is incremented for each item pucWrite moves past
+*/
+static void prvSendItemDoneDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Sends acquired data in a byte buffer. pucWrite is progressed up to the oldest data acquired and not sent yet
+static void prvSendItemDoneByteBuf(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
 /*
 Copies an item to a no-split ring buffer
 Entry:
     - Must have already guaranteed there is sufficient space for item by calling prvCheckItemFitsDefault()
 Exit:
     - New item copied into ring buffer
-    - pucAcquire and pucWrite updated.
+    - pucAcquire updated. pucWrite updated if no acquired item is waiting to be sent before it.
     - Dummy item added if necessary
 */
 static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
@@ -152,7 +195,7 @@ Entry:
     - Must have already guaranteed there is sufficient space for item by calling prvCheckItemFitsDefault()
 Exit:
     - New item copied into ring buffer
-    - pucAcquire and pucWrite updated
+    - pucAcquire updated. pucWrite updated if no acquired item is waiting to be sent before it.
     - Item may be split
 */
 static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
@@ -239,12 +282,16 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
     pxNewRingbuffer->pucWrite = pucRingbufferStorage;
     pxNewRingbuffer->pucAcquire = pucRingbufferStorage;
     pxNewRingbuffer->xItemsWaiting = 0;
+    pxNewRingbuffer->uxAcquiredNum = 0;
+    pxNewRingbuffer->uxAcquiredSentMask = 0;
     pxNewRingbuffer->uxRingbufferFlags = 0;
 
     //Initialize type dependent values and function pointers
     if (xBufferType == RINGBUF_TYPE_NOSPLIT) {
         pxNewRingbuffer->xCheckItemFits = prvCheckItemFitsDefault;
         pxNewRingbuffer->vCopyItem = prvCopyItemNoSplit;
+        pxNewRingbuffer->pvAcquireItem = prvAcquireItemNoSplit;
+        pxNewRingbuffer->vSendItemDone = prvSendItemDoneDefault;
         pxNewRingbuffer->pvGetItem = prvGetItemDefault;
         pxNewRingbuffer->vReturnItem = prvReturnItemDefault;
         /*
@@ -257,6 +304,8 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
         pxNewRingbuffer->uxRingbufferFlags |= rbALLOW_SPLIT_FLAG;
         pxNewRingbuffer->xCheckItemFits = prvCheckItemFitsDefault;
         pxNewRingbuffer->vCopyItem = prvCopyItemAllowSplit;
+        pxNewRingbuffer->pvAcquireItem = prvAcquireItemAllowSplit;
+        pxNewRingbuffer->vSendItemDone = prvSendItemDoneDefault;
         pxNewRingbuffer->pvGetItem = prvGetItemDefault;
         pxNewRingbuffer->vReturnItem = prvReturnItemDefault;
         //Worst case an item is split into two, incurring two headers of overhead
@@ -266,6 +315,8 @@ static void prvInitializeNewRingbuffer(size_t xBufferSize,
         pxNewRingbuffer->uxRingbufferFlags |= rbBYTE_BUFFER_FLAG;
         pxNewRingbuffer->xCheckItemFits = prvCheckItemFitsByteBuffer;
         pxNewRingbuffer->vCopyItem = prvCopyItemByteBuf;
+        pxNewRingbuffer->pvAcquireItem = prvAcquireItemByteBuf;
+        pxNewRingbuffer->vSendItemDone = prvSendItemDoneByteBuf;
         pxNewRingbuffer->pvGetItem = prvGetItemByteBuf;
         pxNewRingbuffer->vReturnItem = prvReturnItemByteBuf;
         //Byte buffers do not incur any overhead
@@ -326,6 +377,11 @@ static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t
     //Check arguments and buffer state
     configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
 
+    if (pxRingbuffer->uxAcquiredNum == rbBYTE_BUF_MAX_ACQUIRED &&
+            (pxRingbuffer->uxAcquiredSentMask & (1 << (rbBYTE_BUF_MAX_ACQUIRED - 1))) == 0) {
+        //Copied data must wait for the acquired items before it to be sent, but there is no room left to record it
+        return pdFALSE;
+    }
     if (pxRingbuffer->pucAcquire == pxRingbuffer->pucFree) {
         //Buffer is either complete empty or completely full
         return (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) ? pdFALSE : pdTRUE;
@@ -338,7 +394,7 @@ static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t
     return (xItemSize <= pxRingbuffer->xSize - (pxRingbuffer->pucAcquire - pxRingbuffer->pucFree)) ? pdTRUE : pdFALSE;
 }
 
-static uint8_t* prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize)
 {
     //Check arguments and buffer state
     size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
@@ -374,10 +430,103 @@ static uint8_t* prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSi
         //Mark the buffer as full to distinguish with an empty buffer
         pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;
     }
+    //Items of no-split buffers are never split
+    *ppucTail = NULL;
+    *pxHeadSize = xItemSize;
     return item_address;
 }
 
-static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t* pucItem)
+static uint8_t *prvAcquireItemAllowSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize)
+{
+    //Check arguments and buffer state
+    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
+    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
+    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucAcquire));              //pucAcquire is always aligned in split ring buffers
+    configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
+    configASSERT(xRemLen >= rbHEADER_SIZE);                             //Remaining length must be able to at least fit an item header
+
+    uint8_t *pucHeadItem = NULL;
+    *ppucTail = NULL;
+    *pxHeadSize = xItemSize;
+    //Split item if necessary
+    if (xRemLen < xAlignedItemSize + rbHEADER_SIZE) {
+        //Set header of the first part of the item
+        ItemHeader_t *pxFirstHeader = (ItemHeader_t *)pxRingbuffer->pucAcquire;
+        pxFirstHeader->xItemLen = xRemLen - rbHEADER_SIZE;  //Fill remaining length with first part
+        xRemLen -= rbHEADER_SIZE;
+        if (xRemLen > 0) {
+            pxFirstHeader->uxItemFlags = rbITEM_SPLIT_FLAG;         //There must be more data
+            pucHeadItem = pxRingbuffer->pucAcquire + rbHEADER_SIZE;
+            *pxHeadSize = xRemLen;
+            //Update item arguments to account for the first part
+            xItemSize -= xRemLen;
+            xAlignedItemSize -= xRemLen;
+        } else {
+            //Remaining length was only large enough to fit header
+            pxFirstHeader->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;    //Item will completely be stored in 2nd part
+        }
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;             //Reset acquire pointer to start of buffer
+    }
+
+    //Item (whole or second part) should be guaranteed to fit at this point
+    ItemHeader_t *pxSecondHeader = (ItemHeader_t *)pxRingbuffer->pucAcquire;
+    pxSecondHeader->xItemLen = xItemSize;
+    pxSecondHeader->uxItemFlags = 0;
+    if (pucHeadItem == NULL) {
+        pucHeadItem = pxRingbuffer->pucAcquire + rbHEADER_SIZE;
+    } else {
+        *ppucTail = pxRingbuffer->pucAcquire + rbHEADER_SIZE;
+    }
+    pxRingbuffer->pucAcquire += rbHEADER_SIZE + xAlignedItemSize;    //Advance pucAcquire past header and the item to next aligned address
+
+    //If current remaining length can't fit a header, wrap around acquire pointer
+    if (pxRingbuffer->pucTail - pxRingbuffer->pucAcquire < rbHEADER_SIZE) {
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;   //Wrap around pucAcquire
+    }
+    //Check if buffer is full
+    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucFree) {
+        //Mark the buffer as full to distinguish with an empty buffer
+        pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;
+    }
+    return pucHeadItem;
+}
+
+static uint8_t *prvAcquireItemByteBuf(Ringbuffer_t *pxRingbuffer, size_t xItemSize, uint8_t **ppucTail, size_t *pxHeadSize)
+{
+    //Check arguments and buffer state
+    configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
+    configASSERT(pxRingbuffer->uxAcquiredNum < rbBYTE_BUF_MAX_ACQUIRED);
+
+    uint8_t *pucHeadItem = pxRingbuffer->pucAcquire;
+    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
+    if (xRemLen < xItemSize) {
+        //Data wraps around, second part starts at the head of the buffer
+        *pxHeadSize = xRemLen;
+        *ppucTail = pxRingbuffer->pucHead;
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead + (xItemSize - xRemLen);
+    } else {
+        *pxHeadSize = xItemSize;
+        *ppucTail = NULL;
+        pxRingbuffer->pucAcquire += xItemSize;
+    }
+
+    //Wrap around pucAcquire if it reaches the end
+    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucTail) {
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;
+    }
+    //Check if buffer is full
+    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucFree) {
+        pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;      //Mark the buffer as full to avoid confusion with an empty buffer
+    }
+
+    //Record the acquired data as not sent yet
+    pxRingbuffer->xAcquiredSize[pxRingbuffer->uxAcquiredNum] = xItemSize;
+    pxRingbuffer->uxAcquiredSentMask &= ~(1 << pxRingbuffer->uxAcquiredNum);
+    pxRingbuffer->uxAcquiredNum++;
+    return pucHeadItem;
+}
+
+static void prvSendItemDoneDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
 {
     //Check arguments and buffer state
     configASSERT(rbCHECK_ALIGNED(pucItem));
@@ -389,28 +538,38 @@ static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t* pucItem)
     configASSERT(pxCurHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
     configASSERT((pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) == 0); //Dummy items should never have been written
     configASSERT((pxCurHeader->uxItemFlags & rbITEM_WRITTEN_FLAG) == 0);       //Indicates item has already been written before
-    pxCurHeader->uxItemFlags &= ~rbITEM_SPLIT_FLAG;                         //Clear wrap flag if set (not strictly necessary)
     pxCurHeader->uxItemFlags |= rbITEM_WRITTEN_FLAG;                           //Mark as written
-
-    pxRingbuffer->xItemsWaiting++;
+    if (pxCurHeader->uxItemFlags & rbITEM_SPLIT_FLAG) {
+        //Second part of a split item is always at the start of the buffer
+        ItemHeader_t *pxSecondHeader = (ItemHeader_t *)pxRingbuffer->pucHead;
+        configASSERT((pxSecondHeader->uxItemFlags & rbITEM_WRITTEN_FLAG) == 0);
+        pxSecondHeader->uxItemFlags |= rbITEM_WRITTEN_FLAG;
+    }
 
     /*
      * Items might not be written in the order they were acquired. Move the
      * write pointer up to the next item that has not been marked as written (by
      * written flag) or up till the acquire pointer. When advancing the write
      * pointer, items that have already been written or items with dummy data
-     * should be skipped over
+     * should be skipped over. Items are only counted as waiting once the write
+     * pointer has moved past them, so that they are read in the order they were
+     * acquired. The write pointer is equal to the acquire pointer on entry if
+     * the acquired items fill the buffer, hence the first item is always checked.
      */
     pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucWrite;
+    BaseType_t xFirstItem = pdTRUE;
     //Skip over Items that have already been written or are dummy items
-    while (((pxCurHeader->uxItemFlags & rbITEM_WRITTEN_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) && pxRingbuffer->pucWrite != pxRingbuffer->pucAcquire) {
+    while ((pxCurHeader->uxItemFlags & (rbITEM_WRITTEN_FLAG | rbITEM_DUMMY_DATA_FLAG)) &&
+            (xFirstItem == pdTRUE || pxRingbuffer->pucWrite != pxRingbuffer->pucAcquire)) {
+        xFirstItem = pdFALSE;
         if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
-            pxCurHeader->uxItemFlags |= rbITEM_WRITTEN_FLAG;   //Mark as freed (not strictly necessary but adds redundancy)
+            pxCurHeader->uxItemFlags |= rbITEM_WRITTEN_FLAG;   //Mark as written (not strictly necessary but adds redundancy)
             pxRingbuffer->pucWrite = pxRingbuffer->pucHead;    //Wrap around due to dummy data
         } else {
             //Item with data that has already been written, advance write pointer past this item
             size_t xAlignedItemSize = rbALIGN_SIZE(pxCurHeader->xItemLen);
             pxRingbuffer->pucWrite += xAlignedItemSize + rbHEADER_SIZE;
+            pxRingbuffer->xItemsWaiting++;
             //Redundancy check to ensure write pointer has not overshot buffer bounds
             configASSERT(pxRingbuffer->pucWrite <= pxRingbuffer->pucHead + pxRingbuffer->xSize);
         }
@@ -422,66 +581,59 @@ static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t* pucItem)
     }
 }
 
-static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static void prvSendItemDoneByteBuf(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
 {
-    uint8_t* item_addr = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
-    memcpy(item_addr, pucItem, xItemSize);
-    prvSendItemDoneNoSplit(pxRingbuffer, item_addr);
-}
-
-static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
-{
-    //Check arguments and buffer state
-    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
-    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
-    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucAcquire));              //pucAcquire is always aligned in split ring buffers
-    configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check write pointer is within bounds
-    configASSERT(xRemLen >= rbHEADER_SIZE);                             //Remaining length must be able to at least fit an item header
+    //Check pointer points to address inside buffer
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem < pxRingbuffer->pucTail);
 
-    //Split item if necessary
-    if (xRemLen < xAlignedItemSize + rbHEADER_SIZE) {
-        //Write first part of the item
-        ItemHeader_t *pxFirstHeader = (ItemHeader_t *)pxRingbuffer->pucAcquire;
-        pxFirstHeader->uxItemFlags = 0;
-        pxFirstHeader->xItemLen = xRemLen - rbHEADER_SIZE;  //Fill remaining length with first part
-        pxRingbuffer->pucAcquire += rbHEADER_SIZE;            //Advance pucAcquire past header
-        xRemLen -= rbHEADER_SIZE;
-        if (xRemLen > 0) {
-            memcpy(pxRingbuffer->pucAcquire, pucItem, xRemLen);
-            pxRingbuffer->xItemsWaiting++;
-            //Update item arguments to account for data already copied
-            pucItem += xRemLen;
-            xItemSize -= xRemLen;
-            xAlignedItemSize -= xRemLen;
-            pxFirstHeader->uxItemFlags |= rbITEM_SPLIT_FLAG;        //There must be more data
-        } else {
-            //Remaining length was only large enough to fit header
-            pxFirstHeader->uxItemFlags |= rbITEM_DUMMY_DATA_FLAG;   //Item will completely be stored in 2nd part
+    //Acquired data is contiguous from the write pointer, find the data starting at pucItem
+    uint8_t *pucStart = pxRingbuffer->pucWrite;
+    UBaseType_t uxIndex;
+    for (uxIndex = 0; uxIndex < pxRingbuffer->uxAcquiredNum; uxIndex++) {
+        if (pucStart == pucItem && (pxRingbuffer->uxAcquiredSentMask & (1 << uxIndex)) == 0) {
+            break;
+        }
+        pucStart += pxRingbuffer->xAcquiredSize[uxIndex];
+        if (pucStart >= pxRingbuffer->pucTail) {
+            pucStart -= pxRingbuffer->xSize;
         }
-        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;             //Reset acquire pointer to start of buffer
     }
+    configASSERT(uxIndex < pxRingbuffer->uxAcquiredNum);   //Data must have been acquired and not sent before
+    pxRingbuffer->uxAcquiredSentMask |= (1 << uxIndex);
 
-    //Item (whole or second part) should be guaranteed to fit at this point
-    ItemHeader_t *pxSecondHeader = (ItemHeader_t *)pxRingbuffer->pucAcquire;
-    pxSecondHeader->xItemLen = xItemSize;
-    pxSecondHeader->uxItemFlags = 0;
-    pxRingbuffer->pucAcquire += rbHEADER_SIZE;     //Advance acquire pointer past header
-    memcpy(pxRingbuffer->pucAcquire, pucItem, xItemSize);
-    pxRingbuffer->xItemsWaiting++;
-    pxRingbuffer->pucAcquire += xAlignedItemSize;  //Advance pucAcquire past item to next aligned address
-
-    //If current remaining length can't fit a header, wrap around write pointer
-    if (pxRingbuffer->pucTail - pxRingbuffer->pucAcquire < rbHEADER_SIZE) {
-        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;   //Wrap around pucAcquire
-    }
-    //Check if buffer is full
-    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucFree) {
-        //Mark the buffer as full to distinguish with an empty buffer
-        pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;
+    //Move the write pointer past the sent data, up to the oldest data not sent yet
+    while (pxRingbuffer->uxAcquiredNum > 0 && (pxRingbuffer->uxAcquiredSentMask & 1)) {
+        pxRingbuffer->pucWrite += pxRingbuffer->xAcquiredSize[0];
+        if (pxRingbuffer->pucWrite >= pxRingbuffer->pucTail) {
+            pxRingbuffer->pucWrite -= pxRingbuffer->xSize;
+        }
+        pxRingbuffer->xItemsWaiting += pxRingbuffer->xAcquiredSize[0];
+        pxRingbuffer->uxAcquiredNum--;
+        memmove(&pxRingbuffer->xAcquiredSize[0], &pxRingbuffer->xAcquiredSize[1], pxRingbuffer->uxAcquiredNum * sizeof(size_t));
+        pxRingbuffer->uxAcquiredSentMask >>= 1;
     }
+}
+
+static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    uint8_t *pucTail;
+    size_t xHeadSize;
+    uint8_t *item_addr = prvAcquireItemNoSplit(pxRingbuffer, xItemSize, &pucTail, &xHeadSize);
+    memcpy(item_addr, pucItem, xItemSize);
+    prvSendItemDoneDefault(pxRingbuffer, item_addr);
+}
 
-    //currently the Split mode is not supported, pucWrite tracks the pucAcquire
-    pxRingbuffer->pucWrite = pxRingbuffer->pucAcquire;
+static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    uint8_t *pucTail;
+    size_t xHeadSize;
+    uint8_t *item_addr = prvAcquireItemAllowSplit(pxRingbuffer, xItemSize, &pucTail, &xHeadSize);
+    memcpy(item_addr, pucItem, xHeadSize);
+    if (pucTail != NULL) {
+        memcpy(pucTail, pucItem + xHeadSize, xItemSize - xHeadSize);
+    }
+    prvSendItemDoneDefault(pxRingbuffer, item_addr);
 }
 
 static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
@@ -489,11 +641,11 @@ static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
     //Check arguments and buffer state
     configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
 
+    size_t xCopySize = xItemSize;
     size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;    //Length from pucAcquire until end of buffer
     if (xRemLen < xItemSize) {
         //Copy as much as possible into remaining length
         memcpy(pxRingbuffer->pucAcquire, pucItem, xRemLen);
-        pxRingbuffer->xItemsWaiting += xRemLen;
         //Update item arguments to account for data already written
         pucItem += xRemLen;
         xItemSize -= xRemLen;
@@ -501,7 +653,6 @@ static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
     }
     //Copy all or remaining portion of the item
     memcpy(pxRingbuffer->pucAcquire, pucItem, xItemSize);
-    pxRingbuffer->xItemsWaiting += xItemSize;
     pxRingbuffer->pucAcquire += xItemSize;
 
     //Wrap around pucAcquire if it reaches the end
@@ -513,8 +664,21 @@ static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
         pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;      //Mark the buffer as full to avoid confusion with an empty buffer
     }
 
-    //Currently, acquiring memory is not supported in byte mode. pucWrite tracks the pucAcquire.
-    pxRingbuffer->pucWrite = pxRingbuffer->pucAcquire;
+    UBaseType_t uxLast = pxRingbuffer->uxAcquiredNum - 1;
+    if (pxRingbuffer->uxAcquiredNum == 0) {
+        //No acquired data waiting to be sent, the copied data can be read right away
+        pxRingbuffer->xItemsWaiting += xCopySize;
+        pxRingbuffer->pucWrite = pxRingbuffer->pucAcquire;
+    } else if (pxRingbuffer->uxAcquiredSentMask & (1 << uxLast)) {
+        //Last recorded data is already sent, both become readable once the data acquired before them is sent
+        pxRingbuffer->xAcquiredSize[uxLast] += xCopySize;
+    } else {
+        //Record the copied data as sent, it becomes readable once the data acquired before it is sent
+        configASSERT(pxRingbuffer->uxAcquiredNum < rbBYTE_BUF_MAX_ACQUIRED);
+        pxRingbuffer->xAcquiredSize[pxRingbuffer->uxAcquiredNum] = xCopySize;
+        pxRingbuffer->uxAcquiredSentMask |= (1 << pxRingbuffer->uxAcquiredNum);
+        pxRingbuffer->uxAcquiredNum++;
+    }
 }
 
 static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer)
@@ -581,7 +745,8 @@ static void *prvGetItemByteBuf(Ringbuffer_t *pxRingbuffer,
     configASSERT(pxRingbuffer->pucRead == pxRingbuffer->pucFree);
 
     uint8_t *ret = pxRingbuffer->pucRead;
-    if ((pxRingbuffer->pucRead > pxRingbuffer->pucWrite) || (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG)) {     //Available data wraps around
+    //Read and write pointers are only equal with data available if the sent data fills the whole buffer
+    if (pxRingbuffer->pucRead >= pxRingbuffer->pucWrite) {     //Available data wraps around
         //Return contiguous piece from read pointer until buffer tail, or xMaxSize
         if (xMaxSize == 0 || pxRingbuffer->pucTail - pxRingbuffer->pucRead <= xMaxSize) {
             //All contiguous data from read pointer to tail
@@ -947,11 +1112,33 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
     //Check arguments
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
-    configASSERT(ppvItem != NULL || xItemSize == 0);
-    //currently only supported in NoSplit buffers
+    //Items may be split in allow-split and byte buffers, use xRingbufferSendAcquireSplit() instead
     configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);
 
-    *ppvItem = NULL;
+    void *pvTailItem;
+    size_t xHeadItemSize;
+    size_t xTailItemSize;
+    return xRingbufferSendAcquireSplit(xRingbuffer, ppvItem, &pvTailItem, &xHeadItemSize, &xTailItemSize, xItemSize, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendAcquireSplit(RingbufHandle_t xRingbuffer,
+                                       void **ppvHeadItem,
+                                       void **ppvTailItem,
+                                       size_t *pxHeadItemSize,
+                                       size_t *pxTailItemSize,
+                                       size_t xItemSize,
+                                       TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvHeadItem != NULL && ppvTailItem != NULL);
+    configASSERT(pxHeadItemSize != NULL && pxTailItemSize != NULL);
+
+    *ppvHeadItem = NULL;
+    *ppvTailItem = NULL;
+    *pxHeadItemSize = 0;
+    *pxTailItemSize = 0;
     if (xItemSize > pxRingbuffer->xMaxItemSize) {
         return pdFALSE;     //Data will never ever fit in the queue.
     }
@@ -971,11 +1158,15 @@ BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, s
             break;
         }
 
-        //Semaphore obtained, check if item can fit
+        //Semaphore obtained, check if item can fit. Byte buffers can only track a limited number of acquired items
         portENTER_CRITICAL(&pxRingbuffer->mux);
-        if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
-            //Item will fit, copy item
-            *ppvItem = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+        if (((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) == 0 || pxRingbuffer->uxAcquiredNum < rbBYTE_BUF_MAX_ACQUIRED) &&
+                pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
+            //Item will fit, acquire memory for the item
+            uint8_t *pucTailItem;
+            *ppvHeadItem = pxRingbuffer->pvAcquireItem(pxRingbuffer, xItemSize, &pucTailItem, pxHeadItemSize);
+            *ppvTailItem = pucTailItem;
+            *pxTailItemSize = xItemSize - *pxHeadItemSize;
             xReturn = pdTRUE;
             //Check if the free semaphore should be returned to allow other tasks to send
             if (prvGetFreeSize(pxRingbuffer) > 0) {
@@ -1007,12 +1198,15 @@ BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
-    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);
 
     portENTER_CRITICAL(&pxRingbuffer->mux);
-    prvSendItemDoneNoSplit(pxRingbuffer, pvItem);
+    pxRingbuffer->vSendItemDone(pxRingbuffer, pvItem);
     portEXIT_CRITICAL(&pxRingbuffer->mux);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        //A slot for acquired items was freed, allow blocked senders to check again
+        xSemaphoreGive(rbGET_TX_SEM_HANDLE(pxRingbuffer));
+    }
     xSemaphoreGive(rbGET_RX_SEM_HANDLE(pxRingbuffer));
     return pdTRUE;
 }
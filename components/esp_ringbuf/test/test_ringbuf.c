@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -18,6 +19,7 @@
 #include "unity.h"
 #include "test_utils.h"
 #include "esp_rom_sys.h"
+#include "esp_cpu.h"
 
 //Definitions used in multiple test cases
 #define TIMEOUT_TICKS               10
@@ -1019,6 +1021,147 @@ TEST_CASE("Test static ring buffer SMP", "[esp_ringbuf]")
 }
 #endif
 
+/* --------------------- Test ring buffer acquire/complete ------------------- */
+
+#define ACQUIRED_ITEMS              3
+#define THROUGHPUT_TEST_BUFF_LEN    16384
+#define THROUGHPUT_TEST_ITEMS       64
+#define THROUGHPUT_TEST_MAX_SIZE    4096
+
+//Receive all the data available without blocking, copy it into data (if not NULL) and return its size
+static size_t receive_all_and_return(RingbufHandle_t handle, RingbufferType_t buf_type, uint8_t *data)
+{
+    size_t total_size = 0;
+    while (1) {
+        void *item1 = NULL;
+        void *item2 = NULL;
+        size_t item_size1 = 0;
+        size_t item_size2 = 0;
+        if (buf_type == RINGBUF_TYPE_ALLOWSPLIT) {
+            if (xRingbufferReceiveSplit(handle, &item1, &item2, &item_size1, &item_size2, 0) != pdTRUE) {
+                break;
+            }
+        } else {
+            item1 = xRingbufferReceive(handle, &item_size1, 0);
+            if (item1 == NULL) {
+                break;
+            }
+        }
+        if (data != NULL) {
+            memcpy(data + total_size, item1, item_size1);
+            if (item2 != NULL) {
+                memcpy(data + total_size + item_size1, item2, item_size2);
+            }
+        }
+        total_size += item_size1 + item_size2;
+        vRingbufferReturnItem(handle, item1);
+        if (item2 != NULL) {
+            vRingbufferReturnItem(handle, item2);
+        }
+    }
+    return total_size;
+}
+
+//Acquire memory for an item, fill it in place with value and return the pointer to pass to xRingbufferSendComplete()
+static void *acquire_and_fill_item(RingbufHandle_t handle, size_t item_size, uint8_t value)
+{
+    void *head;
+    void *tail;
+    size_t head_size;
+    size_t tail_size;
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendAcquireSplit(handle, &head, &tail, &head_size, &tail_size, item_size, 0));
+    TEST_ASSERT_NOT_NULL(head);
+    TEST_ASSERT_EQUAL(item_size, head_size + tail_size);
+    memset(head, value, head_size);
+    if (tail != NULL) {
+        memset(tail, value, tail_size);
+    }
+    return head;
+}
+
+TEST_CASE("Test ring buffer acquire and complete out of order", "[esp_ringbuf]")
+{
+    const size_t acquired_sizes[ACQUIRED_ITEMS] = {20, 8, 24};
+    uint8_t data[BUFFER_SIZE];
+
+    for (int buf_type = 0; buf_type < NO_OF_RB_TYPES; buf_type++) {
+        RingbufHandle_t handle = xRingbufferCreate(BUFFER_SIZE, buf_type);
+        TEST_ASSERT_MESSAGE(handle != NULL, "Failed to create ring buffer");
+
+        //Repeat so that the acquired items start at every offset, and wrap around the end of the buffer
+        for (int iter = 0; iter < 20; iter++) {
+            void *items[ACQUIRED_ITEMS];
+            size_t total_size = SMALL_ITEM_SIZE;
+            for (int i = 0; i < ACQUIRED_ITEMS; i++) {
+                items[i] = acquire_and_fill_item(handle, acquired_sizes[i], iter * ACQUIRED_ITEMS + i);
+                total_size += acquired_sizes[i];
+            }
+            //Copied item is queued behind the acquired items
+            send_item_and_check(handle, small_item, SMALL_ITEM_SIZE, 0, false);
+            if (buf_type == RINGBUF_TYPE_BYTEBUF) {
+                //Byte buffers only track a limited number of acquired items
+                void *head, *tail;
+                size_t head_size, tail_size;
+                TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendAcquireSplit(handle, &head, &tail, &head_size, &tail_size, 0, 0));
+                TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSendAcquireSplit(handle, &head, &tail, &head_size, &tail_size, 1, 0));
+            }
+
+            //Nothing can be received until the first acquired item is sent
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(handle, items[2]));
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(handle, items[1]));
+            TEST_ASSERT_EQUAL(0, receive_all_and_return(handle, buf_type, data));
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(handle, items[0]));
+
+            //All items are received, in the order they were acquired
+            TEST_ASSERT_EQUAL(total_size, receive_all_and_return(handle, buf_type, data));
+            size_t offset = 0;
+            for (int i = 0; i < ACQUIRED_ITEMS; i++) {
+                for (int j = 0; j < acquired_sizes[i]; j++) {
+                    TEST_ASSERT_MESSAGE(data[offset++] == iter * ACQUIRED_ITEMS + i, "Item data is invalid");
+                }
+            }
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(small_item, data + offset, SMALL_ITEM_SIZE);
+        }
+        vRingbufferDelete(handle);
+    }
+}
+
+TEST_CASE("Test ring buffer acquire and complete throughput", "[esp_ringbuf]")
+{
+    uint8_t *src = malloc(THROUGHPUT_TEST_MAX_SIZE);
+    TEST_ASSERT_NOT_NULL(src);
+
+    for (int buf_type = 0; buf_type < NO_OF_RB_TYPES; buf_type++) {
+        RingbufHandle_t handle = xRingbufferCreate(THROUGHPUT_TEST_BUFF_LEN, buf_type);
+        TEST_ASSERT_MESSAGE(handle != NULL, "Failed to create ring buffer");
+
+        for (size_t item_size = 8; item_size <= THROUGHPUT_TEST_MAX_SIZE; item_size *= 2) {
+            //Data is produced in a separate buffer, then copied into the ring buffer
+            uint32_t start = esp_cpu_get_cycle_count();
+            for (int i = 0; i < THROUGHPUT_TEST_ITEMS; i++) {
+                memset(src, i, item_size);
+                send_item_and_check(handle, src, item_size, 0, false);
+                TEST_ASSERT_EQUAL(item_size, receive_all_and_return(handle, buf_type, NULL));
+            }
+            uint32_t send_cycles = (esp_cpu_get_cycle_count() - start) / THROUGHPUT_TEST_ITEMS;
+
+            //Data is produced in place in the ring buffer
+            start = esp_cpu_get_cycle_count();
+            for (int i = 0; i < THROUGHPUT_TEST_ITEMS; i++) {
+                void *item = acquire_and_fill_item(handle, item_size, i);
+                xRingbufferSendComplete(handle, item);
+                TEST_ASSERT_EQUAL(item_size, receive_all_and_return(handle, buf_type, NULL));
+            }
+            uint32_t acquire_cycles = (esp_cpu_get_cycle_count() - start) / THROUGHPUT_TEST_ITEMS;
+
+            IDF_LOG_PERFORMANCE("ringbuf_send_cycles_per_item", "%d, acquire/complete: %d (type %d, item size %d)",
+                                send_cycles, acquire_cycles, buf_type, item_size);
+        }
+        vRingbufferDelete(handle);
+    }
+    free(src);
+}
+
 /* -------------------------- Test ring buffer IRAM ------------------------- */
 
 static IRAM_ATTR __attribute__((noinline)) bool iram_ringbuf_test(void)
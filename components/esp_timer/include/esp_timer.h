@@ -72,6 +72,8 @@ typedef struct {
     esp_timer_dispatch_t dispatch_method;   //!< Call the callback from task or from ISR
     const char* name;               //!< Timer name, used in esp_timer_dump function
     bool skip_unhandled_events;     //!< Skip unhandled events for periodic timers
+    uint32_t slack_us;              //!< The callback may be delayed by up to this many microseconds,
+                                    //!< so that it can be dispatched together with other timers (0: no delay)
 } esp_timer_create_args_t;
 
 
@@ -198,6 +200,10 @@ int64_t esp_timer_get_time(void);
 
 /**
  * @brief Get the timestamp when the next timeout is expected to occur
+ *
+ * Timers with slack (see esp_timer_create_args_t::slack_us) are coalesced, so this may be later
+ * than the earliest alarm of the armed timers, but not later than any of them plus its slack.
+ *
  * @return Timestamp of the nearest timer event, in microseconds.
  *         The timebase is the same as for the values returned by esp_timer_get_time.
  */
@@ -64,17 +64,40 @@ struct esp_timer {
         uint32_t event_id;
     };
     void* arg;
+    uint32_t heap_index;    //!< position in s_timers[].items while the timer is armed
+    uint32_t seq;           //!< insertion order, keeps timers with the same alarm in FIFO order
+    uint32_t slack;         //!< the callback may run up to this many microseconds after the alarm
 #if WITH_PROFILING
     const char* name;
     size_t times_triggered;
     size_t times_armed;
     size_t times_skipped;
     uint64_t total_callback_run_time;
-#endif // WITH_PROFILING
     LIST_ENTRY(esp_timer) list_entry;
+#endif // WITH_PROFILING
 };
 
+/* Armed timers are kept in a binary min-heap ordered by alarm time, so that arming, stopping
+ * and expiring a timer take O(log n) steps inside the critical section instead of a walk over a sorted list.
+ * The array is never allocated while the lock is held: every created timer reserves a slot in advance
+ * (in the TASK heap, which also receives the timers being deleted, and in the ISR heap for ISR timers).
+ */
+typedef struct {
+    esp_timer_handle_t* items;
+    size_t count;       //!< number of armed timers
+    size_t reserved;    //!< number of timers which may be armed at the same time
+    size_t capacity;    //!< size of items
+    uint32_t next_seq;
+    uint64_t alarm;     //!< time last passed to esp_timer_impl_set_alarm_id
+} timer_heap_t;
+
 static inline bool is_initialized(void);
+static esp_err_t timer_heap_reserve(esp_timer_dispatch_t dispatch_method);
+static esp_timer_handle_t* timer_heap_release(esp_timer_dispatch_t dispatch_method);
+static esp_timer_handle_t timer_heap_first(esp_timer_dispatch_t dispatch_method);
+static void timer_heap_remove(esp_timer_handle_t timer, esp_timer_dispatch_t dispatch_method);
+static uint64_t timer_heap_deadline(esp_timer_dispatch_t dispatch_method, bool for_wake_up);
+static void timer_set_alarm(uint64_t alarm, esp_timer_dispatch_t dispatch_method);
 static esp_err_t timer_insert(esp_timer_handle_t timer, bool without_update_alarm);
 static esp_err_t timer_remove(esp_timer_handle_t timer);
 static bool timer_armed(esp_timer_handle_t timer);
@@ -88,9 +111,9 @@ static void timer_remove_inactive(esp_timer_handle_t timer);
 
 __attribute__((unused)) static const char* TAG = "esp_timer";
 
-// lists of currently armed timers for two dispatch methods: ISR and TASK
-static LIST_HEAD(esp_timer_list, esp_timer) s_timers[ESP_TIMER_MAX] = {
-    [0 ... (ESP_TIMER_MAX - 1)] = LIST_HEAD_INITIALIZER(s_timers)
+// heaps of currently armed timers for two dispatch methods: ISR and TASK
+static timer_heap_t s_timers[ESP_TIMER_MAX] = {
+    [0 ... (ESP_TIMER_MAX - 1)] = { .alarm = UINT64_MAX }
 };
 #if WITH_PROFILING
 // lists of unarmed timers for two dispatch methods: ISR and TASK,
@@ -130,6 +153,20 @@ esp_err_t esp_timer_create(const esp_timer_create_args_t* args,
     result->arg = args->arg;
     result->flags = (args->dispatch_method ? FL_ISR_DISPATCH_METHOD : 0) |
                     (args->skip_unhandled_events ? FL_SKIP_UNHANDLED_EVENTS : 0);
+    result->slack = args->slack_us;
+    // every timer goes to the TASK heap when it is deleted
+    if (timer_heap_reserve(ESP_TIMER_TASK) != ESP_OK) {
+        free(result);
+        return ESP_ERR_NO_MEM;
+    }
+    if (args->dispatch_method == ESP_TIMER_ISR && timer_heap_reserve(ESP_TIMER_ISR) != ESP_OK) {
+        timer_list_lock(ESP_TIMER_TASK);
+        esp_timer_handle_t* unused = timer_heap_release(ESP_TIMER_TASK);
+        timer_list_unlock(ESP_TIMER_TASK);
+        free(unused);
+        free(result);
+        return ESP_ERR_NO_MEM;
+    }
 #if WITH_PROFILING
     result->name = args->name;
     esp_timer_dispatch_t dispatch_method = result->flags & FL_ISR_DISPATCH_METHOD;
@@ -205,44 +242,203 @@ esp_err_t esp_timer_delete(esp_timer_handle_t timer)
         return ESP_ERR_INVALID_STATE;
     }
     // A case for the timer with ESP_TIMER_ISR:
-    // This ISR timer was removed from the ISR list in esp_timer_stop() or in timer_process_alarm() -> LIST_REMOVE(it, list_entry)
-    // and here this timer will be added to another the TASK list, see below.
+    // This ISR timer was removed from the ISR heap in esp_timer_stop() or in timer_process_alarm() -> timer_heap_remove()
+    // and here this timer will be added to another the TASK heap, see below.
     // We do this because we want to free memory of the timer in a task context instead of an isr context.
+    if (timer->flags & FL_ISR_DISPATCH_METHOD) {
+        timer_list_lock(ESP_TIMER_ISR);
+        esp_timer_handle_t* unused = timer_heap_release(ESP_TIMER_ISR);
+        timer_list_unlock(ESP_TIMER_ISR);
+        free(unused);
+    }
     int64_t alarm = esp_timer_get_time();
     timer_list_lock(ESP_TIMER_TASK);
     timer->flags &= ~FL_ISR_DISPATCH_METHOD;
     timer->event_id = EVENT_ID_DELETE_TIMER;
     timer->alarm = alarm;
     timer->period = 0;
+    timer->slack = 0;
     timer_insert(timer, false);
     timer_list_unlock(ESP_TIMER_TASK);
     return ESP_OK;
 }
 
-static IRAM_ATTR esp_err_t timer_insert(esp_timer_handle_t timer, bool without_update_alarm)
+static esp_err_t timer_heap_reserve(esp_timer_dispatch_t dispatch_method)
 {
-#if WITH_PROFILING
-    timer_remove_inactive(timer);
-#endif
-    esp_timer_handle_t it, last = NULL;
-    esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
-    if (LIST_FIRST(&s_timers[dispatch_method]) == NULL) {
-        LIST_INSERT_HEAD(&s_timers[dispatch_method], timer, list_entry);
+    timer_heap_t* heap = &s_timers[dispatch_method];
+    while (true) {
+        timer_list_lock(dispatch_method);
+        if (heap->reserved < heap->capacity) {
+            heap->reserved++;
+            timer_list_unlock(dispatch_method);
+            return ESP_OK;
+        }
+        size_t new_capacity = MAX(heap->capacity * 2, 8);
+        timer_list_unlock(dispatch_method);
+
+        // the heap is accessed from the timer ISR, so it has to be in internal memory
+        esp_timer_handle_t* items = heap_caps_malloc(new_capacity * sizeof(esp_timer_handle_t), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+        if (items == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        timer_list_lock(dispatch_method);
+        esp_timer_handle_t* unused = items;
+        // another task may have grown the heap in the meantime
+        if (new_capacity > heap->capacity) {
+            if (heap->count > 0) {
+                memcpy(items, heap->items, heap->count * sizeof(esp_timer_handle_t));
+            }
+            unused = heap->items;
+            heap->items = items;
+            heap->capacity = new_capacity;
+        }
+        timer_list_unlock(dispatch_method);
+        free(unused);
+    }
+}
+
+/* Called with the lock held. When the last timer is gone, returns the array of the heap,
+ * to be freed by the caller once the lock is released, and NULL otherwise.
+ */
+static IRAM_ATTR esp_timer_handle_t* timer_heap_release(esp_timer_dispatch_t dispatch_method)
+{
+    timer_heap_t* heap = &s_timers[dispatch_method];
+    assert(heap->reserved > 0);
+    heap->reserved--;
+    if (heap->reserved > 0) {
+        return NULL;
+    }
+    assert(heap->count == 0);
+    esp_timer_handle_t* unused = heap->items;
+    heap->items = NULL;
+    heap->capacity = 0;
+    return unused;
+}
+
+static IRAM_ATTR inline bool timer_heap_less(esp_timer_handle_t a, esp_timer_handle_t b)
+{
+    if (a->alarm != b->alarm) {
+        return a->alarm < b->alarm;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static IRAM_ATTR void timer_heap_set(timer_heap_t* heap, size_t index, esp_timer_handle_t timer)
+{
+    heap->items[index] = timer;
+    timer->heap_index = index;
+}
+
+static IRAM_ATTR void timer_heap_sift_up(timer_heap_t* heap, size_t index)
+{
+    esp_timer_handle_t timer = heap->items[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!timer_heap_less(timer, heap->items[parent])) {
+            break;
+        }
+        timer_heap_set(heap, index, heap->items[parent]);
+        index = parent;
+    }
+    timer_heap_set(heap, index, timer);
+}
+
+static IRAM_ATTR void timer_heap_sift_down(timer_heap_t* heap, size_t index)
+{
+    esp_timer_handle_t timer = heap->items[index];
+    while (true) {
+        size_t child = 2 * index + 1;
+        if (child >= heap->count) {
+            break;
+        }
+        if (child + 1 < heap->count && timer_heap_less(heap->items[child + 1], heap->items[child])) {
+            child++;
+        }
+        if (!timer_heap_less(heap->items[child], timer)) {
+            break;
+        }
+        timer_heap_set(heap, index, heap->items[child]);
+        index = child;
+    }
+    timer_heap_set(heap, index, timer);
+}
+
+static IRAM_ATTR esp_timer_handle_t timer_heap_first(esp_timer_dispatch_t dispatch_method)
+{
+    timer_heap_t* heap = &s_timers[dispatch_method];
+    return (heap->count > 0) ? heap->items[0] : NULL;
+}
+
+static IRAM_ATTR void timer_heap_remove(esp_timer_handle_t timer, esp_timer_dispatch_t dispatch_method)
+{
+    timer_heap_t* heap = &s_timers[dispatch_method];
+    size_t index = timer->heap_index;
+    assert(index < heap->count && heap->items[index] == timer);
+    heap->count--;
+    if (index == heap->count) {
+        return;
+    }
+    // move the last timer into the hole, then restore the order in whichever direction it is broken
+    timer_heap_set(heap, index, heap->items[heap->count]);
+    if (index > 0 && timer_heap_less(heap->items[index], heap->items[(index - 1) / 2])) {
+        timer_heap_sift_up(heap, index);
     } else {
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            if (timer->alarm < it->alarm) {
-                LIST_INSERT_BEFORE(it, timer, list_entry);
-                break;
+        timer_heap_sift_down(heap, index);
+    }
+}
+
+/* Latest time the alarm may fire at without delaying any timer by more than its slack.
+ * All timers with alarms up to that time are dispatched together then.
+ * Only the timers which expire before the deadline are visited: the subtree of a timer
+ * expiring after it is skipped. The tree is walked without recursion or a stack, moving
+ * from a left child (odd index) to its right sibling, and up from a right child.
+ * For a wake up from sleep, the timers with the SKIP_UNHANDLED_EVENTS flag are ignored.
+ */
+static IRAM_ATTR uint64_t timer_heap_deadline(esp_timer_dispatch_t dispatch_method, bool for_wake_up)
+{
+    const timer_heap_t* heap = &s_timers[dispatch_method];
+    uint64_t deadline = UINT64_MAX;
+    size_t index = 0;
+    while (true) {
+        if (index < heap->count && heap->items[index]->alarm <= deadline) {
+            esp_timer_handle_t timer = heap->items[index];
+            if (!for_wake_up || (timer->flags & FL_SKIP_UNHANDLED_EVENTS) == 0) {
+                deadline = MIN(deadline, timer->alarm + timer->slack);
             }
-            last = it;
+            index = 2 * index + 1;
+            continue;
+        }
+        // the subtree is done, go up while it is the right one
+        while (index > 0 && index % 2 == 0) {
+            index = (index - 1) / 2;
         }
-        if (it == NULL) {
-            assert(last);
-            LIST_INSERT_AFTER(last, timer, list_entry);
+        if (index == 0) {
+            return deadline;
         }
+        index++;
     }
-    if (without_update_alarm == false && timer == LIST_FIRST(&s_timers[dispatch_method])) {
-        esp_timer_impl_set_alarm_id(timer->alarm, dispatch_method);
+}
+
+static IRAM_ATTR void timer_set_alarm(uint64_t alarm, esp_timer_dispatch_t dispatch_method)
+{
+    s_timers[dispatch_method].alarm = alarm;
+    esp_timer_impl_set_alarm_id(alarm, dispatch_method);
+}
+
+static IRAM_ATTR esp_err_t timer_insert(esp_timer_handle_t timer, bool without_update_alarm)
+{
+#if WITH_PROFILING
+    timer_remove_inactive(timer);
+#endif
+    esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
+    timer_heap_t* heap = &s_timers[dispatch_method];
+    assert(heap->count < heap->reserved);
+    timer->seq = heap->next_seq++;
+    heap->items[heap->count] = timer;
+    timer_heap_sift_up(heap, heap->count++);
+    // the timer only matters if it expires before the current deadline, and then it can only bring the deadline forward
+    if (without_update_alarm == false && timer->alarm + timer->slack < heap->alarm) {
+        timer_set_alarm(timer->alarm + timer->slack, dispatch_method);
     }
     return ESP_OK;
 }
@@ -251,17 +447,13 @@ static IRAM_ATTR esp_err_t timer_remove(esp_timer_handle_t timer)
 {
     esp_timer_dispatch_t dispatch_method = timer->flags & FL_ISR_DISPATCH_METHOD;
     timer_list_lock(dispatch_method);
-    esp_timer_handle_t first_timer = LIST_FIRST(&s_timers[dispatch_method]);
-    LIST_REMOVE(timer, list_entry);
+    esp_timer_handle_t first_timer = timer_heap_first(dispatch_method);
+    timer_heap_remove(timer, dispatch_method);
     timer->alarm = 0;
     timer->period = 0;
-    if (timer == first_timer) { // if this timer was the first in the list.
-        uint64_t next_timestamp = UINT64_MAX;
-        first_timer = LIST_FIRST(&s_timers[dispatch_method]);
-        if (first_timer) { // if after removing the timer from the list, this list is not empty.
-            next_timestamp = first_timer->alarm;
-        }
-        esp_timer_impl_set_alarm_id(next_timestamp, dispatch_method);
+    if (timer == first_timer) { // if this timer was the first in the heap.
+        // UINT64_MAX if after removing the timer from the heap, this heap is empty.
+        timer_set_alarm(timer_heap_deadline(dispatch_method, false), dispatch_method);
     }
 #if WITH_PROFILING
     timer_insert_inactive(timer);
@@ -321,18 +513,22 @@ static bool timer_process_alarm(esp_timer_dispatch_t dispatch_method)
     bool processed = false;
     esp_timer_handle_t it;
     while (1) {
-        it = LIST_FIRST(&s_timers[dispatch_method]);
+        it = timer_heap_first(dispatch_method);
         int64_t now = esp_timer_impl_get_time();
         if (it == NULL || it->alarm > now) {
             break;
         }
         processed = true;
-        LIST_REMOVE(it, list_entry);
+        timer_heap_remove(it, dispatch_method);
         if (it->event_id == EVENT_ID_DELETE_TIMER) {
             // It is handled only by ESP_TIMER_TASK (see esp_timer_delete()).
-            // All the ESP_TIMER_ISR timers which should be deleted are moved by esp_timer_delete() to the ESP_TIMER_TASK list.
+            // All the ESP_TIMER_ISR timers which should be deleted are moved by esp_timer_delete() to the ESP_TIMER_TASK heap.
             // We want to free memory of the timer in a task context instead of an isr context.
+            esp_timer_handle_t* unused = timer_heap_release(ESP_TIMER_TASK);
+            timer_list_unlock(dispatch_method);
             free(it);
+            free(unused);
+            timer_list_lock(dispatch_method);
             it = NULL;
         } else {
             if (it->period > 0) {
@@ -368,11 +564,11 @@ static bool timer_process_alarm(esp_timer_dispatch_t dispatch_method)
     } // while(1)
     if (it) {
         if (dispatch_method == ESP_TIMER_TASK || (dispatch_method != ESP_TIMER_TASK && processed == true)) {
-            esp_timer_impl_set_alarm_id(it->alarm, dispatch_method);
+            timer_set_alarm(timer_heap_deadline(dispatch_method, false), dispatch_method);
         }
     } else {
         if (processed) {
-            esp_timer_impl_set_alarm_id(UINT64_MAX, dispatch_method);
+            timer_set_alarm(UINT64_MAX, dispatch_method);
         }
     }
     timer_list_unlock(dispatch_method);
@@ -473,7 +669,7 @@ esp_err_t esp_timer_deinit(void)
 
     /* Check if there are any active timers */
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
-        if (!LIST_EMPTY(&s_timers[dispatch_method])) {
+        if (s_timers[dispatch_method].count != 0) {
             return ESP_ERR_INVALID_STATE;
         }
     }
@@ -520,6 +716,13 @@ static void print_timer_info(esp_timer_handle_t t, char** dst, size_t* dst_size)
 }
 
 
+static int timer_dump_compare(const void* a, const void* b)
+{
+    esp_timer_handle_t ta = *(const esp_timer_handle_t*) a;
+    esp_timer_handle_t tb = *(const esp_timer_handle_t*) b;
+    return timer_heap_less(ta, tb) ? -1 : 1;
+}
+
 esp_err_t esp_timer_dump(FILE* stream)
 {
     /* Since timer lock is a critical section, we don't want to print directly
@@ -528,15 +731,15 @@ esp_err_t esp_timer_dump(FILE* stream)
      * print to it, then dump this memory to stdout.
      */
 
+#if WITH_PROFILING
     esp_timer_handle_t it;
+#endif
 
     /* First count the number of timers */
     size_t timer_count = 0;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            ++timer_count;
-        }
+        timer_count += s_timers[dispatch_method].count;
 #if WITH_PROFILING
         LIST_FOREACH(it, &s_inactive_timers[dispatch_method], list_entry) {
             ++timer_count;
@@ -552,7 +755,12 @@ esp_err_t esp_timer_dump(FILE* stream)
      */
     size_t buf_size = TIMER_INFO_LINE_LEN * (timer_count + 3);
     char* print_buf = calloc(1, buf_size + 1);
-    if (print_buf == NULL) {
+    /* The heap is only partially ordered, armed timers are sorted in a copy of it */
+    size_t sorted_size = timer_count + 3;
+    esp_timer_handle_t* sorted = calloc(sorted_size, sizeof(esp_timer_handle_t));
+    if (print_buf == NULL || sorted == NULL) {
+        free(print_buf);
+        free(sorted);
         return ESP_ERR_NO_MEM;
     }
 
@@ -560,8 +768,13 @@ esp_err_t esp_timer_dump(FILE* stream)
     char* pos = print_buf;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            print_timer_info(it, &pos, &buf_size);
+        size_t count = MIN(s_timers[dispatch_method].count, sorted_size);
+        if (count > 0) {
+            memcpy(sorted, s_timers[dispatch_method].items, count * sizeof(esp_timer_handle_t));
+            qsort(sorted, count, sizeof(esp_timer_handle_t), &timer_dump_compare);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            print_timer_info(sorted[i], &pos, &buf_size);
         }
 #if WITH_PROFILING
         LIST_FOREACH(it, &s_inactive_timers[dispatch_method], list_entry) {
@@ -585,6 +798,7 @@ esp_err_t esp_timer_dump(FILE* stream)
     }
 
     free(print_buf);
+    free(sorted);
     return ESP_OK;
 }
 
@@ -593,11 +807,9 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm(void)
     int64_t next_alarm = INT64_MAX;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        esp_timer_handle_t it = LIST_FIRST(&s_timers[dispatch_method]);
-        if (it) {
-            if (next_alarm > it->alarm) {
-                next_alarm = it->alarm;
-            }
+        uint64_t deadline = timer_heap_deadline(dispatch_method, false);
+        if (deadline < (uint64_t) next_alarm) {
+            next_alarm = deadline;
         }
         timer_list_unlock(dispatch_method);
     }
@@ -609,15 +821,11 @@ int64_t IRAM_ATTR esp_timer_get_next_alarm_for_wake_up(void)
     int64_t next_alarm = INT64_MAX;
     for (esp_timer_dispatch_t dispatch_method = ESP_TIMER_TASK; dispatch_method < ESP_TIMER_MAX; ++dispatch_method) {
         timer_list_lock(dispatch_method);
-        esp_timer_handle_t it = NULL;
-        LIST_FOREACH(it, &s_timers[dispatch_method], list_entry) {
-            // timers with the SKIP_UNHANDLED_EVENTS flag do not want to wake up CPU from a sleep mode.
-            if ((it->flags & FL_SKIP_UNHANDLED_EVENTS) == 0) {
-                if (next_alarm > it->alarm) {
-                    next_alarm = it->alarm;
-                }
-                break;
-            }
+        // timers with the SKIP_UNHANDLED_EVENTS flag do not want to wake up CPU from a sleep mode.
+        // wake up as late as the slack of the timer allows, the timers due by then are dispatched together
+        uint64_t deadline = timer_heap_deadline(dispatch_method, true);
+        if (deadline < (uint64_t) next_alarm) {
+            next_alarm = deadline;
         }
         timer_list_unlock(dispatch_method);
     }
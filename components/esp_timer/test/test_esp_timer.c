@@ -19,6 +19,7 @@
 #include "test_utils.h"
 #include "esp_freertos_hooks.h"
 #include "esp_rom_sys.h"
+#include "esp_random.h"
 
 #define SEC  (1000000)
 
@@ -492,6 +493,127 @@ TEST_CASE("Can dump esp_timer stats", "[esp_timer]")
     esp_timer_dump(stdout);
 }
 
+TEST_CASE("esp_timer arms and stops thousands of timers", "[esp_timer]")
+{
+    const int num_timers = 1000;
+    const int rounds = 10;
+    esp_timer_handle_t* handles = calloc(num_timers, sizeof(esp_timer_handle_t));
+    TEST_ASSERT_NOT_NULL(handles);
+    for (int i = 0; i < num_timers; ++i) {
+        esp_timer_create_args_t args = {
+                .callback = &dummy_cb,
+        };
+        TEST_ESP_OK(esp_timer_create(&args, &handles[i]));
+    }
+
+    int64_t start_time = 0;
+    int64_t stop_time = 0;
+    for (int round = 0; round < rounds; ++round) {
+        int64_t t0 = esp_timer_get_time();
+        for (int i = 0; i < num_timers; ++i) {
+            TEST_ESP_OK(esp_timer_start_once(handles[i], 10 * SEC + (esp_random() % (10 * SEC))));
+        }
+        int64_t t1 = esp_timer_get_time();
+
+        // the next alarm is not later than the earliest one of these timers (other timers may be armed, too)
+        uint64_t min_expiry = UINT64_MAX;
+        for (int i = 0; i < num_timers; ++i) {
+            uint64_t expiry;
+            TEST_ESP_OK(esp_timer_get_expiry_time(handles[i], &expiry));
+            min_expiry = MIN(min_expiry, expiry);
+        }
+        TEST_ASSERT(esp_timer_get_next_alarm() <= min_expiry);
+
+        // stop in an order unrelated to the alarm times
+        int64_t t2 = esp_timer_get_time();
+        for (int i = 0; i < num_timers; ++i) {
+            TEST_ESP_OK(esp_timer_stop(handles[(i * 7) % num_timers]));
+        }
+        int64_t t3 = esp_timer_get_time();
+        start_time += t1 - t0;
+        stop_time += t3 - t2;
+    }
+    printf("%d timers: start %lld ns, stop %lld ns on average\n", num_timers,
+           start_time * 1000 / (rounds * num_timers), stop_time * 1000 / (rounds * num_timers));
+
+    for (int i = 0; i < num_timers; ++i) {
+        TEST_ESP_OK(esp_timer_delete(handles[i]));
+    }
+    free(handles);
+    // timers are freed by the timer task
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+}
+
+#define NUM_COALESCED_TIMERS 16
+
+typedef struct {
+    int64_t expected;
+    uint64_t period;
+    int64_t max_delay;
+    int64_t* last_dispatch;
+    int* dispatches;
+} test_coalesced_timer_args_t;
+
+static void test_coalesced_timer_cb(void* arg)
+{
+    test_coalesced_timer_args_t* p_args = (test_coalesced_timer_args_t*) arg;
+    int64_t now = esp_timer_get_time();
+    p_args->max_delay = MAX(p_args->max_delay, now - p_args->expected);
+    p_args->expected += p_args->period;
+    // callbacks running right one after another were dispatched by the same alarm
+    if (now - *p_args->last_dispatch > 200) {
+        ++*p_args->dispatches;
+    }
+    *p_args->last_dispatch = now;
+}
+
+static int test_coalesced_timers(uint32_t slack_us, int64_t* max_delay)
+{
+    test_coalesced_timer_args_t args[NUM_COALESCED_TIMERS] = { 0 };
+    esp_timer_handle_t handles[NUM_COALESCED_TIMERS];
+    int64_t last_dispatch = 0;
+    int dispatches = 0;
+    for (int i = 0; i < NUM_COALESCED_TIMERS; ++i) {
+        esp_timer_create_args_t create_args = {
+                .callback = &test_coalesced_timer_cb,
+                .arg = &args[i],
+                .slack_us = slack_us,
+        };
+        TEST_ESP_OK(esp_timer_create(&create_args, &handles[i]));
+        args[i].period = 10000 + i * 3100;
+        args[i].last_dispatch = &last_dispatch;
+        args[i].dispatches = &dispatches;
+    }
+    for (int i = 0; i < NUM_COALESCED_TIMERS; ++i) {
+        args[i].expected = esp_timer_get_time() + args[i].period;
+        TEST_ESP_OK(esp_timer_start_periodic(handles[i], args[i].period));
+    }
+    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    *max_delay = 0;
+    for (int i = 0; i < NUM_COALESCED_TIMERS; ++i) {
+        TEST_ESP_OK(esp_timer_stop(handles[i]));
+        TEST_ESP_OK(esp_timer_delete(handles[i]));
+        *max_delay = MAX(*max_delay, args[i].max_delay);
+    }
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    return dispatches;
+}
+
+TEST_CASE("esp_timer coalesces timers with slack", "[esp_timer]")
+{
+    const uint32_t slack_us = 5000;
+    int64_t max_delay_precise;
+    int64_t max_delay_coalesced;
+    int dispatches_precise = test_coalesced_timers(0, &max_delay_precise);
+    int dispatches_coalesced = test_coalesced_timers(slack_us, &max_delay_coalesced);
+    printf("%d timers for 1 s: %d alarms without slack (max delay %lld us), %d alarms with %u us slack (max delay %lld us)\n",
+           NUM_COALESCED_TIMERS, dispatches_precise, max_delay_precise, dispatches_coalesced, slack_us, max_delay_coalesced);
+    TEST_ASSERT_LESS_THAN(dispatches_precise, dispatches_coalesced);
+    // allow for the latency of the timer task
+    TEST_ASSERT_LESS_THAN(slack_us + 1000, max_delay_coalesced);
+}
+#undef NUM_COALESCED_TIMERS
+
 typedef struct {
     SemaphoreHandle_t notify_from_timer_cb;
     esp_timer_handle_t timer;
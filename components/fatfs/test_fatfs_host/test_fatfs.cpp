@@ -92,3 +92,79 @@ TEST_CASE("create volume, open file, write and read back data", "[fatfs]")
     free(read);
     free(data);
 }
+
+extern "C" int spi_flash_get_total_erase_cycles(void);
+
+TEST_CASE("benchmark erase count of writing many small files", "[fatfs][benchmark]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+
+    wl_handle_t wl_handle;
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+
+    BYTE pdrv;
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+
+    LBA_t part_list[] = {100, 0, 0, 0};
+    BYTE work_area[FF_MAX_SS];
+    REQUIRE(f_fdisk(pdrv, part_list, work_area) == FR_OK);
+    const MKFS_PARM opt = {(BYTE)FM_ANY, 0, 0, 0, 0};
+    REQUIRE(f_mkfs(drv, &opt, work_area, sizeof(work_area)) == FR_OK);
+
+    FATFS fs;
+    REQUIRE(f_mount(&fs, drv, 0) == FR_OK);
+
+    // Files are appended to one sector at a time, so that the FAT and the directory entry are updated for each sector
+    const int files_count = 40;
+    const int file_sectors = 4;
+    const UINT sector_size = CONFIG_WL_SECTOR_SIZE;
+    char *data = (char*) malloc(sector_size);
+    char *read = (char*) malloc(sector_size);
+    char name[16];
+    FIL file;
+    UINT bw;
+
+    int erase_cycles = spi_flash_get_total_erase_cycles();
+    for (int i = 0; i < files_count; i++) {
+        snprintf(name, sizeof(name), "%s/f%d.bin", drv, i);
+        REQUIRE(f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+        for (int j = 0; j < file_sectors; j++) {
+            memset(data, i * file_sectors + j, sector_size);
+            REQUIRE(f_write(&file, data, sector_size, &bw) == FR_OK);
+            REQUIRE(bw == sector_size);
+        }
+        REQUIRE(f_close(&file) == FR_OK);
+    }
+    REQUIRE(f_mount(0, drv, 0) == FR_OK);
+    // Unmounting writes back the sectors which are still cached
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+    erase_cycles = spi_flash_get_total_erase_cycles() - erase_cycles;
+
+    // Read the files back from a fresh mount
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+    REQUIRE(f_mount(&fs, drv, 0) == FR_OK);
+    for (int i = 0; i < files_count; i++) {
+        snprintf(name, sizeof(name), "%s/f%d.bin", drv, i);
+        REQUIRE(f_open(&file, name, FA_READ) == FR_OK);
+        for (int j = 0; j < file_sectors; j++) {
+            memset(data, i * file_sectors + j, sector_size);
+            REQUIRE(f_read(&file, read, sector_size, &bw) == FR_OK);
+            REQUIRE(bw == sector_size);
+            REQUIRE(memcmp(data, read, sector_size) == 0);
+        }
+        REQUIRE(f_close(&file) == FR_OK);
+    }
+    REQUIRE(f_mount(0, drv, 0) == FR_OK);
+    ff_diskio_unregister(pdrv);
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+
+    printf("%d files of %d sectors: %d erases\n", files_count, file_sectors, erase_cycles);
+
+    free(read);
+    free(data);
+}
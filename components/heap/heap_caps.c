@@ -83,6 +83,65 @@ bool heap_caps_match(const heap_t *heap, uint32_t caps)
     return heap->heap != NULL && ((get_all_caps(heap) & caps) == caps);
 }
 
+/* Allocate and free through the small-object cache of the heap, if any */
+IRAM_ATTR static inline void *heap_malloc(heap_t *heap, size_t size)
+{
+#if CONFIG_HEAP_CACHE
+    if (heap->cache != NULL) {
+        return multi_heap_cache_malloc(heap->cache, size);
+    }
+#endif
+    return multi_heap_malloc(heap->heap, size);
+}
+
+IRAM_ATTR static inline void heap_free(heap_t *heap, void *ptr)
+{
+#if CONFIG_HEAP_CACHE
+    if (heap->cache != NULL) {
+        multi_heap_cache_free(heap->cache, ptr);
+        return;
+    }
+#endif
+    multi_heap_free(heap->heap, ptr);
+}
+
+void heap_caps_cache_create(heap_t *heap)
+{
+#if CONFIG_HEAP_CACHE
+    heap->cache = NULL;
+    //The cache lives in the heap it caches, and its locks must be in internal memory
+    if (heap_caps_match(heap, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)) {
+        heap->cache = multi_heap_cache_create(heap->heap);
+    }
+#endif
+}
+
+void heap_caps_cache_flush(void)
+{
+#if CONFIG_HEAP_CACHE
+    heap_t *heap;
+    SLIST_FOREACH(heap, &registered_heaps, next) {
+        if (heap->heap != NULL && heap->cache != NULL) {
+            multi_heap_cache_flush(heap->cache);
+        }
+    }
+#endif
+}
+
+size_t heap_caps_cache_get_size(void)
+{
+    size_t size = 0;
+#if CONFIG_HEAP_CACHE
+    heap_t *heap;
+    SLIST_FOREACH(heap, &registered_heaps, next) {
+        if (heap->heap != NULL && heap->cache != NULL) {
+            size += multi_heap_cache_get_size(heap->cache);
+        }
+    }
+#endif
+    return size;
+}
+
 
 /*
 This function should not be called directly as it does not
@@ -143,7 +202,7 @@ IRAM_ATTR static void *heap_caps_malloc_base( size_t size, uint32_t caps)
                         }
                     } else {
                         //Just try to alloc, nothing special.
-                        ret = multi_heap_malloc(heap->heap, size);
+                        ret = heap_malloc(heap, size);
                         if (ret != NULL) {
                             return ret;
                         }
@@ -350,7 +409,7 @@ IRAM_ATTR void heap_caps_free( void *ptr)
 
     heap_t *heap = find_containing_heap(ptr);
     assert(heap != NULL && "free() target pointer is outside heap areas");
-    multi_heap_free(heap->heap, ptr);
+    heap_free(heap, ptr);
 }
 
 /*
@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/param.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_caps_pool.h"
+#include "multi_heap_platform.h"
+
+/*
+Pools of fixed-size objects.
+
+The objects of a pool are carved out of a single block, allocated with the capabilities of the pool. Free objects are
+linked through their first word, so that objects have no header. Objects which were never allocated are not on the
+free list: they are taken in order from the block once the free list is empty, so creating a pool doesn't touch its
+memory.
+*/
+
+struct heap_caps_pool {
+    multi_heap_lock_t lock;
+    void *free_list;        // Objects freed to the pool
+    uint8_t *objs;          // Memory of the objects
+    size_t obj_size;
+    size_t num_objs;
+    size_t num_carved;      // Objects up to this index were allocated at least once
+    size_t free_objs;
+    size_t minimum_free_objs;
+};
+
+heap_caps_pool_handle_t heap_caps_pool_create(size_t obj_size, uint32_t caps, size_t num_objs)
+{
+    size_t size;
+
+    if (obj_size == 0 || num_objs == 0 || (caps & MALLOC_CAP_EXEC)) {
+        return NULL;
+    }
+    // Free objects hold a pointer, and 32-bit only memory needs 4 byte aligned sizes
+    obj_size = (MAX(obj_size, sizeof(void *)) + 3) & ~3;
+    if (obj_size < 4 /* rounding overflowed */ || __builtin_mul_overflow(obj_size, num_objs, &size)) {
+        return NULL;
+    }
+
+    heap_caps_pool_handle_t pool = heap_caps_malloc(sizeof(struct heap_caps_pool), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (pool == NULL) {
+        return NULL;
+    }
+    // Align objects on the largest power of two their size is a multiple of, up to 16 bytes
+    size_t alignment = MIN(obj_size & -obj_size, 16);
+    pool->objs = heap_caps_aligned_alloc(alignment, size, caps);
+    if (pool->objs == NULL) {
+        heap_caps_free(pool);
+        return NULL;
+    }
+    MULTI_HEAP_LOCK_INIT(&pool->lock);
+    pool->free_list = NULL;
+    pool->obj_size = obj_size;
+    pool->num_objs = num_objs;
+    pool->num_carved = 0;
+    pool->free_objs = num_objs;
+    pool->minimum_free_objs = num_objs;
+    return pool;
+}
+
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    heap_caps_free(pool->objs);
+    heap_caps_free(pool);
+}
+
+IRAM_ATTR void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool)
+{
+    void *ptr = NULL;
+
+    MULTI_HEAP_LOCK(&pool->lock);
+    if (pool->free_list != NULL) {
+        ptr = pool->free_list;
+        pool->free_list = *(void **)ptr;
+    } else if (pool->num_carved < pool->num_objs) {
+        ptr = pool->objs + pool->num_carved * pool->obj_size;
+        pool->num_carved++;
+    }
+    if (ptr != NULL) {
+        pool->free_objs--;
+        if (pool->free_objs < pool->minimum_free_objs) {
+            pool->minimum_free_objs = pool->free_objs;
+        }
+    }
+    MULTI_HEAP_UNLOCK(&pool->lock);
+    return ptr;
+}
+
+IRAM_ATTR void *heap_caps_pool_calloc(heap_caps_pool_handle_t pool)
+{
+    void *ptr = heap_caps_pool_alloc(pool);
+    if (ptr != NULL) {
+        memset(ptr, 0, pool->obj_size);
+    }
+    return ptr;
+}
+
+IRAM_ATTR void heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    size_t offset = (uint8_t *)ptr - pool->objs;
+    assert((uint8_t *)ptr >= pool->objs && offset < pool->num_carved * pool->obj_size && "pool_free() pointer is outside the pool");
+    assert(offset % pool->obj_size == 0 && "pool_free() pointer is not an object of the pool");
+    (void) offset;
+
+    MULTI_HEAP_LOCK(&pool->lock);
+    *(void **)ptr = pool->free_list;
+    pool->free_list = ptr;
+    pool->free_objs++;
+    MULTI_HEAP_UNLOCK(&pool->lock);
+}
+
+size_t heap_caps_pool_get_obj_size(heap_caps_pool_handle_t pool)
+{
+    return pool->obj_size;
+}
+
+void heap_caps_pool_get_info(heap_caps_pool_handle_t pool, multi_heap_info_t *info)
+{
+    MULTI_HEAP_LOCK(&pool->lock);
+    const size_t free_objs = pool->free_objs;
+    const size_t minimum_free_objs = pool->minimum_free_objs;
+    MULTI_HEAP_UNLOCK(&pool->lock);
+
+    info->total_free_bytes = free_objs * pool->obj_size;
+    info->total_allocated_bytes = (pool->num_objs - free_objs) * pool->obj_size;
+    info->largest_free_block = free_objs ? pool->obj_size : 0;
+    info->minimum_free_bytes = minimum_free_objs * pool->obj_size;
+    info->allocated_blocks = pool->num_objs - free_objs;
+    info->free_blocks = free_objs;
+    info->total_blocks = pool->num_objs;
+}
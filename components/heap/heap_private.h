@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include "sdkconfig.h"
 #include <soc/soc_memory_layout.h>
 #include "multi_heap.h"
 #include "multi_heap_platform.h"
@@ -29,6 +30,9 @@ typedef struct heap_t_ {
     intptr_t end;
     multi_heap_lock_t heap_mux;
     multi_heap_handle_t heap;
+#if CONFIG_HEAP_CACHE
+    multi_heap_cache_handle_t cache; ///< Small-object cache in front of the heap, NULL if the heap isn't cached
+#endif
     SLIST_ENTRY(heap_t_) next;
 } heap_t;
 
@@ -42,6 +46,9 @@ extern SLIST_HEAD(registered_heap_ll, heap_t_) registered_heaps;
 
 bool heap_caps_match(const heap_t *heap, uint32_t caps);
 
+/* Create the small-object cache of a newly registered heap, if it is cached */
+void heap_caps_cache_create(heap_t *heap);
+
 /* return all possible capabilities (across all priorities) for a given heap */
 inline static IRAM_ATTR uint32_t get_all_caps(const heap_t *heap)
 {
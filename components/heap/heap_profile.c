@@ -0,0 +1,493 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include <stdio.h>
+#include <sys/queue.h>
+#include <sys/param.h>
+#include <sdkconfig.h>
+
+#define HEAP_PROFILE_SRCFILE /* don't warn on inclusion here */
+#include "esp_heap_profile.h"
+#undef HEAP_PROFILE_SRCFILE
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "soc/soc_memory_layout.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+Allocation profiler.
+
+The allocation functions are wrapped at link time, like for heap tracing, so that the return address of a wrapper is
+the call site of the allocation. One allocation in sample_period is sampled, and its size is added to the statistics
+of its call site, in a fixed-size table. The sampled allocations are also recorded in a hash map indexed by address,
+so that freeing them subtracts their size from the live bytes of their call site.
+*/
+
+#define STACK_DEPTH CONFIG_HEAP_PROFILING_STACK_DEPTH
+#define MAX_SITES CONFIG_HEAP_PROFILING_MAX_SITES
+#define MAX_LIVE CONFIG_HEAP_PROFILING_MAX_LIVE
+
+/* Slots of the hash table of call sites, twice the number of call sites so that probing stops early */
+#define SITE_SLOTS (2 * MAX_SITES)
+
+_Static_assert(STACK_DEPTH >= 1 && STACK_DEPTH <= 4, "CONFIG_HEAP_PROFILING_STACK_DEPTH must be in range 1-4");
+_Static_assert(MAX_SITES < UINT16_MAX, "CONFIG_HEAP_PROFILING_MAX_SITES is too large");
+
+/* Architecture-specific return value of __builtin_return_address which
+ * should be interpreted as an invalid address.
+ */
+#ifdef __XTENSA__
+#define HEAP_ARCH_INVALID_PC  0x40000000
+#else
+#define HEAP_ARCH_INVALID_PC  0x00000000
+#endif
+
+/* Sampled allocation which wasn't freed yet */
+typedef struct live_alloc {
+    SLIST_ENTRY(live_alloc) next;
+    void *address;
+    uint32_t size;
+    uint16_t site;
+} live_alloc_t;
+
+SLIST_HEAD(live_alloc_list, live_alloc);
+
+static portMUX_TYPE profile_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool profiling;
+static uint32_t sample_period;
+
+/* Allocations left before the next sample, and state of the random number generator, for each core.
+
+   They are not protected by the lock: if a task moves to the other core while using them, the only effect is that an
+   allocation may be sampled or skipped when it shouldn't.
+*/
+static uint32_t countdown[portNUM_PROCESSORS];
+static uint32_t rng_state[portNUM_PROCESSORS];
+
+/* Call sites, in the order of their first sampled allocation */
+static heap_profile_site_t sites[MAX_SITES];
+static size_t num_sites;
+
+/* Hash table of the call sites, by call stack. Each slot holds an index in sites[] plus one, or 0 if free. */
+static uint16_t site_slots[SITE_SLOTS];
+
+/* Sampled allocations which weren't freed yet, by address, and unused records */
+static live_alloc_t live_allocs[MAX_LIVE];
+static struct live_alloc_list live_map[MAX_LIVE];
+static struct live_alloc_list live_unused;
+static size_t num_live;
+
+/* Sampled allocations which weren't counted because the table of call sites was full */
+static uint32_t lost;
+
+/* Sampled allocations which aren't counted in the live bytes because all the live records were in use */
+static uint32_t untracked;
+
+static uint32_t start_ms;
+static uint32_t stop_ms;
+
+/* Incremented by heap_profile_start(), so that a record removed by a failed realloc isn't put back into the
+   statistics of another profiling session */
+static uint32_t session;
+
+/* Record of a sampled allocation removed before a realloc, to be put back if the realloc fails */
+typedef struct {
+    live_alloc_t live;
+    uint32_t session;
+    bool removed;
+} realloc_undo_t;
+
+/* Map a 32-bit hash to [0, n) */
+static inline uint32_t hash_to_range(uint32_t hash, uint32_t n)
+{
+    return ((uint64_t)hash * n) >> 32;
+}
+
+static inline uint32_t hash_address(const void *p)
+{
+    return (uintptr_t)p * 2654435761U;
+}
+
+esp_err_t heap_profile_start(uint32_t period)
+{
+    if (period == 0 || period > UINT32_MAX / 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint32_t now_ms = esp_log_timestamp();
+
+    portENTER_CRITICAL(&profile_mux);
+
+    profiling = false;
+    sample_period = period;
+    memset(sites, 0, sizeof(sites));
+    memset(site_slots, 0, sizeof(site_slots));
+    num_sites = 0;
+    memset(live_map, 0, sizeof(live_map));
+    SLIST_INIT(&live_unused);
+    for (int i = 0; i < MAX_LIVE; i++) {
+        SLIST_INSERT_HEAD(&live_unused, &live_allocs[i], next);
+    }
+    num_live = 0;
+    lost = 0;
+    untracked = 0;
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        countdown[i] = 1;
+        rng_state[i] = ((0x9E3779B9U * (i + 1)) ^ now_ms) | 1;  // xorshift32 state must not be 0
+    }
+    start_ms = now_ms;
+    session++;
+    profiling = true;
+
+    portEXIT_CRITICAL(&profile_mux);
+    return ESP_OK;
+}
+
+esp_err_t heap_profile_stop(void)
+{
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    const uint32_t now_ms = esp_log_timestamp();
+
+    portENTER_CRITICAL(&profile_mux);
+    if (profiling) {
+        profiling = false;
+        stop_ms = now_ms;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&profile_mux);
+    return err;
+}
+
+size_t heap_profile_get_sites(heap_profile_site_t *out, size_t max_sites)
+{
+    portENTER_CRITICAL(&profile_mux);
+    const size_t count = num_sites;
+    memcpy(out, sites, MIN(count, max_sites) * sizeof(heap_profile_site_t));
+    portEXIT_CRITICAL(&profile_mux);
+    return count;
+}
+
+void heap_profile_dump(void)
+{
+    const uint32_t now_ms = esp_log_timestamp();
+
+    portENTER_CRITICAL(&profile_mux);
+    const uint32_t elapsed_ms = (profiling ? now_ms : stop_ms) - start_ms;
+    const size_t count = num_sites;
+    const uint32_t lost_count = lost;
+    const uint32_t untracked_count = untracked;
+    portEXIT_CRITICAL(&profile_mux);
+
+    printf("heap_profile: period=%u depth=%d ms=%u sites=%u lost=%u untracked=%u\n",
+           sample_period, STACK_DEPTH, elapsed_ms, count, lost_count, untracked_count);
+    for (size_t i = 0; i < count; i++) {
+        heap_profile_site_t site;
+        portENTER_CRITICAL(&profile_mux);
+        site = sites[i];
+        portEXIT_CRITICAL(&profile_mux);
+
+        printf("heap_profile: count=%u bytes=%llu live=%u peak=%u at",
+               site.count, (unsigned long long)site.bytes, site.live_bytes, site.peak_live_bytes);
+        for (int j = 0; j < STACK_DEPTH && site.callers[j] != NULL; j++) {
+            printf(" %p", site.callers[j]);
+        }
+        printf("\n");
+    }
+}
+
+/* Return true if the current allocation must be sampled */
+static IRAM_ATTR bool sample(void)
+{
+    if (sample_period == 1) {
+        return true;
+    }
+    const int core = xPortGetCoreID();
+    if (--countdown[core] > 0) {
+        return false;
+    }
+    /* xorshift32. The next interval is uniform in [1, 2 * sample_period - 1], so the average is sample_period and
+       periodic allocation patterns don't bias the sampling. */
+    uint32_t x = rng_state[core];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state[core] = x;
+    countdown[core] = 1 + x % (2 * sample_period - 1);
+    return true;
+}
+
+#define GET_CALLER(N) do {                                                  \
+        if (STACK_DEPTH == N) {                                             \
+            return;                                                         \
+        }                                                                   \
+        callers[N] = __builtin_return_address(N + STACK_OFFSET);            \
+        if (!esp_ptr_executable(callers[N])                                 \
+                || callers[N] == (void *) HEAP_ARCH_INVALID_PC) {           \
+            callers[N] = NULL;                                              \
+            return;                                                         \
+        }                                                                   \
+    } while(0)
+
+/* Read the callers of the caller of the allocation function, for a stack depth above 1.
+
+   The caller of the allocation function is the return address of the wrapper, which is 2 stack frames above: the
+   wrapper calls profile_alloc(), which calls this function.
+*/
+#define STACK_OFFSET 2
+
+static IRAM_ATTR __attribute__((noinline)) void get_callers(void **callers)
+{
+#if STACK_DEPTH > 1
+    GET_CALLER(1);
+    GET_CALLER(2);
+    GET_CALLER(3);
+#endif
+}
+
+/* Find the call site matching a call stack, or add it. Called with the lock held. */
+static IRAM_ATTR heap_profile_site_t *find_site(void *const *callers)
+{
+    uint32_t hash = 0;
+    for (int i = 0; i < STACK_DEPTH; i++) {
+        hash = (hash ^ (uintptr_t)callers[i]) * 2654435761U;
+    }
+
+    uint32_t slot = hash_to_range(hash, SITE_SLOTS);
+    while (site_slots[slot] != 0) {
+        heap_profile_site_t *site = &sites[site_slots[slot] - 1];
+        if (memcmp(site->callers, callers, sizeof(site->callers)) == 0) {
+            return site;
+        }
+        if (++slot == SITE_SLOTS) {
+            slot = 0;
+        }
+    }
+
+    if (num_sites == MAX_SITES) {
+        return NULL;
+    }
+    heap_profile_site_t *site = &sites[num_sites++];
+    memcpy(site->callers, callers, sizeof(site->callers));
+    site_slots[slot] = num_sites;
+    return site;
+}
+
+static IRAM_ATTR __attribute__((noinline)) void profile_alloc(void *p, size_t size, void *caller)
+{
+    if (p == NULL || !sample()) {
+        return;
+    }
+
+    void *callers[STACK_DEPTH] = { caller };
+    get_callers(callers);
+
+    portENTER_CRITICAL(&profile_mux);
+    if (!profiling) {
+        portEXIT_CRITICAL(&profile_mux);
+        return;
+    }
+
+    heap_profile_site_t *site = find_site(callers);
+    if (site == NULL) {
+        lost++;
+        portEXIT_CRITICAL(&profile_mux);
+        return;
+    }
+    site->count++;
+    site->bytes += size;
+
+    live_alloc_t *live = SLIST_FIRST(&live_unused);
+    if (live != NULL) {
+        SLIST_REMOVE_HEAD(&live_unused, next);
+        live->address = p;
+        live->size = size;
+        live->site = site - sites;
+        SLIST_INSERT_HEAD(&live_map[hash_to_range(hash_address(p), MAX_LIVE)], live, next);
+        num_live++;
+        site->live_bytes += size;
+        site->peak_live_bytes = MAX(site->peak_live_bytes, site->live_bytes);
+    } else {
+        untracked++;
+    }
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+/* Remove the record of the allocation at p, if it was sampled. A copy of the record is kept in undo, if not NULL. */
+static IRAM_ATTR void profile_free(void *p, realloc_undo_t *undo)
+{
+    if (p == NULL || num_live == 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&profile_mux);
+    if (profiling) {
+        struct live_alloc_list *bucket = &live_map[hash_to_range(hash_address(p), MAX_LIVE)];
+        live_alloc_t *prev = NULL;
+        live_alloc_t *live;
+        SLIST_FOREACH(live, bucket, next) {
+            if (live->address == p) {
+                if (prev == NULL) {
+                    SLIST_REMOVE_HEAD(bucket, next);
+                } else {
+                    SLIST_NEXT(prev, next) = SLIST_NEXT(live, next);
+                }
+                sites[live->site].live_bytes -= live->size;
+                SLIST_INSERT_HEAD(&live_unused, live, next);
+                num_live--;
+                if (undo != NULL) {
+                    undo->live = *live;
+                    undo->session = session;
+                    undo->removed = true;
+                }
+                break;
+            }
+            prev = live;
+        }
+    }
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+/* Put back the record removed before a realloc which failed, the memory is still allocated */
+static IRAM_ATTR void profile_realloc_failed(const realloc_undo_t *undo)
+{
+    if (!undo->removed) {
+        return;
+    }
+
+    portENTER_CRITICAL(&profile_mux);
+    live_alloc_t *live = SLIST_FIRST(&live_unused);
+    if (undo->session == session && live != NULL) {
+        SLIST_REMOVE_HEAD(&live_unused, next);
+        live->address = undo->live.address;
+        live->size = undo->live.size;
+        live->site = undo->live.site;
+        SLIST_INSERT_HEAD(&live_map[hash_to_range(hash_address(live->address), MAX_LIVE)], live, next);
+        num_live++;
+        sites[live->site].live_bytes += live->size;
+    }
+    portEXIT_CRITICAL(&profile_mux);
+}
+
+void *__real_heap_caps_malloc(size_t size, uint32_t caps);
+void *__real_heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *__real_heap_caps_realloc(void *p, size_t size, uint32_t caps);
+void __real_heap_caps_free(void *p);
+void *__real_heap_caps_malloc_default(size_t size);
+void *__real_heap_caps_realloc_default(void *p, size_t size);
+
+/* The return address of each wrapper is the call site of the allocation. Nothing is recorded while profiling is
+   stopped, apart from reading the flag. */
+
+IRAM_ATTR void *__wrap_heap_caps_malloc(size_t size, uint32_t caps)
+{
+    void *p = __real_heap_caps_malloc(size, caps);
+    if (profiling) {
+        profile_alloc(p, size, __builtin_return_address(0));
+    }
+    return p;
+}
+
+IRAM_ATTR void *__wrap_heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    void *p = __real_heap_caps_calloc(n, size, caps);
+    if (profiling) {
+        profile_alloc(p, n * size, __builtin_return_address(0));
+    }
+    return p;
+}
+
+IRAM_ATTR void *__wrap_heap_caps_malloc_default(size_t size)
+{
+    void *p = __real_heap_caps_malloc_default(size);
+    if (profiling) {
+        profile_alloc(p, size, __builtin_return_address(0));
+    }
+    return p;
+}
+
+IRAM_ATTR void *__wrap_malloc(size_t size)
+{
+    void *p = __real_heap_caps_malloc_default(size);
+    if (profiling) {
+        profile_alloc(p, size, __builtin_return_address(0));
+    }
+    return p;
+}
+
+IRAM_ATTR void *__wrap_calloc(size_t n, size_t size)
+{
+    size_t size_bytes;
+    if (__builtin_mul_overflow(n, size, &size_bytes)) {
+        return NULL;
+    }
+    void *p = __real_heap_caps_malloc_default(size_bytes);
+    if (p != NULL) {
+        memset(p, 0, size_bytes);
+    }
+    if (profiling) {
+        profile_alloc(p, size_bytes, __builtin_return_address(0));
+    }
+    return p;
+}
+
+/* realloc is profiled as a free followed by an allocation. The free is recorded first, as another core may get the
+   same address as soon as it is freed. If the realloc fails, the memory isn't freed, and the record is put back. */
+
+IRAM_ATTR void *__wrap_heap_caps_realloc(void *p, size_t size, uint32_t caps)
+{
+    realloc_undo_t undo = { .removed = false };
+    if (profiling) {
+        profile_free(p, &undo);
+    }
+    void *r = __real_heap_caps_realloc(p, size, caps);
+    if (r == NULL && size != 0) {
+        profile_realloc_failed(&undo);
+    } else if (profiling) {
+        profile_alloc(r, size, __builtin_return_address(0));
+    }
+    return r;
+}
+
+IRAM_ATTR void *__wrap_heap_caps_realloc_default(void *p, size_t size)
+{
+    realloc_undo_t undo = { .removed = false };
+    if (profiling) {
+        profile_free(p, &undo);
+    }
+    void *r = __real_heap_caps_realloc_default(p, size);
+    if (r == NULL && size != 0) {
+        profile_realloc_failed(&undo);
+    } else if (profiling) {
+        profile_alloc(r, size, __builtin_return_address(0));
+    }
+    return r;
+}
+
+IRAM_ATTR void *__wrap_realloc(void *p, size_t size)
+{
+    realloc_undo_t undo = { .removed = false };
+    if (profiling) {
+        profile_free(p, &undo);
+    }
+    void *r = __real_heap_caps_realloc_default(p, size);
+    if (r == NULL && size != 0) {
+        profile_realloc_failed(&undo);
+    } else if (profiling) {
+        profile_alloc(r, size, __builtin_return_address(0));
+    }
+    return r;
+}
+
+IRAM_ATTR void __wrap_heap_caps_free(void *p)
+{
+    if (profiling) {
+        profile_free(p, NULL);
+    }
+    __real_heap_caps_free(p);
+}
+
+void __wrap_free(void *p) __attribute__((alias("__wrap_heap_caps_free")));
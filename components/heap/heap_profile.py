@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# heap_profile.py reads the output of heap_profile_dump() from a log, symbolizes the call
+# sites against the ELF file of the app, and prints them sorted by allocation rate.
+
+import argparse
+import re
+import subprocess
+import sys
+from typing import Dict, List, TextIO
+
+HEADER = re.compile(r'heap_profile: period=(\d+) depth=(\d+) ms=(\d+) sites=(\d+) lost=(\d+) untracked=(\d+)')
+SITE = re.compile(r'heap_profile: count=(\d+) bytes=(\d+) live=(\d+) peak=(\d+) at((?: 0x[0-9a-fA-F]+)*)')
+
+
+class Site(object):
+    def __init__(self, match, period):  # type: (re.Match, int) -> None
+        # count and bytes are scaled to estimate the totals, live and peak are for the sampled allocations only
+        self.count = int(match.group(1)) * period
+        self.bytes = int(match.group(2)) * period
+        self.live = int(match.group(3))
+        self.peak = int(match.group(4))
+        self.callers = match.group(5).split()
+
+
+def read_last_dump(log):  # type: (TextIO) -> tuple
+    header = None
+    sites = []  # type: List[Site]
+    for line in log:
+        m = HEADER.search(line)
+        if m:
+            header = m
+            sites = []
+            continue
+        m = SITE.search(line)
+        if m and header:
+            sites.append(Site(m, int(header.group(1))))
+    return header, sites
+
+
+def symbolize(addresses, elf_file, toolchain_prefix):  # type: (List[str], str, str) -> Dict[str, str]
+    if not addresses:
+        return {}
+    cmd = ['%saddr2line' % toolchain_prefix, '-pfC', '-e', elf_file] + addresses
+    try:
+        output = subprocess.check_output(cmd, universal_newlines=True)
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.stderr.write('Cannot run {}: {}\n'.format(cmd[0], e))
+        return {}
+    return dict(zip(addresses, output.splitlines()))
+
+
+def main():  # type: () -> None
+    parser = argparse.ArgumentParser(description='Print the allocation profile dumped by heap_profile_dump()')
+    parser.add_argument('elf_file', help='ELF file of the app')
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='Log holding the output of heap_profile_dump(), standard input by default')
+    parser.add_argument('--toolchain-prefix', default='xtensa-esp32-elf-',
+                        help='Prefix of the toolchain binaries, e.g. riscv32-esp-elf-')
+    parser.add_argument('--sort', choices=['bytes', 'count', 'live', 'peak'], default='bytes',
+                        help='Statistic to sort the call sites by')
+    args = parser.parse_args()
+
+    header, sites = read_last_dump(args.log)
+    if header is None:
+        sys.exit('No heap profile found in the log')
+
+    period, ms = int(header.group(1)), int(header.group(3))
+    seconds = max(ms, 1) / 1000.0
+    print('{} call sites, {:.1f} s, one allocation in {} sampled'.format(len(sites), seconds, period))
+    if int(header.group(5)) or int(header.group(6)):
+        print('{} sampled allocations not counted (call site table full), '
+              '{} not counted in live bytes (live allocation table full)'.format(header.group(5), header.group(6)))
+
+    symbols = symbolize(sorted(set(pc for site in sites for pc in site.callers)), args.elf_file, args.toolchain_prefix)
+    sites.sort(key=lambda site: getattr(site, args.sort), reverse=True)
+
+    print('{:>10} {:>10} {:>12} {:>10} {:>10}  call site'.format('allocs/s', 'bytes/s', 'bytes', 'live', 'peak'))
+    for site in sites:
+        print('{:>10.1f} {:>10.0f} {:>12} {:>10} {:>10}  {}'.format(site.count / seconds, site.bytes / seconds,
+                                                                    site.bytes, site.live, site.peak,
+                                                                    symbols.get(site.callers[0], site.callers[0])
+                                                                    if site.callers else '?'))
+        for pc in site.callers[1:]:
+            print('{:>58}  {}'.format('called from', symbols.get(pc, pc)))
+
+
+if __name__ == '__main__':
+    main()
@@ -11,6 +11,8 @@
 #undef HEAP_TRACE_SRCFILE
 
 #include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include <sys/queue.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -19,15 +21,59 @@
 
 #if CONFIG_HEAP_TRACING_STANDALONE
 
+/* Number of buckets of the hash map of records, indexed by address */
+#define HASH_MAP_SIZE CONFIG_HEAP_TRACING_HASH_MAP_SIZE
+
+_Static_assert((HASH_MAP_SIZE & (HASH_MAP_SIZE - 1)) == 0, "CONFIG_HEAP_TRACING_HASH_MAP_SIZE must be a power of two");
+
+/* Links of a record, kept out of heap_trace_record_t which is part of the API.
+
+   They are in an array parallel to the buffer of records: links[i] belongs to buffer[i].
+*/
+typedef struct record_links_t {
+    TAILQ_ENTRY(record_links_t) tailq;          // list of records, ordered by allocation
+    SLIST_ENTRY(record_links_t) slist_hashmap;  // hash map bucket of records, indexed by address
+} record_links_t;
+
+TAILQ_HEAD(heap_trace_record_list, record_links_t);
+SLIST_HEAD(heap_trace_record_slist, record_links_t);
+
 static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
 static bool tracing;
 static heap_trace_mode_t mode;
 
-/* Buffer used for records, starting at offset 0
+/* Buffer used for records
 */
 static heap_trace_record_t *buffer;
 static size_t total_records;
 
+/* Links of the records, allocated by heap_trace_init_standalone() */
+static record_links_t *links;
+
+/* Records in use, oldest first.
+
+   Records are taken from the list of unused records. When there is
+   none left, the oldest record is reused, so in HEAP_TRACE_ALL mode,
+   where records are never removed, the buffer is used as a ring buffer.
+*/
+static struct heap_trace_record_list records;
+
+/* Records not in use */
+static struct heap_trace_record_list unused;
+
+/* Records of the allocations which weren't freed yet, by address.
+
+   In each bucket, the most recent allocation comes first.
+*/
+static struct heap_trace_record_slist hash_map[HASH_MAP_SIZE];
+
+/* Record returned by the last heap_trace_get() call, and its index.
+
+   Reading the records in order takes constant time per record.
+*/
+static heap_trace_record_t *last_get;
+static size_t last_get_index;
+
 /* Count of entries logged in the buffer.
 
    Maximum total_records
@@ -43,14 +89,47 @@ static size_t total_frees;
 /* Has the buffer overflowed and lost trace entries? */
 static bool has_overflowed = false;
 
+static inline heap_trace_record_t *record_of(record_links_t *l)
+{
+    return &buffer[l - links];
+}
+
+static inline record_links_t *links_of(heap_trace_record_t *rec)
+{
+    return &links[rec - buffer];
+}
+
+static void reset_records(void)
+{
+    TAILQ_INIT(&records);
+    TAILQ_INIT(&unused);
+    for (size_t i = 0; i < total_records; i++) {
+        TAILQ_INSERT_TAIL(&unused, &links[i], tailq);
+    }
+    memset(hash_map, 0, sizeof(hash_map));
+    last_get = NULL;
+}
+
 esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t num_records)
 {
     if (tracing) {
         return ESP_ERR_INVALID_STATE;
     }
+    record_links_t *new_links = NULL;
+    if (num_records > 0) {
+        // used from IRAM functions with the lock held, like the buffer it must be in internal memory
+        new_links = heap_caps_malloc(num_records * sizeof(record_links_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (new_links == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    heap_caps_free(links);
+    links = new_links;
     buffer = record_buffer;
     total_records = num_records;
     memset(buffer, 0, num_records * sizeof(heap_trace_record_t));
+    reset_records();
+    count = 0;
     return ESP_OK;
 }
 
@@ -64,6 +143,8 @@ esp_err_t heap_trace_start(heap_trace_mode_t mode_param)
 
     tracing = false;
     mode = mode_param;
+    memset(buffer, 0, total_records * sizeof(heap_trace_record_t));
+    reset_records();
     count = 0;
     total_allocations = 0;
     total_frees = 0;
@@ -109,7 +190,22 @@ esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record)
     if (index >= count) {
         result = ESP_ERR_INVALID_ARG; /* out of range for 'count' */
     } else {
-        memcpy(record, &buffer[index], sizeof(heap_trace_record_t));
+        /* walk the list from the closest known position */
+        heap_trace_record_t *rec;
+        size_t i;
+        if (last_get != NULL && index >= last_get_index) {
+            rec = last_get;
+            i = last_get_index;
+        } else {
+            rec = record_of(TAILQ_FIRST(&records));
+            i = 0;
+        }
+        for (; i < index; i++) {
+            rec = record_of(TAILQ_NEXT(links_of(rec), tailq));
+        }
+        last_get = rec;
+        last_get_index = index;
+        memcpy(record, rec, sizeof(heap_trace_record_t));
     }
     portEXIT_CRITICAL(&trace_mux);
     return result;
@@ -124,7 +220,11 @@ void heap_trace_dump(void)
            count, total_records);
     size_t start_count = count;
     for (int i = 0; i < count; i++) {
-        heap_trace_record_t *rec = &buffer[i];
+        heap_trace_record_t rec_copy;
+        heap_trace_record_t *rec = &rec_copy;
+        if (heap_trace_get(i, rec) != ESP_OK) {
+            break;
+        }
 
         if (rec->address != NULL) {
             printf("%d bytes (@ %p) allocated CPU %d ccount 0x%08x caller ",
@@ -162,6 +262,31 @@ void heap_trace_dump(void)
     }
 }
 
+static inline struct heap_trace_record_slist *hash_bucket(void *p)
+{
+    /* Fibonacci hashing, heap addresses are at least 4 bytes aligned */
+    return &hash_map[(((uint32_t)(uintptr_t) p >> 2) * 2654435761u) & (HASH_MAP_SIZE - 1)];
+}
+
+/* remove a record from the hash map, if it is there */
+static IRAM_ATTR void hash_map_remove(record_links_t *l)
+{
+    struct heap_trace_record_slist *bucket = hash_bucket(record_of(l)->address);
+    record_links_t *it;
+    record_links_t *prev = NULL;
+    SLIST_FOREACH(it, bucket, slist_hashmap) {
+        if (it == l) {
+            if (prev == NULL) {
+                SLIST_REMOVE_HEAD(bucket, slist_hashmap);
+            } else {
+                SLIST_NEXT(prev, slist_hashmap) = SLIST_NEXT(it, slist_hashmap);
+            }
+            return;
+        }
+        prev = it;
+    }
+}
+
 /* Add a new allocation to the heap trace records */
 static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 {
@@ -171,29 +296,32 @@ static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
 
     portENTER_CRITICAL(&trace_mux);
     if (tracing) {
-        if (count == total_records) {
+        record_links_t *l = TAILQ_FIRST(&unused);
+        if (l != NULL) {
+            TAILQ_REMOVE(&unused, l, tailq);
+            count++;
+        } else {
             has_overflowed = true;
-            /* Move the whole buffer back one slot.
-
-               This is a bit slow, compared to treating this buffer as a ringbuffer and rotating a head pointer.
-
-               However, ringbuffer code gets tricky when we remove elements in mid-buffer (for leak trace mode) while
-               trying to keep track of an item count that may overflow.
-            */
-            memmove(&buffer[0], &buffer[1], sizeof(heap_trace_record_t) * (total_records -1));
-            count--;
+            /* Reuse the oldest record */
+            l = TAILQ_FIRST(&records);
+            TAILQ_REMOVE(&records, l, tailq);
+            hash_map_remove(l);
+            last_get = NULL;
         }
         // Copy new record into place
-        memcpy(&buffer[count], record, sizeof(heap_trace_record_t));
-        count++;
+        heap_trace_record_t *rec = record_of(l);
+        rec->ccount = record->ccount;
+        rec->address = record->address;
+        rec->size = record->size;
+        memcpy(rec->alloced_by, record->alloced_by, sizeof(void *) * STACK_DEPTH);
+        memset(rec->freed_by, 0, sizeof(void *) * STACK_DEPTH);
+        TAILQ_INSERT_TAIL(&records, l, tailq);
+        SLIST_INSERT_HEAD(hash_bucket(rec->address), l, slist_hashmap);
         total_allocations++;
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-// remove a record, used when freeing
-static void remove_record(int index);
-
 /* record a free event in the heap trace log
 
    For HEAP_TRACE_ALL, this means filling in the freed_by pointer.
@@ -208,40 +336,40 @@ static IRAM_ATTR void record_free(void *p, void **callers)
     portENTER_CRITICAL(&trace_mux);
     if (tracing && count > 0) {
         total_frees++;
-        /* search backwards for the allocation record matching this free */
-        int i;
-        for (i = count - 1; i >= 0; i--) {
-            if (buffer[i].address == p) {
+        /* look for the most recent allocation record matching this free */
+        struct heap_trace_record_slist *bucket = hash_bucket(p);
+        record_links_t *l;
+        record_links_t *prev = NULL;
+        SLIST_FOREACH(l, bucket, slist_hashmap) {
+            if (record_of(l)->address == p) {
                 break;
             }
+            prev = l;
         }
 
-        if (i >= 0) {
+        if (l != NULL) {
+            heap_trace_record_t *rec = record_of(l);
+            // The allocation isn't alive anymore, a later free of the same address matches a later allocation
+            if (prev == NULL) {
+                SLIST_REMOVE_HEAD(bucket, slist_hashmap);
+            } else {
+                SLIST_NEXT(prev, slist_hashmap) = SLIST_NEXT(l, slist_hashmap);
+            }
             if (mode == HEAP_TRACE_ALL) {
-                memcpy(buffer[i].freed_by, callers, sizeof(void *) * STACK_DEPTH);
+                memcpy(rec->freed_by, callers, sizeof(void *) * STACK_DEPTH);
             } else { // HEAP_TRACE_LEAKS
                 // Leak trace mode, once an allocation is freed we remove it from the list
-                remove_record(i);
+                TAILQ_REMOVE(&records, l, tailq);
+                memset(rec, 0, sizeof(heap_trace_record_t));
+                TAILQ_INSERT_TAIL(&unused, l, tailq);
+                count--;
+                last_get = NULL;
             }
         }
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-/* remove the entry at 'index' from the ringbuffer of saved records */
-static IRAM_ATTR void remove_record(int index)
-{
-    if (index < count - 1) {
-        // Remove the buffer entry from the list
-        memmove(&buffer[index], &buffer[index+1],
-                sizeof(heap_trace_record_t) * (total_records - index - 1));
-    } else {
-        // For last element, just zero it out to avoid ambiguity
-        memset(&buffer[index], 0, sizeof(heap_trace_record_t));
-    }
-    count--;
-}
-
 #include "heap_trace.inc"
 
 #endif /*CONFIG_HEAP_TRACING_STANDALONE*/
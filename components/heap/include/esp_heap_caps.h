@@ -391,6 +391,26 @@ void heap_caps_dump_all(void);
  */
 size_t heap_caps_get_allocated_size( void *ptr );
 
+/**
+ * @brief Free the blocks held by the small-object caches of all heaps.
+ *
+ * When CONFIG_HEAP_CACHE is enabled, small blocks freed on each core are kept
+ * for the next allocations of the same size on that core. These blocks count
+ * as allocated in heap_caps_get_free_size(), heap_caps_get_info() and the other
+ * heap statistics. Call this function before taking heap statistics, or to give
+ * the memory back to the heaps.
+ *
+ * Does nothing if CONFIG_HEAP_CACHE is disabled.
+ */
+void heap_caps_cache_flush(void);
+
+/**
+ * @brief Return the total size of the blocks held by the small-object caches of all heaps.
+ *
+ * @return Number of bytes, 0 if CONFIG_HEAP_CACHE is disabled.
+ */
+size_t heap_caps_cache_get_size(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "multi_heap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opaque handle to a pool of fixed-size objects
+ */
+typedef struct heap_caps_pool *heap_caps_pool_handle_t;
+
+/**
+ * @brief Create a pool of fixed-size objects in memory which has the given capabilities
+ *
+ * The memory for all the objects is allocated at once, as a single block of a heap
+ * with the given capabilities. Objects are then allocated from the pool and freed
+ * to it in constant time, without any per-object header.
+ *
+ * Objects are at least 4-byte aligned. Objects whose size is a multiple of 8 or 16
+ * bytes are aligned on 8 or 16 bytes.
+ *
+ * @param obj_size Size of each object, in bytes. Rounded up to a multiple of 4 bytes.
+ * @param caps     Bitwise OR of MALLOC_CAP_* flags indicating the type of memory
+ *                 of the objects. MALLOC_CAP_EXEC is not supported.
+ * @param num_objs Number of objects in the pool. The pool doesn't grow.
+ *
+ * @return Handle to the pool, or NULL if the parameters are invalid or there is not
+ *         enough memory.
+ */
+heap_caps_pool_handle_t heap_caps_pool_create(size_t obj_size, uint32_t caps, size_t num_objs);
+
+/**
+ * @brief Delete a pool, and free its memory
+ *
+ * Any object still allocated from the pool must not be used anymore.
+ *
+ * @param pool Handle to the pool, or NULL.
+ */
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Allocate an object from a pool
+ *
+ * @param pool Handle to the pool.
+ *
+ * @return Pointer to the object, or NULL if all the objects of the pool are allocated.
+ */
+void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Allocate an object from a pool, filled with zeros
+ *
+ * @param pool Handle to the pool.
+ *
+ * @return Pointer to the object, or NULL if all the objects of the pool are allocated.
+ */
+void *heap_caps_pool_calloc(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Free an object to the pool it was allocated from
+ *
+ * @note The app will crash with an assertion failure if the pointer is not an
+ *       object of the pool.
+ *
+ * @param pool Handle to the pool.
+ * @param ptr  Pointer to an object allocated from the pool, or NULL.
+ */
+void heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr);
+
+/**
+ * @brief Return the size of the objects of a pool
+ *
+ * @param pool Handle to the pool.
+ *
+ * @return Size of each object, in bytes, after rounding up.
+ */
+size_t heap_caps_pool_get_obj_size(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Get information about a pool
+ *
+ * The fields of the structure have the same meaning as for heap_caps_get_info(),
+ * each object of the pool being a block: total_free_bytes and total_allocated_bytes
+ * are the sizes of the free and allocated objects, largest_free_block is the size
+ * of an object if any is free, minimum_free_bytes is the lowest total_free_bytes
+ * since the pool was created, and allocated_blocks, free_blocks and total_blocks
+ * are numbers of objects.
+ *
+ * @param pool Handle to the pool.
+ * @param info Pointer to a structure which will be filled with relevant
+ *             information about the pool.
+ */
+void heap_caps_pool_get_info(heap_caps_pool_handle_t pool, multi_heap_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !defined(CONFIG_HEAP_PROFILING) && !defined(HEAP_PROFILE_SRCFILE)
+#warning "esp_heap_profile.h is included but heap profiling is disabled in menuconfig"
+#endif
+
+#ifndef CONFIG_HEAP_PROFILING_STACK_DEPTH
+#define CONFIG_HEAP_PROFILING_STACK_DEPTH 1
+#endif
+
+/**
+ * @brief Allocation statistics of a call site
+ *
+ * Only the sampled allocations are counted. With a sample period of N, multiply
+ * count and bytes by N to estimate the totals of the call site.
+ */
+typedef struct {
+    void *callers[CONFIG_HEAP_PROFILING_STACK_DEPTH]; ///< Call stack of the allocations, starting with the caller of the allocation function
+    uint32_t count;             ///< Number of sampled allocations
+    uint64_t bytes;             ///< Total size of the sampled allocations
+    uint32_t live_bytes;        ///< Size of the sampled allocations which weren't freed yet
+    uint32_t peak_live_bytes;   ///< Highest value of live_bytes since profiling started
+} heap_profile_site_t;
+
+/**
+ * @brief Start profiling the allocations
+ *
+ * The statistics of the previous profiling, if any, are cleared. Allocations made
+ * by malloc(), calloc(), realloc(), heap_caps_malloc(), heap_caps_calloc() and
+ * heap_caps_realloc() are then sampled, and aggregated by call site.
+ *
+ * Allocations are sampled at random intervals, one in sample_period on average. The
+ * sampled allocations which are freed before profiling stops are subtracted from the
+ * live bytes of their call site.
+ *
+ * @param sample_period Average number of allocations for each sampled allocation.
+ *                      1 samples every allocation.
+ *
+ * @return
+ *  - ESP_ERR_INVALID_ARG sample_period is 0 or too large
+ *  - ESP_OK Profiling started
+ */
+esp_err_t heap_profile_start(uint32_t sample_period);
+
+/**
+ * @brief Stop profiling the allocations
+ *
+ * The statistics are kept until profiling is started again.
+ *
+ * @return
+ *  - ESP_ERR_INVALID_STATE Profiling was not running
+ *  - ESP_OK Profiling stopped
+ */
+esp_err_t heap_profile_stop(void);
+
+/**
+ * @brief Get the statistics of the call sites
+ *
+ * Call sites are in the order of their first sampled allocation.
+ *
+ * @param sites     Array which will be filled with the statistics of the call sites.
+ * @param max_sites Number of elements of the array.
+ *
+ * @return Number of call sites, which may be larger than max_sites.
+ */
+size_t heap_profile_get_sites(heap_profile_site_t *sites, size_t max_sites);
+
+/**
+ * @brief Print the statistics of the call sites
+ *
+ * Each call site is printed on a line, so that the monitor decodes its call stack.
+ * The output can also be symbolized with components/heap/heap_profile.py.
+ */
+void heap_profile_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -177,6 +177,59 @@ typedef struct {
  */
 void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info);
 
+/** @brief Opaque handle to the small-object cache of a heap */
+typedef struct multi_heap_cache *multi_heap_cache_handle_t;
+
+/** @brief Create a small-object cache in front of a heap
+ *
+ * Small blocks freed through the cache are kept on per-core free lists, one for each of a few size classes, and
+ * returned by the next allocations of the same size class on that core without taking the heap lock. The blocks
+ * held by the cache of each core are limited to MULTI_HEAP_CACHE_SIZE bytes (see multi_heap_config.h).
+ *
+ * The cache itself is allocated in the heap, which must be byte-accessible.
+ *
+ * @param heap Handle to a registered heap.
+ * @return Handle to the cache, or NULL if the allocation failed.
+ */
+multi_heap_cache_handle_t multi_heap_cache_create(multi_heap_handle_t heap);
+
+/** @brief malloc() a buffer in the heap of a cache
+ *
+ * Small sizes are rounded up to their size class and taken from the cache of the current core if possible.
+ * Other sizes are allocated with multi_heap_malloc().
+ *
+ * @param cache Handle to a cache.
+ * @param size Size of desired buffer.
+ *
+ * @return Pointer to new memory, or NULL if allocation fails.
+ */
+void *multi_heap_cache_malloc(multi_heap_cache_handle_t cache, size_t size);
+
+/** @brief free() a buffer in the heap of a cache
+ *
+ * Small blocks are kept in the cache of the current core, unless it is full. Other blocks are freed with
+ * multi_heap_free().
+ *
+ * @param cache Handle to a cache.
+ * @param p NULL, or a pointer previously allocated in the heap of the cache.
+ */
+void multi_heap_cache_free(multi_heap_cache_handle_t cache, void *p);
+
+/** @brief Free all the blocks held by a cache
+ *
+ * Blocks held by a cache count as allocated in multi_heap_get_info() and the other statistics of the heap.
+ *
+ * @param cache Handle to a cache.
+ */
+void multi_heap_cache_flush(multi_heap_cache_handle_t cache);
+
+/** @brief Return the total size of the blocks held by a cache, on all cores
+ *
+ * @param cache Handle to a cache.
+ * @return Number of bytes.
+ */
+size_t multi_heap_cache_get_size(multi_heap_cache_handle_t cache);
+
 #ifdef __cplusplus
 }
 #endif
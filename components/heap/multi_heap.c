@@ -46,6 +46,9 @@ void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size)
 size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
     __attribute__((alias("multi_heap_get_allocated_size_impl")));
 
+size_t multi_heap_get_usable_size(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_get_allocated_size_impl")));
+
 multi_heap_handle_t multi_heap_register(void *start, size_t size)
     __attribute__((alias("multi_heap_register_impl")));
 
@@ -103,6 +106,14 @@ void multi_heap_in_rom_init(void)
     multi_heap_os_funcs_init(&multi_heap_os_funcs);
 }
 
+#ifndef MULTI_HEAP_POISONING
+/* The implementation in ROM has no usable size function, without poisoning it is the size of the block */
+size_t multi_heap_get_usable_size(multi_heap_handle_t heap, void *p)
+{
+    return multi_heap_get_allocated_size(heap, p);
+}
+#endif
+
 #else //#ifndef CONFIG_HEAP_TLSF_USE_ROM_IMPL
 
 /* Return true if this block is free. */
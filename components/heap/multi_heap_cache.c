@@ -0,0 +1,198 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "multi_heap.h"
+#include "multi_heap_internal.h"
+
+/* Note: Keep platform-specific parts in this header, this source
+   file should depend on libc only */
+#include "multi_heap_platform.h"
+
+/* Defines compile-time configuration macros */
+#include "multi_heap_config.h"
+
+/* Small-object cache
+
+   Blocks of a few small size classes which are freed through the cache are
+   pushed on a free list of the current core, linked through their first
+   word, and popped by the next allocations of the same size class on that
+   core. Each core only takes the lock of its own lists, so the cores don't
+   contend with each other, and the TLSF free lists of the heap are not
+   searched.
+
+   Allocations of a cached size are rounded up to the size of their class,
+   so any block of the class fits them. When freed, a block goes to the
+   largest class which fits in its usable size, which is its own class,
+   unless it was allocated without the cache. With heap poisoning, the
+   usable size is the size the block was allocated with, so that the tail
+   canary is never overwritten by a later allocation of the block.
+
+   Cached blocks are still allocated from the point of view of the heap. The
+   blocks held by each core are limited to MULTI_HEAP_CACHE_SIZE bytes, and
+   CACHE_DEPTH blocks for each class, beyond which blocks are freed to the
+   heap.
+*/
+
+#define CACHE_CLASSES 8
+
+/* Maximum number of blocks on each free list */
+#define CACHE_DEPTH 32
+
+static const uint16_t class_size[CACHE_CLASSES] = { 16, 24, 32, 48, 64, 96, 128, 192 };
+
+/* Blocks this big and above are not cached, even if they fit in the largest class */
+#define CACHE_BLOCK_SIZE_MAX 256
+
+typedef struct {
+    multi_heap_lock_t lock;
+    size_t size;                            ///< Total size of the classes of the blocks in the free lists
+    void *free_list[CACHE_CLASSES];
+    uint32_t count[CACHE_CLASSES];
+} cache_slot_t;
+
+typedef struct multi_heap_cache {
+    multi_heap_handle_t heap;
+    cache_slot_t slots[MULTI_HEAP_CACHE_SLOTS];
+} cache_t;
+
+/* Return the smallest class which fits 'size', or -1 if none */
+static inline int alloc_class(size_t size)
+{
+    if (size == 0 || size > class_size[CACHE_CLASSES - 1]) {
+        return -1;
+    }
+    int c = 0;
+    while (class_size[c] < size) {
+        c++;
+    }
+    return c;
+}
+
+/* Return the largest class which fits in a block of 'size' bytes, or -1 if none */
+static inline int free_class(size_t size)
+{
+    if (size < class_size[0] || size >= CACHE_BLOCK_SIZE_MAX) {
+        return -1;
+    }
+    int c = CACHE_CLASSES - 1;
+    while (class_size[c] > size) {
+        c--;
+    }
+    return c;
+}
+
+static inline cache_slot_t *current_slot(cache_t *cache)
+{
+    /* The slot of another core is still protected by its lock, if the
+       task moves to another core after this */
+    return &cache->slots[MULTI_HEAP_CACHE_SLOT()];
+}
+
+multi_heap_cache_handle_t multi_heap_cache_create(multi_heap_handle_t heap)
+{
+    cache_t *cache = multi_heap_malloc(heap, sizeof(cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(cache_t));
+    cache->heap = heap;
+    for (int i = 0; i < MULTI_HEAP_CACHE_SLOTS; i++) {
+        MULTI_HEAP_LOCK_INIT(&cache->slots[i].lock);
+    }
+    return cache;
+}
+
+void *multi_heap_cache_malloc(multi_heap_cache_handle_t cache, size_t size)
+{
+    const int c = alloc_class(size);
+    if (c >= 0) {
+        cache_slot_t *slot = current_slot(cache);
+        MULTI_HEAP_LOCK(&slot->lock);
+        void *p = slot->free_list[c];
+        if (p != NULL) {
+            slot->free_list[c] = *(void **)p;
+            slot->count[c]--;
+            slot->size -= class_size[c];
+        }
+        MULTI_HEAP_UNLOCK(&slot->lock);
+        if (p != NULL) {
+            return p;
+        }
+        size = class_size[c];
+    }
+
+    void *p = multi_heap_malloc(cache->heap, size);
+    if (p == NULL && multi_heap_cache_get_size(cache) > 0) {
+        /* Give the cached blocks back to the heap, they may merge into a block big enough */
+        multi_heap_cache_flush(cache);
+        p = multi_heap_malloc(cache->heap, size);
+    }
+    return p;
+}
+
+void multi_heap_cache_free(multi_heap_cache_handle_t cache, void *p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    const int c = free_class(multi_heap_get_usable_size(cache->heap, p));
+    if (c >= 0) {
+        cache_slot_t *slot = current_slot(cache);
+        bool cached = false;
+        MULTI_HEAP_LOCK(&slot->lock);
+        if (slot->count[c] < CACHE_DEPTH && slot->size + class_size[c] <= MULTI_HEAP_CACHE_SIZE) {
+            *(void **)p = slot->free_list[c];
+            slot->free_list[c] = p;
+            slot->count[c]++;
+            slot->size += class_size[c];
+            cached = true;
+        }
+        MULTI_HEAP_UNLOCK(&slot->lock);
+        if (cached) {
+            return;
+        }
+    }
+    multi_heap_free(cache->heap, p);
+}
+
+void multi_heap_cache_flush(multi_heap_cache_handle_t cache)
+{
+    for (int i = 0; i < MULTI_HEAP_CACHE_SLOTS; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        for (int c = 0; c < CACHE_CLASSES; c++) {
+            MULTI_HEAP_LOCK(&slot->lock);
+            void *p = slot->free_list[c];
+            slot->free_list[c] = NULL;
+            slot->size -= slot->count[c] * class_size[c];
+            slot->count[c] = 0;
+            MULTI_HEAP_UNLOCK(&slot->lock);
+
+            /* Free the blocks outside of the lock of the slot, so that the core it belongs to isn't held up */
+            while (p != NULL) {
+                void *next = *(void **)p;
+                multi_heap_free(cache->heap, p);
+                p = next;
+            }
+        }
+    }
+}
+
+size_t multi_heap_cache_get_size(multi_heap_cache_handle_t cache)
+{
+    size_t size = 0;
+    for (int i = 0; i < MULTI_HEAP_CACHE_SLOTS; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        MULTI_HEAP_LOCK(&slot->lock);
+        size += slot->size;
+        MULTI_HEAP_UNLOCK(&slot->lock);
+    }
+    return size;
+}
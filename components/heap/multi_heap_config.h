@@ -21,3 +21,11 @@
 #define MULTI_HEAP_POISONING
 #define MULTI_HEAP_POISONING_SLOW
 #endif
+
+/* Maximum size of the blocks held by the small-object cache
+   of a heap, for each core */
+#ifdef CONFIG_HEAP_CACHE_SIZE
+#define MULTI_HEAP_CACHE_SIZE CONFIG_HEAP_CACHE_SIZE
+#else
+#define MULTI_HEAP_CACHE_SIZE 2048
+#endif
@@ -49,6 +49,11 @@ size_t multi_heap_minimum_free_size_impl(multi_heap_handle_t heap);
 size_t multi_heap_get_allocated_size_impl(multi_heap_handle_t heap, void *p);
 void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block);
 
+/* Return the number of bytes the caller may use in an allocated block. Unlike
+   multi_heap_get_allocated_size(), this excludes the poisoning overhead and
+   the bytes after the poison tail. */
+size_t multi_heap_get_usable_size(multi_heap_handle_t heap, void *p);
+
 /* Some internal functions for heap poisoning use */
 
 /* Check an allocated block's poison bytes are correct. Called by multi_heap_check(). */
@@ -36,6 +36,10 @@ typedef portMUX_TYPE multi_heap_lock_t;
 
 #define MULTI_HEAP_LOCK_STATIC_INITIALIZER     portMUX_INITIALIZER_UNLOCKED
 
+/* The small-object cache has one set of free lists per core */
+#define MULTI_HEAP_CACHE_SLOTS portNUM_PROCESSORS
+#define MULTI_HEAP_CACHE_SLOT() xPortGetCoreID()
+
 /* Not safe to use std i/o while in a portmux critical section,
    can deadlock, so we use the ROM equivalent functions. */
 
@@ -78,13 +82,44 @@ inline static void multi_heap_assert(bool condition, const char *format, int lin
 #else // MULTI_HEAP_FREERTOS
 
 #include <assert.h>
+#include <pthread.h>
+
+typedef pthread_mutex_t multi_heap_lock_t;
 
 #define MULTI_HEAP_PRINTF printf
 #define MULTI_HEAP_STDERR_PRINTF(MSG, ...) fprintf(stderr, MSG, __VA_ARGS__)
-#define MULTI_HEAP_LOCK(PLOCK)  (void) (PLOCK)
-#define MULTI_HEAP_UNLOCK(PLOCK)  (void) (PLOCK)
-#define MULTI_HEAP_LOCK_INIT(PLOCK)  (void) (PLOCK)
-#define MULTI_HEAP_LOCK_STATIC_INITIALIZER  0
+
+/* Heaps are only locked if a lock was set with multi_heap_set_lock() */
+#define MULTI_HEAP_LOCK(PLOCK) do {                         \
+        if ((PLOCK) != NULL) {                              \
+            pthread_mutex_lock((pthread_mutex_t *)(PLOCK)); \
+        }                                                   \
+    } while(0)
+
+#define MULTI_HEAP_UNLOCK(PLOCK) do {                         \
+        if ((PLOCK) != NULL) {                                \
+            pthread_mutex_unlock((pthread_mutex_t *)(PLOCK)); \
+        }                                                     \
+    } while(0)
+
+#define MULTI_HEAP_LOCK_INIT(PLOCK)  pthread_mutex_init((PLOCK), NULL)
+#define MULTI_HEAP_LOCK_STATIC_INITIALIZER  PTHREAD_MUTEX_INITIALIZER
+
+/* The small-object cache has one set of free lists per thread, threads
+   beyond MULTI_HEAP_CACHE_SLOTS share them */
+#define MULTI_HEAP_CACHE_SLOTS 4
+
+static inline int multi_heap_cache_slot(void)
+{
+    static __thread int slot = -1;
+    static int next_slot;
+    if (slot < 0) {
+        slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED) % MULTI_HEAP_CACHE_SLOTS;
+    }
+    return slot;
+}
+
+#define MULTI_HEAP_CACHE_SLOT() multi_heap_cache_slot()
 
 #define MULTI_HEAP_ASSERT(CONDITION, ADDRESS) assert((CONDITION) && "Heap corrupt")
 
@@ -381,6 +381,14 @@ size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
     return result;
 }
 
+size_t multi_heap_get_usable_size(multi_heap_handle_t heap, void *p)
+{
+    poison_head_t *head = verify_allocated_region(p, true);
+    assert(head != NULL);
+    /* The tail canary follows the requested size, the rest of the block can't be used */
+    return head->alloc_size;
+}
+
 void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
 {
     multi_heap_get_info_impl(heap, info);
@@ -0,0 +1,132 @@
+/*
+ Tests for the pools of fixed-size objects.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_caps_pool.h"
+#include "esp_memory_utils.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "test_utils.h"
+
+#define NUM_OBJS 16
+
+TEST_CASE("Object pool allocates and frees objects", "[heap]")
+{
+    heap_caps_cache_flush();
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(21, MALLOC_CAP_8BIT, NUM_OBJS);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_EQUAL(24, heap_caps_pool_get_obj_size(pool));
+
+    multi_heap_info_t info;
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(NUM_OBJS, info.total_blocks);
+    TEST_ASSERT_EQUAL(NUM_OBJS, info.free_blocks);
+    TEST_ASSERT_EQUAL(NUM_OBJS * 24, info.total_free_bytes);
+    TEST_ASSERT_EQUAL(24, info.largest_free_block);
+
+    uint8_t *objs[NUM_OBJS];
+    for (int i = 0; i < NUM_OBJS; i++) {
+        objs[i] = heap_caps_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(objs[i]);
+        TEST_ASSERT_EQUAL(0, (intptr_t)objs[i] % 4);
+        memset(objs[i], i, 24);
+        for (int j = 0; j < i; j++) {
+            // Objects don't overlap
+            TEST_ASSERT(objs[i] >= objs[j] + 24 || objs[j] >= objs[i] + 24);
+        }
+    }
+    TEST_ASSERT_NULL(heap_caps_pool_alloc(pool));
+
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(NUM_OBJS, info.allocated_blocks);
+    TEST_ASSERT_EQUAL(0, info.free_blocks);
+    TEST_ASSERT_EQUAL(0, info.largest_free_block);
+    TEST_ASSERT_EQUAL(0, info.minimum_free_bytes);
+
+    // Objects weren't overwritten by the allocations of the others
+    for (int i = 0; i < NUM_OBJS; i++) {
+        for (int j = 0; j < 24; j++) {
+            TEST_ASSERT_EQUAL(i, objs[i][j]);
+        }
+    }
+
+    // A freed object is allocated again
+    heap_caps_pool_free(pool, objs[5]);
+    uint8_t *obj = heap_caps_pool_calloc(pool);
+    TEST_ASSERT_EQUAL_PTR(objs[5], obj);
+    for (int j = 0; j < 24; j++) {
+        TEST_ASSERT_EQUAL(0, obj[j]);
+    }
+
+    for (int i = 0; i < NUM_OBJS; i++) {
+        heap_caps_pool_free(pool, objs[i]);
+    }
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(NUM_OBJS, info.free_blocks);
+    TEST_ASSERT_EQUAL(0, info.minimum_free_bytes);
+
+    heap_caps_pool_delete(pool);
+    heap_caps_cache_flush();
+    TEST_ASSERT_EQUAL(free_before, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+TEST_CASE("Object pool aligns objects and checks parameters", "[heap]")
+{
+    TEST_ASSERT_NULL(heap_caps_pool_create(0, MALLOC_CAP_8BIT, NUM_OBJS));
+    TEST_ASSERT_NULL(heap_caps_pool_create(16, MALLOC_CAP_8BIT, 0));
+    TEST_ASSERT_NULL(heap_caps_pool_create(16, MALLOC_CAP_EXEC, NUM_OBJS));
+    TEST_ASSERT_NULL(heap_caps_pool_create(SIZE_MAX / 2, MALLOC_CAP_8BIT, 4));
+    TEST_ASSERT_NULL(heap_caps_pool_create(16, MALLOC_CAP_8BIT, SIZE_MAX / 8));
+
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(48, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA, NUM_OBJS);
+    TEST_ASSERT_NOT_NULL(pool);
+    for (int i = 0; i < NUM_OBJS; i++) {
+        void *obj = heap_caps_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(obj);
+        TEST_ASSERT_EQUAL(0, (intptr_t)obj % 16);
+        TEST_ASSERT(esp_ptr_dma_capable(obj));
+    }
+    heap_caps_pool_delete(pool);
+}
+
+TEST_CASE("Object pool allocation performance", "[heap]")
+{
+    const int iterations = 1000;
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(32, MALLOC_CAP_8BIT, NUM_OBJS);
+    TEST_ASSERT_NOT_NULL(pool);
+    void *objs[NUM_OBJS];
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < NUM_OBJS; j++) {
+            objs[j] = heap_caps_malloc(32, MALLOC_CAP_8BIT);
+        }
+        for (int j = 0; j < NUM_OBJS; j++) {
+            heap_caps_free(objs[j]);
+        }
+    }
+    uint32_t heap_cycles = (esp_cpu_get_cycle_count() - start) / (iterations * NUM_OBJS);
+
+    start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < NUM_OBJS; j++) {
+            objs[j] = heap_caps_pool_alloc(pool);
+        }
+        for (int j = 0; j < NUM_OBJS; j++) {
+            heap_caps_pool_free(pool, objs[j]);
+        }
+    }
+    uint32_t pool_cycles = (esp_cpu_get_cycle_count() - start) / (iterations * NUM_OBJS);
+
+    IDF_LOG_PERFORMANCE("heap_caps_pool_cycles_per_alloc_free", "%u, heap_caps_malloc/free: %u (object size %d)",
+                        pool_cycles, heap_cycles, 32);
+
+    heap_caps_pool_delete(pool);
+}
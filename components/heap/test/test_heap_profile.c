@@ -0,0 +1,114 @@
+/*
+ Tests for the allocation profiler
+
+ Only compiled in if CONFIG_HEAP_PROFILING is set
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "esp_heap_caps.h"
+
+#ifdef CONFIG_HEAP_PROFILING
+
+#include "esp_heap_profile.h"
+
+#define NUM_ALLOCS 10
+
+static void *ptrs[NUM_ALLOCS];
+static heap_profile_site_t sites[CONFIG_HEAP_PROFILING_MAX_SITES];
+
+static __attribute__((noinline)) void profiled_allocs(int n, size_t size)
+{
+    for (int i = 0; i < n; i++) {
+        ptrs[i % NUM_ALLOCS] = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+        if (n > NUM_ALLOCS) {
+            heap_caps_free(ptrs[i % NUM_ALLOCS]);
+        }
+    }
+}
+
+/* Return the call site of profiled_allocs(), or NULL */
+static heap_profile_site_t *find_site(size_t num_sites)
+{
+    for (int i = 0; i < num_sites; i++) {
+        // The call site is in the body of profiled_allocs(), which is small
+        intptr_t offset = (intptr_t)sites[i].callers[0] - (intptr_t)profiled_allocs;
+        if (offset > 0 && offset < 0x100) {
+            return &sites[i];
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("heap profile counts the allocations of a call site", "[heap]")
+{
+    printf("Profiling\n"); // Print something before profiling starts, so that stdout doesn't allocate while profiling
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, heap_profile_start(0));
+    TEST_ASSERT_EQUAL(ESP_OK, heap_profile_start(1));
+    profiled_allocs(NUM_ALLOCS, 100);
+    for (int i = 0; i < 6; i++) {
+        free(ptrs[i]);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, heap_profile_stop());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, heap_profile_stop());
+    for (int i = 6; i < NUM_ALLOCS; i++) {
+        free(ptrs[i]);
+    }
+
+    heap_profile_dump();
+    size_t num_sites = heap_profile_get_sites(sites, CONFIG_HEAP_PROFILING_MAX_SITES);
+    heap_profile_site_t *site = find_site(num_sites);
+    TEST_ASSERT_NOT_NULL(site);
+    TEST_ASSERT_EQUAL(NUM_ALLOCS, site->count);
+    TEST_ASSERT_EQUAL(NUM_ALLOCS * 100, site->bytes);
+    // Frees after profiling stopped are not counted
+    TEST_ASSERT_EQUAL(4 * 100, site->live_bytes);
+    TEST_ASSERT_EQUAL(NUM_ALLOCS * 100, site->peak_live_bytes);
+}
+
+TEST_CASE("heap profile samples the allocations", "[heap]")
+{
+    const int n = 4000;
+    const int period = 8;
+
+    printf("Profiling\n");
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_profile_start(period));
+    profiled_allocs(n, 32);
+    heap_profile_stop();
+
+    size_t num_sites = heap_profile_get_sites(sites, CONFIG_HEAP_PROFILING_MAX_SITES);
+    heap_profile_site_t *site = find_site(num_sites);
+    TEST_ASSERT_NOT_NULL(site);
+    printf("%u of %d allocations sampled\n", site->count, n);
+    TEST_ASSERT_INT_WITHIN(n / period / 4, n / period, site->count);
+    TEST_ASSERT_EQUAL(site->count * 32, site->bytes);
+    TEST_ASSERT_EQUAL(0, site->live_bytes);
+    TEST_ASSERT_EQUAL(32, site->peak_live_bytes);
+}
+
+TEST_CASE("heap profile keeps the allocation of a failed realloc", "[heap]")
+{
+    printf("Profiling\n");
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_profile_start(1));
+    profiled_allocs(1, 100);
+    TEST_ASSERT_NULL(heap_caps_realloc(ptrs[0], SIZE_MAX / 2, MALLOC_CAP_8BIT));
+
+    size_t num_sites = heap_profile_get_sites(sites, CONFIG_HEAP_PROFILING_MAX_SITES);
+    heap_profile_site_t *site = find_site(num_sites);
+    TEST_ASSERT_NOT_NULL(site);
+    TEST_ASSERT_EQUAL(100, site->live_bytes);
+
+    free(ptrs[0]);
+    heap_profile_stop();
+    num_sites = heap_profile_get_sites(sites, CONFIG_HEAP_PROFILING_MAX_SITES);
+    site = find_site(num_sites);
+    TEST_ASSERT_EQUAL(0, site->live_bytes);
+}
+
+#endif
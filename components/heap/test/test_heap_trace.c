@@ -59,9 +59,10 @@ TEST_CASE("heap trace leak check", "[heap]")
     heap_trace_get(0, &trace_b);
     TEST_ASSERT_EQUAL_PTR(b, trace_b.address);
 
-    /* buffer deletes trace_a when freed,
-       so trace_b at head of buffer */
-    TEST_ASSERT_EQUAL_PTR(recs[0].address, trace_b.address);
+    /* buffer deletes trace_a when freed, trace_b stays in place
+       and is now the first record */
+    TEST_ASSERT_EQUAL_PTR(recs[1].address, trace_b.address);
+    TEST_ASSERT_NULL(recs[0].address);
 
     heap_trace_stop();
 }
@@ -123,6 +124,44 @@ TEST_CASE("heap trace wrapped buffer check", "[heap]")
     heap_trace_stop();
 }
 
+TEST_CASE("heap trace all mode wrapped buffer check", "[heap]")
+{
+    const size_t N = 8;
+    heap_trace_record_t recs[N];
+    heap_trace_init_standalone(recs, N);
+
+    heap_trace_start(HEAP_TRACE_ALL);
+
+    void *ptrs[2*N];
+    for (int i = 0; i < 2*N; i++) {
+        ptrs[i] = malloc(i + 1);
+    }
+    for (int i = 0; i < 2*N; i++) {
+        free(ptrs[i]);
+    }
+
+    heap_trace_stop();
+
+    /* the oldest records were overwritten, and the frees matched
+       the latest allocations */
+    TEST_ASSERT_EQUAL(N, heap_trace_get_count());
+    int found = 0;
+    for (int i = 0; i < N; i++) {
+        heap_trace_record_t rec;
+        TEST_ASSERT_EQUAL(ESP_OK, heap_trace_get(i, &rec));
+        for (int j = N; j < 2*N; j++) {
+            if (rec.address == ptrs[j] && rec.size == j + 1) {
+#if CONFIG_HEAP_TRACING_STACK_DEPTH > 0
+                TEST_ASSERT_NOT_NULL(rec.freed_by[0]);
+#endif
+                found++;
+            }
+        }
+    }
+    /* allocations made by the test itself may take some of the records */
+    TEST_ASSERT(found > 0);
+}
+
 static void print_floats_task(void *ignore)
 {
     heap_trace_start(HEAP_TRACE_ALL);
@@ -5,6 +5,11 @@
 
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 /* Insurance against accidentally using libc heap functions in tests */
 #undef free
@@ -523,3 +528,175 @@ TEST_CASE("multi_heap allocation overhead", "[multi_heap]")
 
     multi_heap_free(heap, x);
 }
+
+TEST_CASE("multi_heap small-object cache", "[multi_heap]")
+{
+    uint8_t heapdata[16 * 1024];
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+    multi_heap_cache_handle_t cache = multi_heap_cache_create(heap);
+    REQUIRE( cache != NULL );
+    size_t free_bytes = multi_heap_free_size(heap);
+
+    /* Small sizes are rounded up to their size class */
+    void *a = multi_heap_cache_malloc(cache, 20);
+    REQUIRE( a != NULL );
+    REQUIRE( multi_heap_get_allocated_size(heap, a) >= 24 );
+    memset(a, 0xEE, 24);
+    multi_heap_cache_free(cache, a);
+    REQUIRE( multi_heap_cache_get_size(cache) == 24 );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    /* The next allocation of the same class gets the cached block */
+    void *b = multi_heap_cache_malloc(cache, 24);
+    REQUIRE( b == a );
+    REQUIRE( multi_heap_cache_get_size(cache) == 0 );
+    multi_heap_cache_free(cache, b);
+
+    /* Big blocks aren't cached */
+    void *c = multi_heap_cache_malloc(cache, 1000);
+    REQUIRE( c != NULL );
+    multi_heap_cache_free(cache, c);
+    REQUIRE( multi_heap_cache_get_size(cache) == 24 );
+
+    /* The cache is bounded */
+    void *p[100];
+    for (int i = 0; i < 100; i++) {
+        p[i] = multi_heap_cache_malloc(cache, 16 + (i % 8) * 16);
+        REQUIRE( p[i] != NULL );
+    }
+    for (int i = 0; i < 100; i++) {
+        multi_heap_cache_free(cache, p[i]);
+    }
+    REQUIRE( multi_heap_cache_get_size(cache) > 0 );
+    REQUIRE( multi_heap_cache_get_size(cache) <= MULTI_HEAP_CACHE_SIZE );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    /* Flushing gives all the blocks back to the heap */
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_cache_get_size(cache) == 0 );
+    REQUIRE( multi_heap_free_size(heap) == free_bytes );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    /* A block allocated without the cache goes to a class which fits in the size it can be used with */
+    void *d = multi_heap_malloc(heap, 30);
+    REQUIRE( d != NULL );
+    multi_heap_cache_free(cache, d);
+    size_t class_size = multi_heap_cache_get_size(cache);
+    REQUIRE( class_size >= 24 );
+    REQUIRE( class_size <= 32 );
+    void *e = multi_heap_cache_malloc(cache, class_size);
+    REQUIRE( e == d );
+    memset(e, 0xEE, class_size);
+    REQUIRE( multi_heap_check(heap, true) );
+    multi_heap_cache_free(cache, e);
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_free_size(heap) == free_bytes );
+}
+
+TEST_CASE("multi_heap small-object cache flushes when an allocation fails", "[multi_heap]")
+{
+    uint8_t heapdata[4 * 1024];
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+    multi_heap_cache_handle_t cache = multi_heap_cache_create(heap);
+    REQUIRE( cache != NULL );
+
+    /* Fill the heap with small blocks, then free a few of them to the cache */
+    void *p[256];
+    int n = 0;
+    while (n < 256 && (p[n] = multi_heap_cache_malloc(cache, 32)) != NULL) {
+        n++;
+    }
+    REQUIRE( n > 8 );
+    REQUIRE( n < 256 );
+    for (int i = 0; i < 8; i++) {
+        multi_heap_cache_free(cache, p[i]);
+    }
+    REQUIRE( multi_heap_cache_get_size(cache) == 8 * 32 );
+
+    /* Sizes which aren't cached also flush the cache when they don't fit, the flushed blocks merge to fit them */
+    void *big = multi_heap_cache_malloc(cache, 200);
+    REQUIRE( big != NULL );
+    REQUIRE( multi_heap_cache_get_size(cache) == 0 );
+    multi_heap_cache_free(cache, big);
+    for (int i = 8; i < n; i++) {
+        multi_heap_cache_free(cache, p[i]);
+    }
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_check(heap, true) );
+}
+
+/* Allocate and free batches of small blocks from several threads,
+   with or without a cache in front of the heap */
+static double small_allocs_ns_per_op(multi_heap_handle_t heap, multi_heap_cache_handle_t cache, int num_threads)
+{
+    const int iterations = 20000;
+    const int batch = 8;
+    std::atomic<int> failures(0);
+
+    auto worker = [=, &failures]() {
+        void *p[batch];
+        for (int i = 0; i < iterations; i++) {
+            for (int j = 0; j < batch; j++) {
+                size_t size = 16 + ((i + j) % 8) * 12;
+                p[j] = cache ? multi_heap_cache_malloc(cache, size) : multi_heap_malloc(heap, size);
+                if (p[j] == NULL) {
+                    failures++;
+                    return;
+                }
+                *(volatile uint8_t *)p[j] = j;
+            }
+            for (int j = 0; j < batch; j++) {
+                if (cache) {
+                    multi_heap_cache_free(cache, p[j]);
+                } else {
+                    multi_heap_free(heap, p[j]);
+                }
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE( failures == 0 );
+    return elapsed.count() / ((double)num_threads * iterations * batch * 2);
+}
+
+TEST_CASE("multi_heap small-object cache contention benchmark", "[multi_heap][benchmark]")
+{
+    static uint8_t heapdata[256 * 1024];
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+
+    /* Like on the target, lock the heap for each operation */
+    pthread_mutexattr_t attr;
+    pthread_mutex_t lock;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&lock, &attr);
+    multi_heap_set_lock(heap, &lock);
+
+    multi_heap_cache_handle_t cache = multi_heap_cache_create(heap);
+    REQUIRE( cache != NULL );
+    size_t free_bytes = multi_heap_free_size(heap);
+
+    for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
+        double heap_ns = small_allocs_ns_per_op(heap, NULL, num_threads);
+        double cache_ns = small_allocs_ns_per_op(heap, cache, num_threads);
+        printf("[benchmark] %d thread(s): heap %.1f ns/op, cache %.1f ns/op\n", num_threads, heap_ns, cache_ns);
+        REQUIRE( multi_heap_check(heap, true) );
+    }
+
+    multi_heap_cache_flush(cache);
+    REQUIRE( multi_heap_free_size(heap) == free_bytes );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    multi_heap_set_lock(heap, NULL);
+    pthread_mutex_destroy(&lock);
+    pthread_mutexattr_destroy(&attr);
+}
@@ -1,6 +1,77 @@
 #pragma once
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
 
 void esp_log_impl_lock(void);
 bool esp_log_impl_lock_timeout(void);
 void esp_log_impl_unlock(void);
+
+/* Output using the function set by esp_log_set_vprintf() */
+int esp_log_vprint(const char *format, va_list args);
+
+/* Encoding of log arguments, see log_args.c */
+// Longest conversion specification supported, e.g. "%-+#012.*llx"
+#define ESP_LOG_ARGS_MAX_SPEC 16
+
+typedef enum {
+    ESP_LOG_ARG_NONE,       // "%%", no argument
+    ESP_LOG_ARG_INT,
+    ESP_LOG_ARG_LONG,
+    ESP_LOG_ARG_LLONG,
+    ESP_LOG_ARG_INTMAX,
+    ESP_LOG_ARG_SIZE,
+    ESP_LOG_ARG_PTRDIFF,
+    ESP_LOG_ARG_PTR,
+    ESP_LOG_ARG_STR,
+    ESP_LOG_ARG_DOUBLE,
+    ESP_LOG_ARG_LDOUBLE,
+    ESP_LOG_ARG_INVALID,    // Not supported, e.g. "%n" or "%ls"
+} esp_log_arg_type_t;
+
+typedef struct {
+    const char *start;      // '%' of the specification
+    size_t len;
+    int stars;              // Number of '*' preceding the value
+    bool precision_star;
+    int precision;          // -1 if not given in the format string
+    int length;             // 'h' is -1, 'hh' is -2, 'l' is 1, 'll' is 2, 'L' is 3
+    char conversion;        // e.g. 'd' or 's'
+    esp_log_arg_type_t type;
+} esp_log_arg_spec_t;
+
+/* Parse the conversion specification at 'format', which points to a '%' */
+void esp_log_args_parse_spec(const char *format, esp_log_arg_spec_t *spec);
+
+typedef int (*esp_log_args_print_t)(void *ctx, const char *format, ...);
+/* Returns the size of the encoded arguments, or -1 if they can't be encoded */
+int esp_log_args_encode(const char *format, va_list args, uint8_t *buf, size_t size);
+void esp_log_args_format(const char *format, const uint8_t *buf, size_t size, esp_log_args_print_t print, void *ctx);
+
+#if CONFIG_LOG_ASYNC && !BOOTLOADER_BUILD
+/* Asynchronous logging, see log_async.c */
+#if CONFIG_IDF_TARGET_LINUX || CONFIG_FREERTOS_UNICORE
+#define ESP_LOG_ASYNC_CORES 1
+#else
+#define ESP_LOG_ASYNC_CORES 2
+#endif
+
+/* Returns false if the message has to be output right away */
+bool esp_log_async_write(const char *format, va_list args);
+/* Body of the task which outputs the messages, never returns */
+void esp_log_async_task(void);
+
+/* Whether a message with this format can be queued from the current context */
+bool esp_log_impl_async_ready(const char *format);
+unsigned esp_log_impl_async_core(void);
+void esp_log_impl_async_wait(void);
+void esp_log_impl_async_notify(void);
+void esp_log_impl_async_delay(void);
+#endif
+
+#if CONFIG_LOG_BINARY && !BOOTLOADER_BUILD
+/* Binary logging, see log_binary.c. Returns false if the message has to be output as text */
+bool esp_log_binary_write(const char *format, va_list args);
+#endif
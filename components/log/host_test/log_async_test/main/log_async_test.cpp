@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#define CATCH_CONFIG_MAIN
+#include <cstdio>
+#include <cstring>
+#include <regex>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "esp_log.h"
+
+#include "catch.hpp"
+
+using namespace std;
+
+static const char *TEST_TAG = "test";
+
+struct AsyncPrintFixture {
+    AsyncPrintFixture(chrono::microseconds output_time = chrono::microseconds(0)) : output_time(output_time)
+    {
+        if (instance != nullptr) {
+            throw exception();
+        }
+
+        instance = this;
+
+        esp_log_level_set("*", ESP_LOG_VERBOSE);
+        old_vprintf = esp_log_set_vprintf(print_callback);
+    }
+
+    virtual ~AsyncPrintFixture()
+    {
+        esp_log_async_flush();
+        esp_log_set_vprintf(old_vprintf);
+        esp_log_level_set("*", ESP_LOG_INFO);
+        instance = nullptr;
+    }
+
+    string get_print_buffer_string()
+    {
+        esp_log_async_flush();
+        lock_guard<mutex> lock(buffer_mutex);
+        return print_buffer;
+    }
+
+    size_t calls = 0;
+    thread::id output_thread;
+    atomic<bool> blocked {false};
+
+private:
+    static int print_callback(const char *format, va_list args)
+    {
+        return instance->print_to_buffer(format, args);
+    }
+
+    int print_to_buffer(const char *format, va_list args)
+    {
+        while (blocked) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        // Simulate an output which takes time, e.g. a UART
+        auto end = chrono::steady_clock::now() + output_time;
+        while (chrono::steady_clock::now() < end) {
+        }
+
+        char buffer[512];
+        int ret = vsnprintf(buffer, sizeof(buffer), format, args);
+        lock_guard<mutex> lock(buffer_mutex);
+        print_buffer += buffer;
+        output_thread = this_thread::get_id();
+        calls++;
+        return ret;
+    }
+
+    static AsyncPrintFixture *instance;
+
+    chrono::microseconds output_time;
+    mutex buffer_mutex;
+    string print_buffer;
+    vprintf_like_t old_vprintf;
+};
+
+AsyncPrintFixture *AsyncPrintFixture::instance = nullptr;
+
+TEST_CASE("messages are output by the log task")
+{
+    AsyncPrintFixture fix;
+    const regex test_print("I \\([0-9]*\\) test: info 42 -1 0x1f 2.50 string", regex::ECMAScript);
+
+    char str[] = "string";
+    ESP_LOGI(TEST_TAG, "info %d %ld 0x%x %.2f %s", 42, -1L, 31, 2.5, str);
+    // Arguments are copied when logging
+    strcpy(str, "change");
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+    CHECK(fix.calls == 1);
+}
+
+TEST_CASE("messages are output in order")
+{
+    AsyncPrintFixture fix;
+
+    for (int i = 0; i < 50; i++) {
+        ESP_LOGI(TEST_TAG, "message %d", i);
+    }
+    string output = fix.get_print_buffer_string();
+    size_t pos = 0;
+    for (int i = 0; i < 50; i++) {
+        pos = output.find("test: message " + to_string(i) + "\033", pos);
+        CHECK(pos != string::npos);
+    }
+}
+
+TEST_CASE("messages longer than the line buffer are output entirely")
+{
+    AsyncPrintFixture fix;
+    const regex test_print("test: long +1- +2\033", regex::ECMAScript);
+
+    ESP_LOGI(TEST_TAG, "long %300d-%300d", 1, 2);
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+}
+
+TEST_CASE("messages with large arguments are output right away")
+{
+    AsyncPrintFixture fix;
+    string arg(300, 'a');
+
+    ESP_LOGI(TEST_TAG, "%s", arg.c_str());
+    CHECK(fix.get_print_buffer_string().find(arg) != string::npos);
+    CHECK(fix.output_thread == this_thread::get_id());
+
+    ESP_LOGI(TEST_TAG, "%s", "short");
+    CHECK(fix.get_print_buffer_string().find("short") != string::npos);
+    CHECK(fix.output_thread != this_thread::get_id());
+}
+
+TEST_CASE("messages are dropped when the buffer is full")
+{
+    AsyncPrintFixture fix;
+    const regex test_print("W \\([0-9]*\\) log: [0-9]+ log messages were dropped", regex::ECMAScript);
+    uint32_t dropped = esp_log_async_get_dropped_count();
+
+    // Block the output, so that the buffer fills up
+    fix.blocked = true;
+    for (int i = 0; i < CONFIG_LOG_ASYNC_BUFFER_SIZE; i++) {
+        ESP_LOGI(TEST_TAG, "message %d", i);
+    }
+    fix.blocked = false;
+
+    CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
+    CHECK(esp_log_async_get_dropped_count() > dropped);
+}
+
+TEST_CASE("logging latency benchmark", "[benchmark]")
+{
+    // Output taking 20 us per message, i.e. a 2 Mbaud UART
+    AsyncPrintFixture fix(chrono::microseconds(20));
+    const int MESSAGES = 20000;
+    const int BURST = 32;
+    chrono::duration<double> caller(0);
+    chrono::duration<double> worst(0);
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < MESSAGES; i += BURST) {
+        for (int j = 0; j < BURST; j++) {
+            auto before = chrono::steady_clock::now();
+            ESP_LOGI(TEST_TAG, "benchmark message %d, %s", i + j, "argument");
+            auto elapsed = chrono::steady_clock::now() - before;
+            caller += elapsed;
+            worst = max<chrono::duration<double>>(worst, elapsed);
+        }
+        // Let the output catch up between bursts
+        esp_log_async_flush();
+    }
+    chrono::duration<double> total = chrono::steady_clock::now() - start;
+
+    CHECK(fix.calls >= MESSAGES);
+    printf("caller: %.0f ns per message (max %.0f ns), output: %.0f ns per message\n",
+           caller.count() / MESSAGES * 1e9, worst.count() * 1e9, total.count() / MESSAGES * 1e9);
+}
@@ -7,8 +7,11 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #define CATCH_CONFIG_MAIN
+#include <chrono>
 #include <cstdio>
 #include <regex>
+#include <string>
+#include <vector>
 #include <iostream>
 #include "esp_log.h"
 
@@ -279,3 +282,106 @@ TEST_CASE("changing early log level")
     ESP_EARLY_LOGI(TEST_TAG, "must indeed be printed");
     CHECK(regex_search(fix.get_print_buffer_string(), test_print) == true);
 }
+
+TEST_CASE("level set for a tag applies to all copies of the tag string")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    char tag_copy[] = "test";
+
+    esp_log_level_set(TEST_TAG, ESP_LOG_WARN);
+    CHECK(esp_log_level_get(TEST_TAG) == ESP_LOG_WARN);
+    CHECK(esp_log_level_get(tag_copy) == ESP_LOG_WARN);
+    CHECK(esp_log_level_get("other") == ESP_LOG_INFO);
+
+    esp_log_level_set(tag_copy, ESP_LOG_ERROR);
+    CHECK(esp_log_level_get(TEST_TAG) == ESP_LOG_ERROR);
+    CHECK(esp_log_level_get(tag_copy) == ESP_LOG_ERROR);
+
+    esp_log_level_set("*", ESP_LOG_DEBUG);
+    CHECK(esp_log_level_get(TEST_TAG) == ESP_LOG_DEBUG);
+    CHECK(esp_log_level_get(tag_copy) == ESP_LOG_DEBUG);
+}
+
+TEST_CASE("tag levels are looked up in the cache")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    uint32_t hits, misses;
+
+    // No level set for a specific tag, the cache isn't used
+    ESP_LOGI(TEST_TAG, "info");
+    esp_log_tag_cache_get_stats(&hits, &misses);
+    CHECK(hits == 0);
+    CHECK(misses == 0);
+
+    esp_log_level_set(TEST_TAG, ESP_LOG_WARN);
+    ESP_LOGI(TEST_TAG, "must not be printed");
+    ESP_LOGW(TEST_TAG, "warn");
+    CHECK(esp_log_level_get(TEST_TAG) == ESP_LOG_WARN);
+    esp_log_tag_cache_get_stats(&hits, &misses);
+    CHECK(hits == 2);
+    CHECK(misses == 1);
+    CHECK(fix.get_print_buffer_string().find("must not be printed") == string::npos);
+}
+
+TEST_CASE("levels of many tags")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    const int TAGS = 200;
+    vector<string> tags;
+
+    for (int i = 0; i < TAGS; i++) {
+        tags.push_back("tag" + to_string(i));
+    }
+    for (int i = 0; i < TAGS; i += 2) {
+        esp_log_level_set(tags[i].c_str(), (esp_log_level_t)(i % ESP_LOG_VERBOSE));
+    }
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < TAGS; i++) {
+            CHECK(esp_log_level_get(tags[i].c_str()) == ((i % 2) ? ESP_LOG_INFO : (esp_log_level_t)(i % ESP_LOG_VERBOSE)));
+        }
+    }
+}
+
+static double lookup_time_ns(const vector<string> &tags, int rounds)
+{
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const string &tag : tags) {
+            // Not printed, only the level of the tag is looked up
+            ESP_LOGD(tag.c_str(), "debug");
+        }
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / (rounds * tags.size());
+}
+
+TEST_CASE("tag level lookup benchmark", "[benchmark]")
+{
+    PrintFixture fix(ESP_LOG_INFO);
+    const int ROUNDS = 10000;
+    vector<string> few_tags;
+    vector<string> many_tags;
+    uint32_t hits, misses;
+
+    for (int i = 0; i < 8; i++) {
+        few_tags.push_back("few" + to_string(i));
+    }
+    for (int i = 0; i < 100; i++) {
+        many_tags.push_back("many" + to_string(i));
+    }
+
+    double no_override = lookup_time_ns(few_tags, ROUNDS);
+
+    for (const string &tag : many_tags) {
+        esp_log_level_set(tag.c_str(), ESP_LOG_WARN);
+    }
+    double cached = lookup_time_ns(few_tags, ROUNDS);
+    esp_log_tag_cache_get_stats(&hits, &misses);
+    printf("no level set per tag: %.0f ns per lookup\n", no_override);
+    printf("8 tags, 100 levels set per tag: %.0f ns per lookup, %u hits, %u misses\n", cached, hits, misses);
+    CHECK(misses <= few_tags.size());
+
+    double uncached = lookup_time_ns(many_tags, ROUNDS / 10);
+    esp_log_tag_cache_get_stats(&hits, &misses);
+    printf("100 tags, 100 levels set per tag: %.0f ns per lookup, %u hits, %u misses\n", uncached, hits, misses);
+}
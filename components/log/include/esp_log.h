@@ -70,6 +70,19 @@ void esp_log_level_set(const char* tag, esp_log_level_t level);
  */
 esp_log_level_t esp_log_level_get(const char* tag);
 
+/**
+ * @brief Get statistics of the cache of log levels per tag
+ *
+ * Once a log level was set for a specific tag with esp_log_level_set(),
+ * the level of each tag is looked up in a cache indexed by the address
+ * of the tag string. The statistics are reset when esp_log_level_set()
+ * is called with the "*" tag.
+ *
+ * @param[out] hits Number of lookups of a tag found in the cache, may be NULL
+ * @param[out] misses Number of lookups of a tag not found in the cache, may be NULL
+ */
+void esp_log_tag_cache_get_stats(uint32_t *hits, uint32_t *misses);
+
 /**
  * @brief Set function used to output log entries
  *
@@ -144,6 +157,28 @@ void esp_log_write(esp_log_level_t level, const char* tag, const char* format, .
  */
 void esp_log_writev(esp_log_level_t level, const char* tag, const char* format, va_list args);
 
+#if CONFIG_LOG_ASYNC || __DOXYGEN__
+/**
+ * @brief Wait until the log messages queued so far have been output
+ *
+ * Only available when CONFIG_LOG_ASYNC is enabled. Log messages are queued, then
+ * formatted and output by a separate task. This function blocks until that task
+ * has output the messages queued before the call, e.g. before restarting.
+ *
+ * @note Must not be called from the function set by esp_log_set_vprintf().
+ */
+void esp_log_async_flush(void);
+
+/**
+ * @brief Get the number of log messages dropped because the log buffer was full
+ *
+ * Only available when CONFIG_LOG_ASYNC is enabled.
+ *
+ * @return number of log messages dropped since startup
+ */
+uint32_t esp_log_async_get_dropped_count(void);
+#endif
+
 /** @cond */
 
 #include "esp_log_internal.h"
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -7,25 +7,23 @@
 /*
  * Log library implementation notes.
  *
- * Log library stores all tags provided to esp_log_level_set as a linked
- * list. See uncached_tag_entry_t structure.
+ * Log library stores all tags provided to esp_log_level_set in a hash
+ * table of linked lists, indexed by a hash of the tag string. See
+ * uncached_tag_entry_t structure.
  *
- * To avoid looking up log level for given tag each time message is
- * printed, this library caches pointers to tags. Because the suggested
- * way of creating tags uses one 'TAG' constant per file, this caching
- * should be effective. Cache is a binary min-heap of cached_tag_entry_t
- * items, ordering is done on 'generation' member. In this context,
- * generation is an integer which is incremented each time an operation
- * with cache is performed. When cache is full, new item is inserted in
- * place of an oldest item (that is, with smallest 'generation' value).
- * After that, bubble-down operation is performed to fix ordering in the
- * min-heap.
- *
- * The potential problem with wrap-around of cache generation counter is
- * ignored for now. This will happen if someone happens to output more
- * than 4 billion log entries, at which point wrap-around will not be
- * the biggest problem.
+ * As long as no level was set for a specific tag, which is the common
+ * case, the level of every tag is the default level, and it is read
+ * without taking the lock.
  *
+ * Otherwise, to avoid hashing and comparing the tag string each time a
+ * message is printed, this library caches pointers to tags. Because the
+ * suggested way of creating tags uses one 'TAG' constant per file, this
+ * caching should be effective. The cache is a set-associative table of
+ * cached_tag_entry_t items, indexed by a hash of the tag pointer. Within
+ * a set, the most recently used tags come first, and a new tag replaces
+ * the least recently used one. Tags without a level of their own are
+ * cached along with the default level, so the cache is cleared when the
+ * default level changes.
  */
 
 #include <stdbool.h>
@@ -41,44 +39,42 @@
 #ifndef NDEBUG
 // Enable built-in checks in queue.h in debug builds
 #define INVARIANTS
-// Enable consistency checks and cache statistics in this file.
-#define LOG_BUILTIN_CHECKS
 #endif
 
 #include "sys/queue.h"
 
-// Number of tags to be cached. Must be 2**n - 1, n >= 2.
-#define TAG_CACHE_SIZE 31
+// Number of sets of the tag cache, as a power of two, and number of tags per set.
+#define TAG_CACHE_SETS_LOG2 4
+#define TAG_CACHE_SETS (1 << TAG_CACHE_SETS_LOG2)
+#define TAG_CACHE_WAYS 2
+
+// Number of lists of the hash table of tags. Must be 2**n.
+#define TAG_HASH_SIZE 16
 
 typedef struct {
-    const char *tag;
-    uint32_t level : 3;
-    uint32_t generation : 29;
+    const char *tag;    // NULL if the entry is free
+    uint32_t level;
 } cached_tag_entry_t;
 
 typedef struct uncached_tag_entry_ {
     SLIST_ENTRY(uncached_tag_entry_) entries;
+    uint32_t hash;  // tag_hash() of the tag
     uint8_t level;  // esp_log_level_t as uint8_t
     char tag[0];    // beginning of a zero-terminated string
 } uncached_tag_entry_t;
 
 esp_log_level_t esp_log_default_level = CONFIG_LOG_DEFAULT_LEVEL;
-static SLIST_HEAD(log_tags_head, uncached_tag_entry_) s_log_tags = SLIST_HEAD_INITIALIZER(s_log_tags);
-static cached_tag_entry_t s_log_cache[TAG_CACHE_SIZE];
-static uint32_t s_log_cache_max_generation = 0;
-static uint32_t s_log_cache_entry_count = 0;
-static vprintf_like_t s_log_print_func = &vprintf;
-
-#ifdef LOG_BUILTIN_CHECKS
+static SLIST_HEAD(log_tags_head, uncached_tag_entry_) s_log_tags[TAG_HASH_SIZE];
+static uint32_t s_log_tags_count = 0;   // Read without taking the lock
+static cached_tag_entry_t s_log_cache[TAG_CACHE_SETS][TAG_CACHE_WAYS];
+static uint32_t s_log_cache_hits = 0;
 static uint32_t s_log_cache_misses = 0;
-#endif
+static vprintf_like_t s_log_print_func = &vprintf;
 
 
-static inline bool get_cached_log_level(const char *tag, esp_log_level_t *level);
-static inline bool get_uncached_log_level(const char *tag, esp_log_level_t *level);
-static inline void add_to_cache(const char *tag, esp_log_level_t level);
-static void heap_bubble_down(int index);
-static inline void heap_swap(int i, int j);
+static inline uint32_t tag_hash(const char *tag);
+static inline uncached_tag_entry_t *find_tag(const char *tag, uint32_t hash);
+static inline esp_log_level_t get_log_level(const char *tag);
 static inline bool should_output(esp_log_level_t level_for_message, esp_log_level_t level_for_tag);
 static inline void clear_log_level_list(void);
 
@@ -95,26 +91,21 @@ void esp_log_level_set(const char *tag, esp_log_level_t level)
 {
     esp_log_impl_lock();
 
-    // for wildcard tag, remove all linked list items and clear the cache
+    // for wildcard tag, remove all hash table items and clear the cache
     if (strcmp(tag, "*") == 0) {
-        esp_log_default_level = level;
+        __atomic_store_n(&esp_log_default_level, level, __ATOMIC_RELAXED);
         clear_log_level_list();
         esp_log_impl_unlock();
         return;
     }
 
     // search for existing tag
-    uncached_tag_entry_t *it = NULL;
-    SLIST_FOREACH(it, &s_log_tags, entries) {
-        if (strcmp(it->tag, tag) == 0) {
-            // one tag in the linked list matched, update the level
-            it->level = level;
-            // quit with it != NULL
-            break;
-        }
-    }
-    // no existing tag, append new one
-    if (it == NULL) {
+    const uint32_t hash = tag_hash(tag);
+    uncached_tag_entry_t *it = find_tag(tag, hash);
+    if (it != NULL) {
+        // one tag in the hash table matched, update the level
+        it->level = level;
+    } else {
         // allocate new linked list entry and append it to the head of the list
         size_t tag_len = strlen(tag) + 1;
         size_t entry_size = offsetof(uncached_tag_entry_t, tag) + tag_len;
@@ -123,65 +114,61 @@ void esp_log_level_set(const char *tag, esp_log_level_t level)
             esp_log_impl_unlock();
             return;
         }
+        new_entry->hash = hash;
         new_entry->level = (uint8_t) level;
         memcpy(new_entry->tag, tag, tag_len); // we know the size and strncpy would trigger a compiler warning here
-        SLIST_INSERT_HEAD(&s_log_tags, new_entry, entries);
+        SLIST_INSERT_HEAD(&s_log_tags[hash & (TAG_HASH_SIZE - 1)], new_entry, entries);
+        // From now on, levels are looked up with the lock taken
+        __atomic_store_n(&s_log_tags_count, s_log_tags_count + 1, __ATOMIC_RELEASE);
     }
 
-    // search in the cache and update the entry it if exists
-    for (uint32_t i = 0; i < s_log_cache_entry_count; ++i) {
-#ifdef LOG_BUILTIN_CHECKS
-        assert(i == 0 || s_log_cache[(i - 1) / 2].generation < s_log_cache[i].generation);
-#endif
-        if (strcmp(s_log_cache[i].tag, tag) == 0) {
-            s_log_cache[i].level = level;
-            break;
+    // search in the cache and update the entries of the tag, which may be cached under several pointers
+    for (int i = 0; i < TAG_CACHE_SETS; ++i) {
+        for (int j = 0; j < TAG_CACHE_WAYS && s_log_cache[i][j].tag != NULL; ++j) {
+            if (strcmp(s_log_cache[i][j].tag, tag) == 0) {
+                s_log_cache[i][j].level = level;
+            }
         }
     }
     esp_log_impl_unlock();
 }
 
-
-/* Common code for getting the log level from cache, esp_log_impl_lock()
-   should be called before calling this function. The function unlocks,
-   as indicated in the name.
-*/
-static esp_log_level_t s_log_level_get_and_unlock(const char *tag)
+esp_log_level_t esp_log_level_get(const char *tag)
 {
-    esp_log_level_t level_for_tag;
-    // Look for the tag in cache first, then in the linked list of all tags
-    if (!get_cached_log_level(tag, &level_for_tag)) {
-        if (!get_uncached_log_level(tag, &level_for_tag)) {
-            level_for_tag = esp_log_default_level;
-        }
-        add_to_cache(tag, level_for_tag);
-#ifdef LOG_BUILTIN_CHECKS
-        ++s_log_cache_misses;
-#endif
+    if (__atomic_load_n(&s_log_tags_count, __ATOMIC_ACQUIRE) == 0) {
+        return __atomic_load_n(&esp_log_default_level, __ATOMIC_RELAXED);
     }
+    esp_log_impl_lock();
+    esp_log_level_t level_for_tag = get_log_level(tag);
     esp_log_impl_unlock();
-
     return level_for_tag;
 }
 
-esp_log_level_t esp_log_level_get(const char *tag)
+void esp_log_tag_cache_get_stats(uint32_t *hits, uint32_t *misses)
 {
     esp_log_impl_lock();
-    return s_log_level_get_and_unlock(tag);
+    if (hits) {
+        *hits = s_log_cache_hits;
+    }
+    if (misses) {
+        *misses = s_log_cache_misses;
+    }
+    esp_log_impl_unlock();
 }
 
 void clear_log_level_list(void)
 {
-    uncached_tag_entry_t *it;
-    while ((it = SLIST_FIRST(&s_log_tags)) != NULL) {
-        SLIST_REMOVE_HEAD(&s_log_tags, entries);
-        free(it);
+    for (int i = 0; i < TAG_HASH_SIZE; ++i) {
+        uncached_tag_entry_t *it;
+        while ((it = SLIST_FIRST(&s_log_tags[i])) != NULL) {
+            SLIST_REMOVE_HEAD(&s_log_tags[i], entries);
+            free(it);
+        }
     }
-    s_log_cache_entry_count = 0;
-    s_log_cache_max_generation = 0;
-#ifdef LOG_BUILTIN_CHECKS
+    __atomic_store_n(&s_log_tags_count, 0, __ATOMIC_RELEASE);
+    memset(s_log_cache, 0, sizeof(s_log_cache));
+    s_log_cache_hits = 0;
     s_log_cache_misses = 0;
-#endif
 }
 
 void esp_log_writev(esp_log_level_t level,
@@ -189,18 +176,42 @@ void esp_log_writev(esp_log_level_t level,
                    const char *format,
                    va_list args)
 {
-    if (!esp_log_impl_lock_timeout()) {
-        return;
+    esp_log_level_t level_for_tag;
+    if (__atomic_load_n(&s_log_tags_count, __ATOMIC_ACQUIRE) == 0) {
+        // No level was set for a specific tag, the lock isn't needed
+        level_for_tag = __atomic_load_n(&esp_log_default_level, __ATOMIC_RELAXED);
+    } else {
+        if (!esp_log_impl_lock_timeout()) {
+            return;
+        }
+        level_for_tag = get_log_level(tag);
+        esp_log_impl_unlock();
     }
-    esp_log_level_t level_for_tag = s_log_level_get_and_unlock(tag);
     if (!should_output(level, level_for_tag)) {
         return;
     }
 
+#if CONFIG_LOG_ASYNC && !BOOTLOADER_BUILD
+    if (esp_log_async_write(format, args)) {
+        return;
+    }
+#endif
+
+#if CONFIG_LOG_BINARY && !BOOTLOADER_BUILD
+    if (esp_log_binary_write(format, args)) {
+        return;
+    }
+#endif
+
     (*s_log_print_func)(format, args);
 
 }
 
+int esp_log_vprint(const char *format, va_list args)
+{
+    return (*s_log_print_func)(format, args);
+}
+
 void esp_log_write(esp_log_level_t level,
                    const char *tag,
                    const char *format, ...)
@@ -211,97 +222,60 @@ void esp_log_write(esp_log_level_t level,
     va_end(list);
 }
 
-static inline bool get_cached_log_level(const char *tag, esp_log_level_t *level)
-{
-    // Look for `tag` in cache
-    uint32_t i;
-    for (i = 0; i < s_log_cache_entry_count; ++i) {
-#ifdef LOG_BUILTIN_CHECKS
-        assert(i == 0 || s_log_cache[(i - 1) / 2].generation < s_log_cache[i].generation);
-#endif
-        if (s_log_cache[i].tag == tag) {
-            break;
-        }
-    }
-    if (i == s_log_cache_entry_count) { // Not found in cache
-        return false;
-    }
-    // Return level from cache
-    *level = (esp_log_level_t) s_log_cache[i].level;
-    // If cache has been filled, start taking ordering into account
-    // (other options are: dynamically resize cache, add "dummy" entries
-    //  to the cache; this option was chosen because code is much simpler,
-    //  and the unfair behavior of cache will show it self at most once, when
-    //  it has just been filled)
-    if (s_log_cache_entry_count == TAG_CACHE_SIZE) {
-        // Update item generation
-        s_log_cache[i].generation = s_log_cache_max_generation++;
-        // Restore heap ordering
-        heap_bubble_down(i);
-    }
-    return true;
-}
-
-static inline void add_to_cache(const char *tag, esp_log_level_t level)
+static inline uint32_t tag_hash(const char *tag)
 {
-    uint32_t generation = s_log_cache_max_generation++;
-    // First consider the case when cache is not filled yet.
-    // In this case, just add new entry at the end.
-    // This happens to satisfy binary min-heap ordering.
-    if (s_log_cache_entry_count < TAG_CACHE_SIZE) {
-        s_log_cache[s_log_cache_entry_count] = (cached_tag_entry_t) {
-            .generation = generation,
-            .level = level,
-            .tag = tag
-        };
-        ++s_log_cache_entry_count;
-        return;
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*tag) {
+        hash = (hash ^ (uint8_t) *tag++) * 16777619u;
     }
-
-    // Cache is full, so we replace the oldest entry (which is at index 0
-    // because this is a min-heap) with the new one, and do bubble-down
-    // operation to restore min-heap ordering.
-    s_log_cache[0] = (cached_tag_entry_t) {
-        .tag = tag,
-        .level = level,
-        .generation = generation
-    };
-    heap_bubble_down(0);
+    return hash;
 }
 
-static inline bool get_uncached_log_level(const char *tag, esp_log_level_t *level)
+static inline uncached_tag_entry_t *find_tag(const char *tag, uint32_t hash)
 {
-    // Walk the linked list of all tags and see if given tag is present in the list.
-    // This is slow because tags are compared as strings.
+    // Only the tags with the same hash are compared as strings
     uncached_tag_entry_t *it;
-    SLIST_FOREACH(it, &s_log_tags, entries) {
-        if (strcmp(tag, it->tag) == 0) {
-            *level = it->level;
-            return true;
+    SLIST_FOREACH(it, &s_log_tags[hash & (TAG_HASH_SIZE - 1)], entries) {
+        if (it->hash == hash && strcmp(tag, it->tag) == 0) {
+            return it;
         }
     }
-    return false;
+    return NULL;
 }
 
-static inline bool should_output(esp_log_level_t level_for_message, esp_log_level_t level_for_tag)
+/* Get the log level of the tag, esp_log_impl_lock() should be called before calling this function */
+static inline esp_log_level_t get_log_level(const char *tag)
 {
-    return level_for_message <= level_for_tag;
-}
+    // Fibonacci hashing of the tag pointer
+    cached_tag_entry_t *set = s_log_cache[((uint32_t)(uintptr_t) tag * 2654435761u) >> (32 - TAG_CACHE_SETS_LOG2)];
+    cached_tag_entry_t entry;
+    int i;
 
-static void heap_bubble_down(int index)
-{
-    while (index < TAG_CACHE_SIZE / 2) {
-        int left_index = index * 2 + 1;
-        int right_index = left_index + 1;
-        int next = (s_log_cache[left_index].generation < s_log_cache[right_index].generation) ? left_index : right_index;
-        heap_swap(index, next);
-        index = next;
+    for (i = 0; i < TAG_CACHE_WAYS - 1; ++i) {
+        if (set[i].tag == tag || set[i].tag == NULL) {
+            break;
+        }
+    }
+    if (set[i].tag == tag) {
+        ++s_log_cache_hits;
+        entry = set[i];
+    } else {
+        // Not found in cache, evict the least recently used tag of the set
+        ++s_log_cache_misses;
+        uncached_tag_entry_t *it = find_tag(tag, tag_hash(tag));
+        entry = (cached_tag_entry_t) {
+            .tag = tag,
+            .level = it ? it->level : __atomic_load_n(&esp_log_default_level, __ATOMIC_RELAXED),
+        };
     }
+    // Move the tag to the front of the set
+    memmove(&set[1], &set[0], i * sizeof(cached_tag_entry_t));
+    set[0] = entry;
+    return (esp_log_level_t) entry.level;
 }
 
-static inline void heap_swap(int i, int j)
+static inline bool should_output(esp_log_level_t level_for_message, esp_log_level_t level_for_tag)
 {
-    cached_tag_entry_t tmp = s_log_cache[i];
-    s_log_cache[i] = s_log_cache[j];
-    s_log_cache[j] = tmp;
+    return level_for_message <= level_for_tag;
 }
@@ -0,0 +1,333 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Encoding of the arguments of log messages which are not formatted right away.
+ *
+ * Arguments are stored in the order of the conversion specifications of the
+ * format string, each one with the size of the type it is passed as, without
+ * any padding. Width and precision given as '*' are stored as int before the
+ * value they apply to. Strings are copied up to the precision, if any, and
+ * stored with a terminating null character, so that the encoded arguments
+ * don't refer to memory owned by the caller anymore.
+ *
+ * The format string is walked again to decode the arguments when the message
+ * is output.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_log_private.h"
+
+/* Parse the conversion specification at 'format', which points to a '%' */
+void esp_log_args_parse_spec(const char *format, esp_log_arg_spec_t *spec)
+{
+    const char *p = format + 1;
+    int length = 0;
+
+    *spec = (esp_log_arg_spec_t) {
+        .start = format,
+        .precision = -1,
+        .type = ESP_LOG_ARG_INVALID,
+    };
+
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            spec->precision_star = true;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                spec->precision = spec->precision * 10 + (*p++ - '0');
+            }
+        }
+    }
+
+    esp_log_arg_type_t int_type = ESP_LOG_ARG_INT;
+    switch (*p) {
+    case 'h':
+        p++;
+        length = -1;
+        if (*p == 'h') {
+            p++;
+            length = -2;
+        }
+        break;
+    case 'l':
+        p++;
+        length = 1;
+        int_type = ESP_LOG_ARG_LONG;
+        if (*p == 'l') {
+            p++;
+            length = 2;
+            int_type = ESP_LOG_ARG_LLONG;
+        }
+        break;
+    case 'q':
+        p++;
+        length = 2;
+        int_type = ESP_LOG_ARG_LLONG;
+        break;
+    case 'j':
+        p++;
+        length = 1;
+        int_type = ESP_LOG_ARG_INTMAX;
+        break;
+    case 'z':
+        p++;
+        length = 1;
+        int_type = ESP_LOG_ARG_SIZE;
+        break;
+    case 't':
+        p++;
+        length = 1;
+        int_type = ESP_LOG_ARG_PTRDIFF;
+        break;
+    case 'L':
+        p++;
+        length = 3;
+        break;
+    default:
+        break;
+    }
+
+    switch (*p) {
+    case '%':
+        spec->type = (p == format + 1) ? ESP_LOG_ARG_NONE : ESP_LOG_ARG_INVALID;
+        break;
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        spec->type = (length == 3) ? ESP_LOG_ARG_INVALID : int_type;
+        break;
+    case 'c':
+        // wint_t is promoted to int, like char
+        spec->type = (length <= 1) ? ESP_LOG_ARG_INT : ESP_LOG_ARG_INVALID;
+        break;
+    case 'p':
+        spec->type = (length == 0) ? ESP_LOG_ARG_PTR : ESP_LOG_ARG_INVALID;
+        break;
+    case 's':
+        spec->type = (length == 0) ? ESP_LOG_ARG_STR : ESP_LOG_ARG_INVALID;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec->type = (length == 3) ? ESP_LOG_ARG_LDOUBLE : (length <= 1) ? ESP_LOG_ARG_DOUBLE : ESP_LOG_ARG_INVALID;
+        break;
+    default:
+        break;
+    }
+
+    spec->length = length;
+    spec->conversion = *p;
+    spec->len = (*p) ? (size_t)(p + 1 - format) : (size_t)(p - format);
+    if (spec->len >= ESP_LOG_ARGS_MAX_SPEC) {
+        spec->type = ESP_LOG_ARG_INVALID;
+    }
+}
+
+#define ENCODE_ARG(type) do {                \
+        type v = va_arg(args, type);         \
+        if (sizeof(v) > (size_t)(end - p)) { \
+            return -1;                       \
+        }                                    \
+        memcpy(p, &v, sizeof(v));            \
+        p += sizeof(v);                      \
+    } while (0)
+
+int esp_log_args_encode(const char *format, va_list args, uint8_t *buf, size_t size)
+{
+    uint8_t *p = buf;
+    uint8_t *const end = buf + size;
+    esp_log_arg_spec_t spec;
+
+    for (format = strchr(format, '%'); format != NULL; format = strchr(format + spec.len, '%')) {
+        esp_log_args_parse_spec(format, &spec);
+        if (spec.type == ESP_LOG_ARG_INVALID) {
+            return -1;
+        }
+
+        int precision = spec.precision;
+        for (int i = 0; i < spec.stars; i++) {
+            int v = va_arg(args, int);
+            if (sizeof(v) > (size_t)(end - p)) {
+                return -1;
+            }
+            memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+            if (spec.precision_star && i == spec.stars - 1) {
+                precision = v;
+            }
+        }
+
+        switch (spec.type) {
+        case ESP_LOG_ARG_INT:
+            ENCODE_ARG(int);
+            break;
+        case ESP_LOG_ARG_LONG:
+            ENCODE_ARG(long);
+            break;
+        case ESP_LOG_ARG_LLONG:
+            ENCODE_ARG(long long);
+            break;
+        case ESP_LOG_ARG_INTMAX:
+            ENCODE_ARG(intmax_t);
+            break;
+        case ESP_LOG_ARG_SIZE:
+            ENCODE_ARG(size_t);
+            break;
+        case ESP_LOG_ARG_PTRDIFF:
+            ENCODE_ARG(ptrdiff_t);
+            break;
+        case ESP_LOG_ARG_PTR:
+            ENCODE_ARG(void *);
+            break;
+        case ESP_LOG_ARG_DOUBLE:
+            ENCODE_ARG(double);
+            break;
+        case ESP_LOG_ARG_LDOUBLE:
+            ENCODE_ARG(long double);
+            break;
+        case ESP_LOG_ARG_STR: {
+            const char *s = va_arg(args, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            // A negative precision is taken as if it was omitted
+            size_t len = (precision >= 0) ? strnlen(s, precision) : strlen(s);
+            if (len + 1 > (size_t)(end - p)) {
+                return -1;
+            }
+            memcpy(p, s, len);
+            p[len] = '\0';
+            p += len + 1;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return p - buf;
+}
+
+#define FORMAT_ARG(type) do {                            \
+        type v;                                          \
+        if (sizeof(v) > (size_t)(end - p)) {             \
+            return;                                      \
+        }                                                \
+        memcpy(&v, p, sizeof(v));                        \
+        p += sizeof(v);                                  \
+        if (spec.stars == 0) {                           \
+            print(ctx, spec_str, v);                     \
+        } else if (spec.stars == 1) {                    \
+            print(ctx, spec_str, stars[0], v);           \
+        } else {                                         \
+            print(ctx, spec_str, stars[0], stars[1], v); \
+        }                                                \
+    } while (0)
+
+void esp_log_args_format(const char *format, const uint8_t *buf, size_t size, esp_log_args_print_t print, void *ctx)
+{
+    const uint8_t *p = buf;
+    const uint8_t *const end = buf + size;
+    esp_log_arg_spec_t spec;
+    char spec_str[ESP_LOG_ARGS_MAX_SPEC];
+    int stars[2];
+
+    while (*format) {
+        const char *next = strchr(format, '%');
+        if (next == NULL) {
+            next = format + strlen(format);
+        }
+        if (next != format) {
+            print(ctx, "%.*s", (int)(next - format), format);
+        }
+        if (*next == '\0') {
+            return;
+        }
+
+        esp_log_args_parse_spec(next, &spec);
+        format = next + spec.len;
+        if (spec.type == ESP_LOG_ARG_INVALID) {
+            // Not encoded either, give up on the rest of the message
+            return;
+        }
+        if (spec.type == ESP_LOG_ARG_NONE) {
+            print(ctx, "%%");
+            continue;
+        }
+
+        for (int i = 0; i < spec.stars; i++) {
+            if (sizeof(int) > (size_t)(end - p)) {
+                return;
+            }
+            memcpy(&stars[i], p, sizeof(int));
+            p += sizeof(int);
+        }
+        memcpy(spec_str, spec.start, spec.len);
+        spec_str[spec.len] = '\0';
+
+        switch (spec.type) {
+        case ESP_LOG_ARG_INT:
+            FORMAT_ARG(int);
+            break;
+        case ESP_LOG_ARG_LONG:
+            FORMAT_ARG(long);
+            break;
+        case ESP_LOG_ARG_LLONG:
+            FORMAT_ARG(long long);
+            break;
+        case ESP_LOG_ARG_INTMAX:
+            FORMAT_ARG(intmax_t);
+            break;
+        case ESP_LOG_ARG_SIZE:
+            FORMAT_ARG(size_t);
+            break;
+        case ESP_LOG_ARG_PTRDIFF:
+            FORMAT_ARG(ptrdiff_t);
+            break;
+        case ESP_LOG_ARG_PTR:
+            FORMAT_ARG(void *);
+            break;
+        case ESP_LOG_ARG_DOUBLE:
+            FORMAT_ARG(double);
+            break;
+        case ESP_LOG_ARG_LDOUBLE:
+            FORMAT_ARG(long double);
+            break;
+        case ESP_LOG_ARG_STR: {
+            const char *s = (const char *) p;
+            size_t len = strnlen(s, end - p);
+            if (len == (size_t)(end - p)) {
+                return;
+            }
+            p += len + 1;
+            if (spec.stars == 0) {
+                print(ctx, spec_str, s);
+            } else if (spec.stars == 1) {
+                print(ctx, spec_str, stars[0], s);
+            } else {
+                print(ctx, spec_str, stars[0], stars[1], s);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,273 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Asynchronous logging.
+ *
+ * Instead of being formatted and output by the caller, log messages are
+ * queued as a record holding the format string pointer and the encoded
+ * arguments (see log_args.c), which include the timestamp and the tag. A
+ * low priority task formats and outputs the records later.
+ *
+ * Each core has its own ring buffer, so that logging on one core doesn't
+ * contend with logging on the other. Producers reserve space in the ring by
+ * advancing 'head' with a compare-and-swap, fill in their record, and then
+ * mark it as committed. The output task is the only consumer: it takes the
+ * committed records in order from 'tail', zeroes their space and advances
+ * 'tail'. As the space is zeroed before it is reused, a record which is
+ * reserved but not committed yet is seen as free, and the consumer waits for
+ * it. When a record doesn't fit before the end of the buffer, the rest of
+ * the buffer is reserved along with it, as a padding record.
+ *
+ * When a ring is full, messages are dropped and counted.
+ */
+
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_log_private.h"
+
+#define LOG_ASYNC_BUFFER_SIZE CONFIG_LOG_ASYNC_BUFFER_SIZE
+
+_Static_assert((LOG_ASYNC_BUFFER_SIZE & (LOG_ASYNC_BUFFER_SIZE - 1)) == 0, "CONFIG_LOG_ASYNC_BUFFER_SIZE must be a power of two");
+
+// Maximum size of the encoded arguments of a message. Messages with larger arguments are output synchronously.
+#define LOG_ASYNC_MAX_ARGS_SIZE 192
+
+// Size of the buffer used to format a message. Longer messages are output in several pieces.
+#define LOG_ASYNC_LINE_SIZE 256
+
+#define LOG_RECORD_ALIGN 8
+
+typedef enum {
+    LOG_RECORD_FREE = 0,
+    LOG_RECORD_MESSAGE,
+    LOG_RECORD_PADDING,
+} log_record_state_t;
+
+typedef struct {
+    uint16_t size;          // Size of the record, including this header
+    uint16_t args_size;
+    uint32_t state;         // log_record_state_t, written last by the producer
+    const char *format;
+    uint8_t args[];
+} log_record_t;
+
+_Static_assert(offsetof(log_record_t, format) == LOG_RECORD_ALIGN, "padding records only have the header");
+
+typedef struct {
+    uint32_t head;          // Reserved up to here, by the producers
+    uint32_t tail;          // Consumed up to here, by the output task
+    uint8_t buf[LOG_ASYNC_BUFFER_SIZE] __attribute__((aligned(LOG_RECORD_ALIGN)));
+} log_async_ring_t;
+
+typedef struct {
+    char buf[LOG_ASYNC_LINE_SIZE];
+    size_t len;
+} log_async_line_t;
+
+static const char *TAG = "log";
+
+static log_async_ring_t s_log_async_rings[ESP_LOG_ASYNC_CORES];
+static uint32_t s_log_async_dropped;
+static uint32_t s_log_async_dropped_reported;
+static bool s_log_async_idle;
+
+static inline log_record_t *ring_record(log_async_ring_t *ring, uint32_t pos)
+{
+    return (log_record_t *) &ring->buf[pos & (LOG_ASYNC_BUFFER_SIZE - 1)];
+}
+
+bool esp_log_async_write(const char *format, va_list args)
+{
+    if (!esp_log_impl_async_ready(format)) {
+        return false;
+    }
+
+    uint8_t args_buf[LOG_ASYNC_MAX_ARGS_SIZE];
+    va_list copy;
+    va_copy(copy, args);
+    int args_size = esp_log_args_encode(format, copy, args_buf, sizeof(args_buf));
+    va_end(copy);
+    if (args_size < 0) {
+        return false;
+    }
+
+    const uint32_t size = (offsetof(log_record_t, args) + args_size + LOG_RECORD_ALIGN - 1) & ~(LOG_RECORD_ALIGN - 1);
+    log_async_ring_t *ring = &s_log_async_rings[esp_log_impl_async_core()];
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t padding;
+    do {
+        const uint32_t offset = head & (LOG_ASYNC_BUFFER_SIZE - 1);
+        padding = (LOG_ASYNC_BUFFER_SIZE - offset < size) ? LOG_ASYNC_BUFFER_SIZE - offset : 0;
+        // Acquire the space zeroed by the output task
+        if (head + padding + size - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > LOG_ASYNC_BUFFER_SIZE) {
+            __atomic_fetch_add(&s_log_async_dropped, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+    } while (!__atomic_compare_exchange_n(&ring->head, &head, head + padding + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (padding) {
+        log_record_t *record = ring_record(ring, head);
+        record->size = padding;
+        __atomic_store_n(&record->state, LOG_RECORD_PADDING, __ATOMIC_SEQ_CST);
+    }
+
+    log_record_t *record = ring_record(ring, head + padding);
+    record->size = size;
+    record->args_size = args_size;
+    record->format = format;
+    memcpy(record->args, args_buf, args_size);
+    __atomic_store_n(&record->state, LOG_RECORD_MESSAGE, __ATOMIC_SEQ_CST);
+
+    if (__atomic_exchange_n(&s_log_async_idle, false, __ATOMIC_SEQ_CST)) {
+        esp_log_impl_async_notify();
+    }
+    return true;
+}
+
+static int log_print(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = esp_log_vprint(format, args);
+    va_end(args);
+    return len;
+}
+
+static void line_flush(log_async_line_t *line)
+{
+    if (line->len) {
+        line->buf[line->len] = '\0';
+        line->len = 0;
+        log_print("%s", line->buf);
+    }
+}
+
+static int line_printf(void *ctx, const char *format, ...)
+{
+    log_async_line_t *line = (log_async_line_t *) ctx;
+    va_list args;
+    va_list copy;
+
+    va_start(args, format);
+    va_copy(copy, args);
+    const size_t room = sizeof(line->buf) - line->len;
+    int len = vsnprintf(line->buf + line->len, room, format, args);
+    if (len >= 0 && (size_t) len < room) {
+        line->len += len;
+    } else if (len >= 0) {
+        // Doesn't fit after the text formatted so far, output that text first
+        line_flush(line);
+        if ((size_t) len < sizeof(line->buf)) {
+            line->len = vsnprintf(line->buf, sizeof(line->buf), format, copy);
+        } else {
+            esp_log_vprint(format, copy);
+        }
+    }
+    va_end(copy);
+    va_end(args);
+    return len;
+}
+
+/* Whether the output task has committed records to process */
+static bool log_async_pending(void)
+{
+    for (int i = 0; i < ESP_LOG_ASYNC_CORES; i++) {
+        log_async_ring_t *ring = &s_log_async_rings[i];
+        uint32_t tail = ring->tail;
+        if (tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) &&
+                __atomic_load_n(&ring_record(ring, tail)->state, __ATOMIC_SEQ_CST) != LOG_RECORD_FREE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void log_async_drain(log_async_line_t *line)
+{
+    for (int i = 0; i < ESP_LOG_ASYNC_CORES; i++) {
+        log_async_ring_t *ring = &s_log_async_rings[i];
+        uint32_t tail = ring->tail;
+        while (tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+            log_record_t *record = ring_record(ring, tail);
+            uint32_t state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+            if (state == LOG_RECORD_FREE) {
+                // Reserved, but not committed yet
+                break;
+            }
+            const uint32_t size = record->size;
+            if (state == LOG_RECORD_MESSAGE) {
+                esp_log_args_format(record->format, record->args, record->args_size, line_printf, line);
+                line_flush(line);
+            }
+            // Producers see records reserved after this one as free, until they commit them
+            memset(record, 0, size);
+            tail += size;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+void esp_log_async_task(void)
+{
+    static log_async_line_t line;
+
+    while (true) {
+        log_async_drain(&line);
+
+        const uint32_t reported = s_log_async_dropped_reported;
+        const uint32_t dropped = __atomic_load_n(&s_log_async_dropped, __ATOMIC_RELAXED);
+        if (dropped != reported) {
+            log_print(LOG_FORMAT(W, "%" PRIu32 " log messages were dropped"), esp_log_timestamp(), TAG, dropped - reported);
+            __atomic_store_n(&s_log_async_dropped_reported, dropped, __ATOMIC_RELEASE);
+        }
+
+        // Producers notify the task only once it has checked for records for the last time
+        __atomic_store_n(&s_log_async_idle, true, __ATOMIC_SEQ_CST);
+        if (log_async_pending()) {
+            __atomic_store_n(&s_log_async_idle, false, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        esp_log_impl_async_wait();
+    }
+}
+
+static bool log_async_flushed(const uint32_t *heads, uint32_t dropped)
+{
+    for (int i = 0; i < ESP_LOG_ASYNC_CORES; i++) {
+        // Head and tail wrap around, check that the tail went past the messages queued before
+        if ((int32_t)(heads[i] - __atomic_load_n(&s_log_async_rings[i].tail, __ATOMIC_ACQUIRE)) > 0) {
+            return false;
+        }
+    }
+    return (int32_t)(dropped - __atomic_load_n(&s_log_async_dropped_reported, __ATOMIC_ACQUIRE)) <= 0;
+}
+
+void esp_log_async_flush(void)
+{
+    uint32_t heads[ESP_LOG_ASYNC_CORES];
+    for (int i = 0; i < ESP_LOG_ASYNC_CORES; i++) {
+        heads[i] = __atomic_load_n(&s_log_async_rings[i].head, __ATOMIC_ACQUIRE);
+    }
+    const uint32_t dropped = __atomic_load_n(&s_log_async_dropped, __ATOMIC_RELAXED);
+
+    while (!log_async_flushed(heads, dropped)) {
+        if (__atomic_exchange_n(&s_log_async_idle, false, __ATOMIC_SEQ_CST)) {
+            esp_log_impl_async_notify();
+        }
+        esp_log_impl_async_delay();
+    }
+}
+
+uint32_t esp_log_async_get_dropped_count(void)
+{
+    return __atomic_load_n(&s_log_async_dropped, __ATOMIC_RELAXED);
+}
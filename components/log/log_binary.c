@@ -0,0 +1,271 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Binary logging.
+ *
+ * Instead of being formatted, log messages are output as a frame holding the
+ * address of the format string and the arguments. idf_monitor decodes the
+ * frames and formats the messages, using the format strings found in the ELF
+ * file of the application (see tools/idf_monitor_base/binary_log.py).
+ *
+ * A frame starts with LOG_FRAME_START and ends with a newline. In between:
+ *
+ * - the address of the format string, 4 bytes, little endian;
+ * - the arguments, in the order of the conversion specifications of the
+ *   format string:
+ *   - width and precision given as '*', and values of signed conversions
+ *     ("%d", "%i"), as a zigzag encoded varint;
+ *   - values of the other integer conversions, including "%c" and "%p", as a
+ *     varint, after conversion to the type given by the length modifier;
+ *   - floating point values as a varint holding the bits of the double, in
+ *     reverse byte order;
+ *   - strings located in the read-only data of the application as a 0 byte
+ *     followed by their address, 4 bytes, little endian. Other strings, e.g.
+ *     in a partition mapped with esp_partition_mmap(), which isn't part of
+ *     the ELF file, as a varint holding their length plus one, followed by
+ *     their characters, up to the precision, if any.
+ *
+ * Varints are stored 7 bits at a time, least significant bits first, with
+ * the top bit set in all bytes but the last one.
+ *
+ * As the frame is output like a string and the monitor splits its input
+ * into lines, null, carriage return and newline characters, as well as
+ * LOG_FRAME_START and LOG_FRAME_ESCAPE, are replaced by LOG_FRAME_ESCAPE
+ * followed by the character XOR 0x20.
+ *
+ * Messages with a format string which is not located in the read-only data
+ * of the application, or which don't fit in a frame, are output as text.
+ */
+
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_log_private.h"
+
+// ASCII record separator and unit separator, which don't appear in text output
+#define LOG_FRAME_START  0x1e
+#define LOG_FRAME_ESCAPE 0x1f
+
+// Size of the buffer in which a frame is built, including the terminating null character
+#define LOG_FRAME_SIZE 192
+
+// Bounds of the read-only data of the application, defined in sections.ld.in
+extern char _rodata_start, _rodata_end;
+
+typedef struct {
+    char *p;
+    char *end;          // Room for the newline and the null character is kept after 'end'
+    bool error;         // Frame full, or unsupported conversion
+} log_frame_t;
+
+static inline void put_byte(log_frame_t *frame, uint8_t b)
+{
+    if (b == '\0' || b == '\n' || b == '\r' || b == LOG_FRAME_START || b == LOG_FRAME_ESCAPE) {
+        if (frame->end - frame->p < 2) {
+            frame->error = true;
+            return;
+        }
+        *frame->p++ = LOG_FRAME_ESCAPE;
+        b ^= 0x20;
+    } else if (frame->p == frame->end) {
+        frame->error = true;
+        return;
+    }
+    *frame->p++ = b;
+}
+
+/* Only the strings found in the ELF file can be decoded by the monitor */
+static inline bool is_in_app_rodata(const char *s)
+{
+    return s >= &_rodata_start && s < &_rodata_end;
+}
+
+static void put_u32(log_frame_t *frame, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        put_byte(frame, v >> (8 * i));
+    }
+}
+
+static void put_varint(log_frame_t *frame, uint64_t v)
+{
+    while (v >= 0x80) {
+        put_byte(frame, (v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    put_byte(frame, v);
+}
+
+static void put_signed(log_frame_t *frame, int64_t v)
+{
+    put_varint(frame, ((uint64_t) v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void put_double(log_frame_t *frame, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    // The low bits of the mantissa of most values are zeros, make them the high bits of the varint
+    put_varint(frame, __builtin_bswap64(bits));
+}
+
+static void put_string(log_frame_t *frame, const char *s, int precision)
+{
+    if (s == NULL) {
+        s = "(null)";
+    }
+    if (is_in_app_rodata(s)) {
+        put_byte(frame, 0);
+        put_u32(frame, (uint32_t)(uintptr_t) s);
+        return;
+    }
+    // A negative precision is taken as if it was omitted
+    size_t len = (precision >= 0) ? strnlen(s, precision) : strlen(s);
+    put_varint(frame, len + 1);
+    for (size_t i = 0; i < len && !frame->error; i++) {
+        put_byte(frame, s[i]);
+    }
+}
+
+/* Read an integer argument and convert it to the type given by the length modifier */
+static void put_int(log_frame_t *frame, const esp_log_arg_spec_t *spec, va_list *args)
+{
+    const bool is_signed = (spec->conversion == 'd' || spec->conversion == 'i');
+    int64_t sv = 0;
+    uint64_t uv = 0;
+
+    switch (spec->type) {
+    case ESP_LOG_ARG_INT: {
+        int v = va_arg(*args, int);
+        if (spec->conversion == 'c' || spec->length == -2) {
+            sv = (signed char) v;
+            uv = (unsigned char) v;
+        } else if (spec->length == -1) {
+            sv = (short) v;
+            uv = (unsigned short) v;
+        } else {
+            sv = v;
+            uv = (unsigned) v;
+        }
+        break;
+    }
+    case ESP_LOG_ARG_LONG: {
+        long v = va_arg(*args, long);
+        sv = v;
+        uv = (unsigned long) v;
+        break;
+    }
+    case ESP_LOG_ARG_LLONG: {
+        long long v = va_arg(*args, long long);
+        sv = v;
+        uv = (unsigned long long) v;
+        break;
+    }
+    case ESP_LOG_ARG_INTMAX: {
+        intmax_t v = va_arg(*args, intmax_t);
+        sv = v;
+        uv = (uintmax_t) v;
+        break;
+    }
+    case ESP_LOG_ARG_SIZE: {
+        size_t v = va_arg(*args, size_t);
+        sv = (intptr_t) v;
+        uv = v;
+        break;
+    }
+    case ESP_LOG_ARG_PTRDIFF: {
+        ptrdiff_t v = va_arg(*args, ptrdiff_t);
+        sv = v;
+        uv = (uintptr_t) v;
+        break;
+    }
+    case ESP_LOG_ARG_PTR:
+        uv = (uintptr_t) va_arg(*args, void *);
+        break;
+    default:
+        break;
+    }
+
+    if (is_signed) {
+        put_signed(frame, sv);
+    } else {
+        put_varint(frame, uv);
+    }
+}
+
+static int log_print(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = esp_log_vprint(format, args);
+    va_end(args);
+    return len;
+}
+
+bool esp_log_binary_write(const char *format, va_list args)
+{
+    if (!is_in_app_rodata(format)) {
+        return false;
+    }
+
+    char buf[LOG_FRAME_SIZE];
+    log_frame_t frame = {
+        .p = buf,
+        .end = buf + sizeof(buf) - 2,
+    };
+    esp_log_arg_spec_t spec;
+    va_list copy;
+    va_copy(copy, args);
+
+    *frame.p++ = LOG_FRAME_START;
+    put_u32(&frame, (uint32_t)(uintptr_t) format);
+
+    for (const char *p = strchr(format, '%'); p != NULL && !frame.error; p = strchr(p + spec.len, '%')) {
+        esp_log_args_parse_spec(p, &spec);
+        if (spec.type == ESP_LOG_ARG_INVALID) {
+            frame.error = true;
+            break;
+        }
+
+        int precision = spec.precision;
+        for (int i = 0; i < spec.stars; i++) {
+            int v = va_arg(copy, int);
+            put_signed(&frame, v);
+            if (spec.precision_star && i == spec.stars - 1) {
+                precision = v;
+            }
+        }
+
+        switch (spec.type) {
+        case ESP_LOG_ARG_NONE:
+            break;
+        case ESP_LOG_ARG_STR:
+            put_string(&frame, va_arg(copy, const char *), precision);
+            break;
+        case ESP_LOG_ARG_DOUBLE:
+            put_double(&frame, va_arg(copy, double));
+            break;
+        case ESP_LOG_ARG_LDOUBLE:
+            put_double(&frame, (double) va_arg(copy, long double));
+            break;
+        default:
+            put_int(&frame, &spec, &copy);
+            break;
+        }
+    }
+    va_end(copy);
+
+    if (frame.error) {
+        return false;
+    }
+    *frame.p++ = '\n';
+    *frame.p = '\0';
+    log_print("%s", buf);
+    return true;
+}
@@ -14,6 +14,10 @@
 #include "esp_compiler.h"
 #include "esp_log.h"
 #include "esp_log_private.h"
+#if CONFIG_LOG_ASYNC
+#include "esp_memory_utils.h"
+#include "esp_private/startup_internal.h"
+#endif
 
 
 // Maximum time to wait for the mutex in a logging statement.
@@ -56,6 +60,56 @@ void esp_log_impl_unlock(void)
     xSemaphoreGive(s_log_mutex);
 }
 
+#if CONFIG_LOG_ASYNC
+static TaskHandle_t s_log_async_task = NULL;
+
+static void log_async_task(void *arg)
+{
+    esp_log_async_task();
+}
+
+ESP_SYSTEM_INIT_FN(esp_log_async_init, BIT(0), 110)
+{
+    if (xTaskCreate(log_async_task, "log", CONFIG_LOG_ASYNC_TASK_STACK_SIZE, NULL,
+                    CONFIG_LOG_ASYNC_TASK_PRIORITY, &s_log_async_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool esp_log_impl_async_ready(const char *format)
+{
+    // Only defer messages logged by tasks, with a format string in flash which is
+    // guaranteed to be still there when the message is output
+    return s_log_async_task != NULL && xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED &&
+           !xPortInIsrContext() && esp_ptr_in_drom(format);
+}
+
+unsigned esp_log_impl_async_core(void)
+{
+#if CONFIG_FREERTOS_UNICORE
+    return 0;
+#else
+    return xPortGetCoreID();
+#endif
+}
+
+void esp_log_impl_async_wait(void)
+{
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void esp_log_impl_async_notify(void)
+{
+    xTaskNotifyGive(s_log_async_task);
+}
+
+void esp_log_impl_async_delay(void)
+{
+    vTaskDelay(1);
+}
+#endif // CONFIG_LOG_ASYNC
+
 char *esp_log_system_timestamp(void)
 {
     static char buffer[18] = {0};
@@ -16,6 +16,7 @@
 #include <time.h>
 #include <assert.h>
 #include <stdint.h>
+#include <unistd.h>
 #include "esp_log_private.h"
 
 static pthread_mutex_t mutex1 = PTHREAD_MUTEX_INITIALIZER;
@@ -44,3 +45,61 @@ uint32_t esp_log_timestamp(void)
     uint32_t milliseconds = current_time.tv_sec * 1000 + current_time.tv_nsec / 1000000;
     return milliseconds;
 }
+
+#if CONFIG_LOG_ASYNC
+static pthread_once_t s_async_once = PTHREAD_ONCE_INIT;
+static bool s_async_started = false;
+static pthread_mutex_t s_async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_async_cond = PTHREAD_COND_INITIALIZER;
+static bool s_async_notified = false;
+
+static void *log_async_thread(void *arg)
+{
+    esp_log_async_task();
+    return NULL;
+}
+
+static void log_async_start(void)
+{
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, log_async_thread, NULL) == 0) {
+        pthread_detach(thread);
+        s_async_started = true;
+    }
+}
+
+bool esp_log_impl_async_ready(const char *format)
+{
+    // The output thread is started on first use, messages are output synchronously if it can't be
+    pthread_once(&s_async_once, log_async_start);
+    return s_async_started;
+}
+
+unsigned esp_log_impl_async_core(void)
+{
+    return 0;
+}
+
+void esp_log_impl_async_wait(void)
+{
+    pthread_mutex_lock(&s_async_mutex);
+    while (!s_async_notified) {
+        pthread_cond_wait(&s_async_cond, &s_async_mutex);
+    }
+    s_async_notified = false;
+    pthread_mutex_unlock(&s_async_mutex);
+}
+
+void esp_log_impl_async_notify(void)
+{
+    pthread_mutex_lock(&s_async_mutex);
+    s_async_notified = true;
+    pthread_cond_signal(&s_async_cond);
+    pthread_mutex_unlock(&s_async_mutex);
+}
+
+void esp_log_impl_async_delay(void)
+{
+    usleep(1000);
+}
+#endif // CONFIG_LOG_ASYNC
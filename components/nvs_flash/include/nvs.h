@@ -515,6 +515,44 @@ esp_err_t nvs_erase_all(nvs_handle_t handle);
  */
 esp_err_t nvs_commit(nvs_handle_t handle);
 
+/**
+ * @brief      Start a batch of changes which are written together by nvs_commit
+ *
+ * After this call, the nvs_set_* functions only stage the new values in RAM, and reads
+ * through any handle still return the previously committed values. nvs_commit then writes
+ * all staged values into consecutive entries of a single page, using one flash write for
+ * the entries and one update of the entry state table. If power is lost during nvs_commit,
+ * either all or none of the staged values are present after the next nvs_flash_init.
+ *
+ * The staged values must fit into one NVS page (126 entries of 32 bytes). Staged blobs are
+ * stored as a single chunk, so each of them needs two entries plus its data.
+ * Setting a key which is already staged replaces the staged value, even with another type.
+ * nvs_erase_key and nvs_erase_all are rejected while a batch is open.
+ * nvs_commit ends the batch whether it succeeds or not; nvs_close discards it.
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *                     Handles that were opened read only cannot be used.
+ *
+ * @return
+ *             - ESP_OK if the batch was started
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *             - ESP_ERR_NVS_INVALID_STATE if a batch is already open on this handle
+ */
+esp_err_t nvs_batch_begin(nvs_handle_t handle);
+
+/**
+ * @brief      Discard all values staged since nvs_batch_begin and end the batch
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *
+ * @return
+ *             - ESP_OK if the batch was discarded
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_STATE if no batch is open on this handle
+ */
+esp_err_t nvs_batch_abort(nvs_handle_t handle);
+
 /**
  * @brief      Close the storage handle and free any allocated resources
  *
@@ -573,6 +611,38 @@ typedef struct {
  */
 esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats);
 
+/**
+ * @note Info about the read cache of a partition, see CONFIG_NVS_READ_CACHE.
+ */
+typedef struct {
+    uint32_t hits;            /**< Number of lookups answered from the cache. */
+    uint32_t misses;          /**< Number of lookups which had to read the flash. */
+    uint32_t evictions;       /**< Number of values dropped to make room for others. */
+    size_t cached_items;      /**< Number of values currently cached. */
+} nvs_cache_stats_t;
+
+/**
+ * @brief      Fill structure nvs_cache_stats_t with the read cache statistics of the partition.
+ *
+ * Integers and short strings which have been read are kept in a small per-partition cache when
+ * CONFIG_NVS_READ_CACHE is enabled. Hits and misses are counted by nvs_get_* and size queries
+ * since the partition was initialized.
+ *
+ * @param[in]   part_name   Partition name NVS in the partition table.
+ *                          If pass a NULL than will use NVS_DEFAULT_PART_NAME ("nvs").
+ *
+ * @param[out]  cache_stats Returns filled structure nvs_cache_stats_t.
+ *
+ * @return
+ *             - ESP_OK if cache_stats has been filled.
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the storage driver is not initialized.
+ *               Return param cache_stats will be filled 0.
+ *             - ESP_ERR_INVALID_ARG if cache_stats equal to NULL.
+ *             - ESP_ERR_NOT_SUPPORTED if CONFIG_NVS_READ_CACHE is disabled.
+ *               Return param cache_stats will be filled 0.
+ */
+esp_err_t nvs_get_cache_stats(const char *part_name, nvs_cache_stats_t *cache_stats);
+
 /**
  * @brief      Calculate all entries in a namespace.
  *
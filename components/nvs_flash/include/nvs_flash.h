@@ -117,6 +117,37 @@ esp_err_t nvs_flash_deinit(void);
  */
 esp_err_t nvs_flash_deinit_partition(const char* partition_label);
 
+/**
+ * @brief Complete the initialization of the default NVS partition
+ *
+ * Same as nvs_flash_complete_load_partition() for the partition with "nvs" label.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NVS_NOT_INITIALIZED if the storage was not initialized prior to this call
+ *      - one of the error codes from the underlying flash storage driver
+ */
+esp_err_t nvs_flash_complete_load(void);
+
+/**
+ * @brief Complete the initialization of the given NVS partition
+ *
+ * With CONFIG_NVS_LAZY_MOUNT enabled, initialization only reads the page headers of the partition,
+ * and the items of each page are read on first access. This function reads all remaining pages and
+ * erases leftovers of interrupted blob writes, so that later accesses take a predictable time.
+ * It may be called at any time after initialization, e.g. from a low priority task once booting
+ * has finished. Without CONFIG_NVS_LAZY_MOUNT, or if called again, it does nothing.
+ *
+ * @param[in]  partition_label   Label of the partition
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NVS_NOT_INITIALIZED if the storage for given partition was not
+ *        initialized prior to this call
+ *      - one of the error codes from the underlying flash storage driver
+ */
+esp_err_t nvs_flash_complete_load_partition(const char* partition_label);
+
 /**
  * @brief Erase the default NVS partition
  *
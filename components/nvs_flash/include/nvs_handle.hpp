@@ -179,10 +179,39 @@ public:
     /**
      * Commits all changes done through this handle so far.
      * Currently, NVS writes to storage right after the set and get functions,
-     * but this is not guaranteed.
+     * unless a batch has been started with begin_batch(), but this is not guaranteed.
      */
     virtual esp_err_t commit() = 0;
 
+    /**
+     * Starts staging the values set through this handle, until commit() writes all of them at once or
+     * abort_batch() discards them. A committed batch is atomic with respect to power loss.
+     * See nvs_batch_begin() for the details.
+     *
+     * @return
+     *              - ESP_OK if the batch was started
+     *              - ESP_ERR_NVS_READ_ONLY if the handle is read only
+     *              - ESP_ERR_NVS_INVALID_STATE if a batch is already open
+     *              - ESP_ERR_NOT_SUPPORTED if the implementation doesn't support batches
+     */
+    virtual esp_err_t begin_batch()
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /**
+     * Discards all values staged since begin_batch().
+     *
+     * @return
+     *              - ESP_OK if the batch was discarded
+     *              - ESP_ERR_NVS_INVALID_STATE if no batch is open
+     *              - ESP_ERR_NOT_SUPPORTED if the implementation doesn't support batches
+     */
+    virtual esp_err_t abort_batch()
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
     /**
      * @brief      Calculate all entries in the scope of the handle.
      *
@@ -62,6 +62,16 @@ esp_err_t NVSHandleLocked::commit() {
     return handle->commit();
 }
 
+esp_err_t NVSHandleLocked::begin_batch() {
+    Lock lock;
+    return handle->begin_batch();
+}
+
+esp_err_t NVSHandleLocked::abort_batch() {
+    Lock lock;
+    return handle->abort_batch();
+}
+
 esp_err_t NVSHandleLocked::get_used_entry_count(size_t& usedEntries) {
     Lock lock;
     return handle->get_used_entry_count(usedEntries);
@@ -18,6 +18,7 @@
 namespace nvs {
 
 NVSHandleSimple::~NVSHandleSimple() {
+    mBatch.clearAndFreeNodes();
     NVSPartitionManager::get_instance()->close_handle(this);
 }
 
@@ -26,6 +27,8 @@ esp_err_t NVSHandleSimple::set_typed_item(ItemType datatype, const char *key, co
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mBatchOpen) return stageItem(datatype, key, data, dataSize);
+
     return mStoragePtr->writeItem(mNsIndex, datatype, key, data, dataSize);
 }
 
@@ -41,6 +44,8 @@ esp_err_t NVSHandleSimple::set_string(const char *key, const char* str)
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mBatchOpen) return stageItem(nvs::ItemType::SZ, key, str, strlen(str) + 1);
+
     return mStoragePtr->writeItem(mNsIndex, nvs::ItemType::SZ, key, str, strlen(str) + 1);
 }
 
@@ -49,6 +54,8 @@ esp_err_t NVSHandleSimple::set_blob(const char *key, const void* blob, size_t le
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
 
+    if (mBatchOpen) return stageItem(nvs::ItemType::BLOB, key, blob, len);
+
     return mStoragePtr->writeItem(mNsIndex, nvs::ItemType::BLOB, key, blob, len);
 }
 
@@ -77,6 +84,7 @@ esp_err_t NVSHandleSimple::erase_item(const char* key)
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mBatchOpen) return ESP_ERR_NVS_INVALID_STATE;
 
     return mStoragePtr->eraseItem(mNsIndex, key);
 }
@@ -85,6 +93,7 @@ esp_err_t NVSHandleSimple::erase_all()
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mBatchOpen) return ESP_ERR_NVS_INVALID_STATE;
 
     return mStoragePtr->eraseNamespace(mNsIndex);
 }
@@ -92,7 +101,67 @@ esp_err_t NVSHandleSimple::erase_all()
 esp_err_t NVSHandleSimple::commit()
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mBatchOpen) return ESP_OK;
+
+    mBatchOpen = false;
+    esp_err_t err = mStoragePtr->writeBatch(mNsIndex, mBatch);
+    mBatch.clearAndFreeNodes();
+    return err;
+}
+
+esp_err_t NVSHandleSimple::begin_batch()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mBatchOpen) return ESP_ERR_NVS_INVALID_STATE;
 
+    mBatchOpen = true;
+    return ESP_OK;
+}
+
+esp_err_t NVSHandleSimple::abort_batch()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mBatchOpen) return ESP_ERR_NVS_INVALID_STATE;
+
+    mBatchOpen = false;
+    mBatch.clearAndFreeNodes();
+    return ESP_OK;
+}
+
+esp_err_t NVSHandleSimple::stageItem(ItemType datatype, const char *key, const void* data, size_t dataSize)
+{
+    if (strlen(key) > Item::MAX_KEY_LENGTH) return ESP_ERR_NVS_KEY_TOO_LONG;
+
+    uint8_t* copy = new (std::nothrow) uint8_t[dataSize];
+    if (!copy) return ESP_ERR_NO_MEM;
+    memcpy(copy, data, dataSize);
+
+    BatchItem* item = new (std::nothrow) BatchItem(datatype, copy, dataSize);
+    if (!item) {
+        delete[] copy;
+        return ESP_ERR_NO_MEM;
+    }
+    strncpy(item->mKey, key, sizeof(item->mKey) - 1);
+    item->mKey[sizeof(item->mKey) - 1] = 0;
+
+    if (item->getEntryCount() > Page::ENTRY_COUNT) {
+        delete item;
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    // staging a key again replaces the staged value, whatever its type, as it isn't stored yet
+    auto it = std::find_if(mBatch.begin(), mBatch.end(), [=](BatchItem& e) -> bool {
+        return strncmp(e.mKey, key, Item::MAX_KEY_LENGTH) == 0;
+    });
+    if (it != mBatch.end()) {
+        BatchItem* old = static_cast<BatchItem*>(it);
+        mBatch.insert(it, item);
+        mBatch.erase(it);
+        delete old;
+    } else {
+        mBatch.push_back(item);
+    }
     return ESP_OK;
 }
 
@@ -62,6 +62,10 @@ public:
 
     esp_err_t commit() override;
 
+    esp_err_t begin_batch() override;
+
+    esp_err_t abort_batch() override;
+
     esp_err_t get_used_entry_count(size_t &usedEntries) override;
 
     esp_err_t getItemDataSize(ItemType datatype, const char *key, size_t &dataSize);
@@ -79,6 +83,8 @@ public:
     const char *get_partition_name() const;
 
 private:
+    esp_err_t stageItem(ItemType datatype, const char *key, const void *data, size_t dataSize);
+
     /**
      * The underlying storage's object.
      */
@@ -100,6 +106,16 @@ private:
      * Upon opening, a handle is valid. It becomes invalid if the underlying storage is de-initialized.
      */
     uint8_t valid;
+
+    /**
+     * Whether set operations are staged in mBatch until the next commit.
+     */
+    bool mBatchOpen = false;
+
+    /**
+     * Values staged since begin_batch().
+     */
+    TBatchList mBatch;
 };
 
 } // nvs
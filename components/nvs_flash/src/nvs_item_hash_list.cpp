@@ -23,12 +23,10 @@ HashList::HashList()
 
 void HashList::clear()
 {
-    for (auto it = mBlockList.begin(); it != mBlockList.end();) {
-        auto tmp = it;
-        ++it;
-        mBlockList.erase(tmp);
-        delete static_cast<HashListBlock*>(tmp);
-    }
+    delete[] mNodes;
+    mNodes = nullptr;
+    mCount = 0;
+    mCapacity = 0;
 }
 
 HashList::~HashList()
@@ -36,85 +34,62 @@ HashList::~HashList()
     clear();
 }
 
-HashList::HashListBlock::HashListBlock()
-{
-    static_assert(sizeof(HashListBlock) == HashListBlock::BYTE_SIZE,
-                  "cache block size calculation incorrect");
-}
-
 esp_err_t HashList::insert(const Item& item, size_t index)
 {
     const uint32_t hash_24 = item.calculateCrc32WithoutValue() & 0xffffff;
-    // add entry to the end of last block if possible
-    if (mBlockList.size()) {
-        auto& block = mBlockList.back();
-        if (block.mCount < HashListBlock::ENTRY_COUNT) {
-            block.mNodes[block.mCount++] = HashListNode(hash_24, index);
-            return ESP_OK;
-        }
-    }
-    // if the above failed, create a new block and add entry to it
-    HashListBlock* newBlock = new (std::nothrow) HashListBlock;
+    const uint32_t node = makeNode(hash_24, index);
 
-    if (!newBlock) return ESP_ERR_NO_MEM;
+    if (mCount == mCapacity) {
+        const size_t newCapacity = (mCapacity == 0) ? MIN_CAPACITY : mCapacity * 2;
+        uint32_t* newNodes = new (std::nothrow) uint32_t[newCapacity];
 
-    mBlockList.push_back(newBlock);
-    newBlock->mNodes[0] = HashListNode(hash_24, index);
-    newBlock->mCount++;
+        if (!newNodes) return ESP_ERR_NO_MEM;
+
+        std::copy(mNodes, mNodes + mCount, newNodes);
+        delete[] mNodes;
+        mNodes = newNodes;
+        mCapacity = newCapacity;
+    }
+
+    // insert after existing nodes with the same value, so that duplicates keep their insertion order
+    uint32_t* pos = std::upper_bound(mNodes, mNodes + mCount, node);
+    std::copy_backward(pos, mNodes + mCount, mNodes + mCount + 1);
+    *pos = node;
+    ++mCount;
 
     return ESP_OK;
 }
 
 bool HashList::erase(size_t index)
 {
-    for (auto it = mBlockList.begin(); it != mBlockList.end();) {
-        bool haveEntries = false;
-        bool foundIndex = false;
-        for (size_t i = 0; i < it->mCount; ++i) {
-            if (it->mNodes[i].mIndex == index) {
-                it->mNodes[i].mIndex = 0xff;
-                foundIndex = true;
-                /* found the item and removed it */
-            }
-            if (it->mNodes[i].mIndex != 0xff) {
-                haveEntries = true;
-            }
-            if (haveEntries && foundIndex) {
-                /* item was found, and HashListBlock still has some items */
-                return true;
-            }
-        }
-        /* no items left in HashListBlock, can remove */
-        if (!haveEntries) {
-            auto tmp = it;
-            ++it;
-            mBlockList.erase(tmp);
-            delete static_cast<HashListBlock*>(tmp);
-        } else {
-            ++it;
-        }
-        if (foundIndex) {
-            /* item was found and empty HashListBlock was removed */
-            return true;
-        }
+    uint32_t* end = mNodes + mCount;
+    uint32_t* pos = std::find_if(mNodes, end, [=](uint32_t node) -> bool {
+        return (node & 0xff) == index;
+    });
+    if (pos == end) {
+        // item hasn't been present in cache
+        return false;
     }
 
-    // item hasn't been present in cache");
-    return false;
+    std::copy(pos + 1, end, pos);
+    --mCount;
+    if (mCount == 0) {
+        clear();
+    }
+    return true;
 }
 
 size_t HashList::find(size_t start, const Item& item)
 {
     const uint32_t hash_24 = item.calculateCrc32WithoutValue() & 0xffffff;
-    for (auto it = mBlockList.begin(); it != mBlockList.end(); ++it) {
-        for (size_t index = 0; index < it->mCount; ++index) {
-            HashListNode& e = it->mNodes[index];
-            if (e.mIndex >= start &&
-                    e.mHash == hash_24 &&
-                    e.mIndex != 0xff) {
-                return e.mIndex;
-            }
-        }
+    if (start > 0xff) {
+        return SIZE_MAX;
+    }
+    // smallest entry index >= start among the nodes with this hash
+    uint32_t* end = mNodes + mCount;
+    uint32_t* pos = std::lower_bound(mNodes, end, makeNode(hash_24, start));
+    if (pos != end && (*pos >> 8) == hash_24) {
+        return *pos & 0xff;
     }
     return SIZE_MAX;
 }
@@ -17,11 +17,18 @@
 
 #include "nvs.h"
 #include "nvs_types.hpp"
-#include "intrusive_list.h"
 
 namespace nvs
 {
 
+/**
+ * Per-page index of item hashes.
+ *
+ * Nodes combine the 24-bit item hash (upper bits) with the 8-bit entry index (lower bits)
+ * and are kept sorted in a single array. Lookups are a binary search over at most
+ * Page::ENTRY_COUNT words, and the whole list takes one heap allocation which is
+ * grown by doubling and released once the last node is erased.
+ */
 class HashList
 {
 public:
@@ -39,33 +46,16 @@ private:
 
 protected:
 
-    struct HashListNode {
-        HashListNode() :
-            mIndex(0xff), mHash(0)
-        {
-        }
+    static const size_t MIN_CAPACITY = 8;
 
-        HashListNode(uint32_t hash, size_t index) :
-            mIndex((uint32_t) index), mHash(hash)
-        {
-        }
+    static uint32_t makeNode(uint32_t hash, size_t index)
+    {
+        return (hash << 8) | static_cast<uint32_t>(index & 0xff);
+    }
 
-        uint32_t mIndex : 8;
-        uint32_t mHash  : 24;
-    };
-
-    struct HashListBlock : public intrusive_list_node<HashList::HashListBlock> {
-        HashListBlock();
-
-        static const size_t BYTE_SIZE = 128;
-        static const size_t ENTRY_COUNT = (BYTE_SIZE - sizeof(intrusive_list_node<HashListBlock>) - sizeof(size_t)) / 4;
-
-        size_t mCount = 0;
-        HashListNode mNodes[ENTRY_COUNT];
-    };
-
-    typedef intrusive_list<HashListBlock> TBlockList;
-    TBlockList mBlockList;
+    uint32_t* mNodes = nullptr;
+    uint16_t mCount = 0;
+    uint16_t mCapacity = 0;
 }; // class HashList
 
 } // namespace nvs
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "nvs_key_index.hpp"
+
+namespace nvs
+{
+
+KeyIndex::KeyIndex()
+{
+}
+
+KeyIndex::~KeyIndex()
+{
+    delete[] mSlots;
+}
+
+uint32_t KeyIndex::hash(const Item& item)
+{
+    return item.calculateCrc32WithoutValue() & 0xffffff;
+}
+
+void KeyIndex::clear()
+{
+    delete[] mSlots;
+    mSlots = nullptr;
+    mCapacity = 0;
+    mCount = 0;
+    mValid = true;
+}
+
+bool KeyIndex::grow()
+{
+    const size_t newCapacity = (mCapacity == 0) ? MIN_CAPACITY : mCapacity * 2;
+    Slot* newSlots = new (std::nothrow) Slot[newCapacity];
+    if (!newSlots) {
+        return false;
+    }
+    for (size_t i = 0; i < newCapacity; ++i) {
+        newSlots[i].mIndex = EMPTY_INDEX;
+    }
+
+    // capacity is always a power of two, so masking replaces the modulo
+    const size_t mask = newCapacity - 1;
+    for (size_t i = 0; i < mCapacity; ++i) {
+        if (mSlots[i].mIndex == EMPTY_INDEX) {
+            continue;
+        }
+        size_t pos = mSlots[i].mHash & mask;
+        while (newSlots[pos].mIndex != EMPTY_INDEX) {
+            pos = (pos + 1) & mask;
+        }
+        newSlots[pos] = mSlots[i];
+    }
+
+    delete[] mSlots;
+    mSlots = newSlots;
+    mCapacity = newCapacity;
+    return true;
+}
+
+void KeyIndex::insert(const Item& item, uint32_t sector, size_t index)
+{
+    if (!mValid) {
+        return;
+    }
+
+    // keep the load factor below 3/4, otherwise probe sequences get long
+    if (sector >= UINT16_MAX || ((mCount + 1) * 4 > mCapacity * 3 && !grow())) {
+        clear();
+        mValid = false;
+        return;
+    }
+
+    const size_t mask = mCapacity - 1;
+    const uint32_t hash_24 = hash(item);
+    size_t pos = hash_24 & mask;
+    while (mSlots[pos].mIndex != EMPTY_INDEX) {
+        pos = (pos + 1) & mask;
+    }
+    mSlots[pos].mHash = hash_24;
+    mSlots[pos].mIndex = static_cast<uint32_t>(index);
+    mSlots[pos].mSector = static_cast<uint16_t>(sector);
+    ++mCount;
+}
+
+void KeyIndex::removeAt(size_t pos)
+{
+    // backward shift deletion: move later members of the probe sequence into the hole,
+    // so that lookups never need tombstones
+    const size_t mask = mCapacity - 1;
+    size_t hole = pos;
+    size_t next = pos;
+    while (true) {
+        next = (next + 1) & mask;
+        if (mSlots[next].mIndex == EMPTY_INDEX) {
+            break;
+        }
+        const size_t home = mSlots[next].mHash & mask;
+        const bool reachable = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!reachable) {
+            mSlots[hole] = mSlots[next];
+            hole = next;
+        }
+    }
+    mSlots[hole].mIndex = EMPTY_INDEX;
+    --mCount;
+}
+
+void KeyIndex::erase(const Item& item, uint32_t sector, size_t index)
+{
+    if (!mValid || mCount == 0) {
+        return;
+    }
+
+    const size_t mask = mCapacity - 1;
+    const uint32_t hash_24 = hash(item);
+    for (size_t pos = hash_24 & mask; mSlots[pos].mIndex != EMPTY_INDEX; pos = (pos + 1) & mask) {
+        const Slot& slot = mSlots[pos];
+        if (slot.mHash == hash_24 && slot.mSector == sector && slot.mIndex == index) {
+            removeAt(pos);
+            return;
+        }
+    }
+}
+
+void KeyIndex::eraseSector(uint32_t sector)
+{
+    if (!mValid) {
+        return;
+    }
+
+    for (size_t pos = 0; pos < mCapacity;) {
+        if (mSlots[pos].mIndex != EMPTY_INDEX && mSlots[pos].mSector == sector) {
+            // removeAt() may shift another slot into pos, so check it again
+            removeAt(pos);
+        } else {
+            ++pos;
+        }
+    }
+}
+
+bool KeyIndex::find(uint32_t hash, size_t& pos, uint32_t& sector, size_t& index) const
+{
+    if (!mValid || mCount == 0) {
+        return false;
+    }
+
+    const size_t mask = mCapacity - 1;
+    while (pos < mCapacity) {
+        const Slot& slot = mSlots[(hash + pos) & mask];
+        ++pos;
+        if (slot.mIndex == EMPTY_INDEX) {
+            return false;
+        }
+        if (slot.mHash == hash) {
+            sector = slot.mSector;
+            index = slot.mIndex;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace nvs
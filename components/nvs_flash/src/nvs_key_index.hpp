@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef nvs_key_index_hpp
+#define nvs_key_index_hpp
+
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+/**
+ * Partition-wide index of item headers.
+ *
+ * Maps the 24-bit hash of namespace index, key and chunk index (the same hash the per-page HashList uses) to the
+ * sector and entry index of every item header in the partition. The index only yields candidate locations,
+ * the item still has to be verified on its page. If the table cannot grow, the index invalidates itself and
+ * lookups have to fall back to scanning all pages.
+ */
+class KeyIndex
+{
+public:
+    KeyIndex();
+    ~KeyIndex();
+
+    static uint32_t hash(const Item& item);
+
+    void insert(const Item& item, uint32_t sector, size_t index);
+    void erase(const Item& item, uint32_t sector, size_t index);
+    void eraseSector(uint32_t sector);
+
+    /**
+     * Returns the next location recorded for the given hash.
+     * pos must be 0 on the first call and is advanced by each call.
+     * Returns false once there are no more candidates.
+     */
+    bool find(uint32_t hash, size_t& pos, uint32_t& sector, size_t& index) const;
+
+    void clear();
+
+    bool isValid() const
+    {
+        return mValid;
+    }
+
+    size_t size() const
+    {
+        return mCount;
+    }
+
+private:
+    KeyIndex(const KeyIndex& other);
+    const KeyIndex& operator= (const KeyIndex& rhs);
+
+protected:
+    struct Slot {
+        uint32_t mHash  : 24;
+        uint32_t mIndex : 8;
+        uint16_t mSector;
+    };
+
+    static const size_t MIN_CAPACITY = 64;
+    static const uint32_t EMPTY_INDEX = 0xff;
+
+    bool grow();
+    void removeAt(size_t pos);
+
+    Slot* mSlots = nullptr;
+    size_t mCapacity = 0;
+    size_t mCount = 0;
+    bool mValid = true;
+}; // class KeyIndex
+
+} // namespace nvs
+
+#endif /* nvs_key_index_hpp */
@@ -21,13 +21,14 @@ uint32_t Page::Header::calculateCrc32()
                     offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
 }
 
-esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
+esp_err_t Page::load(Partition *partition, uint32_t sectorNumber, KeyIndex *keyIndex, bool lazy)
 {
     if (partition == nullptr) {
         return ESP_ERR_INVALID_ARG;
     }
 
     mPartition = partition;
+    mKeyIndex = keyIndex;
     mBaseAddress = sectorNumber * SEC_SIZE;
     mUsedEntryCount = 0;
     mErasedEntryCount = 0;
@@ -80,7 +81,8 @@ esp_err_t Page::load(Partition *partition, uint32_t sectorNumber)
     case PageState::FULL:
     case PageState::ACTIVE:
     case PageState::FREEING:
-        return mLoadEntryTable();
+        // only full pages can be loaded lazily, others may need recovery right away
+        return mLoadEntryTable(lazy && mState == PageState::FULL);
         break;
 
     default:
@@ -199,7 +201,7 @@ esp_err_t Page::writeItem(uint8_t nsIndex, ItemType datatype, const char* key, c
     // write first item
     size_t span = (totalSize + ENTRY_SIZE - 1) / ENTRY_SIZE;
     item = Item(nsIndex, datatype, span, key, chunkIdx);
-    err = mHashList.insert(item, mNextFreeEntry);
+    err = insertHash(item, mNextFreeEntry);
 
     if (err != ESP_OK) {
         return err;
@@ -246,6 +248,130 @@ esp_err_t Page::writeItem(uint8_t nsIndex, ItemType datatype, const char* key, c
     return ESP_OK;
 }
 
+esp_err_t Page::writeItems(uint8_t nsIndex, TBatchList& batch)
+{
+    esp_err_t err;
+
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    if (mState == PageState::UNINITIALIZED) {
+        err = initialize();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (mState == PageState::FULL) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    size_t count = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        if (!it->mSkip) {
+            count += it->getEntryCount();
+        }
+    }
+
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    if (mNextFreeEntry == INVALID_ENTRY || mNextFreeEntry + count > ENTRY_COUNT) {
+        // page will not fit this amount of data
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    // lay out all items in RAM first, exactly as they will appear on the page
+    Item* entries = new (std::nothrow) Item[count];
+    if (!entries) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t pos = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        if (it->mSkip) {
+            continue;
+        }
+
+        if (!isVariableLengthType(it->mDatatype)) {
+            Item& item = entries[pos++];
+            item = Item(nsIndex, it->mDatatype, 1, it->mKey);
+            memcpy(item.data, it->mData, it->mDataSize);
+            item.crc32 = item.calculateCrc32();
+            continue;
+        }
+
+        // blobs are stored as a single data chunk followed by the blob index
+        ItemType datatype = it->mDatatype;
+        uint8_t chunkIdx = CHUNK_ANY;
+        if (datatype == ItemType::BLOB) {
+            datatype = ItemType::BLOB_DATA;
+            chunkIdx = static_cast<uint8_t>(it->mChunkStart);
+        }
+
+        const size_t dataEntries = (it->mDataSize + ENTRY_SIZE - 1) / ENTRY_SIZE;
+        Item& item = entries[pos++];
+        item = Item(nsIndex, datatype, 1 + dataEntries, it->mKey, chunkIdx);
+        item.varLength.dataCrc32 = Item::calculateCrc32(it->mData, it->mDataSize);
+        item.varLength.dataSize = it->mDataSize;
+        item.varLength.reserved = 0xffff;
+        item.crc32 = item.calculateCrc32();
+
+        uint8_t* dst = reinterpret_cast<uint8_t*>(&entries[pos]);
+        std::fill_n(dst, dataEntries * ENTRY_SIZE, 0xff);
+        memcpy(dst, it->mData, it->mDataSize);
+        pos += dataEntries;
+
+        if (it->mDatatype == ItemType::BLOB) {
+            Item& index = entries[pos++];
+            index = Item(nsIndex, ItemType::BLOB_IDX, 1, it->mKey);
+            index.blobIndex.dataSize = it->mDataSize;
+            index.blobIndex.chunkCount = 1;
+            index.blobIndex.chunkStart = it->mChunkStart;
+            index.crc32 = index.calculateCrc32();
+        }
+    }
+    NVS_ASSERT_OR_RETURN(pos == count, ESP_FAIL);
+
+    for (size_t i = 0; i < count; i += entries[i].span) {
+        err = insertHash(entries[i], mNextFreeEntry + i);
+        if (err != ESP_OK) {
+            for (size_t j = 0; j < i; j += entries[j].span) {
+                eraseHash(entries[j], mNextFreeEntry + j);
+            }
+            delete[] entries;
+            return err;
+        }
+    }
+
+    uint32_t phyAddr;
+    err = getEntryAddress(mNextFreeEntry, &phyAddr);
+    if (err == ESP_OK) {
+        err = mPartition->write(phyAddr, entries, count * ENTRY_SIZE);
+    }
+    delete[] entries;
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
+    }
+
+    // the range is marked from its end, so the batch only becomes visible
+    // once the state table word holding its first entry has been written
+    err = alterEntryRangeState(mNextFreeEntry, mNextFreeEntry + count, EntryState::WRITTEN);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (mFirstUsedEntry == INVALID_ENTRY) {
+        mFirstUsedEntry = mNextFreeEntry;
+    }
+    mUsedEntryCount += count;
+    mNextFreeEntry += count;
+    return ESP_OK;
+}
+
 esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx, VerOffset chunkStart)
 {
     size_t index = 0;
@@ -386,7 +512,7 @@ esp_err_t Page::eraseEntryAndSpan(size_t index)
             return rc;
         }
         if (item.calculateCrc32() != item.crc32) {
-            mHashList.erase(index);
+            eraseHash(item, index);
             rc = alterEntryState(index, EntryState::ERASED);
             --mUsedEntryCount;
             ++mErasedEntryCount;
@@ -394,7 +520,7 @@ esp_err_t Page::eraseEntryAndSpan(size_t index)
                 return rc;
             }
         } else {
-            mHashList.erase(index);
+            eraseHash(item, index);
             span = item.span;
             for (ptrdiff_t i = index + span - 1; i >= static_cast<ptrdiff_t>(index); --i) {
                 rc = mEntryTable.get(i, &state);
@@ -459,8 +585,35 @@ esp_err_t Page::updateFirstUsedEntry(size_t index, size_t span)
     return ESP_OK;
 }
 
+esp_err_t Page::insertHash(const Item& item, size_t index)
+{
+    esp_err_t err = mHashList.insert(item, index);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (mKeyIndex) {
+        mKeyIndex->insert(item, getSector(), index);
+    }
+    return ESP_OK;
+}
+
+void Page::eraseHash(const Item& item, size_t index)
+{
+    mHashList.erase(index);
+    if (mKeyIndex) {
+        mKeyIndex->erase(item, getSector(), index);
+    }
+}
+
 esp_err_t Page::copyItems(Page& other)
 {
+    if (!mItemsLoaded) {
+        auto err = loadItems();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
     if (mFirstUsedEntry == INVALID_ENTRY) {
         return ESP_ERR_NVS_NOT_FOUND;
     }
@@ -492,7 +645,7 @@ esp_err_t Page::copyItems(Page& other)
             return err;
         }
 
-        err = other.mHashList.insert(entry, other.mNextFreeEntry);
+        err = other.insertHash(entry, other.mNextFreeEntry);
         if (err != ESP_OK) {
             return err;
         }
@@ -519,7 +672,7 @@ esp_err_t Page::copyItems(Page& other)
     return ESP_OK;
 }
 
-esp_err_t Page::mLoadEntryTable()
+esp_err_t Page::mLoadEntryTable(bool deferItems)
 {
     // for states where we actually care about data in the page, read entry state table
     if (mState == PageState::ACTIVE ||
@@ -604,6 +757,11 @@ esp_err_t Page::mLoadEntryTable()
             }
         }
 
+        err = eraseUncommittedEntries();
+        if (err != ESP_OK) {
+            return err;
+        }
+
         // check that all variable-length items are written or erased fully
         Item item;
         size_t lastItemIndex = INVALID_ENTRY;
@@ -650,7 +808,7 @@ esp_err_t Page::mLoadEntryTable()
                 continue;
             }
 
-            err = mHashList.insert(item, i);
+            err = insertHash(item, i);
             if (err != ESP_OK) {
                 mState = PageState::INVALID;
                 return err;
@@ -705,63 +863,173 @@ esp_err_t Page::mLoadEntryTable()
     } else if (mState == PageState::FULL || mState == PageState::FREEING) {
         // We have already filled mHashList for page in active state.
         // Do the same for the case when page is in full or freeing state.
-        Item item;
-        for (size_t i = mFirstUsedEntry; i < ENTRY_COUNT; ++i) {
-            auto err = mEntryTable.get(i, &state);
-            if (err != ESP_OK) {
-                return err;
-            }
-            if (state != EntryState::WRITTEN) {
-                continue;
-            }
+        if (deferItems) {
+            mItemsLoaded = false;
+            return ESP_OK;
+        }
+        return loadItems();
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t Page::loadItems()
+{
+    mItemsLoaded = true;
+    if (mFirstUsedEntry == INVALID_ENTRY) {
+        mNewestPage = nullptr;
+        return ESP_OK;
+    }
+
+    EntryState state;
+    Item item;
+    for (size_t i = mFirstUsedEntry; i < ENTRY_COUNT; ++i) {
+        auto err = mEntryTable.get(i, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (state != EntryState::WRITTEN) {
+            continue;
+        }
 
-            err = readEntry(i, item);
+        err = readEntry(i, item);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
+
+        if (item.crc32 != item.calculateCrc32()) {
+            err = eraseEntryAndSpan(i);
             if (err != ESP_OK) {
                 mState = PageState::INVALID;
                 return err;
             }
+            continue;
+        }
 
-            if (item.crc32 != item.calculateCrc32()) {
-                err = eraseEntryAndSpan(i);
+        NVS_ASSERT_OR_RETURN(item.span > 0, ESP_FAIL);
+
+        err = insertHash(item, i);
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
+
+        size_t span = item.span;
+        bool erased = false;
+
+        if (isVariableLengthType(item.datatype)) {
+            for (size_t j = i + 1; j < i + span; ++j) {
+                err = mEntryTable.get(j, &state);
                 if (err != ESP_OK) {
-                    mState = PageState::INVALID;
                     return err;
                 }
-                continue;
+                if (state != EntryState::WRITTEN) {
+                    eraseEntryAndSpan(i);
+                    erased = true;
+                    break;
+                }
             }
+        }
 
-            NVS_ASSERT_OR_RETURN(item.span > 0, ESP_FAIL);
-
-            err = mHashList.insert(item, i);
+        // If power went out after an item was written to the newest page, but before the old copy on this
+        // page was erased, the old copy is still here. PageManager::load() removes such duplicates from
+        // loaded pages, do the same here for pages which were loaded lazily.
+        if (!erased && mNewestPage != nullptr
+                && (mNewestPage->findItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK
+                        || (item.datatype == ItemType::BLOB
+                                && mNewestPage->findItem(item.nsIndex, ItemType::BLOB_IDX, item.key) == ESP_OK))) {
+            err = eraseEntryAndSpan(i);
             if (err != ESP_OK) {
                 mState = PageState::INVALID;
                 return err;
             }
+        }
 
-            size_t span = item.span;
+        i += span - 1;
+    }
+    mNewestPage = nullptr;
 
-            if (isVariableLengthType(item.datatype)) {
-                for (size_t j = i + 1; j < i + span; ++j) {
-                    err = mEntryTable.get(j, &state);
-                    if (err != ESP_OK) {
-                        return err;
-                    }
-                    if (state != EntryState::WRITTEN) {
-                        eraseEntryAndSpan(i);
-                        break;
-                    }
-                }
-            }
+    return ESP_OK;
+}
+
+
+esp_err_t Page::eraseUncommittedEntries()
+{
+    // Entries are programmed before they are marked as written, and ranges of entries are marked starting from
+    // their end. If power went out in between, there may be programmed or even written entries past the first
+    // empty one. These never became visible, so erase everything up to the last entry which isn't blank.
+    if (mNextFreeEntry >= ENTRY_COUNT) {
+        return ESP_OK;
+    }
+
+    size_t end = mNextFreeEntry;
+    for (size_t i = ENTRY_COUNT; i > mNextFreeEntry; --i) {
+        EntryState state;
+        auto err = mEntryTable.get(i - 1, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (state != EntryState::EMPTY) {
+            end = i;
+            break;
+        }
 
-            i += span - 1;
+        uint32_t entryAddress;
+        err = getEntryAddress(i - 1, &entryAddress);
+        if (err != ESP_OK) {
+            return err;
+        }
+        uint32_t entry[ENTRY_SIZE / sizeof(uint32_t)];
+        err = mPartition->read_raw(entryAddress, entry, sizeof(entry));
+        if (err != ESP_OK) {
+            mState = PageState::INVALID;
+            return err;
+        }
+        if (std::any_of(std::begin(entry), std::end(entry), [](uint32_t val) -> bool { return val != 0xffffffff; })) {
+            end = i;
+            break;
         }
+    }
 
+    if (end == mNextFreeEntry) {
+        return ESP_OK;
+    }
+
+    for (size_t i = mNextFreeEntry; i < end; ++i) {
+        EntryState state;
+        auto err = mEntryTable.get(i, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (state == EntryState::WRITTEN) {
+            --mUsedEntryCount;
+        }
+        if (state != EntryState::ERASED) {
+            ++mErasedEntryCount;
+        }
+    }
+
+    auto err = alterEntryRangeState(mNextFreeEntry, end, EntryState::ERASED);
+    if (err != ESP_OK) {
+        mState = PageState::INVALID;
+        return err;
     }
+    mNextFreeEntry = end;
 
+    if (mFirstUsedEntry != INVALID_ENTRY) {
+        EntryState state;
+        err = mEntryTable.get(mFirstUsedEntry, &state);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (state != EntryState::WRITTEN) {
+            return updateFirstUsedEntry(mFirstUsedEntry, 1);
+        }
+    }
     return ESP_OK;
 }
 
-
 esp_err_t Page::initialize()
 {
     NVS_ASSERT_OR_RETURN(mState == PageState::UNINITIALIZED, ESP_FAIL);
@@ -863,6 +1131,13 @@ esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, si
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
+    if (!mItemsLoaded) {
+        auto err = loadItems();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
     size_t findBeginIndex = itemIndex;
     if (findBeginIndex >= ENTRY_COUNT) {
         return ESP_ERR_NVS_NOT_FOUND;
@@ -1004,6 +1279,11 @@ esp_err_t Page::erase()
     mNextFreeEntry = INVALID_ENTRY;
     mState = PageState::UNINITIALIZED;
     mHashList.clear();
+    mItemsLoaded = true;
+    mNewestPage = nullptr;
+    if (mKeyIndex) {
+        mKeyIndex->eraseSector(getSector());
+    }
     return ESP_OK;
 }
 
@@ -1034,6 +1314,16 @@ size_t Page::getVarDataTailroom() const
     return ((mNextFreeEntry < (ENTRY_COUNT-1)) ? ((ENTRY_COUNT - mNextFreeEntry - 1) * ENTRY_SIZE): 0);
 }
 
+size_t Page::getFreeEntryCount() const
+{
+    if (mState == PageState::UNINITIALIZED) {
+        return ENTRY_COUNT;
+    } else if (mState == PageState::FULL || mNextFreeEntry >= ENTRY_COUNT) {
+        return 0;
+    }
+    return ENTRY_COUNT - mNextFreeEntry;
+}
+
 const char* Page::pageStateToName(PageState ps)
 {
     switch (ps) {
@@ -1123,4 +1413,16 @@ esp_err_t Page::calcEntries(nvs_stats_t &nvsStats)
     return ESP_OK;
 }
 
+size_t BatchItem::getEntryCount() const
+{
+    if (!isVariableLengthType(mDatatype)) {
+        return 1;
+    }
+    size_t count = 1 + (mDataSize + Page::ENTRY_SIZE - 1) / Page::ENTRY_SIZE;
+    if (mDatatype == ItemType::BLOB) {
+        ++count;
+    }
+    return count;
+}
+
 } // namespace nvs
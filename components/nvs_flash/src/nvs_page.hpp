@@ -16,11 +16,15 @@
 #include "compressed_enum_table.hpp"
 #include "intrusive_list.h"
 #include "nvs_item_hash_list.hpp"
+#include "nvs_key_index.hpp"
 #include "partition.hpp"
 
 namespace nvs
 {
 
+class BatchItem;
+
+typedef intrusive_list<BatchItem> TBatchList;
 
 class Page : public intrusive_list_node<Page>
 {
@@ -77,7 +81,26 @@ public:
         return mState;
     }
 
-    esp_err_t load(Partition *partition, uint32_t sectorNumber);
+    esp_err_t load(Partition *partition, uint32_t sectorNumber, KeyIndex *keyIndex = nullptr, bool lazy = false);
+
+    /**
+     * Reads and validates the items of a page which was loaded lazily, and fills the hash list.
+     * Called on first access to the page.
+     */
+    esp_err_t loadItems();
+
+    bool isLoaded() const
+    {
+        return mItemsLoaded;
+    }
+
+    /**
+     * Items which are also present on the given page are dropped as stale when the items of this page are loaded.
+     */
+    void setNewestPage(Page* page)
+    {
+        mNewestPage = page;
+    }
 
     esp_err_t getSeqNumber(uint32_t& seqNumber) const;
 
@@ -87,6 +110,13 @@ public:
 
     esp_err_t writeItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY);
 
+    /**
+     * Writes all items of the batch which are not marked as skipped into consecutive entries.
+     * The entries are programmed with a single flash write and become valid with the last entry state table write,
+     * so after a power loss either all of them or none of them are present on the page.
+     */
+    esp_err_t writeItems(uint8_t nsIndex, TBatchList& batch);
+
     esp_err_t readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
     esp_err_t cmpItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
@@ -132,6 +162,8 @@ public:
     }
     size_t getVarDataTailroom() const ;
 
+    size_t getFreeEntryCount() const;
+
     esp_err_t markFull();
 
     esp_err_t markFreeing();
@@ -171,7 +203,9 @@ protected:
         INVALID = 0x4 // entry is in inconsistent state (write started but ESB_WRITTEN has not been set yet)
     };
 
-    esp_err_t mLoadEntryTable();
+    esp_err_t mLoadEntryTable(bool deferItems);
+
+    esp_err_t eraseUncommittedEntries();
 
     esp_err_t initialize();
 
@@ -191,6 +225,15 @@ protected:
 
     esp_err_t updateFirstUsedEntry(size_t index, size_t span);
 
+    esp_err_t insertHash(const Item& item, size_t index);
+
+    void eraseHash(const Item& item, size_t index);
+
+    uint32_t getSector() const
+    {
+        return mBaseAddress / SEC_SIZE;
+    }
+
     static constexpr size_t getAlignmentForType(ItemType type)
     {
         return static_cast<uint8_t>(type) & 0x0f;
@@ -223,6 +266,21 @@ protected:
      */
     HashList mHashList;
 
+    /**
+     * Optional partition-wide index, kept in sync with mHashList.
+     */
+    KeyIndex *mKeyIndex = nullptr;
+
+    /**
+     * False while the items of a lazily loaded page haven't been read yet, mHashList is empty then.
+     */
+    bool mItemsLoaded = true;
+
+    /**
+     * Newest page at the time this page was loaded lazily, see setNewestPage().
+     */
+    Page *mNewestPage = nullptr;
+
     Partition *mPartition;
 
     static const uint32_t HEADER_OFFSET = 0;
@@ -235,6 +293,43 @@ protected:
 
 }; // class Page
 
+/**
+ * A value staged in a write batch, see NVSHandle::begin_batch().
+ */
+class BatchItem : public intrusive_list_node<BatchItem>
+{
+public:
+    BatchItem(ItemType datatype, uint8_t* data, size_t dataSize) :
+        mDatatype(datatype),
+        mData(data),
+        mDataSize(dataSize)
+    { }
+
+    ~BatchItem()
+    {
+        delete[] mData;
+    }
+
+    /**
+     * Number of page entries the item occupies. Blobs are written as a single data chunk plus a blob index.
+     */
+    size_t getEntryCount() const;
+
+    ItemType mDatatype;
+    char mKey[Item::MAX_KEY_LENGTH + 1];
+    uint8_t* mData;
+    size_t mDataSize;
+
+    // set by Storage::writeBatch
+    bool mSkip = false;        // the same value is stored already
+    bool mReplace = false;     // a previous value has to be erased once the batch is written
+    VerOffset mChunkStart = VerOffset::VER_0_OFFSET;
+
+private:
+    BatchItem(const BatchItem& other);
+    const BatchItem& operator= (const BatchItem& rhs);
+}; // class BatchItem
+
 } // namespace nvs
 
 
@@ -7,7 +7,7 @@
 
 namespace nvs
 {
-esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t sectorCount)
+esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t sectorCount, KeyIndex *keyIndex, bool lazy)
 {
     if (partition == nullptr) {
         return ESP_ERR_INVALID_ARG;
@@ -17,12 +17,13 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     mPageCount = sectorCount;
     mPageList.clear();
     mFreePageList.clear();
+    mAllLoaded = !lazy;
     mPages.reset(new (nothrow) Page[sectorCount]);
 
     if (!mPages) return ESP_ERR_NO_MEM;
 
     for (uint32_t i = 0; i < sectorCount; ++i) {
-        auto err = mPages[i].load(partition, baseSector + i);
+        auto err = mPages[i].load(partition, baseSector + i, keyIndex, lazy);
         if (err != ESP_OK) {
             return err;
         }
@@ -54,24 +55,32 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
         mSeqNumber = lastSeqNo + 1;
     }
 
-    // if power went out after a new item for the given key was written,
-    // but before the old one was erased, we end up with a duplicate item
+    // if power went out after new items were written, but before the old ones were erased,
+    // we end up with duplicate items. New items always go to the last page, and a batch
+    // may have written several of them at once, so check every item on that page.
     Page& lastPage = back();
-    size_t lastItemIndex = SIZE_MAX;
+    auto last = PageManager::TPageListIterator(&lastPage);
+    if (!lastPage.isLoaded()) {
+        auto err = lastPage.loadItems();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    // pages which weren't loaded yet check their items against the last page once they are loaded
+    for (auto it = begin(); it != last; ++it) {
+        if (!it->isLoaded()) {
+            it->setNewestPage(&lastPage);
+        }
+    }
     Item item;
     size_t itemIndex = 0;
     while (lastPage.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
         itemIndex += item.span;
-        lastItemIndex = itemIndex;
-    }
-
-    if (lastItemIndex != SIZE_MAX) {
-        auto last = PageManager::TPageListIterator(&lastPage);
         TPageListIterator it;
 
         for (it = begin(); it != last; ++it) {
 
-            if ((it->state() != Page::PageState::FREEING) &&
+            if ((it->state() != Page::PageState::FREEING) && it->isLoaded() &&
                     (it->eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK)) {
                 break;
             }
@@ -81,7 +90,7 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
              * blob index during modification. Loop again and delete the old version blob*/
             for (it = begin(); it != last; ++it) {
 
-                if ((it->state() != Page::PageState::FREEING) &&
+                if ((it->state() != Page::PageState::FREEING) && it->isLoaded() &&
                         (it->eraseItem(item.nsIndex, ItemType::BLOB, item.key, item.chunkIndex) == ESP_OK)) {
                     break;
                 }
@@ -92,6 +101,12 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     // check if power went out while page was being freed
     for (auto it = begin(); it!= end(); ++it) {
         if (it->state() == Page::PageState::FREEING) {
+            // items are about to move between pages, so the lazily loaded ones have to be sorted out first
+            auto err = loadAll();
+            if (err != ESP_OK) {
+                return err;
+            }
+
             Page* newPage = &mPageList.back();
             if (newPage->state() == Page::PageState::ACTIVE) {
                 auto err = newPage->erase();
@@ -101,7 +116,7 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
                 mPageList.erase(newPage);
                 mFreePageList.push_back(newPage);
             }
-            auto err = activatePage();
+            err = activatePage();
             if (err != ESP_OK) {
                 return err;
             }
@@ -132,12 +147,36 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     return ESP_OK;
 }
 
+esp_err_t PageManager::loadAll()
+{
+    if (mAllLoaded) {
+        return ESP_OK;
+    }
+
+    for (auto it = begin(); it != end(); ++it) {
+        if (!it->isLoaded()) {
+            auto err = it->loadItems();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    mAllLoaded = true;
+    return ESP_OK;
+}
+
 esp_err_t PageManager::requestNewPage()
 {
     if (mFreePageList.empty()) {
         return ESP_ERR_NVS_INVALID_STATE;
     }
 
+    // the last page stops being the newest one, which the deferred duplicate check of unloaded pages relies on
+    auto err = loadAll();
+    if (err != ESP_OK) {
+        return err;
+    }
+
     // do we have at least two free pages? in that case no erasing is required
     if (mFreePageList.size() >= 2) {
         return activatePage();
@@ -159,7 +198,7 @@ esp_err_t PageManager::requestNewPage()
         return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
     }
 
-    esp_err_t err = activatePage();
+    err = activatePage();
     if (err != ESP_OK) {
         return err;
     }
@@ -195,6 +234,32 @@ esp_err_t PageManager::requestNewPage()
     return ESP_OK;
 }
 
+esp_err_t PageManager::getNewPageFreeEntryCount(size_t& freeEntries)
+{
+    freeEntries = 0;
+    if (mFreePageList.empty()) {
+        return ESP_OK;
+    }
+    if (mFreePageList.size() >= 2) {
+        freeEntries = Page::ENTRY_COUNT;
+        return ESP_OK;
+    }
+
+    auto err = loadAll();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // requestNewPage() moves the items of the page with the most erased entries to the new page
+    for (auto it = begin(); it != end(); ++it) {
+        size_t unused = Page::ENTRY_COUNT - it->getUsedEntryCount();
+        if (unused > freeEntries) {
+            freeEntries = unused;
+        }
+    }
+    return ESP_OK;
+}
+
 esp_err_t PageManager::activatePage()
 {
     if (mFreePageList.empty()) {
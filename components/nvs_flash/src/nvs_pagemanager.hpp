@@ -31,7 +31,17 @@ public:
 
     PageManager() {}
 
-    esp_err_t load(Partition *partition, uint32_t baseSector, uint32_t sectorCount);
+    esp_err_t load(Partition *partition, uint32_t baseSector, uint32_t sectorCount, KeyIndex *keyIndex = nullptr, bool lazy = false);
+
+    /**
+     * Loads the items of all pages which were left unloaded by a lazy load().
+     */
+    esp_err_t loadAll();
+
+    bool isLoaded() const
+    {
+        return mAllLoaded;
+    }
 
     TPageListIterator begin()
     {
@@ -54,6 +64,12 @@ public:
 
     esp_err_t requestNewPage();
 
+    /**
+     * Number of free entries of the page which requestNewPage() would activate, once the
+     * current page is marked full. Requires all pages to be loaded, like requestNewPage().
+     */
+    esp_err_t getNewPageFreeEntryCount(size_t& freeEntries);
+
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
     uint32_t getBaseSector()
@@ -61,6 +77,14 @@ public:
         return mBaseSector;
     }
 
+    Page* getPage(uint32_t sector)
+    {
+        if (sector < mBaseSector || sector - mBaseSector >= mPageCount) {
+            return nullptr;
+        }
+        return &mPages[sector - mBaseSector];
+    }
+
 protected:
     friend class Iterator;
 
@@ -72,6 +96,7 @@ protected:
     uint32_t mBaseSector;
     uint32_t mPageCount;
     uint32_t mSeqNumber;
+    bool mAllLoaded = true;
 }; // class PageManager
 
 
@@ -89,7 +89,11 @@ esp_err_t NVSPartitionManager::init_custom(Partition *partition, uint32_t baseSe
         }
     }
 
+#if CONFIG_NVS_LAZY_MOUNT
+    esp_err_t err = storage->init(baseSector, sectorCount, true);
+#else
     esp_err_t err = storage->init(baseSector, sectorCount);
+#endif
     if (new_storage != nullptr) {
         if (err == ESP_OK) {
             nvs_storage_list.push_back(new_storage);
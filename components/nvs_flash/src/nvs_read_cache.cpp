@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "nvs_read_cache.hpp"
+#include <cstring>
+
+namespace nvs
+{
+
+ReadCache::ReadCache(size_t capacity) : mCapacity(capacity)
+{
+}
+
+ReadCache::~ReadCache()
+{
+    delete[] mSlots;
+}
+
+ReadCache::Slot* ReadCache::findSlot(uint8_t nsIndex, ItemType datatype, const char* key)
+{
+    if (mCount == 0) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < mCapacity; ++i) {
+        Slot& slot = mSlots[i];
+        if (slot.mValid && slot.mNsIndex == nsIndex && slot.mDatatype == datatype
+                && strncmp(slot.mKey, key, Item::MAX_KEY_LENGTH) == 0) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+const uint8_t* ReadCache::find(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize)
+{
+    Slot* slot = findSlot(nsIndex, datatype, key);
+    if (slot == nullptr) {
+        ++mMisses;
+        return nullptr;
+    }
+    ++mHits;
+    slot->mLastUse = ++mClock;
+    dataSize = slot->mDataSize;
+    return slot->mData;
+}
+
+void ReadCache::insert(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    if (dataSize > MAX_DATA_SIZE || mCapacity == 0) {
+        return;
+    }
+    if (mSlots == nullptr) {
+        mSlots = new (std::nothrow) Slot[mCapacity];
+        if (mSlots == nullptr) {
+            mCapacity = 0;
+            return;
+        }
+        for (size_t i = 0; i < mCapacity; ++i) {
+            mSlots[i].mValid = false;
+        }
+    }
+
+    Slot* slot = findSlot(nsIndex, datatype, key);
+    if (slot == nullptr) {
+        // take a free slot, or else the one unused for the longest time; comparing ages keeps working
+        // when the clock wraps around
+        uint32_t maxAge = 0;
+        for (size_t i = 0; i < mCapacity; ++i) {
+            if (!mSlots[i].mValid) {
+                slot = &mSlots[i];
+                break;
+            }
+            const uint32_t age = mClock - mSlots[i].mLastUse;
+            if (slot == nullptr || age > maxAge) {
+                slot = &mSlots[i];
+                maxAge = age;
+            }
+        }
+        if (slot->mValid) {
+            ++mEvictions;
+        } else {
+            slot->mValid = true;
+            ++mCount;
+        }
+        slot->mNsIndex = nsIndex;
+        slot->mDatatype = datatype;
+        strncpy(slot->mKey, key, sizeof(slot->mKey) - 1);
+        slot->mKey[sizeof(slot->mKey) - 1] = 0;
+    }
+    memcpy(slot->mData, data, dataSize);
+    slot->mDataSize = static_cast<uint8_t>(dataSize);
+    slot->mLastUse = ++mClock;
+}
+
+void ReadCache::invalidate(uint8_t nsIndex, const char* key)
+{
+    if (mCount == 0) {
+        return;
+    }
+    for (size_t i = 0; i < mCapacity; ++i) {
+        Slot& slot = mSlots[i];
+        if (slot.mValid && slot.mNsIndex == nsIndex && strncmp(slot.mKey, key, Item::MAX_KEY_LENGTH) == 0) {
+            slot.mValid = false;
+            --mCount;
+        }
+    }
+}
+
+void ReadCache::invalidateNamespace(uint8_t nsIndex)
+{
+    if (mCount == 0) {
+        return;
+    }
+    for (size_t i = 0; i < mCapacity; ++i) {
+        Slot& slot = mSlots[i];
+        if (slot.mValid && slot.mNsIndex == nsIndex) {
+            slot.mValid = false;
+            --mCount;
+        }
+    }
+}
+
+void ReadCache::clear()
+{
+    for (size_t i = 0; mSlots != nullptr && i < mCapacity; ++i) {
+        mSlots[i].mValid = false;
+    }
+    mCount = 0;
+    mHits = 0;
+    mMisses = 0;
+    mEvictions = 0;
+}
+
+void ReadCache::getStats(nvs_cache_stats_t& stats) const
+{
+    stats.hits = mHits;
+    stats.misses = mMisses;
+    stats.evictions = mEvictions;
+    stats.cached_items = mCount;
+}
+
+} // namespace nvs
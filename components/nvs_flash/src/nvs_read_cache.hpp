@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef nvs_read_cache_hpp
+#define nvs_read_cache_hpp
+
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+/**
+ * Small LRU cache of item values, keyed by namespace index, type and key.
+ *
+ * Only values up to MAX_DATA_SIZE bytes are cached, i.e. integers and short strings. The cache doesn't know
+ * anything about flash, Storage has to invalidate entries whenever the underlying items are written or erased.
+ * Slots are allocated on the first insert; if that fails, the cache stays empty and every lookup is a miss.
+ */
+class ReadCache
+{
+public:
+    static const size_t MAX_DATA_SIZE = 32;
+
+    ReadCache(size_t capacity);
+    ~ReadCache();
+
+    /**
+     * Returns the cached value and its size, or nullptr if the value isn't cached.
+     * Counts a hit or a miss.
+     */
+    const uint8_t* find(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize);
+
+    /**
+     * Caches a value, evicting the least recently used one if all slots are taken.
+     * Values larger than MAX_DATA_SIZE are ignored.
+     */
+    void insert(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    /**
+     * Drops the values of all types cached for the key.
+     */
+    void invalidate(uint8_t nsIndex, const char* key);
+
+    void invalidateNamespace(uint8_t nsIndex);
+
+    /**
+     * Drops all cached values and resets the statistics.
+     */
+    void clear();
+
+    void getStats(nvs_cache_stats_t& stats) const;
+
+private:
+    ReadCache(const ReadCache& other);
+    const ReadCache& operator= (const ReadCache& rhs);
+
+protected:
+    struct Slot {
+        uint32_t mLastUse;
+        uint8_t mNsIndex;
+        ItemType mDatatype;
+        uint8_t mDataSize;
+        bool mValid;
+        char mKey[Item::MAX_KEY_LENGTH + 1];
+        uint8_t mData[MAX_DATA_SIZE];
+    };
+
+    Slot* findSlot(uint8_t nsIndex, ItemType datatype, const char* key);
+
+    Slot* mSlots = nullptr;
+    size_t mCapacity;
+    size_t mCount = 0;
+    uint32_t mClock = 0;
+    uint32_t mHits = 0;
+    uint32_t mMisses = 0;
+    uint32_t mEvictions = 0;
+}; // class ReadCache
+
+} // namespace nvs
+
+#endif /* nvs_read_cache_hpp */
@@ -90,38 +90,115 @@ void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
     }
 }
 
-esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
+esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount, bool lazy)
 {
-    auto err = mPageManager.load(mPartition, baseSector, sectorCount);
+#if CONFIG_NVS_READ_CACHE
+    mReadCache.clear();
+#endif
+#if CONFIG_NVS_GLOBAL_KEY_INDEX
+    // pages add their items to the index while they are being loaded
+    mKeyIndex.clear();
+    auto err = mPageManager.load(mPartition, baseSector, sectorCount, &mKeyIndex, lazy);
+#else
+    auto err = mPageManager.load(mPartition, baseSector, sectorCount, nullptr, lazy);
+#endif
     if (err != ESP_OK) {
         mState = StorageState::INVALID;
         return err;
     }
 
-    // load namespaces list
+    // load namespaces list, for a lazy load only from the pages loaded so far
+    err = loadNamespaces();
+    if (err != ESP_OK) {
+        return err;
+    }
+    mState = StorageState::ACTIVE;
+
+    // for a lazy load, the rest is done by completeLoad()
+    mLoadPending = lazy;
+    if (!lazy) {
+        err = eraseOrphans();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+#ifdef DEBUG_STORAGE
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
+esp_err_t Storage::completeLoad()
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (!mLoadPending) {
+        return ESP_OK;
+    }
+
+    auto err = mPageManager.loadAll();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = loadNamespaces();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = eraseOrphans();
+    if (err != ESP_OK) {
+        return err;
+    }
+    mLoadPending = false;
+
+#ifdef DEBUG_STORAGE
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
+esp_err_t Storage::addNamespace(Item& item)
+{
+    NamespaceEntry* entry = new (std::nothrow) NamespaceEntry;
+
+    if (!entry) {
+        mState = StorageState::INVALID;
+        return ESP_ERR_NO_MEM;
+    }
+
+    item.getKey(entry->mName, sizeof(entry->mName));
+    auto err = item.getValue(entry->mIndex);
+    if (err != ESP_OK) {
+        delete entry;
+        return err;
+    }
+    mNamespaces.push_back(entry);
+    if (mNamespaceUsage.set(entry->mIndex, true) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::loadNamespaces()
+{
     clearNamespaces();
     std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
     for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
         Page& p = *it;
+        if (!p.isLoaded()) {
+            // picked up by createOrOpenNamespace() or completeLoad()
+            continue;
+        }
         size_t itemIndex = 0;
         Item item;
         while (p.findItem(Page::NS_INDEX, ItemType::U8, nullptr, itemIndex, item) == ESP_OK) {
-            NamespaceEntry* entry = new (std::nothrow) NamespaceEntry;
-
-            if (!entry) {
-                mState = StorageState::INVALID;
-                return ESP_ERR_NO_MEM;
-            }
-
-            item.getKey(entry->mName, sizeof(entry->mName));
-            err = item.getValue(entry->mIndex);
+            auto err = addNamespace(item);
             if (err != ESP_OK) {
                 return err;
             }
-            mNamespaces.push_back(entry);
-            if (mNamespaceUsage.set(entry->mIndex, true) != ESP_OK) {
-                return ESP_FAIL;
-            }
             itemIndex += item.span;
         }
     }
@@ -131,13 +208,17 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     if (mNamespaceUsage.set(255, true) != ESP_OK) {
         return ESP_FAIL;
     }
-    mState = StorageState::ACTIVE;
+    return ESP_OK;
+}
 
+esp_err_t Storage::eraseOrphans()
+{
     // Populate list of multi-page index entries.
     TBlobIndexList blobIdxList;
-    err = populateBlobIndices(blobIdxList);
+    auto err = populateBlobIndices(blobIdxList);
     if (err != ESP_OK) {
         mState = StorageState::INVALID;
+        blobIdxList.clearAndFreeNodes();
         return ESP_ERR_NO_MEM;
     }
 
@@ -146,10 +227,6 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
 
     // Purge the blob index list
     blobIdxList.clearAndFreeNodes();
-
-#ifdef DEBUG_STORAGE
-    debugCheck();
-#endif
     return ESP_OK;
 }
 
@@ -159,6 +236,60 @@ bool Storage::isValid() const
 }
 
 esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+#if CONFIG_NVS_GLOBAL_KEY_INDEX
+    // same condition under which Page::findItem consults its hash list,
+    // the index is only complete once all pages have been loaded
+    if (mKeyIndex.isValid() && mPageManager.isLoaded() && nsIndex != Page::NS_ANY && datatype != ItemType::ANY && key != nullptr) {
+        return lookupItem(nsIndex, datatype, key, page, item, chunkIdx, chunkStart);
+    }
+#endif
+    return scanItem(nsIndex, datatype, key, page, item, chunkIdx, chunkStart);
+}
+
+#if CONFIG_NVS_GLOBAL_KEY_INDEX
+esp_err_t Storage::lookupItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+{
+    const uint32_t hash = KeyIndex::hash(Item(nsIndex, datatype, 0, key, chunkIdx));
+    Page* found = nullptr;
+    uint32_t foundSeqNumber = 0;
+    size_t pos = 0;
+    uint32_t sector;
+    size_t index;
+
+    // A hash may be recorded on several pages, e.g. while an item is being rewritten or on a hash collision.
+    // Page list is ordered by sequence number, so pick the oldest matching page, like scanItem() does.
+    while (mKeyIndex.find(hash, pos, sector, index)) {
+        Page* candidate = mPageManager.getPage(sector);
+        uint32_t seqNumber;
+        if (candidate == nullptr || candidate == found
+                || candidate->getSeqNumber(seqNumber) != ESP_OK
+                || (found != nullptr && seqNumber >= foundSeqNumber)) {
+            continue;
+        }
+        size_t itemIndex = 0;
+        Item candidateItem;
+        const size_t indexSize = mKeyIndex.size();
+        if (candidate->findItem(nsIndex, datatype, key, itemIndex, candidateItem, chunkIdx, chunkStart) == ESP_OK) {
+            found = candidate;
+            foundSeqNumber = seqNumber;
+            item = candidateItem;
+        }
+        if (mKeyIndex.size() != indexSize) {
+            // findItem erased a corrupted entry, which may have moved slots around
+            pos = 0;
+        }
+    }
+
+    if (found == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    page = found;
+    return ESP_OK;
+}
+#endif // CONFIG_NVS_GLOBAL_KEY_INDEX
+
+esp_err_t Storage::scanItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
 {
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         size_t itemIndex = 0;
@@ -282,10 +413,22 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+#if CONFIG_NVS_READ_CACHE
+    mReadCache.invalidate(nsIndex, key);
+#endif
+
     Page* findPage = nullptr;
     Item item;
 
     esp_err_t err;
+    if (datatype == ItemType::BLOB) {
+        // chunks left over by an interrupted blob write might collide with the new ones
+        err = completeLoad();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
     if (datatype == ItemType::BLOB) {
         err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
     } else {
@@ -409,6 +552,146 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
     return ESP_OK;
 }
 
+esp_err_t Storage::writeBatch(uint8_t nsIndex, TBatchList& batch)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    Page* findPage = nullptr;
+    Item item;
+    esp_err_t err;
+    size_t entryCount = 0;
+
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        if (it->mDatatype == ItemType::BLOB) {
+            // same as in writeItem()
+            err = completeLoad();
+            if (err != ESP_OK) {
+                return err;
+            }
+            break;
+        }
+    }
+
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        it->mSkip = false;
+        it->mReplace = false;
+        it->mChunkStart = VerOffset::VER_0_OFFSET;
+#if CONFIG_NVS_READ_CACHE
+        mReadCache.invalidate(nsIndex, it->mKey);
+#endif
+
+        if (it->mDatatype == ItemType::BLOB) {
+            err = findItem(nsIndex, ItemType::BLOB_IDX, it->mKey, findPage, item);
+            if (err == ESP_OK) {
+                if (cmpMultiPageBlob(nsIndex, it->mKey, it->mData, it->mDataSize) == ESP_OK) {
+                    it->mSkip = true;
+                    continue;
+                }
+                /* Toggle the version, as writeItem() does */
+                it->mReplace = true;
+                it->mChunkStart = (item.blobIndex.chunkStart == VerOffset::VER_1_OFFSET) ?
+                        VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+            } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+                /* Support for earlier versions where BLOBS were stored without index */
+                err = findItem(nsIndex, ItemType::BLOB, it->mKey, findPage, item);
+                it->mReplace = (err == ESP_OK);
+            }
+        } else {
+            err = findItem(nsIndex, it->mDatatype, it->mKey, findPage, item);
+            if (err == ESP_OK) {
+                if (findPage->cmpItem(nsIndex, it->mDatatype, it->mKey, it->mData, it->mDataSize) == ESP_OK) {
+                    it->mSkip = true;
+                    continue;
+                }
+                it->mReplace = true;
+            }
+        }
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            return err;
+        }
+        entryCount += it->getEntryCount();
+    }
+
+    if (entryCount == 0) {
+        return ESP_OK;
+    }
+
+    // the batch is only atomic if all of it goes onto the same page
+    if (entryCount > Page::ENTRY_COUNT) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    if (getCurrentPage().getFreeEntryCount() < entryCount) {
+        // The current page is only left if the new one takes the whole batch, otherwise the
+        // entries still free on it would be lost to the following writes as well
+        size_t newPageFree;
+        err = mPageManager.getNewPageFreeEntryCount(newPageFree);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (newPageFree < entryCount) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        Page& page = getCurrentPage();
+        if (page.state() != Page::PageState::FULL) {
+            err = page.markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = mPageManager.requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    err = getCurrentPage().writeItems(nsIndex, batch);
+    if (err == ESP_ERR_NVS_PAGE_FULL) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // The new values are committed now. Previous values are found before the new ones,
+    // either on an older page or at a lower index of the current page.
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+        if (it->mSkip || !it->mReplace) {
+            continue;
+        }
+
+        if (it->mDatatype == ItemType::BLOB) {
+            VerOffset prevStart = (it->mChunkStart == VerOffset::VER_1_OFFSET) ?
+                    VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+            err = eraseMultiPageBlob(nsIndex, it->mKey, prevStart);
+            if (err == ESP_ERR_NVS_NOT_FOUND) {
+                err = findItem(nsIndex, ItemType::BLOB, it->mKey, findPage, item);
+                if (err == ESP_OK) {
+                    err = findPage->eraseItem(nsIndex, ItemType::BLOB, it->mKey);
+                }
+            }
+        } else {
+            err = findItem(nsIndex, it->mDatatype, it->mKey, findPage, item);
+            if (err == ESP_OK) {
+                err = findPage->eraseItem(nsIndex, it->mDatatype, it->mKey);
+            }
+        }
+
+        if (err == ESP_ERR_FLASH_OP_FAIL) {
+            return ESP_ERR_NVS_REMOVE_FAILED;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+#ifdef DEBUG_STORAGE
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
 esp_err_t Storage::createOrOpenNamespace(const char* nsName, bool canCreate, uint8_t& nsIndex)
 {
     if (mState != StorageState::ACTIVE) {
@@ -417,6 +700,29 @@ esp_err_t Storage::createOrOpenNamespace(const char* nsName, bool canCreate, uin
     auto it = std::find_if(mNamespaces.begin(), mNamespaces.end(), [=] (const NamespaceEntry& e) -> bool {
         return strncmp(nsName, e.mName, sizeof(e.mName) - 1) == 0;
     });
+    if (it == std::end(mNamespaces) && mLoadPending) {
+        // the namespace entry may be on a page which hasn't been loaded yet
+        Page* findPage = nullptr;
+        Item item;
+        auto err = scanItem(Page::NS_INDEX, ItemType::U8, nsName, findPage, item);
+        if (err == ESP_OK) {
+            err = addNamespace(item);
+            if (err != ESP_OK) {
+                return err;
+            }
+            nsIndex = mNamespaces.back().mIndex;
+            return ESP_OK;
+        }
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            return err;
+        }
+
+        // a new index can only be picked once all namespaces are known
+        err = completeLoad();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
     if (it == std::end(mNamespaces)) {
         if (!canCreate) {
             return ESP_ERR_NVS_NOT_FOUND;
@@ -560,12 +866,38 @@ esp_err_t Storage::readItem(uint8_t nsIndex, ItemType datatype, const char* key,
             return err;
         } // else check if the blob is stored with earlier version format without index
     }
+#if CONFIG_NVS_READ_CACHE
+    else {
+        size_t cachedSize;
+        const uint8_t* cached = mReadCache.find(nsIndex, datatype, key, cachedSize);
+        if (cached != nullptr) {
+            // same checks as in Page::readItem()
+            if (!isVariableLengthType(datatype) && dataSize != cachedSize) {
+                return ESP_ERR_NVS_TYPE_MISMATCH;
+            }
+            if (dataSize < cachedSize) {
+                return ESP_ERR_NVS_INVALID_LENGTH;
+            }
+            memcpy(data, cached, cachedSize);
+            return ESP_OK;
+        }
+    }
+#endif
 
     auto err = findItem(nsIndex, datatype, key, findPage, item);
     if (err != ESP_OK) {
         return err;
     }
+#if CONFIG_NVS_READ_CACHE
+    err = findPage->readItem(nsIndex, datatype, key, data, dataSize);
+    if (err == ESP_OK && datatype != ItemType::BLOB) {
+        mReadCache.insert(nsIndex, datatype, key, data,
+                isVariableLengthType(datatype) ? item.varLength.dataSize : dataSize);
+    }
+    return err;
+#else
     return findPage->readItem(nsIndex, datatype, key, data, dataSize);
+#endif
 
 }
 
@@ -620,6 +952,10 @@ esp_err_t Storage::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+#if CONFIG_NVS_READ_CACHE
+    mReadCache.invalidate(nsIndex, key);
+#endif
+
     if (datatype == ItemType::BLOB) {
         return eraseMultiPageBlob(nsIndex, key);
     }
@@ -644,6 +980,10 @@ esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+#if CONFIG_NVS_READ_CACHE
+    mReadCache.invalidateNamespace(nsIndex);
+#endif
+
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         while (true) {
             auto err = it->eraseItem(nsIndex, ItemType::ANY, nullptr);
@@ -665,6 +1005,15 @@ esp_err_t Storage::getItemDataSize(uint8_t nsIndex, ItemType datatype, const cha
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+#if CONFIG_NVS_READ_CACHE
+    if (datatype == ItemType::SZ) {
+        const uint8_t* cached = mReadCache.find(nsIndex, datatype, key, dataSize);
+        if (cached != nullptr) {
+            return ESP_OK;
+        }
+    }
+#endif
+
     Item item;
     Page* findPage = nullptr;
     auto err = findItem(nsIndex, datatype, key, findPage, item);
@@ -697,6 +1046,10 @@ void Storage::debugCheck()
     std::map<std::string, Page*> keys;
 
     for (auto p = mPageManager.begin(); p != mPageManager.end(); ++p) {
+        if (!p->isLoaded()) {
+            // checking would load it
+            continue;
+        }
         size_t itemIndex = 0;
         size_t usedCount = 0;
         Item item;
@@ -710,6 +1063,20 @@ void Storage::debugCheck()
                 assert(0);
             }
             keys.insert(std::make_pair(keystr, static_cast<Page*>(p)));
+#if CONFIG_NVS_GLOBAL_KEY_INDEX
+            if (mKeyIndex.isValid() && mPageManager.isLoaded() && item.datatype != ItemType::ANY) {
+                // index lookup must agree with a full scan
+                Page* indexedPage = nullptr;
+                Page* scannedPage = nullptr;
+                Item indexedItem;
+                Item scannedItem;
+                auto indexedErr = lookupItem(item.nsIndex, item.datatype, item.key, indexedPage, indexedItem, item.chunkIndex, VerOffset::VER_ANY);
+                auto scannedErr = scanItem(item.nsIndex, item.datatype, item.key, scannedPage, scannedItem, item.chunkIndex);
+                assert(indexedErr == scannedErr);
+                assert(indexedErr != ESP_OK || indexedPage == scannedPage);
+            }
+#endif
+
             itemIndex += item.span;
             usedCount += item.span;
         }
@@ -720,6 +1087,11 @@ void Storage::debugCheck()
 
 esp_err_t Storage::fillStats(nvs_stats_t& nvsStats)
 {
+    // namespaces are only all known after a complete load
+    auto err = completeLoad();
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_INITIALIZED) {
+        return err;
+    }
     nvsStats.namespace_count = mNamespaces.size();
     return mPageManager.fillStats(nvsStats);
 }
@@ -767,6 +1139,11 @@ void Storage::fillEntryInfo(Item &item, nvs_entry_info_t &info)
 
 bool Storage::findEntry(nvs_opaque_iterator_t* it, const char* namespace_name)
 {
+    // entry info is filled in from the list of namespaces, which is only complete after a complete load
+    if (completeLoad() != ESP_OK) {
+        return false;
+    }
+
     it->entryIndex = 0;
     it->nsIndex = Page::NS_ANY;
     it->page = mPageManager.begin();
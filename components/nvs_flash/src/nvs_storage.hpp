@@ -20,7 +20,10 @@
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
+#include "nvs_key_index.hpp"
+#include "nvs_read_cache.hpp"
 #include "partition.hpp"
+#include "sdkconfig.h"
 
 //extern void dumpBytes(const uint8_t* data, size_t count);
 
@@ -67,7 +70,17 @@ public:
         }
     };
 
-    esp_err_t init(uint32_t baseSector, uint32_t sectorCount);
+    /**
+     * With lazy set, only page headers and entry state tables of full pages are read, their items are read
+     * when the page is first accessed. Cleanup of orphaned blob chunks is deferred to completeLoad().
+     */
+    esp_err_t init(uint32_t baseSector, uint32_t sectorCount, bool lazy = false);
+
+    /**
+     * Finishes a lazy init(): loads the remaining pages and erases orphaned blob chunks.
+     * Does nothing if the storage is already completely loaded.
+     */
+    esp_err_t completeLoad();
 
     bool isValid() const;
 
@@ -75,6 +88,8 @@ public:
 
     esp_err_t writeItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
 
+    esp_err_t writeBatch(uint8_t nsIndex, TBatchList& batch);
+
     esp_err_t readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize);
 
     esp_err_t getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize);
@@ -129,6 +144,13 @@ public:
 
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
+#if CONFIG_NVS_READ_CACHE
+    void fillCacheStats(nvs_cache_stats_t& cacheStats) const
+    {
+        mReadCache.getStats(cacheStats);
+    }
+#endif
+
     esp_err_t calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries);
 
     bool findEntry(nvs_opaque_iterator_t*, const char* name);
@@ -144,6 +166,12 @@ protected:
 
     void clearNamespaces();
 
+    esp_err_t addNamespace(Item& item);
+
+    esp_err_t loadNamespaces();
+
+    esp_err_t eraseOrphans();
+
     esp_err_t populateBlobIndices(TBlobIndexList&);
 
     void eraseOrphanDataBlobs(TBlobIndexList&);
@@ -152,6 +180,12 @@ protected:
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    esp_err_t scanItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+
+#if CONFIG_NVS_GLOBAL_KEY_INDEX
+    esp_err_t lookupItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart);
+#endif
+
 protected:
     Partition *mPartition;
     size_t mPageCount;
@@ -159,6 +193,13 @@ protected:
     TNamespaces mNamespaces;
     CompressedEnumTable<bool, 1, 256> mNamespaceUsage;
     StorageState mState = StorageState::INVALID;
+    bool mLoadPending = false;
+#if CONFIG_NVS_GLOBAL_KEY_INDEX
+    KeyIndex mKeyIndex;
+#endif
+#if CONFIG_NVS_READ_CACHE
+    ReadCache mReadCache{CONFIG_NVS_READ_CACHE_SIZE};
+#endif
 };
 
 } // namespace nvs
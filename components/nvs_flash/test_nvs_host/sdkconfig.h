@@ -3,3 +3,7 @@
 #define CONFIG_LOG_TIMESTAMP_SOURCE_RTOS 1
 #define CONFIG_IDF_TARGET_LINUX 1
 #define CONFIG_NVS_ASSERT_ERROR_CHECK 1
+#define CONFIG_NVS_GLOBAL_KEY_INDEX 1
+#define CONFIG_NVS_LAZY_MOUNT 1
+#define CONFIG_NVS_READ_CACHE 1
+#define CONFIG_NVS_READ_CACHE_SIZE 16
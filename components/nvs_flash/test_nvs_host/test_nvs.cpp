@@ -19,6 +19,10 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <string>
+#include <chrono>
+#include <new>
+#include <malloc.h>
+#include <cassert>
 
 #include "test_fixtures.hpp"
 
@@ -30,6 +34,74 @@ using namespace nvs;
 
 stringstream s_perf;
 
+/* Heap usage of operator new while a HeapUsageCounter exists, so that benchmarks can report RAM used by
+ * NVS objects. Outside of it, operator new and delete are plain malloc and free. */
+class HeapUsageCounter
+{
+public:
+    HeapUsageCounter()
+    {
+        assert(s_active == nullptr);
+        s_active = this;
+    }
+
+    ~HeapUsageCounter()
+    {
+        s_active = nullptr;
+    }
+
+    ptrdiff_t bytes() const
+    {
+        return mBytes;
+    }
+
+    ptrdiff_t blocks() const
+    {
+        return mBlocks;
+    }
+
+    static void allocated(void* ptr)
+    {
+        if (s_active) {
+            s_active->mBytes += malloc_usable_size(ptr);
+            ++s_active->mBlocks;
+        }
+    }
+
+    static void freed(void* ptr)
+    {
+        if (s_active) {
+            s_active->mBytes -= malloc_usable_size(ptr);
+            --s_active->mBlocks;
+        }
+    }
+
+private:
+    static HeapUsageCounter* s_active;
+    ptrdiff_t mBytes = 0;
+    ptrdiff_t mBlocks = 0;
+};
+
+HeapUsageCounter* HeapUsageCounter::s_active = nullptr;
+
+void* operator new(size_t size)
+{
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    HeapUsageCounter::allocated(p);
+    return p;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr) {
+        HeapUsageCounter::freed(ptr);
+        free(ptr);
+    }
+}
+
 void dumpBytes(const uint8_t* data, size_t count)
 {
     for (uint32_t i = 0; i < count; ++i) {
@@ -285,9 +357,9 @@ TEST_CASE("Page handles invalid CRC of variable length items", "[nvs][cur]")
 class HashListTestHelper : public HashList
 {
     public:
-        size_t getBlockCount()
+        size_t getCapacity()
         {
-            return mBlockList.size();
+            return mCapacity;
         }
 };
 
@@ -302,13 +374,13 @@ TEST_CASE("HashList is cleaned up as soon as items are erased", "[nvs]")
         Item item(1, ItemType::U32, 1, key);
         hashlist.insert(item, i);
     }
-    INFO("Added " << count << " items, " << hashlist.getBlockCount() << " blocks");
+    INFO("Added " << count << " items, capacity " << hashlist.getCapacity());
     // Remove them in reverse order
     for (size_t i = count; i > 0; --i) {
         // Make sure that the element existed before it's erased
         CHECK(hashlist.erase(i - 1) == true);
     }
-    CHECK(hashlist.getBlockCount() == 0);
+    CHECK(hashlist.getCapacity() == 0);
     // Add again
     for (size_t i = 0; i < count; ++i) {
         char key[16];
@@ -316,12 +388,31 @@ TEST_CASE("HashList is cleaned up as soon as items are erased", "[nvs]")
         Item item(1, ItemType::U32, 1, key);
         hashlist.insert(item, i);
     }
-    INFO("Added " << count << " items, " << hashlist.getBlockCount() << " blocks");
+    INFO("Added " << count << " items, capacity " << hashlist.getCapacity());
     // Remove them in the same order
     for (size_t i = 0; i < count; ++i) {
         CHECK(hashlist.erase(i) == true);
     }
-    CHECK(hashlist.getBlockCount() == 0);
+    CHECK(hashlist.getCapacity() == 0);
+}
+
+TEST_CASE("HashList finds the lowest matching index at or after start", "[nvs]")
+{
+    HashList hashlist;
+    Item a(1, ItemType::U32, 1, "a");
+    Item b(1, ItemType::U32, 1, "b");
+    for (size_t i = 0; i < Page::ENTRY_COUNT; i += 3) {
+        TEST_ESP_OK(hashlist.insert(a, i));
+        TEST_ESP_OK(hashlist.insert(b, i + 1));
+    }
+    CHECK(hashlist.find(0, a) == 0);
+    CHECK(hashlist.find(1, a) == 3);
+    CHECK(hashlist.find(0, b) == 1);
+    CHECK(hashlist.find(125, a) == SIZE_MAX);
+    CHECK(hashlist.erase(3) == true);
+    CHECK(hashlist.erase(3) == false);
+    CHECK(hashlist.find(1, a) == 6);
+    CHECK(hashlist.find(0, Item(1, ItemType::U32, 1, "c")) == SIZE_MAX);
 }
 
 TEST_CASE("can init PageManager in empty flash", "[nvs]")
@@ -3158,6 +3249,744 @@ TEST_CASE("check and read data from partition generated via manufacturing utilit
 
 }
 
+TEST_CASE("key index returns all locations recorded for a hash", "[nvs]")
+{
+    KeyIndex index;
+    Item a(1, ItemType::U32, 1, "a");
+    Item b(1, ItemType::U32, 1, "b");
+
+    // enough items to force the table to grow a few times
+    for (size_t sector = 0; sector < 20; ++sector) {
+        for (size_t i = 0; i < Page::ENTRY_COUNT; i += 2) {
+            index.insert(a, sector, i);
+            index.insert(b, sector, i + 1);
+        }
+    }
+    CHECK(index.isValid());
+    CHECK(index.size() == 20 * Page::ENTRY_COUNT);
+
+    index.erase(a, 3, 10);
+    index.eraseSector(7);
+
+    size_t pos = 0;
+    size_t count = 0;
+    uint32_t sector;
+    size_t itemIndex;
+    const uint32_t hash = KeyIndex::hash(a);
+    while (index.find(hash, pos, sector, itemIndex)) {
+        CHECK(sector != 7);
+        CHECK(!(sector == 3 && itemIndex == 10));
+        CHECK(itemIndex % 2 == 0);
+        ++count;
+    }
+    CHECK(count == 19 * Page::ENTRY_COUNT / 2 - 1);
+    CHECK(index.size() == 19 * Page::ENTRY_COUNT - 1);
+
+    index.clear();
+    pos = 0;
+    CHECK(!index.find(hash, pos, sector, itemIndex));
+}
+
+class ScanningStorage : public Storage
+{
+public:
+    ScanningStorage(Partition *partition) : Storage(partition) { }
+
+    esp_err_t scan(uint8_t nsIndex, const char* key)
+    {
+        Page* page;
+        Item item;
+        return scanItem(nsIndex, ItemType::U32, key, page, item);
+    }
+
+    esp_err_t lookup(uint8_t nsIndex, const char* key)
+    {
+        Page* page;
+        Item item;
+        return findItem(nsIndex, ItemType::U32, key, page, item);
+    }
+};
+
+TEST_CASE("benchmark key lookup latency on a large partition", "[nvs]")
+{
+    const uint32_t PAGE_COUNT = 64;
+    const size_t ITEMS_PER_PAGE = Page::ENTRY_COUNT - 6;
+    const size_t LOOKUPS = 20000;
+    PartitionEmulationFixture f(0, PAGE_COUNT);
+
+    // fill all but one page directly, bypassing the (slow) debug checks of Storage
+    char key[16];
+    for (uint32_t sector = 0; sector < PAGE_COUNT - 1; ++sector) {
+        Page page;
+        REQUIRE(page.load(&f.part, sector) == ESP_OK);
+        REQUIRE(page.setSeqNumber(sector) == ESP_OK);
+        for (size_t i = 0; i < ITEMS_PER_PAGE; ++i) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(sector * ITEMS_PER_PAGE + i));
+            REQUIRE(page.writeItem(1, key, static_cast<uint32_t>(i)) == ESP_OK);
+        }
+        REQUIRE(page.markFull() == ESP_OK);
+    }
+
+    ScanningStorage storage(&f.part);
+    REQUIRE(storage.init(0, PAGE_COUNT) == ESP_OK);
+
+    const size_t itemCount = (PAGE_COUNT - 1) * ITEMS_PER_PAGE;
+    auto measure = [&](bool indexed, bool hit) -> double {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            size_t n = (i * 7919) % itemCount;
+            snprintf(key, sizeof(key), hit ? "key%u" : "nokey%u", static_cast<unsigned>(n));
+            esp_err_t err = indexed ? storage.lookup(1, key) : storage.scan(1, key);
+            CHECK(err == (hit ? ESP_OK : ESP_ERR_NVS_NOT_FOUND));
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        return static_cast<double>(elapsed.count()) / LOOKUPS;
+    };
+
+    s_perf << "Key lookup, " << itemCount << " items on " << PAGE_COUNT << " pages (ns per lookup):" << std::endl;
+    s_perf << "  page scan: hit " << measure(false, true) << ", miss " << measure(false, false) << std::endl;
+    s_perf << "  key index: hit " << measure(true, true) << ", miss " << measure(true, false) << std::endl;
+}
+
+TEST_CASE("benchmark heap used per mounted partition", "[nvs]")
+{
+    const uint32_t PAGE_COUNT = 16;
+    PartitionEmulationFixture f(0, PAGE_COUNT);
+
+    // half of the pages hold small integers, the other half strings spanning several entries
+    char key[16];
+    size_t itemCount = 0;
+    for (uint32_t sector = 0; sector < PAGE_COUNT - 1; ++sector) {
+        Page page;
+        REQUIRE(page.load(&f.part, sector) == ESP_OK);
+        REQUIRE(page.setSeqNumber(sector) == ESP_OK);
+        for (uint32_t i = 0; ; ++i, ++itemCount) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(itemCount));
+            esp_err_t err;
+            if (sector % 2) {
+                err = page.writeItem(1, ItemType::SZ, key, "a string value", 15);
+            } else {
+                err = page.writeItem(1, key, i);
+            }
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+        REQUIRE(page.markFull() == ESP_OK);
+    }
+
+    // the pages and their hash lists only, the global key index isn't used by PageManager on its own
+    {
+        HeapUsageCounter heap;
+        PageManager pageManager;
+        REQUIRE(pageManager.load(&f.part, 0, PAGE_COUNT) == ESP_OK);
+        s_perf << "Heap used by loaded pages, without key index (" << PAGE_COUNT << " pages, " << itemCount << " items): "
+               << heap.bytes() << " bytes in " << heap.blocks() << " blocks" << std::endl;
+    }
+    {
+        HeapUsageCounter heap;
+        Storage storage(&f.part);
+        REQUIRE(storage.init(0, PAGE_COUNT) == ESP_OK);
+        s_perf << "Heap used by mounted partition (" << PAGE_COUNT << " pages, " << itemCount << " items): "
+               << heap.bytes() << " bytes in " << heap.blocks() << " blocks" << std::endl;
+    }
+}
+
+TEST_CASE("batch values are written on commit and discarded on abort", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 5);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 5));
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+
+    uint8_t blob[200];
+    memset(blob, 0x5a, sizeof(blob));
+    TEST_ESP_OK(nvs_set_i32(handle, "a", 1));
+    TEST_ESP_OK(nvs_set_blob(handle, "b", blob, 10));
+
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    TEST_ESP_ERR(nvs_batch_begin(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_set_i32(handle, "a", 2));
+    TEST_ESP_OK(nvs_set_str(handle, "s", "hello"));
+    TEST_ESP_OK(nvs_set_blob(handle, "b", blob, sizeof(blob)));
+    TEST_ESP_OK(nvs_set_u8(handle, "c", 3));
+    // staging a key again replaces the staged value, also with another type
+    TEST_ESP_OK(nvs_set_u16(handle, "c", 5));
+    TEST_ESP_OK(nvs_set_u8(handle, "c", 4));
+    TEST_ESP_ERR(nvs_set_u8(handle, "0123456789abcdef", 1), ESP_ERR_NVS_KEY_TOO_LONG);
+    TEST_ESP_ERR(nvs_erase_key(handle, "a"), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_ERR(nvs_erase_all(handle), ESP_ERR_NVS_INVALID_STATE);
+
+    // staged values are not visible before commit
+    int32_t a;
+    uint8_t c;
+    TEST_ESP_OK(nvs_get_i32(handle, "a", &a));
+    CHECK(a == 1);
+    TEST_ESP_ERR(nvs_get_u8(handle, "c", &c), ESP_ERR_NVS_NOT_FOUND);
+
+    f.emu.clearStats();
+    TEST_ESP_OK(nvs_commit(handle));
+    CHECK(f.emu.getEraseOps() == 0);
+
+    auto checkCommitted = [&]() {
+        int32_t a;
+        uint8_t c;
+        char str[16];
+        size_t strSize = sizeof(str);
+        uint8_t readBlob[sizeof(blob)];
+        size_t blobSize = sizeof(readBlob);
+        TEST_ESP_OK(nvs_get_i32(handle, "a", &a));
+        CHECK(a == 2);
+        TEST_ESP_OK(nvs_get_u8(handle, "c", &c));
+        CHECK(c == 4);
+        TEST_ESP_OK(nvs_get_str(handle, "s", str, &strSize));
+        CHECK(strcmp(str, "hello") == 0);
+        TEST_ESP_OK(nvs_get_blob(handle, "b", readBlob, &blobSize));
+        CHECK(blobSize == sizeof(blob));
+        CHECK(memcmp(readBlob, blob, sizeof(blob)) == 0);
+    };
+    checkCommitted();
+    uint16_t c16;
+    TEST_ESP_ERR(nvs_get_u16(handle, "c", &c16), ESP_ERR_NVS_NOT_FOUND);
+
+    // commit ended the batch, so writes go to flash right away again
+    TEST_ESP_OK(nvs_erase_key(handle, "c"));
+    TEST_ESP_OK(nvs_set_u8(handle, "c", 4));
+
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "a", 5));
+    TEST_ESP_OK(nvs_batch_abort(handle));
+    TEST_ESP_ERR(nvs_batch_abort(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_commit(handle));
+    checkCommitted();
+
+    // values which are stored already are not written again
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    TEST_ESP_OK(nvs_set_i32(handle, "a", 2));
+    TEST_ESP_OK(nvs_set_blob(handle, "b", blob, sizeof(blob)));
+    f.emu.clearStats();
+    TEST_ESP_OK(nvs_commit(handle));
+    CHECK(f.emu.getWriteOps() == 0);
+
+    // the whole batch has to fit into one page
+    char key[16];
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    for (size_t i = 0; i < Page::ENTRY_COUNT + 1; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(nvs_set_u32(handle, key, i));
+    }
+    TEST_ESP_ERR(nvs_commit(handle), ESP_ERR_NVS_VALUE_TOO_LONG);
+    uint32_t value;
+    TEST_ESP_ERR(nvs_get_u32(handle, "key0", &value), ESP_ERR_NVS_NOT_FOUND);
+
+    nvs_handle_t readOnly;
+    TEST_ESP_OK(nvs_open("test", NVS_READONLY, &readOnly));
+    TEST_ESP_ERR(nvs_batch_begin(readOnly), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(readOnly);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+
+    // blobs written by a batch are regular single chunk blobs
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 5));
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    checkCommitted();
+    memset(blob, 0xa5, sizeof(blob));
+    TEST_ESP_OK(nvs_set_blob(handle, "b", blob, sizeof(blob)));
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+}
+
+TEST_CASE("batch commit is all or nothing after power loss at any point", "[nvs]")
+{
+    const size_t KEY_COUNT = 20;
+    char key[16];
+    uint8_t blob[100];
+    uint8_t filler[80 * Page::ENTRY_SIZE] = {0};
+
+    // the batch either goes to the page holding the old values, or needs a new page
+    for (bool newPage : {false, true}) {
+        for (uint32_t failAfter = 0; ; ++failAfter) {
+            PartitionEmulationFixture f(0, 3);
+            TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 3));
+            nvs_handle_t handle;
+            TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+            for (size_t i = 0; i < KEY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "k%u", static_cast<unsigned>(i));
+                TEST_ESP_OK(nvs_set_u32(handle, key, 0));
+            }
+            memset(blob, 0, sizeof(blob));
+            TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+            TEST_ESP_OK(nvs_set_str(handle, "str", "old"));
+            if (newPage) {
+                TEST_ESP_OK(nvs_set_blob(handle, "filler", filler, sizeof(filler)));
+            }
+
+            TEST_ESP_OK(nvs_batch_begin(handle));
+            for (size_t i = 0; i < KEY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "k%u", static_cast<unsigned>(i));
+                TEST_ESP_OK(nvs_set_u32(handle, key, i + 1));
+            }
+            // entries starting with erased words look unwritten, make sure they are cleaned up too
+            memset(blob, 1, sizeof(blob));
+            memset(blob, 0xff, 2 * Page::ENTRY_SIZE);
+            TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+            TEST_ESP_OK(nvs_set_str(handle, "str", "new"));
+
+            f.emu.failAfter(failAfter);
+            esp_err_t commitErr = nvs_commit(handle);
+            nvs_close(handle);
+            TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+
+            TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 3));
+            TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+            size_t newCount = 0;
+            for (size_t i = 0; i < KEY_COUNT; ++i) {
+                snprintf(key, sizeof(key), "k%u", static_cast<unsigned>(i));
+                uint32_t value;
+                TEST_ESP_OK(nvs_get_u32(handle, key, &value));
+                CHECK((value == 0 || value == i + 1));
+                newCount += (value != 0);
+            }
+            const bool committed = (newCount == KEY_COUNT);
+            CHECK((committed || newCount == 0));
+            CHECK((committed || commitErr != ESP_OK));
+
+            uint8_t readBlob[sizeof(blob)];
+            size_t blobSize = sizeof(readBlob);
+            TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &blobSize));
+            CHECK(readBlob[sizeof(blob) - 1] == (committed ? 1 : 0));
+            char str[8];
+            size_t strSize = sizeof(str);
+            TEST_ESP_OK(nvs_get_str(handle, "str", str, &strSize));
+            CHECK(strcmp(str, committed ? "new" : "old") == 0);
+
+            if (commitErr == ESP_OK) {
+                // the flash did not fail during commit, so all the failure points are covered
+                nvs_close(handle);
+                TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+                break;
+            }
+
+            // stale copies must not come back once the new values are updated again
+            TEST_ESP_OK(nvs_set_u32(handle, "k0", 100));
+            nvs_close(handle);
+            TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+            TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 3));
+            TEST_ESP_OK(nvs_open("test", NVS_READONLY, &handle));
+            uint32_t value;
+            TEST_ESP_OK(nvs_get_u32(handle, "k0", &value));
+            CHECK(value == 100);
+            nvs_close(handle);
+            TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+        }
+    }
+}
+
+TEST_CASE("batch which fits on no page leaves the current page in use", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 2);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 2));
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+
+    // namespace entry, blob index and 101 data entries leave 23 free entries on the only used page
+    uint8_t filler[100 * Page::ENTRY_SIZE] = {0};
+    TEST_ESP_OK(nvs_set_blob(handle, "filler", filler, sizeof(filler)));
+    nvs_stats_t stats;
+    TEST_ESP_OK(nvs_get_stats(f.part.get_partition_name(), &stats));
+    const size_t freeEntries = stats.free_entries;
+
+    char key[16];
+    TEST_ESP_OK(nvs_batch_begin(handle));
+    for (size_t i = 0; i < 30; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(nvs_set_u32(handle, key, i));
+    }
+    f.emu.clearStats();
+    TEST_ESP_ERR(nvs_commit(handle), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    CHECK(f.emu.getEraseOps() == 0);
+
+    // the entries left on the page are still used by single writes
+    TEST_ESP_OK(nvs_set_u32(handle, "key0", 0));
+    CHECK(f.emu.getEraseOps() == 0);
+    TEST_ESP_OK(nvs_get_stats(f.part.get_partition_name(), &stats));
+    CHECK(stats.free_entries == freeEntries - 1);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+}
+
+TEST_CASE("benchmark batch commit against individual writes", "[nvs]")
+{
+    const size_t KEY_COUNT = 40;
+    char key[16];
+
+    auto measure = [&](bool batch, size_t& writeOps, size_t& writeTime) {
+        PartitionEmulationFixture f(0, 8);
+        TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 8));
+        nvs_handle_t handle;
+        TEST_ESP_OK(nvs_open("config", NVS_READWRITE, &handle));
+        f.emu.clearStats();
+        if (batch) {
+            TEST_ESP_OK(nvs_batch_begin(handle));
+        }
+        for (size_t i = 0; i < KEY_COUNT; ++i) {
+            snprintf(key, sizeof(key), "cfg%u", static_cast<unsigned>(i));
+            TEST_ESP_OK(nvs_set_u32(handle, key, i));
+        }
+        TEST_ESP_OK(nvs_commit(handle));
+        writeOps = f.emu.getWriteOps();
+        writeTime = f.emu.getTotalTime();
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+    };
+
+    size_t singleOps, singleTime, batchOps, batchTime;
+    measure(false, singleOps, singleTime);
+    measure(true, batchOps, batchTime);
+    CHECK(batchOps < singleOps);
+
+    s_perf << "Writing " << KEY_COUNT << " new u32 keys: individual sets " << singleOps << " flash writes, "
+           << singleTime << " us; batch " << batchOps << " flash writes, " << batchTime << " us" << std::endl;
+}
+
+static size_t fillFullPagesWithIntegers(PartitionEmulationFixture& f, uint32_t pageCount)
+{
+    char key[16];
+    size_t itemCount = 0;
+    for (uint32_t sector = 0; sector < pageCount; ++sector) {
+        Page page;
+        REQUIRE(page.load(&f.part, sector) == ESP_OK);
+        REQUIRE(page.setSeqNumber(sector) == ESP_OK);
+        if (sector == 0) {
+            REQUIRE(page.writeItem<uint8_t>(Page::NS_INDEX, "lazy", 1) == ESP_OK);
+        }
+        for (;; ++itemCount) {
+            snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(itemCount));
+            if (page.writeItem<uint32_t>(1, key, itemCount) != ESP_OK) {
+                break;
+            }
+        }
+        REQUIRE(page.markFull() == ESP_OK);
+    }
+    return itemCount;
+}
+
+TEST_CASE("lazy init reads items of full pages on first access", "[nvs][lazy]")
+{
+    const uint32_t PAGE_COUNT = 8;
+    PartitionEmulationFixture f(0, PAGE_COUNT);
+    const size_t itemCount = fillFullPagesWithIntegers(f, PAGE_COUNT - 2);
+    char key[16];
+
+    f.emu.clearStats();
+    {
+        Storage storage(&f.part);
+        TEST_ESP_OK(storage.init(0, PAGE_COUNT));
+    }
+    const size_t fullReadBytes = f.emu.getReadBytes();
+
+    f.emu.clearStats();
+    Storage storage(&f.part);
+    TEST_ESP_OK(storage.init(0, PAGE_COUNT, true));
+    CHECK(f.emu.getReadBytes() < fullReadBytes / 4);
+
+    // namespace entry is on a page which hasn't been loaded yet
+    uint8_t nsIndex;
+    TEST_ESP_OK(storage.createOrOpenNamespace("lazy", false, nsIndex));
+    CHECK(nsIndex == 1);
+
+    uint32_t val;
+    TEST_ESP_OK(storage.readItem(1, "key0", val));
+    CHECK(val == 0);
+    snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(itemCount - 1));
+    TEST_ESP_OK(storage.readItem(1, key, val));
+    CHECK(val == itemCount - 1);
+    TEST_ESP_ERR(storage.readItem(1, "missing", val), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(storage.writeItem<uint32_t>(1, "key5", 500));
+    TEST_ESP_OK(storage.eraseItem(1, "key6"));
+
+    // a new namespace must not reuse the index of one on an unloaded page
+    TEST_ESP_OK(storage.createOrOpenNamespace("other", true, nsIndex));
+    CHECK(nsIndex == 2);
+    TEST_ESP_OK(storage.completeLoad());
+
+    Storage reloaded(&f.part);
+    TEST_ESP_OK(reloaded.init(0, PAGE_COUNT));
+    TEST_ESP_OK(reloaded.readItem(1, "key5", val));
+    CHECK(val == 500);
+    TEST_ESP_ERR(reloaded.readItem(1, "key6", val), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(reloaded.readItem(1, "key7", val));
+    CHECK(val == 7);
+    nvs_stats_t stats;
+    TEST_ESP_OK(reloaded.fillStats(stats));
+    CHECK(stats.namespace_count == 2);
+    // items and both namespace entries, minus the erased key
+    CHECK(stats.used_entries == itemCount + 1);
+}
+
+TEST_CASE("lazy init removes duplicates left by power loss when the page is loaded", "[nvs][lazy]")
+{
+    PartitionEmulationFixture f(0, 4);
+    {
+        Page p;
+        p.load(&f.part, 0);
+        p.setSeqNumber(0);
+        p.writeItem<uint8_t>(1, "opmode", 3);
+        p.markFull();
+    }
+    {
+        // the new value was written, but power went out before the old one was erased
+        Page p;
+        p.load(&f.part, 1);
+        p.setSeqNumber(1);
+        p.writeItem<uint8_t>(1, "opmode", 2);
+    }
+    {
+        Storage storage(&f.part);
+        TEST_ESP_OK(storage.init(0, 4, true));
+        uint8_t val;
+        TEST_ESP_OK(storage.readItem(1, "opmode", val));
+        CHECK(val == 2);
+        // erasing the new value must not bring back the old one
+        TEST_ESP_OK(storage.eraseItem(1, "opmode"));
+    }
+    {
+        Storage storage(&f.part);
+        TEST_ESP_OK(storage.init(0, 4));
+        uint8_t val;
+        TEST_ESP_ERR(storage.readItem(1, "opmode", val), ESP_ERR_NVS_NOT_FOUND);
+    }
+}
+
+TEST_CASE("lazy init erases orphaned blobs before the next blob write", "[nvs][lazy]")
+{
+    const size_t blob_size = Page::CHUNK_MAX_SIZE * 3;
+    uint8_t blob[blob_size] = {0x11};
+    PartitionEmulationFixture f(0, 5);
+    Storage storage(&f.part);
+
+    TEST_ESP_OK(storage.init(0, 5));
+    TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "key", blob, sizeof(blob)));
+
+    Page p;
+    p.load(&f.part, 3); // This is where index will be placed.
+    p.erase();
+
+    TEST_ESP_OK(storage.init(0, 5, true));
+    TEST_ESP_ERR(storage.readItem(1, ItemType::BLOB, "key", blob, sizeof(blob)), ESP_ERR_NVS_NOT_FOUND);
+    // only fits once the orphaned chunks are gone
+    TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "key3", blob, sizeof(blob)));
+}
+
+TEST_CASE("nvs_flash_complete_load_partition finishes a lazy init", "[nvs][lazy]")
+{
+    PartitionEmulationFixture f(0, 8);
+    const size_t itemCount = fillFullPagesWithIntegers(f, 6);
+
+    TEST_ESP_ERR(nvs_flash_complete_load_partition(f.part.get_partition_name()), ESP_ERR_NVS_NOT_INITIALIZED);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 8));
+    TEST_ESP_OK(nvs_flash_complete_load_partition(f.part.get_partition_name()));
+    TEST_ESP_OK(nvs_flash_complete_load_partition(f.part.get_partition_name()));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("lazy", NVS_READONLY, &handle));
+    size_t used;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &used));
+    CHECK(used == itemCount);
+    nvs_close(handle);
+
+    TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+}
+
+TEST_CASE("benchmark lazy init against full init", "[nvs]")
+{
+    const uint32_t PAGE_COUNT = 64;
+    PartitionEmulationFixture f(0, PAGE_COUNT);
+    const size_t itemCount = fillFullPagesWithIntegers(f, PAGE_COUNT - 2);
+
+    auto measure = [&](bool lazy, size_t& initTime, size_t& firstReadTime, size_t& completeTime) {
+        Storage storage(&f.part);
+        f.emu.clearStats();
+        TEST_ESP_OK(storage.init(0, PAGE_COUNT, lazy));
+        initTime = f.emu.getTotalTime();
+
+        f.emu.clearStats();
+        uint32_t val;
+        TEST_ESP_OK(storage.readItem(1, "key0", val));
+        firstReadTime = f.emu.getTotalTime();
+
+        f.emu.clearStats();
+        TEST_ESP_OK(storage.completeLoad());
+        completeTime = f.emu.getTotalTime();
+    };
+
+    size_t fullInit, fullRead, fullComplete, lazyInit, lazyRead, lazyComplete;
+    measure(false, fullInit, fullRead, fullComplete);
+    measure(true, lazyInit, lazyRead, lazyComplete);
+    CHECK(lazyInit < fullInit);
+
+    s_perf << "Init of " << PAGE_COUNT << " pages with " << itemCount << " items: full " << fullInit
+           << " us (first read " << fullRead << " us); lazy " << lazyInit << " us (first read " << lazyRead
+           << " us, completing " << lazyComplete << " us)" << std::endl;
+}
+
+#if CONFIG_NVS_READ_CACHE
+TEST_CASE("read cache answers repeated reads and stays coherent with writes", "[nvs][cache]")
+{
+    PartitionEmulationFixture f(0, 4);
+    Storage storage(&f.part);
+    TEST_ESP_OK(storage.init(0, 4));
+    TEST_ESP_OK(storage.writeItem<uint32_t>(1, "int", 1));
+    TEST_ESP_OK(storage.writeItem(1, ItemType::SZ, "str", "hello", 6));
+
+    uint32_t val;
+    char str[8];
+    TEST_ESP_OK(storage.readItem(1, "int", val));
+    TEST_ESP_OK(storage.readItem(1, ItemType::SZ, "str", str, sizeof(str)));
+    f.emu.clearStats();
+    TEST_ESP_OK(storage.readItem(1, "int", val));
+    CHECK(val == 1);
+    TEST_ESP_OK(storage.readItem(1, ItemType::SZ, "str", str, sizeof(str)));
+    CHECK(strcmp(str, "hello") == 0);
+    size_t size;
+    TEST_ESP_OK(storage.getItemDataSize(1, ItemType::SZ, "str", size));
+    CHECK(size == 6);
+    CHECK(f.emu.getReadOps() == 0);
+
+    // cached values are checked like the ones read from flash
+    uint8_t small;
+    TEST_ESP_ERR(storage.readItem(1, ItemType::U32, "int", &small, sizeof(small)), ESP_ERR_NVS_TYPE_MISMATCH);
+    TEST_ESP_ERR(storage.readItem(1, ItemType::SZ, "str", str, 5), ESP_ERR_NVS_INVALID_LENGTH);
+    TEST_ESP_ERR(storage.readItem(1, "str", val), ESP_ERR_NVS_NOT_FOUND);
+
+    nvs_cache_stats_t stats;
+    storage.fillCacheStats(stats);
+    CHECK(stats.hits == 5);
+    CHECK(stats.misses == 3);
+    CHECK(stats.cached_items == 2);
+
+    TEST_ESP_OK(storage.writeItem<uint32_t>(1, "int", 2));
+    TEST_ESP_OK(storage.readItem(1, "int", val));
+    CHECK(val == 2);
+    TEST_ESP_OK(storage.eraseItem(1, "int"));
+    TEST_ESP_ERR(storage.readItem(1, "int", val), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(storage.eraseNamespace(1));
+    TEST_ESP_ERR(storage.readItem(1, ItemType::SZ, "str", str, sizeof(str)), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_ERR(storage.getItemDataSize(1, ItemType::SZ, "str", size), ESP_ERR_NVS_NOT_FOUND);
+
+    // values written by a batch are dropped from the cache as well
+    TEST_ESP_OK(storage.writeItem<uint32_t>(1, "int", 3));
+    TEST_ESP_OK(storage.readItem(1, "int", val));
+    TBatchList batch;
+    uint8_t* data = new uint8_t[sizeof(uint32_t)];
+    const uint32_t batchVal = 4;
+    memcpy(data, &batchVal, sizeof(batchVal));
+    BatchItem* item = new BatchItem(ItemType::U32, data, sizeof(uint32_t));
+    strcpy(item->mKey, "int");
+    batch.push_back(item);
+    TEST_ESP_OK(storage.writeBatch(1, batch));
+    batch.clearAndFreeNodes();
+    TEST_ESP_OK(storage.readItem(1, "int", val));
+    CHECK(val == 4);
+}
+
+TEST_CASE("read cache evicts the least recently used value", "[nvs][cache]")
+{
+    PartitionEmulationFixture f(0, 4);
+    Storage storage(&f.part);
+    TEST_ESP_OK(storage.init(0, 4));
+    char key[16];
+    uint32_t val;
+    for (uint32_t i = 0; i <= CONFIG_NVS_READ_CACHE_SIZE; ++i) {
+        snprintf(key, sizeof(key), "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(storage.writeItem(1, key, i));
+        TEST_ESP_OK(storage.readItem(1, key, val));
+        // keep the first key in use
+        TEST_ESP_OK(storage.readItem(1, "key0", val));
+    }
+
+    nvs_cache_stats_t stats;
+    storage.fillCacheStats(stats);
+    CHECK(stats.evictions == 1);
+    CHECK(stats.cached_items == CONFIG_NVS_READ_CACHE_SIZE);
+
+    f.emu.clearStats();
+    TEST_ESP_OK(storage.readItem(1, "key0", val));
+    CHECK(f.emu.getReadOps() == 0);
+    TEST_ESP_OK(storage.readItem(1, "key1", val));
+    CHECK(val == 1);
+    CHECK(f.emu.getReadOps() != 0);
+}
+
+TEST_CASE("nvs_get_cache_stats reports hits and misses", "[nvs][cache]")
+{
+    PartitionEmulationFixture f(0, 4);
+    nvs_cache_stats_t stats;
+    TEST_ESP_ERR(nvs_get_cache_stats(f.part.get_partition_name(), nullptr), ESP_ERR_INVALID_ARG);
+    TEST_ESP_ERR(nvs_get_cache_stats(f.part.get_partition_name(), &stats), ESP_ERR_NVS_NOT_INITIALIZED);
+
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 4));
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("cache", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "hot", 42));
+    uint32_t val;
+    for (int i = 0; i < 10; ++i) {
+        TEST_ESP_OK(nvs_get_u32(handle, "hot", &val));
+        CHECK(val == 42);
+    }
+    nvs_close(handle);
+
+    TEST_ESP_OK(nvs_get_cache_stats(f.part.get_partition_name(), &stats));
+    CHECK(stats.hits == 9);
+    CHECK(stats.misses == 1);
+    CHECK(stats.cached_items == 1);
+    TEST_ESP_OK(nvs_flash_deinit_partition(f.part.get_partition_name()));
+}
+
+TEST_CASE("benchmark reads of hot keys with the read cache", "[nvs]")
+{
+    const uint32_t PAGE_COUNT = 16;
+    const size_t HOT_KEYS = 12;
+    const size_t ROUNDS = 100;
+    PartitionEmulationFixture f(0, PAGE_COUNT);
+    fillFullPagesWithIntegers(f, PAGE_COUNT - 2);
+    Storage storage(&f.part);
+    TEST_ESP_OK(storage.init(0, PAGE_COUNT));
+
+    // pick keys spread over all pages
+    char keys[HOT_KEYS][16];
+    for (size_t i = 0; i < HOT_KEYS; ++i) {
+        snprintf(keys[i], sizeof(keys[i]), "key%u", static_cast<unsigned>(i * 150));
+    }
+
+    auto readAll = [&]() {
+        uint32_t val;
+        for (size_t i = 0; i < HOT_KEYS; ++i) {
+            TEST_ESP_OK(storage.readItem(1, keys[i], val));
+        }
+    };
+
+    f.emu.clearStats();
+    readAll();
+    const size_t coldTime = f.emu.getTotalTime();
+    f.emu.clearStats();
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        readAll();
+    }
+    const size_t hotTime = f.emu.getTotalTime();
+    CHECK(hotTime < coldTime);
+
+    nvs_cache_stats_t stats;
+    storage.fillCacheStats(stats);
+    s_perf << "Reading " << HOT_KEYS << " keys: first pass " << coldTime << " us of flash access, next "
+           << ROUNDS << " passes " << hotTime << " us (" << stats.hits << " hits, " << stats.misses
+           << " misses)" << std::endl;
+}
+#endif // CONFIG_NVS_READ_CACHE
+
 #if CONFIG_NVS_ENCRYPTION
 TEST_CASE("check underlying xts code for 32-byte size sector encryption", "[nvs]")
 {
@@ -0,0 +1,321 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "WL_Cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_log.h"
+
+static const char *TAG = "wl_cache";
+
+// Number of uncached erased sectors remembered per cache slot
+#define WL_CACHE_ERASED_HISTORY 4
+
+#define WL_CACHE_RESULT_CHECK(result) \
+    if (result != ESP_OK) { \
+        ESP_LOGE(TAG,"%s(%d): result = 0x%08x", __FUNCTION__, __LINE__, result); \
+        return (result); \
+    }
+
+WL_Cache::WL_Cache()
+{
+}
+
+WL_Cache::~WL_Cache()
+{
+    if (this->slots != NULL) {
+        for (size_t i = 0; i < this->slot_count; i++) {
+            free(this->slots[i].data);
+        }
+        free(this->slots);
+    }
+    free(this->erased);
+}
+
+esp_err_t WL_Cache::config(Flash_Access *flash_drv, size_t cache_sectors)
+{
+    if (flash_drv == NULL || cache_sectors == 0 || this->slots != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    this->flash_drv = flash_drv;
+    this->sec_size = flash_drv->sector_size();
+
+    this->slots = (Slot *)calloc(cache_sectors, sizeof(Slot));
+    if (this->slots == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    this->slot_count = cache_sectors;
+    for (size_t i = 0; i < cache_sectors; i++) {
+        this->slots[i].data = (uint8_t *)malloc(this->sec_size);
+        if (this->slots[i].data == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    this->erased_count = cache_sectors * WL_CACHE_ERASED_HISTORY;
+    this->erased = (size_t *)malloc(this->erased_count * sizeof(size_t));
+    if (this->erased == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < this->erased_count; i++) {
+        this->erased[i] = SIZE_MAX;
+    }
+    return ESP_OK;
+}
+
+size_t WL_Cache::chip_size()
+{
+    return this->flash_drv->chip_size();
+}
+
+size_t WL_Cache::sector_size()
+{
+    return this->sec_size;
+}
+
+WL_Cache::Slot *WL_Cache::find(size_t sector)
+{
+    for (size_t i = 0; i < this->slot_count; i++) {
+        if (this->slots[i].valid && this->slots[i].sector == sector) {
+            return &this->slots[i];
+        }
+    }
+    return NULL;
+}
+
+bool WL_Cache::take_erased(size_t sector)
+{
+    for (size_t i = 0; i < this->erased_count; i++) {
+        if (this->erased[i] == sector) {
+            this->erased[i] = SIZE_MAX;
+            return true;
+        }
+    }
+    // remember the sector, dropping the one erased the longest time ago
+    this->erased[this->erased_next] = sector;
+    this->erased_next = (this->erased_next + 1) % this->erased_count;
+    return false;
+}
+
+esp_err_t WL_Cache::write_back(Slot *slot)
+{
+    esp_err_t result = this->flash_drv->erase_sector(slot->sector);
+    WL_CACHE_RESULT_CHECK(result);
+    // a sector which was only erased doesn't need to be programmed
+    bool erased = true;
+    for (size_t i = 0; i < this->sec_size; i++) {
+        if (slot->data[i] != 0xff) {
+            erased = false;
+            break;
+        }
+    }
+    if (!erased) {
+        result = this->flash_drv->write(slot->sector * this->sec_size, slot->data, this->sec_size);
+        WL_CACHE_RESULT_CHECK(result);
+    }
+    slot->dirty = false;
+    return ESP_OK;
+}
+
+esp_err_t WL_Cache::allocate(size_t sector, Slot **out_slot)
+{
+    // take a free slot, or else the one unused for the longest time
+    Slot *slot = NULL;
+    uint32_t max_age = 0;
+    for (size_t i = 0; i < this->slot_count; i++) {
+        if (!this->slots[i].valid) {
+            slot = &this->slots[i];
+            break;
+        }
+        uint32_t age = this->clock - this->slots[i].last_use;
+        if (slot == NULL || age > max_age) {
+            slot = &this->slots[i];
+            max_age = age;
+        }
+    }
+    if (slot->valid && slot->dirty) {
+        ESP_LOGV(TAG, "%s - evict sector= 0x%08x", __func__, (uint32_t) slot->sector);
+        esp_err_t result = this->write_back(slot);
+        WL_CACHE_RESULT_CHECK(result);
+    }
+    slot->valid = true;
+    slot->dirty = false;
+    slot->sector = sector;
+    slot->last_use = ++this->clock;
+    *out_slot = slot;
+    return ESP_OK;
+}
+
+esp_err_t WL_Cache::erase_sector(size_t sector)
+{
+    if (sector >= this->chip_size() / this->sec_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    Slot *slot = this->find(sector);
+    if (slot == NULL) {
+        if (!this->take_erased(sector)) {
+            // first erase of the sector within the history, it may just be streamed data
+            return this->flash_drv->erase_sector(sector);
+        }
+        esp_err_t result = this->allocate(sector, &slot);
+        WL_CACHE_RESULT_CHECK(result);
+    }
+    memset(slot->data, 0xff, this->sec_size);
+    slot->dirty = true;
+    slot->last_use = ++this->clock;
+    return ESP_OK;
+}
+
+esp_err_t WL_Cache::erase_range(size_t start_address, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    ESP_LOGD(TAG, "%s - start_address= 0x%08x, size= 0x%08x", __func__, (uint32_t) start_address, (uint32_t) size);
+    size_t erase_count = (size + this->sec_size - 1) / this->sec_size;
+    size_t start_sector = start_address / this->sec_size;
+    if (erase_count > this->slot_count) {
+        // large ranges would only flush the cache, so erase them directly and drop the cached copies
+        for (size_t i = 0; i < this->slot_count; i++) {
+            Slot *slot = &this->slots[i];
+            if (slot->valid && slot->sector >= start_sector && slot->sector < start_sector + erase_count) {
+                slot->valid = false;
+                slot->dirty = false;
+            }
+        }
+        return this->flash_drv->erase_range(start_address, size);
+    }
+    for (size_t i = 0; i < erase_count; i++) {
+        result = this->erase_sector(start_sector + i);
+        WL_CACHE_RESULT_CHECK(result);
+    }
+    return result;
+}
+
+esp_err_t WL_Cache::write(size_t dest_addr, const void *src, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    if (dest_addr + size > this->chip_size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGD(TAG, "%s - dest_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) dest_addr, (uint32_t) size);
+    const uint8_t *data = (const uint8_t *)src;
+    size_t done = 0;
+    size_t pass_start = 0;
+    size_t pass_size = 0;
+    while (done < size) {
+        size_t addr = dest_addr + done;
+        size_t offset = addr % this->sec_size;
+        size_t chunk = this->sec_size - offset;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        Slot *slot = this->find(addr / this->sec_size);
+        if (slot == NULL) {
+            // collect uncached sectors, so that they are written with one call
+            if (pass_size == 0) {
+                pass_start = done;
+            }
+            pass_size += chunk;
+        } else {
+            if (pass_size != 0) {
+                result = this->flash_drv->write(dest_addr + pass_start, &data[pass_start], pass_size);
+                WL_CACHE_RESULT_CHECK(result);
+                pass_size = 0;
+            }
+            memcpy(&slot->data[offset], &data[done], chunk);
+            slot->dirty = true;
+            slot->last_use = ++this->clock;
+        }
+        done += chunk;
+    }
+    if (pass_size != 0) {
+        result = this->flash_drv->write(dest_addr + pass_start, &data[pass_start], pass_size);
+        WL_CACHE_RESULT_CHECK(result);
+    }
+    return result;
+}
+
+esp_err_t WL_Cache::read(size_t src_addr, void *dest, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    if (src_addr + size > this->chip_size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGD(TAG, "%s - src_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) src_addr, (uint32_t) size);
+    uint8_t *data = (uint8_t *)dest;
+    size_t done = 0;
+    size_t pass_start = 0;
+    size_t pass_size = 0;
+    while (done < size) {
+        size_t addr = src_addr + done;
+        size_t offset = addr % this->sec_size;
+        size_t chunk = this->sec_size - offset;
+        if (chunk > size - done) {
+            chunk = size - done;
+        }
+        Slot *slot = this->find(addr / this->sec_size);
+        if (slot == NULL) {
+            if (pass_size == 0) {
+                pass_start = done;
+            }
+            pass_size += chunk;
+        } else {
+            if (pass_size != 0) {
+                result = this->flash_drv->read(src_addr + pass_start, &data[pass_start], pass_size);
+                WL_CACHE_RESULT_CHECK(result);
+                pass_size = 0;
+            }
+            memcpy(&data[done], &slot->data[offset], chunk);
+            slot->last_use = ++this->clock;
+        }
+        done += chunk;
+    }
+    if (pass_size != 0) {
+        result = this->flash_drv->read(src_addr + pass_start, &data[pass_start], pass_size);
+        WL_CACHE_RESULT_CHECK(result);
+    }
+    return result;
+}
+
+esp_err_t WL_Cache::sync()
+{
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < this->slot_count; i++) {
+        Slot *slot = &this->slots[i];
+        if (slot->valid && slot->dirty) {
+            result = this->write_back(slot);
+            WL_CACHE_RESULT_CHECK(result);
+        }
+    }
+    return result;
+}
+
+esp_err_t WL_Cache::flush()
+{
+    esp_err_t result = this->sync();
+    WL_CACHE_RESULT_CHECK(result);
+    return this->flash_drv->flush();
+}
+
+bool WL_Cache::is_sector_safe(size_t sector)
+{
+    Slot *slot = this->find(sector);
+    return slot == NULL || !slot->dirty;
+}
+
+size_t WL_Cache::dirty_count()
+{
+    size_t count = 0;
+    for (size_t i = 0; i < this->slot_count; i++) {
+        if (this->slots[i].valid && this->slots[i].dirty) {
+            count++;
+        }
+    }
+    return count;
+}
+
+Flash_Access *WL_Cache::get_drv()
+{
+    return this->flash_drv;
+}
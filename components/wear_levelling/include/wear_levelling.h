@@ -104,6 +104,33 @@ esp_err_t wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t
 */
 esp_err_t wl_read(wl_handle_t handle, size_t src_addr, void *dest, size_t size);
 
+/**
+* @brief Write cached sectors back to the flash
+*
+* If the sector cache is enabled (CONFIG_WL_CACHE), erased and written sectors are kept in RAM
+* and written back on eviction, periodically and on unmount. This function writes back all of them.
+* Without the cache, data is always written to the flash directly and the function does nothing.
+*
+* @param handle WL module handle that was initialized before
+*
+* @return
+*       - ESP_OK, if all cached sectors were written back;
+*       - ESP_ERR_NOT_FOUND, if the handle is not valid;
+*       - or one of error codes from lower-level flash driver.
+*/
+esp_err_t wl_flush(wl_handle_t handle);
+
+/**
+* @brief Check if a sector would survive a power loss
+*
+* @param handle WL module handle that was initialized before
+* @param sector sector number, in units of wl_sector_size(...)
+*
+* @return false if the sector has been modified in the sector cache but not written back to the flash yet,
+*         or if the handle is not valid; true otherwise
+*/
+bool wl_is_sector_safe(wl_handle_t handle, size_t sector);
+
 /**
 * @brief Get size of the WL storage
 *
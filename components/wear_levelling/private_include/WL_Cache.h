@@ -0,0 +1,91 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _WL_Cache_H_
+#define _WL_Cache_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "Flash_Access.h"
+
+/**
+* @brief Write-back RAM cache of whole sectors, placed on top of another Flash_Access (usually WL_Flash)
+*
+* A sector is only taken into the cache when it is erased for the second time within a short history of
+* erased sectors; the first erase goes straight to the lower layer. Sectors rewritten again and again, like
+* FAT and directory sectors, are then cached, while data sectors of a streamed file, each erased and
+* written once, don't evict them. Once cached, erasing the sector (alone or in a range that fits into the
+* cache) doesn't touch the flash: the sector is kept in RAM as erased and following writes only modify
+* the RAM copy. A dirty sector is written back (erased and programmed once) when it is evicted to make room
+* for another sector, and on sync() or flush(). Writes to sectors which are not cached go straight to
+* the lower layer.
+*
+* A sector which is dirty in the cache is not crash-safe: if power is lost before it is written back,
+* the flash still holds its old contents. is_sector_safe() reports this per sector.
+*/
+class WL_Cache : public Flash_Access
+{
+public:
+    WL_Cache();
+    ~WL_Cache() override;
+
+    /**
+    * @brief Allocate cache_sectors sector buffers for caching flash_drv
+    */
+    esp_err_t config(Flash_Access *flash_drv, size_t cache_sectors);
+
+    size_t chip_size() override;
+    size_t sector_size() override;
+
+    esp_err_t erase_sector(size_t sector) override;
+    esp_err_t erase_range(size_t start_address, size_t size) override;
+
+    esp_err_t write(size_t dest_addr, const void *src, size_t size) override;
+    esp_err_t read(size_t src_addr, void *dest, size_t size) override;
+
+    /**
+    * @brief Write back all dirty sectors and flush the lower layer
+    */
+    esp_err_t flush() override;
+
+    /**
+    * @brief Write back all dirty sectors; the lower layer is not flushed
+    */
+    esp_err_t sync();
+
+    /**
+    * @brief Return false if the sector holds data which hasn't been written back to flash yet
+    */
+    bool is_sector_safe(size_t sector);
+
+    size_t dirty_count();
+
+    Flash_Access *get_drv();
+
+protected:
+    struct Slot {
+        size_t sector;
+        uint32_t last_use;
+        bool valid;
+        bool dirty;
+        uint8_t *data;
+    };
+
+    Flash_Access *flash_drv = NULL;
+    Slot *slots = NULL;
+    size_t slot_count = 0;
+    size_t sec_size = 0;
+    uint32_t clock = 0;
+    size_t *erased = NULL;
+    size_t erased_count = 0;
+    size_t erased_next = 0;
+
+    Slot *find(size_t sector);
+    bool take_erased(size_t sector);
+    esp_err_t allocate(size_t sector, Slot **out_slot);
+    esp_err_t write_back(Slot *slot);
+};
+
+#endif // _WL_Cache_H_
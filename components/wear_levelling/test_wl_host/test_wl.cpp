@@ -6,11 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <chrono>
 
 #include "spi_flash_mmap.h"
 #include "esp_partition.h"
 #include "wear_levelling.h"
 #include "WL_Flash.h"
+#include "WL_Cache.h"
+#include "Partition.h"
 #include "SpiFlash.h"
 
 #include "catch.hpp"
@@ -213,3 +216,278 @@ TEST_CASE("power down test", "[wear_levelling]")
     result = wl_unmount(wl_handle);
     REQUIRE(result == ESP_OK);
 }
+
+// Counts the driver calls made by WL_Flash
+class CountingPartition : public Partition
+{
+public:
+    CountingPartition(const esp_partition_t *partition) : Partition(partition) {}
+
+    esp_err_t write(size_t dest_addr, const void *src, size_t size) override
+    {
+        write_calls++;
+        return Partition::write(dest_addr, src, size);
+    }
+
+    esp_err_t read(size_t src_addr, void *dest, size_t size) override
+    {
+        read_calls++;
+        return Partition::read(src_addr, dest, size);
+    }
+
+    size_t write_calls = 0;
+    size_t read_calls = 0;
+};
+
+static void init_wl_flash(WL_Flash &wl_flash, Flash_Access *part, const esp_partition_t *partition)
+{
+    wl_config_t cfg;
+    cfg.full_mem_size = partition->size;
+    cfg.start_addr = 0;
+    cfg.version = 2;
+    cfg.sector_size = SPI_FLASH_SEC_SIZE;
+    cfg.page_size = SPI_FLASH_SEC_SIZE;
+    cfg.updaterate = 16;
+    cfg.temp_buff_size = 32;
+    cfg.wr_size = 16;
+    REQUIRE(wl_flash.config(&cfg, part) == ESP_OK);
+    REQUIRE(wl_flash.init() == ESP_OK);
+}
+
+TEST_CASE("multi-sector access matches per-sector access at every dummy block position", "[wear_levelling]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    CountingPartition part(partition);
+    WL_Flash wl_flash;
+    init_wl_flash(wl_flash, &part, partition);
+
+    const size_t sector_size = wl_flash.sector_size();
+    const size_t size = wl_flash.chip_size();
+    const size_t sectors = size / sector_size;
+    uint32_t *data = (uint32_t *) malloc(size);
+    uint8_t *read = (uint8_t *) malloc(size);
+
+    // flush() moves the dummy block by one page, so this covers every position of it
+    for (size_t round = 0; round < sectors + 2; round++) {
+        for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+            data[i] = round * size + i;
+        }
+        REQUIRE(wl_flash.erase_range(0, size) == ESP_OK);
+
+        // write everything at once, starting in the middle of a sector, and read it back sector by sector
+        const size_t offset = 100;
+        part.write_calls = 0;
+        REQUIRE(wl_flash.write(0, data, offset) == ESP_OK);
+        REQUIRE(wl_flash.write(offset, (uint8_t *) data + offset, size - offset) == ESP_OK);
+        CHECK(part.write_calls <= 4);
+        for (size_t sector = 0; sector < sectors; sector++) {
+            REQUIRE(wl_flash.read(sector * sector_size, read, sector_size) == ESP_OK);
+            REQUIRE(memcmp(read, (uint8_t *) data + sector * sector_size, sector_size) == 0);
+        }
+
+        // and the other way round
+        for (size_t sector = 0; sector < sectors; sector++) {
+            REQUIRE(wl_flash.erase_sector(sector) == ESP_OK);
+            REQUIRE(wl_flash.write(sector * sector_size, (uint8_t *) data + sector * sector_size, sector_size) == ESP_OK);
+        }
+        part.read_calls = 0;
+        REQUIRE(wl_flash.read(0, read, size) == ESP_OK);
+        CHECK(part.read_calls <= 3);
+        REQUIRE(memcmp(read, data, size) == 0);
+
+        REQUIRE(wl_flash.flush() == ESP_OK);
+    }
+
+    free(data);
+    free(read);
+}
+
+TEST_CASE("benchmark multi-sector write and read throughput", "[wear_levelling][benchmark]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    CountingPartition part(partition);
+    WL_Flash wl_flash;
+    init_wl_flash(wl_flash, &part, partition);
+
+    // FAT cluster sized requests
+    const size_t chunk_size = 32 * 1024;
+    const size_t size = wl_flash.chip_size() / chunk_size * chunk_size;
+    uint8_t *data = (uint8_t *) malloc(chunk_size);
+    for (size_t i = 0; i < chunk_size; i++) {
+        data[i] = i;
+    }
+    REQUIRE(wl_flash.erase_range(0, size) == ESP_OK);
+
+    part.write_calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t addr = 0; addr < size; addr += chunk_size) {
+        REQUIRE(wl_flash.write(addr, data, chunk_size) == ESP_OK);
+    }
+    auto write_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    part.read_calls = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t addr = 0; addr < size; addr += chunk_size) {
+        REQUIRE(wl_flash.read(addr, data, chunk_size) == ESP_OK);
+    }
+    auto read_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    const size_t chunks = size / chunk_size;
+    // a request is only split where it crosses the dummy block or the end of the rotated address space
+    CHECK(part.write_calls <= chunks + 2);
+    CHECK(part.read_calls <= chunks + 2);
+
+    printf("%u requests of %u bytes: write %u driver calls, %lld us; read %u driver calls, %lld us\n",
+           (unsigned) chunks, (unsigned) chunk_size, (unsigned) part.write_calls, (long long) write_us,
+           (unsigned) part.read_calls, (long long) read_us);
+
+    free(data);
+}
+
+TEST_CASE("sector cache reads back what was written and writes it back on sync", "[wear_levelling]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    CountingPartition part(partition);
+    WL_Flash wl_flash;
+    init_wl_flash(wl_flash, &part, partition);
+    WL_Cache cache;
+    REQUIRE(cache.config(&wl_flash, 4) == ESP_OK);
+
+    const size_t sector_size = cache.sector_size();
+    const size_t size = 32 * sector_size;
+    uint8_t *expected = (uint8_t *) malloc(size);
+    uint8_t *read = (uint8_t *) malloc(size);
+    uint8_t chunk[700];
+    REQUIRE(cache.erase_range(0, size) == ESP_OK);
+    memset(expected, 0xff, size);
+
+    srand(1);
+    for (int i = 0; i < 2000; i++) {
+        // rewrite a part of one of few hot sectors, or write to a sector which was erased before
+        size_t sector = (rand() % 4 == 0) ? rand() % 32 : rand() % 6;
+        size_t offset = rand() % (sector_size - sizeof(chunk));
+        size_t len = 1 + rand() % sizeof(chunk);
+        for (size_t j = 0; j < len; j++) {
+            chunk[j] = rand();
+        }
+        if (rand() % 2 == 0) {
+            // read-modify-write of the whole sector, the way FAT does it
+            memcpy(read, expected + sector * sector_size, sector_size);
+            memcpy(read + offset, chunk, len);
+            REQUIRE(cache.erase_sector(sector) == ESP_OK);
+            REQUIRE(cache.write(sector * sector_size, read, sector_size) == ESP_OK);
+            memcpy(expected + sector * sector_size, read, sector_size);
+        } else if (expected[sector * sector_size + offset] == 0xff
+                   && memcmp(expected + sector * sector_size + offset, expected + sector * sector_size + offset + 1, len - 1) == 0) {
+            // plain write to a range which is still erased
+            REQUIRE(cache.write(sector * sector_size + offset, chunk, len) == ESP_OK);
+            memcpy(expected + sector * sector_size + offset, chunk, len);
+        }
+        if (i % 100 == 0) {
+            // accesses spanning cached and not cached sectors
+            REQUIRE(cache.read(0, read, size) == ESP_OK);
+            REQUIRE(memcmp(read, expected, size) == 0);
+        }
+    }
+    REQUIRE(cache.read(sector_size / 2, read, size - sector_size) == ESP_OK);
+    REQUIRE(memcmp(read, expected + sector_size / 2, size - sector_size) == 0);
+
+    CHECK(cache.dirty_count() > 0);
+    size_t unsafe = 0;
+    for (size_t sector = 0; sector < 32; sector++) {
+        if (!cache.is_sector_safe(sector)) {
+            unsafe++;
+        }
+    }
+    CHECK(unsafe == cache.dirty_count());
+
+    REQUIRE(cache.sync() == ESP_OK);
+    CHECK(cache.dirty_count() == 0);
+    for (size_t sector = 0; sector < 32; sector++) {
+        CHECK(cache.is_sector_safe(sector));
+    }
+    REQUIRE(wl_flash.read(0, read, size) == ESP_OK);
+    REQUIRE(memcmp(read, expected, size) == 0);
+
+    // erasing a range larger than the cache drops the cached sectors
+    REQUIRE(cache.erase_sector(1) == ESP_OK);
+    REQUIRE(cache.write(sector_size, expected, 16) == ESP_OK);
+    REQUIRE(cache.erase_range(0, 8 * sector_size) == ESP_OK);
+    CHECK(cache.dirty_count() == 0);
+    REQUIRE(cache.read(0, read, 8 * sector_size) == ESP_OK);
+    for (size_t i = 0; i < 8 * sector_size; i++) {
+        REQUIRE(read[i] == 0xff);
+    }
+    REQUIRE(cache.flush() == ESP_OK);
+
+    free(expected);
+    free(read);
+}
+
+// Sector accesses of FAT filesystem appending to files: each sector write of diskio_wl.c is an erase and a write,
+// every new data sector updates the FAT sector, and closing a file updates the directory sector.
+static void fat_workload(Flash_Access *access, size_t files, size_t sectors_per_file)
+{
+    const size_t sector_size = access->sector_size();
+    const size_t fat_sector = 1;
+    const size_t dir_sector = 2;
+    size_t data_sector = 8;
+    uint8_t *buf = (uint8_t *) malloc(sector_size);
+    for (size_t file = 0; file < files; file++) {
+        for (size_t i = 0; i < sectors_per_file; i++) {
+            memset(buf, file + i, sector_size);
+            REQUIRE(access->erase_range(data_sector * sector_size, sector_size) == ESP_OK);
+            REQUIRE(access->write(data_sector * sector_size, buf, sector_size) == ESP_OK);
+            data_sector++;
+
+            REQUIRE(access->read(fat_sector * sector_size, buf, sector_size) == ESP_OK);
+            buf[data_sector % sector_size] = file;
+            REQUIRE(access->erase_range(fat_sector * sector_size, sector_size) == ESP_OK);
+            REQUIRE(access->write(fat_sector * sector_size, buf, sector_size) == ESP_OK);
+        }
+        REQUIRE(access->read(dir_sector * sector_size, buf, sector_size) == ESP_OK);
+        buf[(file * 32) % sector_size] = file;
+        REQUIRE(access->erase_range(dir_sector * sector_size, sector_size) == ESP_OK);
+        REQUIRE(access->write(dir_sector * sector_size, buf, sector_size) == ESP_OK);
+    }
+    free(buf);
+}
+
+TEST_CASE("benchmark erase count of FAT workload with and without sector cache", "[wear_levelling][benchmark]")
+{
+    const size_t files = 50;
+    const size_t sectors_per_file = 4;
+    const esp_partition_t *partition;
+    uint32_t erases[2];
+
+    for (int cached = 0; cached < 2; cached++) {
+        _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+        partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+        CountingPartition part(partition);
+        WL_Flash wl_flash;
+        init_wl_flash(wl_flash, &part, partition);
+        WL_Cache cache;
+        REQUIRE(cache.config(&wl_flash, 4) == ESP_OK);
+
+        spiflash.reset_total_erase_cycles();
+        if (cached) {
+            fat_workload(&cache, files, sectors_per_file);
+            // f_close() writes back the cache
+            REQUIRE(cache.sync() == ESP_OK);
+        } else {
+            fat_workload(&wl_flash, files, sectors_per_file);
+        }
+        erases[cached] = spiflash.get_total_erase_cycles();
+    }
+
+    // the data sectors are erased once anyway, FAT and directory sectors once per eviction instead of once per update
+    CHECK(erases[1] * 2 < erases[0]);
+    printf("%u files of %u sectors: %u erases without cache, %u erases with a 4 sector cache\n",
+           (unsigned) files, (unsigned) sectors_per_file, (unsigned) erases[0], (unsigned) erases[1]);
+}
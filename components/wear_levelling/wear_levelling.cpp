@@ -15,6 +15,12 @@
 #include "WL_Ext_Safe.h"
 #include "SPI_Flash.h"
 #include "Partition.h"
+#include "WL_Cache.h"
+#if CONFIG_WL_CACHE && CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
 
 #ifndef MAX_WL_HANDLES
 #define MAX_WL_HANDLES 8
@@ -40,17 +46,77 @@
 #define WL_CURRENT_VERSION  2
 #endif //WL_CURRENT_VERSION
 
+#ifndef WL_FLUSH_TASK_STACK_SIZE
+#define WL_FLUSH_TASK_STACK_SIZE    3072
+#endif //WL_FLUSH_TASK_STACK_SIZE
+
+#ifndef WL_FLUSH_TASK_PRIORITY
+#define WL_FLUSH_TASK_PRIORITY  (tskIDLE_PRIORITY + 1)
+#endif //WL_FLUSH_TASK_PRIORITY
+
 typedef struct {
     WL_Flash *instance;
+    WL_Cache *cache; // NULL if sectors are not cached
+#if CONFIG_WL_CACHE && CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+    esp_timer_handle_t flush_timer;
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
     _lock_t lock;
 } wl_instance_t;
 
 static wl_instance_t s_instances[MAX_WL_HANDLES];
 static _lock_t s_instances_lock;
 static const char *TAG = "wear_levelling";
+#if CONFIG_WL_CACHE && CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+// Writes back the caches of all instances, created by the first wl_mount and never deleted
+static TaskHandle_t s_flush_task;
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
 
 static esp_err_t check_handle(wl_handle_t handle, const char *func);
 
+// Reads and writes go through the cache, if there is one
+static inline Flash_Access *get_access(wl_handle_t handle)
+{
+    if (s_instances[handle].cache != NULL) {
+        return s_instances[handle].cache;
+    }
+    return s_instances[handle].instance;
+}
+
+#if CONFIG_WL_CACHE && CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+// The esp_timer task must not be held up by erasing and programming flash,
+// so the timer only sets the bit of its instance in the notification value of the flush task
+static void flush_timer_cb(void *arg)
+{
+    wl_handle_t handle = (wl_handle_t)(intptr_t) arg;
+    xTaskNotify(s_flush_task, 1UL << handle, eSetBits);
+}
+
+static void flush_task(void *arg)
+{
+    while (true) {
+        uint32_t pending = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &pending, portMAX_DELAY);
+        for (wl_handle_t handle = 0; handle < MAX_WL_HANDLES; handle++) {
+            if ((pending & (1UL << handle)) == 0) {
+                continue;
+            }
+            // wl_unmount frees the instance with the instances lock held, so it can't go away during the sync.
+            // A bit left by the timer of an unmounted instance at most syncs the instance mounted after it.
+            _lock_acquire(&s_instances_lock);
+            if (s_instances[handle].cache != NULL) {
+                _lock_acquire(&s_instances[handle].lock);
+                esp_err_t result = s_instances[handle].cache->sync();
+                _lock_release(&s_instances[handle].lock);
+                if (result != ESP_OK) {
+                    ESP_LOGE(TAG, "%s: sync instance=0x%08x, result=0x%x", __func__, handle, result);
+                }
+            }
+            _lock_release(&s_instances_lock);
+        }
+    }
+}
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
+
 esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
 {
     // Initialize variables before the first jump to cleanup label
@@ -58,6 +124,7 @@ esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
     WL_Flash *wl_flash = NULL;
     void *part_ptr = NULL;
     Partition *part = NULL;
+    WL_Cache *cache = NULL;
 
     _lock_acquire(&s_instances_lock);
     esp_err_t result = ESP_OK;
@@ -141,14 +208,57 @@ esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
         ESP_LOGE(TAG, "%s: init instance=0x%08x, result=0x%x", __func__, *out_handle, result);
         goto out;
     }
+
+#if CONFIG_WL_CACHE
+    cache = new (std::nothrow) WL_Cache();
+    if (cache == NULL) {
+        result = ESP_ERR_NO_MEM;
+        ESP_LOGE(TAG, "%s: can't allocate WL_Cache", __func__);
+        goto out;
+    }
+    result = cache->config(wl_flash, CONFIG_WL_CACHE_SECTORS);
+    if (ESP_OK != result) {
+        ESP_LOGE(TAG, "%s: config cache instance=0x%08x, result=0x%x", __func__, *out_handle, result);
+        goto out;
+    }
+#if CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+    if (s_flush_task == NULL) {
+        if (xTaskCreate(flush_task, "wl_flush", WL_FLUSH_TASK_STACK_SIZE, NULL, WL_FLUSH_TASK_PRIORITY, &s_flush_task) != pdPASS) {
+            result = ESP_ERR_NO_MEM;
+            ESP_LOGE(TAG, "%s: can't create flush task", __func__);
+            goto out;
+        }
+    }
+    {
+        const esp_timer_create_args_t timer_args = {
+            .callback = &flush_timer_cb,
+            .arg = (void *)(intptr_t) *out_handle,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "wl_flush",
+            .skip_unhandled_events = true,
+        };
+        result = esp_timer_create(&timer_args, &s_instances[*out_handle].flush_timer);
+        if (ESP_OK != result) {
+            ESP_LOGE(TAG, "%s: create flush timer instance=0x%08x, result=0x%x", __func__, *out_handle, result);
+            goto out;
+        }
+    }
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
+#endif // CONFIG_WL_CACHE
+
     s_instances[*out_handle].instance = wl_flash;
+    s_instances[*out_handle].cache = cache;
     _lock_init(&s_instances[*out_handle].lock);
+#if CONFIG_WL_CACHE && CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+    esp_timer_start_periodic(s_instances[*out_handle].flush_timer, CONFIG_WL_CACHE_FLUSH_PERIOD_MS * 1000ULL);
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
     _lock_release(&s_instances_lock);
     return ESP_OK;
 
 out:
     _lock_release(&s_instances_lock);
     *out_handle = WL_INVALID_HANDLE;
+    delete cache;
     if (wl_flash) {
         wl_flash->~WL_Flash();
         free(wl_flash);
@@ -166,8 +276,15 @@ esp_err_t wl_unmount(wl_handle_t handle)
     _lock_acquire(&s_instances_lock);
     result = check_handle(handle, __func__);
     if (result == ESP_OK) {
-        // We have to flush state of the component
-        result = s_instances[handle].instance->flush();
+#if CONFIG_WL_CACHE && CONFIG_WL_CACHE_FLUSH_PERIOD_MS > 0
+        // A callback which is still running only notifies the flush task, which waits for the instances lock
+        esp_timer_stop(s_instances[handle].flush_timer);
+        esp_timer_delete(s_instances[handle].flush_timer);
+#endif // CONFIG_WL_CACHE_FLUSH_PERIOD_MS
+        // We have to flush state of the component, the cache writes back its sectors first
+        result = get_access(handle)->flush();
+        delete s_instances[handle].cache;
+        s_instances[handle].cache = NULL;
         // We use placement new in wl_mount, so call destructor directly
         Flash_Access *drv = s_instances[handle].instance->get_drv();
         drv->~Flash_Access();
@@ -188,7 +305,7 @@ esp_err_t wl_erase_range(wl_handle_t handle, size_t start_addr, size_t size)
         return result;
     }
     _lock_acquire(&s_instances[handle].lock);
-    result = s_instances[handle].instance->erase_range(start_addr, size);
+    result = get_access(handle)->erase_range(start_addr, size);
     _lock_release(&s_instances[handle].lock);
     return result;
 }
@@ -200,7 +317,7 @@ esp_err_t wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t
         return result;
     }
     _lock_acquire(&s_instances[handle].lock);
-    result = s_instances[handle].instance->write(dest_addr, src, size);
+    result = get_access(handle)->write(dest_addr, src, size);
     _lock_release(&s_instances[handle].lock);
     return result;
 }
@@ -212,7 +329,35 @@ esp_err_t wl_read(wl_handle_t handle, size_t src_addr, void *dest, size_t size)
         return result;
     }
     _lock_acquire(&s_instances[handle].lock);
-    result = s_instances[handle].instance->read(src_addr, dest, size);
+    result = get_access(handle)->read(src_addr, dest, size);
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
+esp_err_t wl_flush(wl_handle_t handle)
+{
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    if (s_instances[handle].cache != NULL) {
+        result = s_instances[handle].cache->sync();
+    }
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
+bool wl_is_sector_safe(wl_handle_t handle, size_t sector)
+{
+    if (check_handle(handle, __func__) != ESP_OK) {
+        return false;
+    }
+    bool result = true;
+    _lock_acquire(&s_instances[handle].lock);
+    if (s_instances[handle].cache != NULL) {
+        result = s_instances[handle].cache->is_sector_safe(sector);
+    }
     _lock_release(&s_instances[handle].lock);
     return result;
 }
@@ -224,7 +369,7 @@ size_t wl_size(wl_handle_t handle)
         return 0;
     }
     _lock_acquire(&s_instances[handle].lock);
-    size_t result = s_instances[handle].instance->chip_size();
+    size_t result = get_access(handle)->chip_size();
     _lock_release(&s_instances[handle].lock);
     return result;
 }
@@ -236,7 +381,7 @@ size_t wl_sector_size(wl_handle_t handle)
         return 0;
     }
     _lock_acquire(&s_instances[handle].lock);
-    size_t result = s_instances[handle].instance->sector_size();
+    size_t result = get_access(handle)->sector_size();
     _lock_release(&s_instances[handle].lock);
     return result;
 }
@@ -561,7 +561,7 @@ TEST_CASE("ESPEventLoop custom loop register, receive, unregister ESPEvent", "[c
 {
     EventFixture f;
     ESPEvent event;
-    esp_event_loop_args_t loop_args;
+    esp_event_loop_args_t loop_args = {};
     loop_args.queue_size = 32;
     loop_args.task_name = "sys_evt";
     loop_args.task_stack_size = 2304;
@@ -744,7 +744,7 @@ TEST_CASE("ESPEventAPIDefault initialization failure", "[cxx event]")
 TEST_CASE("ESPEventAPICustom no mem", "[cxx event]")
 {
     EventFixture f;
-    esp_event_loop_args_t loop_args;
+    esp_event_loop_args_t loop_args = {};
     loop_args.queue_size = 1000000;
     loop_args.task_name = "custom_evt";
     loop_args.task_stack_size = 2304;
@@ -0,0 +1,201 @@
+# SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+import re
+import struct
+from typing import Dict, List, Optional, Tuple
+
+from .output_helpers import yellow_print
+
+# Binary log frames, see components/log/log_binary.c for the format
+BINARY_LOG_FRAME_START = b'\x1e'
+BINARY_LOG_FRAME_ESCAPE = 0x1f
+
+# Conversion specifications supported by the application, see components/log/log_args.c
+SPEC_RE = re.compile(rb"%([-+ #0']*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|q|j|z|t|L)?([diuoxXcpsfFeEgGaA%])")
+
+
+class BinaryLogError(Exception):
+    pass
+
+
+class _Frame:
+    def __init__(self, data):  # type: (bytes) -> None
+        self.data = data
+        self.pos = 0
+
+    def read(self, size):  # type: (int) -> bytes
+        if self.pos + size > len(self.data):
+            raise BinaryLogError('frame too short')
+        data = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return data
+
+    def read_u32(self):  # type: () -> int
+        return int(struct.unpack('<I', self.read(4))[0])
+
+    def read_double(self):  # type: () -> float
+        return float(struct.unpack('<d', self.read_varint().to_bytes(8, 'big'))[0])
+
+    def read_varint(self):  # type: () -> int
+        value = 0
+        shift = 0
+        while True:
+            b = self.read(1)[0]
+            value |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return value
+
+    def read_signed(self):  # type: () -> int
+        value = self.read_varint()
+        return (value >> 1) ^ -(value & 1)
+
+
+class BinaryLog:
+    """
+    Decodes the log messages output in binary form when CONFIG_LOG_BINARY is enabled. The format strings, and the
+    strings passed by address, are read from the ELF file of the application.
+    """
+    def __init__(self, elf_file):  # type: (str) -> None
+        self.elf_file = elf_file
+        self._sections = None  # type: Optional[List[Tuple[int, bytes]]]
+        self._strings = {}  # type: Dict[int, bytes]
+        self._load_failed = False
+
+    @staticmethod
+    def is_partial_frame(line):  # type: (bytes) -> bool
+        return BINARY_LOG_FRAME_START in line
+
+    def _load(self):  # type: () -> bool
+        if self._sections is not None:
+            return True
+        if self._load_failed:
+            return False
+        try:
+            from elftools.elf.constants import SH_FLAGS
+            from elftools.elf.elffile import ELFFile
+            with open(self.elf_file, 'rb') as f:
+                elf = ELFFile(f)
+                self._sections = [(s['sh_addr'], s.data()) for s in elf.iter_sections()
+                                  if s['sh_type'] == 'SHT_PROGBITS' and s['sh_flags'] & SH_FLAGS.SHF_ALLOC]
+            return True
+        except ImportError as e:
+            yellow_print('Failed to decode binary log output: Module {} is not installed'.format(e.name))
+        except Exception as e:
+            yellow_print('Failed to decode binary log output: Can\'t read the ELF file {} ({})'.format(self.elf_file, e))
+        self._load_failed = True
+        return False
+
+    def _read_string(self, address):  # type: (int) -> bytes
+        string = self._strings.get(address)
+        if string is not None:
+            return string
+        for start, data in self._sections or []:
+            if start <= address < start + len(data):
+                end = data.find(b'\0', address - start)
+                if end < 0:
+                    break
+                string = data[address - start:end]
+                self._strings[address] = string
+                return string
+        raise BinaryLogError('no string at address 0x{:08x}'.format(address))
+
+    @staticmethod
+    def _unescape(data):  # type: (bytes) -> bytes
+        if BINARY_LOG_FRAME_ESCAPE not in data:
+            return data
+        out = bytearray()
+        escaped = False
+        for b in data:
+            if escaped:
+                out.append(b ^ 0x20)
+                escaped = False
+            elif b == BINARY_LOG_FRAME_ESCAPE:
+                escaped = True
+            else:
+                out.append(b)
+        return bytes(out)
+
+    def _format_spec(self, frame, flags, width, precision, conversion):
+        # type: (_Frame, bytes, Optional[bytes], Optional[bytes], bytes) -> bytes
+        flags = flags.replace(b"'", b'')
+        if width == b'*':
+            w = frame.read_signed()
+            if w < 0:
+                flags += b'-'
+            width = str(abs(w)).encode()
+        prec = -1
+        if precision == b'*':
+            prec = frame.read_signed()
+        elif precision is not None:
+            prec = int(precision or b'0')
+
+        value = None  # type: object
+        if conversion in b'di':
+            value = frame.read_signed()
+        elif conversion in b'uoxXcp':
+            value = frame.read_varint()
+            if conversion == b'p':
+                # Like newlib, including for null pointers
+                value = b'0x%x' % value
+                conversion = b's'
+                flags = flags.replace(b'#', b'').replace(b'0', b'')
+                prec = -1
+            elif value == 0 and conversion in b'xX':
+                # C doesn't prefix 0 with 0x
+                flags = flags.replace(b'#', b'')
+            elif conversion == b'o' and b'#' in flags:
+                flags = flags.replace(b'#', b'')
+                prec = max(prec, len('{:o}'.format(value)) + (1 if value else 0))
+        elif conversion in b'fFeEgGaA':
+            value = frame.read_double()
+            if conversion in b'aA':
+                value = value.hex().encode()
+                if conversion == b'A':
+                    value = value.upper()
+                conversion = b's'
+                prec = -1
+        elif conversion == b's':
+            length = frame.read_varint()
+            value = self._read_string(frame.read_u32()) if length == 0 else frame.read(length - 1)
+        if conversion in b'diuoxX' and prec == 0 and value == 0:
+            # C outputs no digits for 0 with a precision of 0, only the sign requested by the flags
+            value = b''
+            if conversion in b'di':
+                value = b'+' if b'+' in flags else b' ' if b' ' in flags else b''
+            conversion = b's'
+            flags = b'-' if b'-' in flags else b''
+            prec = -1
+        spec = b'%' + flags + (width or b'') + (b'.%d' % prec if prec >= 0 else b'') + conversion
+        return spec % value
+
+    def _format(self, frame):  # type: (_Frame) -> bytes
+        fmt = self._read_string(frame.read_u32())
+        out = []
+        last = 0
+        for m in SPEC_RE.finditer(fmt):
+            out.append(fmt[last:m.start()])
+            last = m.end()
+            flags, width, precision, _, conversion = m.groups()
+            if conversion == b'%':
+                out.append(b'%')
+            else:
+                out.append(self._format_spec(frame, flags, width, precision, conversion))
+        out.append(fmt[last:])
+        return b''.join(out)
+
+    def decode(self, line):  # type: (bytes) -> bytes
+        """
+        Return the line with the binary log frame it contains, if any, replaced by the formatted message
+        """
+        pos = line.find(BINARY_LOG_FRAME_START)
+        if pos < 0 or not self._load():
+            return line
+        text = line[:pos]
+        frame = _Frame(self._unescape(line[pos + 1:].rstrip(b'\r')))
+        try:
+            message = self._format(frame)
+        except (BinaryLogError, TypeError, ValueError, OverflowError) as e:
+            return text + '(binary log frame could not be decoded: {})'.format(e).encode()
+        # The newline ending the frame is kept by the caller
+        return text + message.rstrip(b'\r\n')
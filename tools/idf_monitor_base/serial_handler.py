@@ -12,6 +12,7 @@ from typing import Callable, Optional
 import serial  # noqa: F401
 from serial.tools import miniterm  # noqa: F401
 
+from .binary_log import BinaryLog
 from .chip_specific_config import get_chip_config
 from .console_parser import ConsoleParser, prompt_next_action  # noqa: F401
 from .console_reader import ConsoleReader  # noqa: F401
@@ -73,6 +74,7 @@ class SerialHandler:
         self.encrypted = encrypted
         self.reset = reset
         self.elf_file = elf_file
+        self.binary_log = BinaryLog(elf_file)
 
     def handle_serial_input(self, data, console_parser, coredump, gdb_helper, line_matcher,
                             check_gdb_stub_and_run, finalize_line=False):
@@ -95,6 +97,7 @@ class SerialHandler:
         for line in sp:
             if line == b'':
                 continue
+            line = self.binary_log.decode(line)
             if self._serial_check_exit and line == console_parser.exit_key.encode('latin-1'):
                 raise SerialStopException()
             if gdb_helper:
@@ -114,7 +117,9 @@ class SerialHandler:
             self._force_line_print,
             (finalize_line and line_matcher.match(self._last_line_part.decode(errors='ignore')))
         ))
-        if self._last_line_part != b'' and force_print_or_matched:
+        # binary log frames are only decoded once complete
+        if self._last_line_part != b'' and force_print_or_matched and \
+                not self.binary_log.is_partial_frame(self._last_line_part):
             self._force_line_print = True
             self.logger.print(self._last_line_part)
             self.logger.handle_possible_pc_address_in_line(self._last_line_part)
@@ -248,6 +253,7 @@ class SerialHandlerNoElf(SerialHandler):
         for line in sp:
             if line == b'':
                 continue
+            line = self.binary_log.decode(line)
             if self._serial_check_exit and line == console_parser.exit_key.encode('latin-1'):
                 raise SerialStopException()
 
@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Outputs binary log frames for test_binary_log.py, built for the host along with
+ * components/log/log_binary.c and log_args.c.
+ *
+ * For each message, the output of esp_log_binary_write() (or the message formatted as
+ * text when it can't be encoded, like esp_log_writev() does) is followed by a line
+ * holding "=" and the message formatted by the C library, which the decoded frame
+ * has to match. The executable has to be linked at a fixed address below 4 GB, like
+ * the application, and the bounds of its read-only data are given as _rodata_start
+ * and _rodata_end.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_log_private.h"
+
+int esp_log_vprint(const char *format, va_list args)
+{
+    return vprintf(format, args);
+}
+
+static void log_message(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    if (!esp_log_binary_write(format, args)) {
+        va_list copy;
+        va_copy(copy, args);
+        vprintf(format, copy);
+        va_end(copy);
+        printf("\n");
+    }
+    va_end(args);
+    va_start(args, format);
+    printf("=");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+// Not part of the read-only data, so not in the ELF file as it is when logged
+static char s_data_string[16] = "initial";
+
+int main(void)
+{
+    char stack_string[16];
+    char stack_format[16];
+    strcpy(stack_string, "on the stack");
+    strcpy(stack_format, "text %d");
+    strcpy(s_data_string, "modified");
+
+    log_message("I (%u) %s: no arguments", 1234u, "tag");
+    log_message("%d %d %d %i %i", 0, 5, -1, INT32_MAX, INT32_MIN);
+    log_message("%u %x %X %o %#x %#o %#x", 4000000000u, 0xbeefu, 0xbeefu, 8u, 255u, 8u, 0u);
+    log_message("%hhd %hd %hhu %hu %c", 300, 70000, 300, 70000, 'A');
+    log_message("%ld %lu %lld %llu %llx", -5L, 5UL, INT64_MIN, UINT64_MAX, 0x123456789abcdefULL);
+    log_message("%zu %td %jd", (size_t) 42, (ptrdiff_t) -7, (intmax_t) 1 << 40);
+    log_message("[%5d] [%-5d] [%05d] [%+d] [% d] [%*d] [%-*d] [%*d]", 42, 42, 42, 42, 42, 6, 42, 6, 42, -6, 42);
+    log_message("%.3d [%.0d] [%+.0d] [%-3.0x] [%#.0o] %.0d|%8.3x", 7, 0, 0, 0u, 0u, 5, 0xabu);
+    log_message("%f %.2f %10.3f %e %E %g %G", 3.14159, -2.5, 1e3, 12345.678, 0.000123, 1e-10, 1e20);
+    log_message("%s %s %s", "literal", stack_string, s_data_string);
+    log_message("[%.3s] [%.*s] [%10s] [%-10s] [%.*s]", "truncated", 4, stack_string, "right", "left", -1, "negative");
+    log_message("%s", (const char *) NULL);
+    log_message("escaped %s", "\x1e\r\x1f.");
+    log_message("100%% %s", "done");
+    // Not part of the read-only data either, output as text
+    log_message(stack_format, 42);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+
+# Encodes log messages with components/log/log_binary.c, built for the host, and checks that
+# idf_monitor decodes the frames into the messages formatted by the C library.
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+try:
+    from idf_monitor_base.binary_log import BinaryLog
+except ImportError:
+    sys.path.append('..')
+    from idf_monitor_base.binary_log import BinaryLog
+
+LOG_DIR = os.path.join(os.path.dirname(os.path.realpath(__file__)), '..', '..', 'components', 'log')
+GENERATOR = os.path.join(os.path.dirname(os.path.realpath(__file__)), 'binary_log_frames.c')
+
+
+class TestBinaryLog(unittest.TestCase):
+    def setUp(self):  # type: () -> None
+        self.tmp_dir = tempfile.TemporaryDirectory()
+        self.elf_file = os.path.join(self.tmp_dir.name, 'binary_log_frames')
+        with open(os.path.join(self.tmp_dir.name, 'sdkconfig.h'), 'w'):
+            pass
+        # Linked at a fixed address, so that addresses fit in the 4 bytes of the frames. The read-only data
+        # ends where .eh_frame_hdr starts, and the writable data isn't part of it.
+        subprocess.check_call([os.environ.get('CC', 'cc'), '-no-pie', '-Wall', '-Werror', '-Wno-format-security',
+                               '-DCONFIG_LOG_BINARY=1', '-I', self.tmp_dir.name, '-I', LOG_DIR,
+                               '-o', self.elf_file, GENERATOR,
+                               os.path.join(LOG_DIR, 'log_binary.c'), os.path.join(LOG_DIR, 'log_args.c'),
+                               '-Wl,--defsym=_rodata_start=__executable_start',
+                               '-Wl,--defsym=_rodata_end=__GNU_EH_FRAME_HDR'])
+
+    def tearDown(self):  # type: () -> None
+        self.tmp_dir.cleanup()
+
+    def test_round_trip(self):  # type: () -> None
+        output = subprocess.check_output([self.elf_file])
+        # Frames contain no newline, so each message and its expected text are on two lines
+        lines = output.split(b'\n')[:-1]
+        self.assertEqual(len(lines) % 2, 0)
+        binary_log = BinaryLog(self.elf_file)
+        frames = 0
+        for line, expected in zip(lines[::2], lines[1::2]):
+            self.assertTrue(expected.startswith(b'='))
+            if BinaryLog.is_partial_frame(line):
+                frames += 1
+            self.assertEqual(binary_log.decode(line), expected[1:])
+        # All but the message with a format string on the stack
+        self.assertEqual(frames, len(lines) // 2 - 1)
+
+    def test_unknown_address(self):  # type: () -> None
+        decoded = BinaryLog(self.elf_file).decode(b'\x1e\xff\xff\xff\x7f')
+        self.assertIn(b'binary log frame could not be decoded', decoded)
+
+
+if __name__ == '__main__':
+    unittest.main()